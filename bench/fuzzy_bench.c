@@ -0,0 +1,203 @@
+/*
+ * Fuzzy item search over synthetic keys shaped like "qa/payments/svc2538/api-key",
+ * one million of them unless a count is given:
+ *
+ *   fuzzy_bench [n-keys]
+ *
+ * Times every prefilter the CPU runs on the same index, checking they agree,
+ * then types a query one key at a time, refining the last matches against
+ * rescanning every key, and checks both rank the same results.
+ */
+/* clock_gettime in a strict C build on glibc */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "locker_fuzzy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_DEFAULT_KEYS 1000000
+#define BENCH_TOP 20
+#define BENCH_ROUNDS 5
+
+static const char *const envs[] = {"prod", "staging", "dev", "qa"};
+static const char *const teams[] = {"payments", "billing", "auth", "search",
+                                    "infra", "mobile", "web", "data"};
+static const char *const kinds[] = {"db-password", "api-key", "oauth-secret",
+                                    "ssh-key", "tls-cert", "webhook-token",
+                                    "smtp-login", "s3-access"};
+static const char *const prefilters[] = {"scalar", "sse2", "avx2"};
+static const char *const queries[] = {"pay", "paymntdbpass", "prodauthssh",
+                                      "webhok", "zzzz"};
+/* typed one character at a time */
+static const char typed[] = "paymntdbpass";
+
+#define LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+/* fixed seed, every run indexes the same keys */
+static uint64_t next_random(uint64_t state[static 1]) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static double ms_since(const struct timespec start[static 1]) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1e3 +
+         (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static bool same_results(size_t n, const locker_fuzzy_result_t a[n],
+                         const locker_fuzzy_result_t b[n]) {
+  for (size_t i = 0; i < n; i++)
+    if (a[i].item_id != b[i].item_id || a[i].score != b[i].score)
+      return false;
+  return true;
+}
+
+/* stands in as the prefilter of the index, timing the one under test */
+static locker_fuzzy_prefilter_fn timed_prefilter;
+static double prefilter_ms;
+static size_t prefilter_candidates;
+
+static size_t timing_prefilter(const locker_fuzzy_t *fuzzy, uint64_t query_mask,
+                               int typos, uint32_t out[]) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  prefilter_candidates = timed_prefilter(fuzzy, query_mask, typos, out);
+  prefilter_ms += ms_since(&start);
+  return prefilter_candidates;
+}
+
+/* best of BENCH_ROUNDS, a fresh search every time so the prefilter runs */
+static size_t search(locker_fuzzy_t fuzzy[static 1], const char query[static 1],
+                     locker_fuzzy_result_t out[BENCH_TOP], double ms[static 1]) {
+  size_t n = 0;
+  *ms = -1;
+  prefilter_ms = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    fuzzy->has_last = false;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    n = fuzzy_search(fuzzy, query, BENCH_TOP, out);
+    double elapsed = ms_since(&start);
+    if (*ms < 0 || elapsed < *ms)
+      *ms = elapsed;
+  }
+  prefilter_ms /= BENCH_ROUNDS;
+  return n;
+}
+
+static bool bench_prefilters(locker_fuzzy_t fuzzy[static 1]) {
+  locker_fuzzy_prefilter_fn picked = fuzzy->prefilter;
+  fuzzy->prefilter = timing_prefilter;
+  bool agree = true;
+
+  printf("\n%-14s %-7s %10s %14s %10s\n", "query", "filter", "candidates",
+         "prefilter ms", "search ms");
+  for (size_t q = 0; q < LEN(queries); q++) {
+    locker_fuzzy_result_t expected[BENCH_TOP];
+    size_t n_expected = 0, expected_candidates = 0;
+
+    for (size_t p = 0; p < LEN(prefilters); p++) {
+      timed_prefilter = fuzzy_prefilter_named(prefilters[p]);
+      if (!timed_prefilter)
+        continue;
+
+      locker_fuzzy_result_t out[BENCH_TOP];
+      double ms;
+      size_t n = search(fuzzy, queries[q], out, &ms);
+      printf("%-14s %-7s %10zu %14.2f %10.2f\n", queries[q], prefilters[p],
+             prefilter_candidates, prefilter_ms, ms);
+
+      if (p == 0) {
+        memcpy(expected, out, n * sizeof(locker_fuzzy_result_t));
+        n_expected = n;
+        expected_candidates = prefilter_candidates;
+      } else if (n != n_expected || prefilter_candidates != expected_candidates ||
+                 !same_results(n, out, expected)) {
+        fprintf(stderr, "%s and scalar disagree on %s\n", prefilters[p],
+                queries[q]);
+        agree = false;
+      }
+    }
+  }
+
+  fuzzy->prefilter = picked;
+  return agree;
+}
+
+/* what typing into CTRL-F costs with and without refining the last matches */
+static bool bench_typing(locker_fuzzy_t fuzzy[static 1]) {
+  char query[sizeof(typed)];
+  double refine_ms = 0, rescan_ms = 0;
+  bool agree = true;
+
+  printf("\n%-14s %8s %10s %10s  %s\n", "typed", "matched", "refine ms",
+         "rescan ms", "best match");
+  fuzzy->has_last = false;
+  for (size_t len = 1; len < sizeof(typed); len++) {
+    memcpy(query, typed, len);
+    query[len] = '\0';
+
+    locker_fuzzy_result_t refined[BENCH_TOP], rescanned[BENCH_TOP];
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t n_refined = fuzzy_search(fuzzy, query, BENCH_TOP, refined);
+    double refine = ms_since(&start);
+    size_t n_matched = fuzzy->n_candidates;
+
+    /* the rescan leaves the same matches behind for the next key */
+    fuzzy->has_last = false;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t n_rescanned = fuzzy_search(fuzzy, query, BENCH_TOP, rescanned);
+    double rescan = ms_since(&start);
+
+    if (n_refined != n_rescanned || n_matched != fuzzy->n_candidates ||
+        !same_results(n_refined, refined, rescanned)) {
+      fprintf(stderr, "refining and rescanning disagree on %s\n", query);
+      agree = false;
+    }
+    printf("%-14s %8zu %10.1f %10.1f  %s\n", query, n_matched, refine, rescan,
+           n_refined ? refined[0].key : "-");
+    refine_ms += refine;
+    rescan_ms += rescan;
+  }
+  printf("typing %s: refine %.0f ms, rescan %.0f ms in total\n", typed,
+         refine_ms, rescan_ms);
+  return agree;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_keys = argc > 1 ? strtoull(argv[1], NULL, 10) : BENCH_DEFAULT_KEYS;
+  if (n_keys == 0) {
+    fprintf(stderr, "Usage: fuzzy_bench [n-keys]\n");
+    return EXIT_FAILURE;
+  }
+
+  locker_fuzzy_t *fuzzy = fuzzy_new();
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  char key[128];
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (size_t i = 0; i < n_keys; i++) {
+    snprintf(key, sizeof(key), "%s/%s/svc%04u/%s",
+             envs[next_random(&state) % LEN(envs)],
+             teams[next_random(&state) % LEN(teams)],
+             (unsigned)(next_random(&state) % 5000),
+             kinds[next_random(&state) % LEN(kinds)]);
+    fuzzy_add(fuzzy, key, (int64_t)i + 1, 0);
+  }
+  printf("indexed %zu keys in %.0f ms, %zu bytes of keys\n", n_keys,
+         ms_since(&start), fuzzy->keys_len);
+
+  bool agree = bench_prefilters(fuzzy) && bench_typing(fuzzy);
+
+  fuzzy_free(fuzzy);
+  return agree ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,280 @@
+/*
+ * Lookups from many threads against a writer, through locker.h only:
+ *
+ *   locker_stress [n-items] [seconds]
+ *
+ * Fills a locker in a scratch directory with n-items API keys and accounts,
+ * 5000 by default, then runs 1, 2, 4 and 8 reader threads for the given
+ * seconds each, first sharing the primary connection and then attached to
+ * connections of their own. A writer adds and deletes keys every millisecond
+ * meanwhile. Readers check every item they fetch, any mismatch makes the exit
+ * status non-zero. Every run prints its lookups per second, the speedup over
+ * the one thread run of the same kind and the CPU time per lookup, which only
+ * grows with the threads when they contend. Threads past the online CPUs can
+ * add no speedup, the count is printed first.
+ */
+/* rand_r, mkdtemp, nftw and CLOCK_PROCESS_CPUTIME_ID */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "locker.h"
+#include "sodium.h"
+#include <ftw.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STRESS_DEFAULT_ITEMS 5000
+#define STRESS_DEFAULT_SECONDS 1
+#define STRESS_MAX_THREADS 8
+/* keys the writer adds and deletes over and over */
+#define STRESS_CHURN_KEYS 32
+#define STRESS_KEY_LEN 64
+
+typedef struct {
+  locker_t *locker;
+  size_t n_items;
+  bool attach;
+  atomic_bool stop;
+  atomic_long errors;
+} stress_t;
+
+typedef struct {
+  stress_t *stress;
+  unsigned seed;
+  long lookups;
+} stress_reader_t;
+
+/* every stable item is derived from its index, readers rebuild what to expect */
+static void item_key(char key[STRESS_KEY_LEN], size_t i) {
+  snprintf(key, STRESS_KEY_LEN, "stress/%zu/%s", i % 97,
+           i % 2 ? "account" : "apikey");
+  size_t len = strlen(key);
+  snprintf(key + len, STRESS_KEY_LEN - len, "-%zu", i);
+}
+
+static void item_value(char value[STRESS_KEY_LEN], size_t i) {
+  snprintf(value, STRESS_KEY_LEN, "value-%zu", i);
+}
+
+static bool fill(locker_t *locker, size_t n_items) {
+  char key[STRESS_KEY_LEN], value[STRESS_KEY_LEN];
+  for (size_t i = 0; i < n_items; i++) {
+    item_key(key, i);
+    item_value(value, i);
+    locker_result_t result;
+    if (i % 2) {
+      locker_item_account_t account = {.key = key, .description = "stress",
+                                       .username = value, .password = value,
+                                       .url = "https://example.com"};
+      result = locker_add_account(locker, &account);
+    } else {
+      locker_item_apikey_t apikey = {.key = key, .description = "stress",
+                                     .value = value};
+      result = locker_add_apikey(locker, &apikey);
+    }
+    if (result != LOCKER_OK) {
+      fprintf(stderr, "Adding %s failed with %d.\n", key, result);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* a churned key may be gone between find and get, but never another item */
+static bool check_churned(locker_t *locker, unsigned seed[static 1],
+                          locker_arena_t arena[static 1]) {
+  char key[STRESS_KEY_LEN];
+  snprintf(key, sizeof(key), "churn/%d", rand_r(seed) % STRESS_CHURN_KEYS);
+
+  locker_item_t item;
+  if (!locker_find_item(locker, key, &item))
+    return true;
+  locker_item_apikey_t *apikey = locker_get_apikey(locker, item.id, arena);
+  return !apikey || strcmp(apikey->key, key) == 0;
+}
+
+static bool check_stable(stress_t stress[static 1], unsigned seed[static 1],
+                         locker_arena_t arena[static 1]) {
+  size_t i = (size_t)rand_r(seed) % stress->n_items;
+  char key[STRESS_KEY_LEN], value[STRESS_KEY_LEN];
+  item_key(key, i);
+  item_value(value, i);
+
+  locker_item_t item;
+  if (!locker_find_item(stress->locker, key, &item))
+    return false;
+  if (item.type == LOCKER_ITEM_ACCOUNT) {
+    locker_item_account_t *account =
+        locker_get_account(stress->locker, item.id, arena);
+    return account && strcmp(account->key, key) == 0 &&
+           strcmp(account->password, value) == 0;
+  }
+  locker_item_apikey_t *apikey = locker_get_apikey(stress->locker, item.id, arena);
+  return apikey && strcmp(apikey->key, key) == 0 &&
+         strcmp(apikey->value, value) == 0;
+}
+
+static void *reader(void *arg) {
+  stress_reader_t *reader = arg;
+  stress_t *stress = reader->stress;
+  if (stress->attach)
+    locker_attach_thread(stress->locker);
+
+  locker_arena_t arena;
+  arena_init(&arena, true);
+  while (!atomic_load(&stress->stop)) {
+    bool ok = rand_r(&reader->seed) % 64 == 0
+                  ? check_churned(stress->locker, &reader->seed, &arena)
+                  : check_stable(stress, &reader->seed, &arena);
+    if (!ok)
+      atomic_fetch_add(&stress->errors, 1);
+    arena_reset(&arena);
+    reader->lookups++;
+  }
+  arena_release(&arena);
+
+  if (stress->attach)
+    locker_detach_thread(stress->locker);
+  return NULL;
+}
+
+static void *writer(void *arg) {
+  stress_t *stress = arg;
+  unsigned seed = 7;
+  char key[STRESS_KEY_LEN];
+  const struct timespec pause = {.tv_nsec = 1000000};
+
+  while (!atomic_load(&stress->stop)) {
+    snprintf(key, sizeof(key), "churn/%d", rand_r(&seed) % STRESS_CHURN_KEYS);
+    locker_item_t item;
+    locker_result_t result;
+    if (locker_find_item(stress->locker, key, &item)) {
+      result = locker_delete_item(stress->locker, &item);
+    } else {
+      locker_item_apikey_t apikey = {.key = key, .description = "",
+                                     .value = key};
+      result = locker_add_apikey(stress->locker, &apikey);
+    }
+    if (result != LOCKER_OK)
+      atomic_fetch_add(&stress->errors, 1);
+    nanosleep(&pause, NULL);
+  }
+  return NULL;
+}
+
+static double seconds_since(clockid_t clock,
+                            const struct timespec start[static 1]) {
+  struct timespec now;
+  clock_gettime(clock, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* lookups per second, one_thread is that of the one thread run or 0 */
+static double run(stress_t stress[static 1], int n_threads, unsigned seconds,
+                  double one_thread) {
+  pthread_t threads[STRESS_MAX_THREADS], writer_thread;
+  stress_reader_t readers[STRESS_MAX_THREADS];
+  long errors_before = atomic_load(&stress->errors);
+
+  atomic_store(&stress->stop, false);
+  struct timespec start, cpu_start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+  for (int i = 0; i < n_threads; i++) {
+    readers[i] = (stress_reader_t){.stress = stress, .seed = 100 + i};
+    pthread_create(&threads[i], NULL, reader, &readers[i]);
+  }
+  pthread_create(&writer_thread, NULL, writer, stress);
+
+  sleep(seconds);
+  atomic_store(&stress->stop, true);
+
+  long lookups = 0;
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(threads[i], NULL);
+    lookups += readers[i].lookups;
+  }
+  pthread_join(writer_thread, NULL);
+
+  double per_second = lookups / seconds_since(CLOCK_MONOTONIC, &start);
+  double cpu_us = seconds_since(CLOCK_PROCESS_CPUTIME_ID, &cpu_start) * 1e6;
+  printf("%-8s %7d %12.0f %7.2fx %12.2f %7ld\n",
+         stress->attach ? "attached" : "shared", n_threads, per_second,
+         one_thread > 0 ? per_second / one_thread : 1.0,
+         lookups ? cpu_us / lookups : 0.0,
+         atomic_load(&stress->errors) - errors_before);
+  return per_second;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag,
+                        struct FTW *ftw) {
+  (void)st;
+  (void)flag;
+  (void)ftw;
+  return remove(path);
+}
+
+int main(int argc, char *argv[]) {
+  size_t n_items = argc > 1 ? strtoull(argv[1], NULL, 10) : STRESS_DEFAULT_ITEMS;
+  unsigned seconds = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10)
+                              : STRESS_DEFAULT_SECONDS;
+  if (n_items == 0 || seconds == 0) {
+    fprintf(stderr, "Usage: locker_stress [n-items] [seconds]\n");
+    return EXIT_FAILURE;
+  }
+  if (sodium_init() < 0) {
+    fprintf(stderr, "libsodium could not be initialised.\n");
+    return EXIT_FAILURE;
+  }
+
+  char workdir[] = "/tmp/locker_stress.XXXXXX";
+  char lockers[sizeof(workdir) + sizeof("/lockers")];
+  if (!mkdtemp(workdir)) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  snprintf(lockers, sizeof(lockers), "%s/lockers", workdir);
+  mkdir(lockers, 0700);
+
+  stress_t stress = {.n_items = n_items};
+  int status = EXIT_FAILURE;
+  if (locker_create(workdir, "stress", "stress") != LOCKER_OK ||
+      locker_open(&stress.locker, workdir, "stress", "stress") != LOCKER_OK) {
+    fprintf(stderr, "Could not create the locker in %s.\n", workdir);
+    goto cleanup;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!fill(stress.locker, n_items)) {
+    close_locker(stress.locker);
+    goto cleanup;
+  }
+  printf("added %zu items in %.2f s, %ld CPUs online\n\n", n_items,
+         seconds_since(CLOCK_MONOTONIC, &start), sysconf(_SC_NPROCESSORS_ONLN));
+
+  printf("%-8s %7s %12s %8s %12s %7s\n", "readers", "threads", "lookups/s",
+         "speedup", "cpu us/look", "errors");
+  for (int attach = 0; attach <= 1; attach++) {
+    stress.attach = attach;
+    double one_thread = 0;
+    for (int n_threads = 1; n_threads <= STRESS_MAX_THREADS; n_threads *= 2) {
+      double per_second = run(&stress, n_threads, seconds, one_thread);
+      if (n_threads == 1)
+        one_thread = per_second;
+    }
+  }
+
+  close_locker(stress.locker);
+  status = atomic_load(&stress.errors) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+cleanup:
+  nftw(workdir, remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+  return status;
+}
@@ -5,10 +5,13 @@
 #define ATTR_ALLOC __attribute__((malloc))
 #define ATTR_NODISCARD __attribute__((warn_unused_result))
 #define ATTR_PURE __attribute__((pure))
+/* symbols the shared liblocker exports, everything else stays hidden */
+#define LOCKER_API __attribute__((visibility("default")))
 #else
 #define ATTR_ALLOC
 #define ATTR_NODISCARD
 #define ATTR_PURE
+#define LOCKER_API
 #endif
 
 #endif
@@ -2,24 +2,34 @@
 #define LOCKER_H
 
 #include "attrs.h"
-#include "locker_crypto.h"
-#include "locker_version.h"
 #include "locker_utils.h"
-#include "sqlite3.h"
-#include "sodium.h"
+#include "locker_version.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* a strict C build on glibc leaves PATH_MAX out of limits.h */
+#ifdef PATH_MAX
+#define LOCKER_PATH_MAX PATH_MAX
+#else
+#define LOCKER_PATH_MAX 4096
+#endif
 
-#define LOCKER_NAME_MAX_LEN 64
 #define LOCKER_FILE_EXTENSION ".locker"
 #define LOCKER_FILE_EXTENSION_LEN 7
-#define LOCKER_MAX_LOCKER_FILE_NUMBER 2 << 4
+#define LOCKER_NAME_MAX_LEN 64
 #define LOCKER_PASSPHRASE_MAX_LEN 200
 #define LOCKER_ITEM_KEY_MAX_LEN 2 << 9
 #define LOCKER_ITEM_DESCRIPTION_MAX_LEN 2 << 9
 #define LOCKER_ITEM_CONTENT_MAX_LEN 2 << 15
+/* notes hold certificates, keystores and runbooks, they are stored in chunks */
+#define LOCKER_ITEM_NOTE_MAX_LEN (2 << 25)
 #define LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN 512
 #define LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN 512
 #define LOCKER_ITEM_ACCOUNT_URL_MAX_LEN 512
 #define LOCKER_ITEM_KEY_QUERY_MAX_LEN 128
+#define LOCKER_ITEM_KEY_SEPARATOR '/'
 
 typedef enum {
   LOCKER_OK = 0,
@@ -36,27 +46,24 @@ typedef enum {
   LOCKER_ITEM_ACCOUNT_USERNAME_TOO_LONG,
   LOCKER_ITEM_ACCOUNT_PASSWORD_TOO_LONG,
   LOCKER_ITEM_ACCOUNT_URL_TOO_LONG,
+  LOCKER_INVALID_KEYFILE,
+  LOCKER_NO_FREE_KEY_SLOT,
+  /* the database or its journal failed, details go to the log */
+  LOCKER_DB_ERROR,
+  /* another handle, in this process or another one, has the locker open */
+  LOCKER_BUSY,
 } locker_result_t;
 
-typedef struct {
-  unsigned int file_version;
-  unsigned long magic;
-  char locker_name[LOCKER_NAME_MAX_LEN + 1];
-  unsigned char salt[LOCKER_CRYPTO_SALT_LEN];
-  unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN];
-  unsigned long long locker_size;
-  /*
-   * XChaCha20-Poly1305 can encrypt at max the file of size 2^64 bytes,
-   * it's unlikly that someone has file of size 17 exabytes
-   */
-} locker_header_t;
+/* an opened locker, only ever handled through a pointer */
+typedef struct locker locker_t;
 
-typedef struct {
-  char locker_name[LOCKER_NAME_MAX_LEN + 1];
-  locker_header_t *_header;
-  locker_crypto_masterkey_t _key[LOCKER_CRYPTO_MASTER_KEY_LEN];
-  sqlite3 *_db;
-} locker_t;
+typedef enum {
+  LOCKER_SAVE_IDLE = 0,
+  LOCKER_SAVE_PENDING,
+  LOCKER_SAVE_RUNNING,
+  /* the last save could not fold the journal in, edits are still durable in it */
+  LOCKER_SAVE_FAILED,
+} locker_save_state_t;
 
 typedef enum {
   LOCKER_ITEM_ACCOUNT = 0,
@@ -65,22 +72,44 @@ typedef enum {
 } locker_item_type_t;
 
 typedef struct {
-    sqlite_int64 id;
+    int64_t id;
     char *key;
     locker_item_type_t type;
 } locker_item_t;
 
 DEFINE_LOCKER_ARRAY_T(locker_item_t, locker_item);
 
+typedef enum {
+  LOCKER_PAGE_AFTER = 0,
+  LOCKER_PAGE_BEFORE,
+} locker_page_direction_t;
+
+/*
+ * Position in the key order of all items, pages are read next to it. A
+ * zeroed cursor lies before the first item, one with past_end set after the
+ * last.
+ */
+typedef struct {
+    char key[(LOCKER_ITEM_KEY_MAX_LEN)+1];
+    int64_t id;
+    bool past_end;
+} locker_item_cursor_t;
+
+/* listed items, their keys live in the arena and go away with it */
 typedef struct {
-    sqlite_int64 id;
+    array_locker_item_t items;
+    locker_arena_t arena;
+} locker_item_list_t;
+
+typedef struct {
+    int64_t id;
     char *key;
     char *description;
     char *value;
 } locker_item_apikey_t;
 
 typedef struct {
-    sqlite_int64 id;
+    int64_t id;
     char *key;
     char *description;
     char *username;
@@ -88,32 +117,129 @@ typedef struct {
     char *url;
 } locker_item_account_t;
 
-locker_result_t locker_create(
-    const char locker_dir[static 1],
-    const char locker_name[static 1],
-    const char passphrase[static 1]
-);
-
-ATTR_ALLOC ATTR_NODISCARD array_str_t *lockers_list(const char locker_dir[static 1]);
-
-locker_result_t locker_open(locker_t **locker, const char locker_dir[static 1], const char locker_name[static 1], const char passphrase[static 1]);
-locker_result_t save_locker(locker_t locker[static 1], const char locker_dir[static 1]);
-locker_result_t close_locker(locker_t locker[static 1]);
+/*
+ * A note is never loaded whole, its size comes with it and its text is read
+ * in ranges with locker_read_note. content is only read by add and update,
+ * it is size bytes long and may hold any bytes.
+ */
+typedef struct {
+    int64_t id;
+    char *key;
+    char *description;
+    size_t size;
+    const char *content;
+} locker_item_note_t;
 
-locker_result_t locker_add_apikey(const locker_t locker[static 1], const locker_item_apikey_t item[static 1]);
-locker_result_t locker_update_apikey(const locker_t locker[static 1], const locker_item_apikey_t item[static 1]);
+/* an item together with its secrets, the union member follows type, notes use apikey */
+typedef struct {
+    locker_item_type_t type;
+    union {
+        locker_item_apikey_t apikey;
+        locker_item_account_t account;
+    };
+} locker_resolved_item_t;
+
+DEFINE_LOCKER_ARRAY_T(locker_resolved_item_t, locker_resolved_item);
+
+/*
+ * One level of the key namespace below a prefix. A name ending with the
+ * separator is a namespace holding count keys, anything else is an item.
+ */
+typedef struct {
+  char *name;
+  size_t count;
+  int64_t item_id;
+  int item_type;
+} locker_trie_entry_t;
 
-locker_result_t locker_add_account(const locker_t locker[static 1], const locker_item_account_t account[static 1]);
-locker_result_t locker_update_account(const locker_t locker[static 1], const locker_item_account_t account[static 1]);
+DEFINE_LOCKER_ARRAY_T(locker_trie_entry_t, locker_trie_entry);
 
-locker_result_t locker_delete_item(const locker_t locker[static 1], const locker_item_t item[static 1]);
+LOCKER_API void trie_free_entry(locker_trie_entry_t entry);
 
-ATTR_ALLOC ATTR_NODISCARD array_locker_item_t *locker_get_items(locker_t locker[static 1], const char query[LOCKER_ITEM_KEY_MAX_LEN]);
-ATTR_ALLOC ATTR_NODISCARD locker_item_apikey_t *locker_get_apikey(const locker_t locker[static 1], sqlite_int64 item_id);
-ATTR_ALLOC ATTR_NODISCARD locker_item_account_t *locker_get_account(const locker_t locker[static 1], sqlite_int64 item_id);
+LOCKER_API locker_result_t locker_create(
+    const char locker_dir[static 1],
+    const char locker_name[static 1],
+    const char passphrase[static 1]
+);
 
-void locker_free_item(locker_item_t item);
-void locker_free_apikey(locker_item_apikey_t item[static 1]);
-void locker_free_account(locker_item_account_t item[static 1]);
+/* <locker_dir>/lockers/<name>.locker with the name lowercased and spaces made '_' */
+LOCKER_API void get_locker_filepath(char filepath[LOCKER_PATH_MAX], const char locker_dir[static 1], const char locker_name[static 1]);
+LOCKER_API ATTR_ALLOC ATTR_NODISCARD array_str_t *lockers_list(const char locker_dir[static 1]);
+
+LOCKER_API locker_result_t locker_open(locker_t **locker, const char locker_dir[static 1], const char locker_name[static 1], const char passphrase[static 1]);
+LOCKER_API locker_result_t locker_open_keyfile(locker_t **locker, const char locker_dir[static 1], const char locker_name[static 1], const char keyfile_path[static 1]);
+
+LOCKER_API locker_result_t locker_change_passphrase(const char locker_dir[static 1], const char locker_name[static 1], const char old_passphrase[static 1], const char new_passphrase[static 1]);
+LOCKER_API locker_result_t locker_add_keyfile(const char locker_dir[static 1], const char locker_name[static 1], const char passphrase[static 1], const char keyfile_path[static 1]);
+LOCKER_API locker_result_t locker_remove_keyfile(const char locker_dir[static 1], const char locker_name[static 1], const char passphrase[static 1], const char keyfile_path[static 1]);
+
+/* the name the locker was opened under */
+LOCKER_API const char *locker_get_name(const locker_t *locker);
+
+LOCKER_API locker_result_t save_locker(locker_t *locker);
+LOCKER_API locker_save_state_t locker_save_state(const locker_t *locker);
+LOCKER_API locker_result_t close_locker(locker_t *locker);
+
+/*
+ * An opened locker may be used from any number of threads. Lookups run in
+ * parallel with each other and writes run alone. Threads that do many lookups
+ * should attach, each then reads through its own connection instead of taking
+ * turns on the one connection. A thread detaches itself or is detached when it
+ * exits, close_locker is called once no other thread uses the locker.
+ *
+ * Everything a function hands back belongs to the caller and stays valid
+ * after later writes: lists and items live in the list or arena passed in,
+ * locker_browse_items entries are freed with trie_free_entry.
+ *
+ * Nothing here ends the process on a failing database or journal. Functions
+ * returning locker_result_t report it as LOCKER_DB_ERROR, item getters return
+ * NULL and the failure itself is logged. A write the journal cannot take is
+ * rolled back, so the locker keeps only edits that survive a crash.
+ *
+ * What still ends it: failing allocations, key derivation and thread
+ * creation, writes to the locker header and the file I/O of the version 1
+ * and 2 migrations.
+ */
+LOCKER_API void locker_attach_thread(locker_t *locker);
+LOCKER_API void locker_detach_thread(locker_t *locker);
+
+LOCKER_API locker_result_t locker_add_apikey(const locker_t *locker, const locker_item_apikey_t item[static 1]);
+LOCKER_API locker_result_t locker_update_apikey(const locker_t *locker, const locker_item_apikey_t item[static 1]);
+
+LOCKER_API locker_result_t locker_add_account(const locker_t *locker, const locker_item_account_t account[static 1]);
+LOCKER_API locker_result_t locker_update_account(const locker_t *locker, const locker_item_account_t account[static 1]);
+
+LOCKER_API locker_result_t locker_add_note(const locker_t *locker, const locker_item_note_t note[static 1]);
+LOCKER_API locker_result_t locker_update_note(const locker_t *locker, const locker_item_note_t note[static 1]);
+
+LOCKER_API locker_result_t locker_delete_item(const locker_t *locker, const locker_item_t item[static 1]);
+
+LOCKER_API locker_result_t locker_get_items(locker_t *locker, const char query[LOCKER_ITEM_KEY_MAX_LEN], locker_item_list_t list[static 1]);
+/* secrets should go into a secure arena, see arena_init, NULL when there is no such item */
+LOCKER_API locker_item_apikey_t *locker_get_apikey(const locker_t *locker, int64_t item_id, locker_arena_t arena[static 1]);
+LOCKER_API locker_item_account_t *locker_get_account(const locker_t *locker, int64_t item_id, locker_arena_t arena[static 1]);
+/* a note without its text, locker_get_apikey on a note reads the whole text as its value */
+LOCKER_API locker_item_note_t *locker_get_note(const locker_t *locker, int64_t item_id, locker_arena_t arena[static 1]);
+/* copies up to size bytes of the note from offset into out, n_read is short past its end */
+LOCKER_API locker_result_t locker_read_note(const locker_t *locker, int64_t item_id, size_t offset, size_t size, char out[size], size_t n_read[static 1]);
+
+LOCKER_API ATTR_ALLOC ATTR_NODISCARD array_locker_trie_entry_t *locker_browse_items(locker_t *locker, const char prefix[static 1]);
+/* appends every item whose key matches the GLOB pattern in key order, strings live in arena */
+LOCKER_API locker_result_t locker_resolve_items(locker_t *locker, const char pattern[static 1], locker_arena_t arena[static 1], array_locker_resolved_item_t out[static 1]);
+/* fills id and type of the item stored under key, false when there is none */
+LOCKER_API bool locker_find_item(locker_t *locker, const char key[static 1], locker_item_t item[static 1]);
+LOCKER_API size_t locker_count_items(locker_t *locker, const char prefix[static 1]);
+LOCKER_API size_t locker_complete_item_key(locker_t *locker, const char prefix[static 1], char out[], size_t out_sz);
+/* replaces list with one page next to cursor, has_more tells whether more items follow */
+LOCKER_API locker_result_t locker_get_items_page(locker_t *locker, const locker_item_cursor_t cursor[static 1], locker_page_direction_t direction, size_t page_size, locker_item_list_t list[static 1], bool has_more[static 1]);
+LOCKER_API void locker_item_cursor_set(locker_item_cursor_t cursor[static 1], const locker_item_t item[static 1]);
+/* moves cursor after the last item, a page before it ends with that item */
+LOCKER_API void locker_item_cursor_set_end(locker_item_cursor_t cursor[static 1]);
+LOCKER_API void locker_fuzzy_find_items(locker_t *locker, const char query[static 1], size_t max_results, locker_item_list_t list[static 1]);
+
+LOCKER_API void locker_item_list_init(locker_item_list_t list[static 1]);
+/* empties the list but keeps its memory for the next fill */
+LOCKER_API void locker_item_list_clear(locker_item_list_t list[static 1]);
+LOCKER_API void locker_item_list_free(locker_item_list_t list[static 1]);
 
 #endif
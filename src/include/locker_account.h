@@ -0,0 +1,33 @@
+#ifndef LOCKER_ACCOUNT_H
+#define LOCKER_ACCOUNT_H
+
+#include "attrs.h"
+#include "locker.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/* fixed zero padded fields written before locker file version 5 */
+#define LOCKER_ACCOUNT_LEGACY_CONTENT_LEN                                      \
+  (LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN +                                      \
+   LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN + LOCKER_ITEM_ACCOUNT_URL_MAX_LEN)
+
+/*
+ * First byte of the length prefixed layout. It never starts UTF-8 text, so
+ * it can not be the first byte of a legacy username either.
+ */
+#define LOCKER_ACCOUNT_FORMAT_LENGTH_PREFIXED 0xF8
+
+/* format | u16 username_len username | u16 password_len password | u16 url_len url */
+ATTR_ALLOC ATTR_NODISCARD unsigned char *
+account_content_encode(const char username[static 1],
+                       const char password[static 1], const char url[static 1],
+                       size_t *size);
+
+/* fills username, password and url of account from arena, accepts both layouts */
+bool account_content_decode(const unsigned char *content, size_t size,
+                            locker_item_account_t account[static 1],
+                            locker_arena_t arena[static 1]);
+
+bool account_content_is_compact(const unsigned char *content, size_t size);
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LOCKER_AGENT_H
+#define LOCKER_AGENT_H
+
+#include "locker.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syslimits.h>
+
+/* the socket sits next to the locker file, <locker>.locker.agent */
+#define LOCKER_AGENT_SOCKET_SUFFIX ".agent"
+#define LOCKER_AGENT_WORKERS 4
+#define LOCKER_AGENT_QUEUE_LEN 64
+/* seconds an agent keeps a locker open before it closes it and exits, 0 never */
+#define LOCKER_AGENT_DEFAULT_TTL 3600
+/* seconds a connected client may stay silent before its worker drops it */
+#define LOCKER_AGENT_IO_TIMEOUT 5
+#define LOCKER_AGENT_MAX_FRAME_LEN (16u << 20)
+
+/*
+ * Every message is a frame, a u32 LE payload length and the payload. A
+ * request is an op byte followed by its argument: a key, a search query, a
+ * GLOB pattern or for ADD an item. A response is a status byte followed by
+ * the body of the op:
+ *
+ *   GET      item
+ *   LIST     u32 count, count * (u8 type | u32 key_len | key)
+ *   RESOLVE  u32 count, count * item
+ *   ADD      nothing
+ *   DELETE   nothing
+ *
+ * where an item is the u8 type followed by u32 length prefixed key,
+ * description and value, or key, description, username, password and url
+ * for accounts. A FAILED status is followed by the u8 locker_result_t.
+ *
+ * The agent keeps the locker open in a write transaction, so while it runs
+ * every change has to go through it as well.
+ */
+typedef enum {
+  LOCKER_AGENT_OP_GET = 1,
+  LOCKER_AGENT_OP_LIST,
+  LOCKER_AGENT_OP_RESOLVE,
+  LOCKER_AGENT_OP_ADD,
+  LOCKER_AGENT_OP_DELETE,
+} locker_agent_op_t;
+
+typedef enum {
+  LOCKER_AGENT_OK = 0,
+  LOCKER_AGENT_NOT_FOUND,
+  LOCKER_AGENT_BAD_REQUEST,
+  LOCKER_AGENT_TOO_LARGE,
+  LOCKER_AGENT_FAILED,
+} locker_agent_status_t;
+
+void agent_socket_path(char path[PATH_MAX], const char workdir[static 1],
+                       const char locker_name[static 1]);
+
+/* payload comes from sodium_malloc, false on EOF, timeout or an oversized frame */
+bool agent_read_frame(int fd, unsigned char **payload, uint32_t *len);
+bool agent_write_frame(int fd, const unsigned char *payload, uint32_t len);
+
+/* bytes the item takes on the wire, written to out unless it is NULL */
+size_t agent_encode_item(unsigned char *out,
+                         const locker_resolved_item_t item[static 1]);
+/* advances p past one item, its strings are copied into arena */
+bool agent_decode_item(const unsigned char **p, const unsigned char *end,
+                       locker_arena_t arena[static 1],
+                       locker_resolved_item_t item[static 1]);
+
+/* socket only its owner can connect to, -1 when an agent is already there */
+int agent_listen(const char path[static 1]);
+
+/*
+ * answers requests until SIGINT, SIGTERM or ttl seconds have passed, false
+ * when it could not start serving
+ */
+bool agent_serve(locker_t *locker, int listen_fd, unsigned ttl);
+
+/* -1 when no agent serves the locker */
+int agent_connect(const char workdir[static 1],
+                  const char locker_name[static 1]);
+
+bool agent_get(int fd, const char key[static 1], locker_arena_t arena[static 1],
+               locker_resolved_item_t item[static 1]);
+
+void agent_list(int fd, const char query[static 1],
+                locker_item_list_t list[static 1]);
+
+size_t agent_resolve(int fd, const char pattern[static 1],
+                     locker_arena_t arena[static 1],
+                     array_locker_resolved_item_t out[static 1]);
+
+locker_result_t agent_add(int fd, const locker_resolved_item_t item[static 1]);
+
+/* false when there is no item under key */
+bool agent_delete(int fd, const char key[static 1]);
+
+#endif
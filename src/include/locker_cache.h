@@ -0,0 +1,63 @@
+#ifndef LOCKER_CACHE_H
+#define LOCKER_CACHE_H
+
+#include "attrs.h"
+#include "locker.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define LOCKER_CACHE_SLOTS 16
+/* an account at its longest fits, longer api keys are read every time */
+#define LOCKER_CACHE_SLOT_LEN 4096
+#define LOCKER_CACHE_IDLE_SEC 60
+
+/*
+ * Items decoded by the last lookups, so redrawing an item or going back to
+ * one seen a moment ago neither runs SQL nor decodes it again. The slots live
+ * in sodium_malloc memory and are wiped when evicted, when their item is
+ * written or removed, when the locker is closed and, by a thread of the
+ * cache, once no lookup used it for LOCKER_CACHE_IDLE_SEC.
+ *
+ * cache_get_* and cache_put_* are called under the shared side of the locker
+ * lock, cache_invalidate under its exclusive side.
+ */
+typedef struct {
+  /* 0 for a free slot */
+  int64_t item_id;
+  locker_item_type_t type;
+  uint64_t last_used;
+  /* the fields one after another, each followed by its NUL */
+  char data[LOCKER_CACHE_SLOT_LEN];
+} locker_cache_slot_t;
+
+typedef struct locker_cache {
+  pthread_mutex_t mutex;
+  /* wakes the sweeper when the first slot is taken or the cache is freed */
+  pthread_cond_t cond;
+  pthread_t sweeper;
+  bool stopping;
+  size_t n_used;
+  /* bumped by every use, the slot with the lowest stamp is evicted */
+  uint64_t clock;
+  struct timespec last_access;
+  locker_cache_slot_t slots[LOCKER_CACHE_SLOTS];
+} locker_cache_t;
+
+ATTR_ALLOC ATTR_NODISCARD locker_cache_t *cache_new(void);
+
+/* stops the thread, sodium_free wipes every slot */
+void cache_free(locker_cache_t cache[static 1]);
+
+/* copies the cached item into arena, NULL when it is not cached */
+locker_item_apikey_t *cache_get_apikey(locker_cache_t cache[static 1], int64_t item_id, locker_arena_t arena[static 1]);
+locker_item_account_t *cache_get_account(locker_cache_t cache[static 1], int64_t item_id, locker_arena_t arena[static 1]);
+
+/* takes the slot used longest ago, items that do not fit a slot are left out */
+void cache_put_apikey(locker_cache_t cache[static 1], const locker_item_apikey_t apikey[static 1]);
+void cache_put_account(locker_cache_t cache[static 1], const locker_item_account_t account[static 1]);
+
+void cache_invalidate(locker_cache_t cache[static 1], int64_t item_id);
+
+#endif
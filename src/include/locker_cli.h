@@ -0,0 +1,14 @@
+#ifndef LOCKER_CLI_H
+#define LOCKER_CLI_H
+
+#include <stdbool.h>
+
+/* true when name is a subcommand answered without the TUI */
+bool cli_is_command(const char name[static 1]);
+
+void cli_print_usage(void);
+
+/* argv[0] is the subcommand, never touches the terminal */
+int cli_run(int argc, char *argv[]);
+
+#endif
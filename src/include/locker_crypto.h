@@ -1,22 +1,85 @@
 #ifndef LOCKER_CRYPTO_H
 #define LOCKER_CRYPTO_H
 
+#include "sodium/crypto_aead_chacha20poly1305.h"
 #include "sodium/crypto_aead_xchacha20poly1305.h"
+#include "sodium/crypto_core_hchacha20.h"
+#include "sodium/crypto_kdf_hkdf_sha256.h"
+#include "sodium/crypto_onetimeauth_poly1305.h"
 #include "sodium/crypto_pwhash.h"
 #include <sodium/crypto_box.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 #define LOCKER_CRYPTO_MASTER_KEY_LEN crypto_aead_xchacha20poly1305_ietf_KEYBYTES
 #define LOCKER_CRYPTO_SALT_LEN crypto_pwhash_SALTBYTES
 #define LOCKER_CRYPTO_NONCE_LEN crypto_aead_xchacha20poly1305_ietf_NPUBBYTES
 
+/* must stay a multiple of the 64 byte ChaCha20 block */
+#define LOCKER_CRYPTO_STREAM_CHUNK_LEN (64 * 1024)
+
 typedef unsigned char locker_crypto_masterkey_t;
 
+/* Argon2 cost, stored with every passphrase key slot */
+typedef struct {
+  int alg;
+  unsigned long long opslimit;
+  size_t memlimit;
+} locker_crypto_kdf_params_t;
+
+/* cost every locker paid before it became tunable */
+#define LOCKER_CRYPTO_KDF_DEFAULT_PARAMS                                       \
+  ((locker_crypto_kdf_params_t){                                               \
+      .alg = crypto_pwhash_ALG_ARGON2ID13,                                     \
+      .opslimit = crypto_pwhash_OPSLIMIT_INTERACTIVE,                          \
+      .memlimit = crypto_pwhash_MEMLIMIT_INTERACTIVE,                          \
+  })
+
+/* upper bound accepted from a header, so a crafted file cannot exhaust memory */
+#define LOCKER_CRYPTO_KDF_MEMLIMIT_MAX (4ULL << 30)
+
+/*
+ * XChaCha20-Poly1305 (IETF) message processed in chunks, so a large single
+ * message can be authenticated and then decrypted without holding it whole.
+ */
+typedef struct {
+  unsigned char subkey[crypto_core_hchacha20_OUTPUTBYTES];
+  unsigned char nonce[crypto_aead_chacha20poly1305_ietf_NPUBBYTES];
+  crypto_onetimeauth_poly1305_state mac;
+  unsigned long long mac_len;
+} locker_crypto_aead_stream_t;
+
 int derieve_key(const char *password, unsigned char *key_out, size_t key_len,
-                const unsigned char *salt);
+                const unsigned char *salt,
+                const locker_crypto_kdf_params_t *params);
+
+bool kdf_params_valid(const locker_crypto_kdf_params_t *params);
+
+int derive_keyfile_key(const unsigned char *keyfile, size_t keyfile_len,
+                       unsigned char *key_out, size_t key_len,
+                       const unsigned char *salt);
+
+void generate_key(locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN]);
 
 void generate_salt(unsigned char salt[LOCKER_CRYPTO_SALT_LEN]);
 
 void generate_nonce(unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN]);
 
+void aead_stream_init(locker_crypto_aead_stream_t *stream,
+                      const unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN],
+                      const locker_crypto_masterkey_t *key);
+
+void aead_stream_authenticate(locker_crypto_aead_stream_t *stream,
+                              const unsigned char *ciphertext, size_t len);
+
+bool aead_stream_verify(locker_crypto_aead_stream_t *stream,
+                        const unsigned char tag[crypto_aead_xchacha20poly1305_ietf_ABYTES]);
+
+void aead_stream_decrypt(const locker_crypto_aead_stream_t *stream,
+                         unsigned char *plaintext,
+                         const unsigned char *ciphertext, size_t len,
+                         unsigned long long offset);
+
+void aead_stream_wipe(locker_crypto_aead_stream_t *stream);
+
 #endif
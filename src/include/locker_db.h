@@ -3,34 +3,103 @@
 
 #include "attrs.h"
 #include "locker.h"
+#include "locker_crypto.h"
 #include "locker_utils.h"
 #include "sqlite3.h"
 #include <stdbool.h>
 
+/* 16 pages, so no read within a chunk follows a long overflow chain */
+#define LOCKER_NOTE_CHUNK_LEN (1 << 16)
+
+typedef enum {
+  LOCKER_STMT_GET_META = 0,
+  LOCKER_STMT_SET_META,
+  LOCKER_STMT_ADD_ITEM,
+  LOCKER_STMT_LIST_ITEMS,
+  LOCKER_STMT_PAGE_ITEMS_AFTER,
+  LOCKER_STMT_PAGE_ITEMS_BEFORE,
+  LOCKER_STMT_SEARCH_ITEMS,
+  LOCKER_STMT_MATCH_ITEMS,
+  LOCKER_STMT_GET_ITEM,
+  LOCKER_STMT_RESOLVE_ITEMS,
+  LOCKER_STMT_GET_ITEM_KEY,
+  LOCKER_STMT_ITEM_KEY_EXISTS,
+  LOCKER_STMT_UPDATE_ITEM,
+  LOCKER_STMT_DELETE_ITEM,
+  LOCKER_STMT_NOTE_SIZE,
+  LOCKER_STMT_NOTE_CHUNKS,
+  LOCKER_STMT_ADD_NOTE_CHUNK,
+  LOCKER_STMT_DELETE_NOTE_CHUNKS,
+  LOCKER_STMT_COUNT,
+} locker_stmt_t;
+
+/* connection of an opened locker together with its compiled statements */
+typedef struct locker_db {
+  sqlite3 *conn;
+  sqlite3_stmt *stmts[LOCKER_STMT_COUNT];
+} locker_db_t;
+
 ATTR_NODISCARD ATTR_ALLOC sqlite3 *get_empty_db(void);
 
+ATTR_NODISCARD ATTR_ALLOC sqlite3 *
+get_locker_db(const char path[static 1], sqlite3_int64 data_offset,
+              const locker_crypto_masterkey_t key[static 1],
+              locker_result_t result[static 1]);
+
 ATTR_NODISCARD ATTR_ALLOC sqlite3 *get_db(sqlite3_int64 size,
                                           unsigned char buffer[size]);
 
 void db_close(sqlite3 *db);
 
-sqlite3_int64 db_dump(sqlite3 *db, unsigned char **buffer);
+/*
+ * Everything below logs a failing call and reports it to its caller, a
+ * bool false, a NULL or a 0 id. Nothing ends the process.
+ */
+bool db_copy(sqlite3 *src, sqlite3 *dst);
+
+bool db_write_raw(sqlite3 *db, sqlite3_int64 offset, int size,
+                  const unsigned char buffer[size]);
+
+bool db_begin(sqlite3 *db);
+bool db_commit(sqlite3 *db);
+bool db_savepoint(sqlite3 *db);
+bool db_release_savepoint(sqlite3 *db);
+void db_rollback_savepoint(sqlite3 *db);
 
-void initdb(sqlite3 *db);
+bool initdb(sqlite3 *db);
 
-void db_add_item(sqlite3 *db, const char key[static 1],
-                 const char description[static 1], int content_size,
-                 const unsigned char content[content_size],
-                 locker_item_type_t item_type);
+bool db_migrate(sqlite3 *db);
 
-ATTR_ALLOC ATTR_NODISCARD array_locker_item_t *db_list_items(sqlite3 *db, const char query[LOCKER_ITEM_KEY_QUERY_MAX_LEN]);
-ATTR_ALLOC ATTR_NODISCARD locker_item_apikey_t *db_get_apikey(sqlite3 *db, sqlite_int64 item_id);
-ATTR_ALLOC ATTR_NODISCARD locker_item_account_t *db_get_account(sqlite3 *db, sqlite_int64 item_id);
+bool db_compact_accounts(sqlite3 *db, size_t n_compacted[static 1],
+                         sqlite3_int64 bytes_before[static 1],
+                         sqlite3_int64 bytes_after[static 1]);
 
-bool db_item_key_exists(sqlite3 *db, sqlite_int64 item_id, const char key[static 1]);
+ATTR_ALLOC ATTR_NODISCARD locker_db_t *db_prepare_statements(sqlite3 *conn);
+void db_finalize_statements(locker_db_t *db);
 
-void db_item_update(
-    sqlite3 *db,
+bool db_get_meta(locker_db_t *db, const char key[static 1],
+                 sqlite_int64 value[static 1]);
+bool db_set_meta(locker_db_t *db, const char key[static 1], sqlite_int64 value);
+
+sqlite_int64 db_add_item(locker_db_t *db, sqlite_int64 item_id,
+                         const char key[static 1],
+                         const char description[static 1], int content_size,
+                         const unsigned char content[content_size],
+                         locker_item_type_t item_type);
+
+bool db_list_items(locker_db_t *db, const char query[LOCKER_ITEM_KEY_QUERY_MAX_LEN], locker_item_list_t list[static 1]);
+bool db_list_items_page(locker_db_t *db, const locker_item_cursor_t cursor[static 1], locker_page_direction_t direction, size_t page_size, locker_item_list_t list[static 1], bool has_more[static 1]);
+locker_item_apikey_t *db_get_apikey(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]);
+locker_item_account_t *db_get_account(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]);
+locker_item_note_t *db_get_note(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]);
+bool db_resolve_items(locker_db_t *db, const char pattern[static 1], locker_arena_t arena[static 1], array_locker_resolved_item_t out[static 1]);
+
+ATTR_ALLOC ATTR_NODISCARD char *db_get_item_key(locker_db_t *db, sqlite_int64 item_id);
+
+bool db_item_key_exists(locker_db_t *db, sqlite_int64 item_id, const char key[static 1], bool exists[static 1]);
+
+bool db_item_update(
+    locker_db_t *db,
     sqlite_int64 item_id,
     const char key[static 1],
     const char description[static 1],
@@ -38,6 +107,13 @@ void db_item_update(
     const unsigned char content[content_size]
 );
 
-void db_item_delete(sqlite3 *db, sqlite_int64 item_id);
+bool db_item_delete(locker_db_t *db, sqlite_int64 item_id);
+
+/*
+ * The text of a note lives in rows of LOCKER_NOTE_CHUNK_LEN bytes, only the
+ * last one is shorter. A range is read from the chunks it spans alone.
+ */
+bool db_write_note(locker_db_t *db, sqlite_int64 item_id, size_t size, const unsigned char content[size]);
+bool db_read_note(locker_db_t *db, sqlite_int64 item_id, size_t offset, size_t size, unsigned char out[size], size_t n_read[static 1]);
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef LOCKER_FUZZY_H
+#define LOCKER_FUZZY_H
+
+#include "attrs.h"
+#include "sqlite3.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOCKER_FUZZY_QUERY_MAX_LEN 128
+/* queries this long tolerate one mistyped or extra character */
+#define LOCKER_FUZZY_TYPO_MIN_QUERY_LEN 4
+
+typedef struct locker_fuzzy locker_fuzzy_t;
+
+typedef size_t (*locker_fuzzy_prefilter_fn)(const locker_fuzzy_t *fuzzy,
+                                            uint64_t query_mask, int typos,
+                                            uint32_t out[]);
+
+/*
+ * Item keys packed into one buffer, in original and lowercase form, with a
+ * 64-bit character class mask per key for the candidate prefilter. Removed
+ * keys stay behind as tombstones with an item id of 0 until compaction.
+ */
+struct locker_fuzzy {
+  char *keys;
+  char *folded;
+  size_t keys_len;
+  size_t keys_capacity;
+
+  uint32_t *offsets;
+  uint16_t *lens;
+  uint64_t *masks;
+  sqlite3_int64 *item_ids;
+  int *item_types;
+  size_t count;
+  size_t capacity;
+  size_t n_removed;
+  size_t max_len;
+
+  locker_fuzzy_prefilter_fn prefilter;
+
+  /* keys matching the last query, narrowed further when the query grows */
+  char last_query[LOCKER_FUZZY_QUERY_MAX_LEN + 1];
+  int last_typos;
+  bool has_last;
+  uint32_t *candidates;
+  size_t n_candidates;
+};
+
+/* key points into the index and is valid until it is next modified */
+typedef struct {
+  sqlite3_int64 item_id;
+  int item_type;
+  const char *key;
+  int score;
+} locker_fuzzy_result_t;
+
+ATTR_ALLOC ATTR_NODISCARD locker_fuzzy_t *fuzzy_new(void);
+
+void fuzzy_free(locker_fuzzy_t fuzzy[static 1]);
+
+void fuzzy_add(locker_fuzzy_t fuzzy[static 1], const char key[static 1],
+               sqlite3_int64 item_id, int item_type);
+
+void fuzzy_remove(locker_fuzzy_t fuzzy[static 1], sqlite3_int64 item_id);
+
+/*
+ * "scalar", "sse2" or "avx2", NULL when this build or CPU cannot run it;
+ * fuzzy_new picks the widest, the benchmark swaps them on one index
+ */
+locker_fuzzy_prefilter_fn fuzzy_prefilter_named(const char name[static 1]);
+
+size_t fuzzy_search(locker_fuzzy_t fuzzy[static 1], const char query[static 1],
+                    size_t max_results,
+                    locker_fuzzy_result_t out[max_results]);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef LOCKER_HEADER_H
+#define LOCKER_HEADER_H
+
+#include "locker.h"
+#include "locker_crypto.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOCKER_MAGIC 0xCA80D4219AB3F102
+
+/*
+ * On-disk header is LOCKER_HEADER_SIZE bytes, little-endian, explicitly laid
+ * out so that it does not depend on the platform:
+ *   0   u64  magic
+ *   8   u32  file version
+ *   12  u32  header size, body starts right after it
+ *   16  char locker name, NUL padded to LOCKER_NAME_MAX_LEN + 1
+ *   81  locker salt, keyed the passphrase straight to the body before version 4
+ *   97  nonce (version 1 body only)
+ *   121 u64  locker size (version 1 body only)
+ *   256 key slots, LOCKER_KEY_SLOT_SIZE bytes each
+ * the rest is reserved and zeroed.
+ *
+ * Since version 4 the body is encrypted with a random data key which is only
+ * stored wrapped in the key slots, every slot by a key derived from its own
+ * passphrase or keyfile. A slot is
+ *   0   u8   slot type
+ *   1   u8   Argon2 algorithm (passphrase slots)
+ *   4   u32  Argon2 opslimit (passphrase slots)
+ *   8   u64  Argon2 memlimit in bytes (passphrase slots)
+ *   16  salt
+ *   32  nonce
+ *   56  data key sealed with XChaCha20-Poly1305
+ * the rest of the slot is reserved and zeroed.
+ */
+#define LOCKER_HEADER_SIZE 1024
+#define LOCKER_KEY_SLOTS 6
+#define LOCKER_KEY_SLOTS_OFFSET 256
+#define LOCKER_KEY_SLOT_SIZE 128
+#define LOCKER_WRAPPED_KEY_LEN                                                 \
+  (LOCKER_CRYPTO_MASTER_KEY_LEN + crypto_aead_xchacha20poly1305_ietf_ABYTES)
+
+/* raw locker_header_t struct written by versions 1 and 2 on LP64 platforms */
+#define LOCKER_LEGACY_HEADER_SIZE 136
+
+typedef enum {
+  LOCKER_KEY_SLOT_EMPTY = 0,
+  LOCKER_KEY_SLOT_PASSPHRASE,
+  LOCKER_KEY_SLOT_KEYFILE,
+} locker_key_slot_type_t;
+
+typedef struct {
+  locker_key_slot_type_t type;
+  locker_crypto_kdf_params_t kdf;
+  unsigned char salt[LOCKER_CRYPTO_SALT_LEN];
+  unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN];
+  unsigned char wrapped_key[LOCKER_WRAPPED_KEY_LEN];
+} locker_key_slot_t;
+
+typedef struct {
+  uint32_t file_version;
+  char locker_name[LOCKER_NAME_MAX_LEN + 1];
+  unsigned char salt[LOCKER_CRYPTO_SALT_LEN];
+  unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN];
+  uint64_t locker_size;
+  /*
+   * XChaCha20-Poly1305 can encrypt at max the file of size 2^64 bytes,
+   * it's unlikly that someone has file of size 17 exabytes
+   */
+  uint32_t data_offset;
+  locker_key_slot_t key_slots[LOCKER_KEY_SLOTS];
+} locker_header_t;
+
+void key_slot_serialize(const locker_key_slot_t slot[static 1],
+                        unsigned char out[LOCKER_KEY_SLOT_SIZE]);
+
+void header_serialize(const locker_header_t header[static 1],
+                      unsigned char out[LOCKER_HEADER_SIZE]);
+
+bool header_parse(const unsigned char *in, size_t len,
+                  locker_header_t header[static 1]);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef LOCKER_JOURNAL_H
+#define LOCKER_JOURNAL_H
+
+#include "attrs.h"
+#include "locker.h"
+#include "locker_crypto.h"
+#include "sqlite3.h"
+#include <stdbool.h>
+#include <sys/types.h>
+
+struct locker_db;
+
+#define LOCKER_JOURNAL_FILE_EXTENSION ".journal"
+#define LOCKER_JOURNAL_COMPACT_THRESHOLD (1 << 20)
+
+typedef enum {
+  LOCKER_JOURNAL_ADD = 1,
+  LOCKER_JOURNAL_UPDATE,
+  LOCKER_JOURNAL_DELETE,
+} locker_journal_op_t;
+
+typedef struct {
+  locker_journal_op_t op;
+  sqlite3_int64 item_id;
+  int item_type;
+  const char *key;
+  const char *description;
+  int content_size;
+  const unsigned char *content;
+} locker_journal_record_t;
+
+typedef struct {
+  int fd;
+  off_t size;
+  sqlite3_uint64 seq;
+  /* a failed record could not be cut off, nothing is appended after it */
+  bool broken;
+  unsigned char salt[LOCKER_CRYPTO_SALT_LEN];
+  const locker_crypto_masterkey_t *key;
+} locker_journal_t;
+
+void journal_filepath(char out[], size_t out_sz, const char locker_filepath[static 1]);
+
+/*
+ * Locks the journal for as long as it stays open, so one handle at a time
+ * writes to a locker. NULL with LOCKER_BUSY in result while another holds it.
+ */
+ATTR_ALLOC ATTR_NODISCARD locker_journal_t *
+journal_open(const char locker_filepath[static 1],
+             const unsigned char salt[LOCKER_CRYPTO_SALT_LEN],
+             const locker_crypto_masterkey_t key[static 1],
+             locker_result_t result[static 1]);
+
+bool journal_replay(locker_journal_t journal[static 1], struct locker_db *db,
+                    sqlite3_uint64 applied_seq);
+
+/* false when the record could not be made durable, see journal.c */
+bool journal_append(locker_journal_t journal[static 1],
+                    const locker_journal_record_t record[static 1]);
+
+bool journal_truncate(locker_journal_t journal[static 1]);
+
+void journal_close(locker_journal_t journal[static 1]);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef LOCKER_KDF_H
+#define LOCKER_KDF_H
+
+#include "locker_crypto.h"
+
+#define LOCKER_KDF_CONFIG_FILENAME "locker.kdf"
+#define LOCKER_KDF_DEFAULT_TARGET_MS 250
+#define LOCKER_KDF_DEFAULT_MAX_MEMLIMIT (1ULL << 30)
+
+typedef struct {
+  locker_crypto_kdf_params_t params;
+  /* unlock time measured with params */
+  double elapsed_ms;
+  /* Argon2 memory filled per second, in MiB */
+  double throughput;
+} locker_kdf_calibration_t;
+
+locker_crypto_kdf_params_t kdf_params_load(const char locker_dir[static 1]);
+
+void kdf_params_store(const char locker_dir[static 1],
+                      const locker_crypto_kdf_params_t params[static 1]);
+
+locker_kdf_calibration_t kdf_calibrate(double target_ms, size_t max_memlimit);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef LOCKER_KEYSLOT_H
+#define LOCKER_KEYSLOT_H
+
+#include "locker_crypto.h"
+#include "locker_header.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LOCKER_KEYFILE_MIN_LEN 32
+#define LOCKER_KEYFILE_MAX_LEN 8192
+
+int key_slot_seal_passphrase(locker_key_slot_t slot[static 1],
+                             const char passphrase[static 1],
+                             const locker_crypto_kdf_params_t kdf[static 1],
+                             const locker_crypto_masterkey_t data_key[static 1],
+                             const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN]);
+
+int key_slot_seal_keyfile(locker_key_slot_t slot[static 1],
+                          const unsigned char *keyfile, size_t keyfile_len,
+                          const locker_crypto_masterkey_t data_key[static 1],
+                          const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN]);
+
+bool key_slot_open_passphrase(const locker_key_slot_t slot[static 1],
+                              const char passphrase[static 1],
+                              const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN],
+                              locker_crypto_masterkey_t data_key[static 1]);
+
+bool key_slot_open_keyfile(const locker_key_slot_t slot[static 1],
+                           const unsigned char *keyfile, size_t keyfile_len,
+                           const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN],
+                           locker_crypto_masterkey_t data_key[static 1]);
+
+#endif
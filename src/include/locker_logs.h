@@ -2,6 +2,7 @@
 #define LOCKER_LOGS_H
 
 void turn_on_logging(const char *workdir);
+void open_log_file(const char *workdir);
 void log_message(const char *fmt, ...);
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef LOCKER_MANIFEST_H
+#define LOCKER_MANIFEST_H
+
+#include "attrs.h"
+#include "locker_utils.h"
+
+#define LOCKER_MANIFEST_FILENAME "lockers.manifest"
+
+typedef struct {
+  char *filename;
+  char *locker_name;
+  long long size;
+  long long mtime;
+} locker_manifest_entry_t;
+
+DEFINE_LOCKER_ARRAY_T(locker_manifest_entry_t, locker_manifest_entry);
+
+ATTR_ALLOC ATTR_NODISCARD array_locker_manifest_entry_t *
+manifest_load(const char locker_dir[static 1], long long dir_mtime);
+
+void manifest_store(const char locker_dir[static 1], long long dir_mtime,
+                    const array_locker_manifest_entry_t entries[static 1]);
+
+void manifest_free_entry(locker_manifest_entry_t entry);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef LOCKER_PREFETCH_H
+#define LOCKER_PREFETCH_H
+
+#include "attrs.h"
+#include <pthread.h>
+
+/* lockers past this size only get their head prefetched */
+#define LOCKER_PREFETCH_MAX_LEN (64 << 20)
+
+typedef struct {
+  pthread_t thread;
+  int fd;
+  double elapsed_ms;
+} locker_prefetch_t;
+
+ATTR_NODISCARD locker_prefetch_t *prefetch_start(const char filepath[static 1]);
+
+double prefetch_finish(locker_prefetch_t *prefetch);
+
+#endif
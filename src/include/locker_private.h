@@ -0,0 +1,38 @@
+#ifndef LOCKER_PRIVATE_H
+#define LOCKER_PRIVATE_H
+
+#include "locker.h"
+#include "locker_cache.h"
+#include "locker_crypto.h"
+#include "locker_fuzzy.h"
+#include "locker_header.h"
+#include "locker_journal.h"
+#include "locker_saver.h"
+#include "locker_trie.h"
+#include <pthread.h>
+
+/*
+ * Body of an opened locker. Only the core sees it, everything outside goes
+ * through the functions in locker.h so the layout may change between
+ * releases of the library.
+ */
+struct locker {
+  char locker_name[LOCKER_NAME_MAX_LEN + 1];
+  locker_header_t *_header;
+  locker_crypto_masterkey_t _key[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  /* locker_db_t, connection plus its compiled statements */
+  struct locker_db *_db;
+  locker_journal_t *_journal;
+  /* in-memory indexes of every item key, kept in step by the item functions */
+  locker_trie_t *_index;
+  locker_fuzzy_t *_fuzzy;
+  /* writes and the saver take it exclusively, lookups share it */
+  pthread_rwlock_t *_lock;
+  /* locker_readers_t, per-thread read connections */
+  struct locker_readers *_readers;
+  locker_saver_t *_saver;
+  /* decoded items of recent lookups, dropped by every write to them */
+  locker_cache_t *_cache;
+};
+
+#endif
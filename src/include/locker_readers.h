@@ -0,0 +1,59 @@
+#ifndef LOCKER_READERS_H
+#define LOCKER_READERS_H
+
+#include "attrs.h"
+#include "locker_db.h"
+#include "locker_vfs.h"
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+ * Read connections of one opened locker. Threads that attach get their own
+ * read-only connection on the locker file, decrypting with the key of the
+ * primary connection, so lookups of different threads never wait on each
+ * other. While any thread is attached every write flushes the pages of the
+ * open transaction to the file. Readers keep the blocks they decrypted and
+ * decrypt again only those a write changed. Threads that did not attach
+ * share the primary connection, one at a time.
+ *
+ * readers_acquire and readers_release are called under the shared side of the
+ * locker lock, readers_attach and readers_invalidate under its exclusive
+ * side. A thread attaches and detaches itself.
+ */
+typedef struct locker_reader locker_reader_t;
+
+typedef struct locker_readers {
+  locker_db_t *primary;
+  /* serializes uses of the primary connection under the shared lock */
+  pthread_mutex_t primary_lock;
+  /* what the connection of an attached thread opens */
+  char *path;
+  locker_vfs_params_t params;
+  pthread_key_t key;
+  /* every attached reader, for readers_free */
+  pthread_mutex_t list_lock;
+  locker_reader_t *head;
+  /* false while the primary cache holds pages the file lacks */
+  bool flushed;
+  /* generation is bumped by every write, the primary marks what it wrote */
+  locker_vfs_versions_t versions;
+} locker_readers_t;
+
+/* params->key has to outlive the readers, params->versions is their own */
+ATTR_ALLOC ATTR_NODISCARD locker_readers_t *
+readers_new(locker_db_t *primary, const char path[static 1],
+            const locker_vfs_params_t params[static 1]);
+
+/* closes every reader, no thread may use the locker anymore */
+void readers_free(locker_readers_t readers[static 1]);
+
+void readers_attach(locker_readers_t readers[static 1]);
+void readers_detach(locker_readers_t readers[static 1]);
+
+/* the calling thread's connection, hand it back with readers_release */
+locker_db_t *readers_acquire(locker_readers_t readers[static 1]);
+void readers_release(locker_readers_t readers[static 1], locker_db_t *db);
+
+void readers_invalidate(locker_readers_t readers[static 1]);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef LOCKER_SAVER_H
+#define LOCKER_SAVER_H
+
+#include "attrs.h"
+#include "locker.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+/* false when the save failed, saver_state reports it until the next one */
+typedef bool (*locker_save_fn)(void *arg);
+
+/*
+ * Runs saves on a writer thread. Requests arriving while a save is running
+ * are merged into a single follow-up save.
+ */
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  locker_save_fn save;
+  void *arg;
+  bool requested;
+  bool running;
+  bool failed;
+  bool stopping;
+} locker_saver_t;
+
+ATTR_ALLOC ATTR_NODISCARD locker_saver_t *saver_start(locker_save_fn save,
+                                                      void *arg);
+
+void saver_request(locker_saver_t saver[static 1]);
+
+locker_save_state_t saver_state(locker_saver_t saver[static 1]);
+
+void saver_stop(locker_saver_t saver[static 1]);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef LOCKER_TRIE_H
+#define LOCKER_TRIE_H
+
+#include "attrs.h"
+#include "locker.h"
+#include "locker_utils.h"
+#include "sqlite3.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Radix trie over item keys. Every node holds the edge label leading to it,
+ * its children ordered by the first byte of their label and the number of
+ * keys stored at or below it. An item_id of 0 means no key ends at the node.
+ */
+typedef struct locker_trie_node {
+  char *label;
+  size_t label_len;
+  struct locker_trie_node **children;
+  size_t n_children;
+  size_t count;
+  sqlite3_int64 item_id;
+  int item_type;
+} locker_trie_node_t;
+
+typedef struct locker_trie {
+  locker_trie_node_t root;
+} locker_trie_t;
+
+ATTR_ALLOC ATTR_NODISCARD locker_trie_t *trie_new(void);
+
+void trie_free(locker_trie_t trie[static 1]);
+
+void trie_insert(locker_trie_t trie[static 1], const char key[static 1],
+                 sqlite3_int64 item_id, int item_type);
+
+bool trie_remove(locker_trie_t trie[static 1], const char key[static 1]);
+
+bool trie_find(const locker_trie_t trie[static 1], const char key[static 1],
+               sqlite3_int64 *item_id, int *item_type);
+
+size_t trie_count_prefix(const locker_trie_t trie[static 1],
+                         const char prefix[static 1]);
+
+size_t trie_complete(const locker_trie_t trie[static 1],
+                     const char prefix[static 1], char out[], size_t out_sz);
+
+/* entries are locker_trie_entry_t of locker.h, freed with trie_free_entry */
+ATTR_ALLOC ATTR_NODISCARD array_locker_trie_entry_t *
+trie_browse(const locker_trie_t trie[static 1], const char prefix[static 1],
+            char separator);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef LOCKER_TUI_EDITOR_H
+#define LOCKER_TUI_EDITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Text with a gap at the cursor: typing fills the gap and deleting widens it,
+ * so only moving the cursor far away copies bytes. The storage comes from
+ * sodium_malloc, it is locked in memory and wiped when freed or grown.
+ */
+typedef struct {
+  char *data;
+  size_t capacity;
+  size_t gap_start;
+  size_t gap_end;
+  size_t max_len;
+} gap_buffer_t;
+
+void gap_buffer_init(gap_buffer_t gb[static 1], size_t max_len, const char *text, size_t len);
+void gap_buffer_free(gap_buffer_t gb[static 1]);
+
+size_t gap_buffer_len(const gap_buffer_t gb[static 1]);
+char gap_buffer_at(const gap_buffer_t gb[static 1], size_t pos);
+/* the cursor is where the gap starts */
+void gap_buffer_move(gap_buffer_t gb[static 1], size_t pos);
+/* inserts at the cursor as much of text as max_len leaves room for, returns that */
+size_t gap_buffer_insert(gap_buffer_t gb[static 1], const char *text, size_t len);
+void gap_buffer_delete(gap_buffer_t gb[static 1], size_t before, size_t after);
+/* writes the text and a NUL, out holds at least gap_buffer_len+1 bytes */
+void gap_buffer_copy(const gap_buffer_t gb[static 1], char *out);
+
+typedef struct {
+  int y;
+  int x;
+  int n_lines;
+  int n_cols;
+  /* ENTER breaks lines instead of being ignored */
+  bool multiline;
+  /* false keeps what is typed off the screen */
+  bool typing;
+  int attrs;
+} tui_editor_box_t;
+
+/* edits gb in a box of the screen until CTRL-X, lines wrap at the box edge */
+void tui_edit(gap_buffer_t gb[static 1], const tui_editor_box_t box[static 1]);
+
+#endif
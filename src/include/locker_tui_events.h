@@ -0,0 +1,46 @@
+#ifndef LOCKER_TUI_EVENTS_H
+#define LOCKER_TUI_EVENTS_H
+
+#include <stdbool.h>
+
+#define TUI_MAX_TIMERS 4
+
+/*
+ * One loop drives every view. It sleeps in poll() on the terminal and a wake
+ * pipe until a key arrives, the terminal is resized or a timer expires, and
+ * hands each of these to the handler of the view on screen. A view opened
+ * from a handler runs a loop of its own, with its own timers, until its
+ * handler returns false.
+ */
+typedef enum {
+  /* also sent when a loop starts, so the first frame is laid out the same way */
+  TUI_EVENT_RESIZE,
+  TUI_EVENT_KEY,
+  TUI_EVENT_TIMER,
+} tui_event_type_t;
+
+typedef struct {
+  tui_event_type_t type;
+  /* ncurses key of TUI_EVENT_KEY, timer id of TUI_EVENT_TIMER */
+  int value;
+} tui_event_t;
+
+typedef struct tui_loop tui_loop_t;
+
+/* handles one event, false leaves the loop */
+typedef bool (*tui_handler_fn)(tui_loop_t *loop, const tui_event_t event[static 1], void *arg);
+
+/* after initscr, input is read without blocking from here on */
+void tui_events_init(void);
+void tui_events_close(void);
+
+void tui_events_run(tui_handler_fn handler, void *arg);
+
+/* fires every interval_ms until stopped, starting a running timer keeps its deadline */
+void tui_timer_start(tui_loop_t *loop, int id, int interval_ms);
+void tui_timer_stop(tui_loop_t *loop, int id);
+
+/* runs a loop that returns the next key */
+int tui_wait_key(void);
+
+#endif
@@ -12,6 +12,9 @@
 #define TAB_LEN 4
 #define PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET 4
 #define PRINTW_DEFAULT_X_OFFSET 2
+#define SAVE_STATUS_REFRESH_MS 250
+#define SAVE_STATUS_TIMER 1
+#define SEARCH_MAX_RESULTS 500
 
 #include <stddef.h>
 #include <stdbool.h>
@@ -24,6 +27,12 @@ void print_control_panel(size_t n_options, const char *options[], int y_offset,
 
 void get_user_str(size_t buffer_sz, char buffer[buffer_sz], int win_y, int win_x, int controls_y, int controls_x, bool typing, bool show_cursor, int attrs);
 
+/* several lines in a box of n_lines rows and n_cols columns, ENTER breaks lines */
+void get_user_text(size_t buffer_sz, char buffer[buffer_sz], int win_y, int win_x, int n_lines, int n_cols, int controls_y, int controls_x);
+
+/* one line ended by ENTER, echoed only when typing */
+void get_user_line(size_t buffer_sz, char buffer[buffer_sz], int win_y, int win_x, bool typing);
+
 int choice_selector(int n_choices, const char *choices[], int row_offset);
 
 void clear_line_inplace(int y, int x);
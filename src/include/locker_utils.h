@@ -1,6 +1,8 @@
 #ifndef LOCKER_UTILS_H
 #define LOCKER_UTILS_H
 
+#include "attrs.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 #define DEFAULT_LOCKER_ARRAY_T_CAPACITY 16
@@ -47,4 +49,33 @@
 
 DEFINE_LOCKER_ARRAY_T(char *, str);
 
+#define LOCKER_ARENA_BLOCK_LEN 4096
+
+typedef struct locker_arena_block {
+    struct locker_arena_block *next;
+    size_t used;
+    size_t capacity;
+    max_align_t data[];
+} locker_arena_block_t;
+
+/*
+ * Bump allocator, everything taken from it is given back at once by
+ * arena_reset or arena_release. A secure arena takes its blocks from
+ * sodium_malloc and wipes them before they are reused or released.
+ */
+typedef struct {
+    locker_arena_block_t *head;
+    bool secure;
+} locker_arena_t;
+
+LOCKER_API void arena_init(locker_arena_t arena[static 1], bool secure);
+
+LOCKER_API void *arena_alloc(locker_arena_t arena[static 1], size_t size);
+LOCKER_API char *arena_strndup(locker_arena_t arena[static 1], const char *s, size_t len);
+LOCKER_API char *arena_strdup(locker_arena_t arena[static 1], const char s[static 1]);
+
+/* keeps the largest block around, so a refilled arena does not allocate */
+LOCKER_API void arena_reset(locker_arena_t arena[static 1]);
+LOCKER_API void arena_release(locker_arena_t arena[static 1]);
+
 #endif
@@ -2,6 +2,9 @@
 #define LOCKER_VERSION_H
 
 #define CURRENT_VERSION "0.2.0"
-#define LOCKER_FILE_VERSION 1
+#define LOCKER_FILE_VERSION 5
+/* first file versions with header key slots and compact account content */
+#define LOCKER_FILE_VERSION_KEY_SLOTS 4
+#define LOCKER_FILE_VERSION_COMPACT_ACCOUNTS 5
 
 #endif
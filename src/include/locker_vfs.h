@@ -0,0 +1,66 @@
+#ifndef LOCKER_VFS_H
+#define LOCKER_VFS_H
+
+#include "locker_crypto.h"
+#include "sqlite3.h"
+#include <stdint.h>
+
+#define LOCKER_VFS_NAME "locker"
+/* read-only connections that leave locking to whoever owns the locker */
+#define LOCKER_VFS_READER_NAME "locker-reader"
+
+/*
+ * Plaintext is split into fixed blocks and every block is stored as its own
+ * XChaCha20-Poly1305 frame: nonce | ciphertext | tag.
+ */
+#define LOCKER_VFS_BLOCK_SIZE 4096
+#define LOCKER_VFS_FRAME_SIZE                                                  \
+  (LOCKER_CRYPTO_NONCE_LEN + LOCKER_VFS_BLOCK_SIZE +                           \
+   crypto_aead_xchacha20poly1305_ietf_ABYTES)
+
+/* decrypted blocks a reader keeps in locked memory, 2 MiB */
+#define LOCKER_VFS_READER_BLOCKS 512
+
+/*
+ * Generation in which every block of a locker file was last written, kept up
+ * to date by the connection that writes it. A reader decrypts a block again
+ * only when it was written after the reader last did. Blocks past n_blocks
+ * were not written since tracking started.
+ */
+typedef struct {
+  uint64_t generation;
+  uint64_t *block_generations;
+  sqlite3_int64 n_blocks;
+} locker_vfs_versions_t;
+
+typedef struct {
+  /* bytes in front of the first frame that belong to the locker header */
+  sqlite3_int64 data_offset;
+  const locker_crypto_masterkey_t *key;
+  /* readers only, tells them which of their blocks are out of date */
+  const locker_vfs_versions_t *versions;
+} locker_vfs_params_t;
+
+/* registers the locker VFS together with the reader VFS */
+int locker_vfs_register(void);
+
+int locker_vfs_open(const char path[static 1],
+                    const locker_vfs_params_t params[static 1], sqlite3 **db);
+
+/*
+ * A reader takes no file locks and sees no journal, it must only read while
+ * nothing writes the file and the file holds every page it is to see.
+ * params->versions is required.
+ */
+int locker_vfs_open_reader(const char path[static 1],
+                           const locker_vfs_params_t params[static 1],
+                           sqlite3 **db);
+
+/*
+ * Marks every block the connection writes from now on with the generation
+ * after versions->generation, NULL stops it. Bumping the generation is up to
+ * the caller.
+ */
+void locker_vfs_track_writes(sqlite3 *db, locker_vfs_versions_t *versions);
+
+#endif
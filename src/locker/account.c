@@ -0,0 +1,94 @@
+#include "locker_account.h"
+#include "locker_utils.h"
+#include "locker_utils_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ACCOUNT_FIELDS 3
+
+ATTR_ALLOC ATTR_NODISCARD unsigned char *
+account_content_encode(const char username[static 1],
+                       const char password[static 1], const char url[static 1],
+                       size_t *size) {
+  const char *fields[ACCOUNT_FIELDS] = {username, password, url};
+  size_t lens[ACCOUNT_FIELDS];
+
+  *size = 1;
+  for (int i = 0; i < ACCOUNT_FIELDS; i++) {
+    lens[i] = strlen(fields[i]);
+    *size += 2 + lens[i];
+  }
+
+  unsigned char *content = malloc(*size);
+  if (!content) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  content[0] = LOCKER_ACCOUNT_FORMAT_LENGTH_PREFIXED;
+  size_t offset = 1;
+  for (int i = 0; i < ACCOUNT_FIELDS; i++) {
+    put_u16_le(content + offset, (uint16_t)lens[i]);
+    memcpy(content + offset + 2, fields[i], lens[i]);
+    offset += 2 + lens[i];
+  }
+
+  return content;
+}
+
+/* field offsets and lengths, or false when content is in no known layout */
+static bool account_content_fields(const unsigned char *content, size_t size,
+                                   size_t offsets[ACCOUNT_FIELDS],
+                                   size_t lens[ACCOUNT_FIELDS]) {
+  if (size > 0 && content[0] == LOCKER_ACCOUNT_FORMAT_LENGTH_PREFIXED) {
+    size_t offset = 1;
+    for (int i = 0; i < ACCOUNT_FIELDS; i++) {
+      if (offset + 2 > size)
+        return false;
+      lens[i] = get_u16_le(content + offset);
+      offsets[i] = offset + 2;
+      offset += 2 + lens[i];
+      if (offset > size)
+        return false;
+    }
+    return offset == size;
+  }
+
+  if (size != LOCKER_ACCOUNT_LEGACY_CONTENT_LEN)
+    return false;
+
+  /* a field filling its whole slot has no terminating NUL */
+  const size_t caps[ACCOUNT_FIELDS] = {LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN,
+                                       LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN,
+                                       LOCKER_ITEM_ACCOUNT_URL_MAX_LEN};
+  size_t offset = 0;
+  for (int i = 0; i < ACCOUNT_FIELDS; i++) {
+    offsets[i] = offset;
+    lens[i] = strnlen((const char *)content + offset, caps[i]);
+    offset += caps[i];
+  }
+  return true;
+}
+
+bool account_content_decode(const unsigned char *content, size_t size,
+                            locker_item_account_t account[static 1],
+                            locker_arena_t arena[static 1]) {
+  size_t offsets[ACCOUNT_FIELDS], lens[ACCOUNT_FIELDS];
+  if (!account_content_fields(content, size, offsets, lens))
+    return false;
+
+  account->username =
+      arena_strndup(arena, (const char *)content + offsets[0], lens[0]);
+  account->password =
+      arena_strndup(arena, (const char *)content + offsets[1], lens[1]);
+  account->url =
+      arena_strndup(arena, (const char *)content + offsets[2], lens[2]);
+  return true;
+}
+
+bool account_content_is_compact(const unsigned char *content, size_t size) {
+  size_t offsets[ACCOUNT_FIELDS], lens[ACCOUNT_FIELDS];
+  return size > 0 && content[0] == LOCKER_ACCOUNT_FORMAT_LENGTH_PREFIXED &&
+         account_content_fields(content, size, offsets, lens);
+}
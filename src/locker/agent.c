@@ -0,0 +1,591 @@
+/* struct ucred for SO_PEERCRED on glibc */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "locker_agent.h"
+#include "locker_logs.h"
+#include "locker_utils_private.h"
+#include "sodium.h"
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define AGENT_ITEM_MAX_STRINGS 5
+
+typedef struct {
+  locker_t *locker;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  /* accepted connections waiting for a free worker */
+  int queue[LOCKER_AGENT_QUEUE_LEN];
+  size_t queue_head;
+  size_t queue_len;
+  /* connection each worker is serving, shut down to wake it when stopping */
+  int serving[LOCKER_AGENT_WORKERS];
+  bool stopping;
+} agent_t;
+
+typedef struct {
+  agent_t *agent;
+  size_t index;
+} agent_worker_t;
+
+/* written to from the signal handler, the event loop polls the other end */
+static int signal_pipe[2] = {-1, -1};
+
+void agent_socket_path(char path[PATH_MAX], const char workdir[static 1],
+                       const char locker_name[static 1]) {
+  char filepath[PATH_MAX];
+  get_locker_filepath(filepath, workdir, locker_name);
+  snprintf(path, PATH_MAX, "%s%s", filepath, LOCKER_AGENT_SOCKET_SUFFIX);
+}
+
+static bool read_full(int fd, void *buf, size_t len) {
+  unsigned char *p = buf;
+  while (len > 0) {
+    ssize_t n = read(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool write_full(int fd, const void *buf, size_t len) {
+  const unsigned char *p = buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool agent_read_frame(int fd, unsigned char **payload, uint32_t *len) {
+  unsigned char header[4];
+  if (!read_full(fd, header, sizeof(header)))
+    return false;
+
+  *len = get_u32_le(header);
+  if (*len > LOCKER_AGENT_MAX_FRAME_LEN)
+    return false;
+
+  /* one spare byte, so an empty payload still gets a buffer */
+  *payload = sodium_malloc(*len + 1);
+  if (!*payload) {
+    perror("sodium_malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  if (!read_full(fd, *payload, *len)) {
+    sodium_free(*payload);
+    return false;
+  }
+  return true;
+}
+
+bool agent_write_frame(int fd, const unsigned char *payload, uint32_t len) {
+  unsigned char header[4];
+  put_u32_le(header, len);
+  return write_full(fd, header, sizeof(header)) && write_full(fd, payload, len);
+}
+
+/* the strings of an item in wire order */
+static size_t item_strings(const locker_resolved_item_t *item,
+                           const char *strings[AGENT_ITEM_MAX_STRINGS]) {
+  if (item->type == LOCKER_ITEM_ACCOUNT) {
+    strings[0] = item->account.key;
+    strings[1] = item->account.description;
+    strings[2] = item->account.username;
+    strings[3] = item->account.password;
+    strings[4] = item->account.url;
+    return 5;
+  }
+
+  strings[0] = item->apikey.key;
+  strings[1] = item->apikey.description;
+  strings[2] = item->apikey.value;
+  return 3;
+}
+
+size_t agent_encode_item(unsigned char *out,
+                         const locker_resolved_item_t item[static 1]) {
+  const char *strings[AGENT_ITEM_MAX_STRINGS];
+  size_t n = item_strings(item, strings);
+
+  if (out)
+    out[0] = (unsigned char)item->type;
+  size_t len = 1;
+  for (size_t i = 0; i < n; i++) {
+    size_t string_len = strlen(strings[i]);
+    if (out) {
+      put_u32_le(out + len, (uint32_t)string_len);
+      memcpy(out + len + 4, strings[i], string_len);
+    }
+    len += 4 + string_len;
+  }
+  return len;
+}
+
+bool agent_decode_item(const unsigned char **p, const unsigned char *end,
+                       locker_arena_t arena[static 1],
+                       locker_resolved_item_t item[static 1]) {
+  if (*p >= end || **p > LOCKER_ITEM_NOTE)
+    return false;
+
+  *item = (locker_resolved_item_t){.type = **p};
+  (*p)++;
+
+  char *strings[AGENT_ITEM_MAX_STRINGS];
+  size_t n = item->type == LOCKER_ITEM_ACCOUNT ? 5 : 3;
+  for (size_t i = 0; i < n; i++) {
+    if (end - *p < 4)
+      return false;
+    uint32_t len = get_u32_le(*p);
+    *p += 4;
+    if ((size_t)(end - *p) < len)
+      return false;
+    strings[i] = arena_strndup(arena, (const char *)*p, len);
+    *p += len;
+  }
+
+  if (item->type == LOCKER_ITEM_ACCOUNT) {
+    item->account.key = strings[0];
+    item->account.description = strings[1];
+    item->account.username = strings[2];
+    item->account.password = strings[3];
+    item->account.url = strings[4];
+  } else {
+    item->apikey.key = strings[0];
+    item->apikey.description = strings[1];
+    item->apikey.value = strings[2];
+  }
+  return true;
+}
+
+static bool reply_status(int fd, locker_agent_status_t status) {
+  unsigned char payload = (unsigned char)status;
+  return agent_write_frame(fd, &payload, 1);
+}
+
+static bool reply_items(int fd, const locker_resolved_item_t items[],
+                        size_t count, bool with_count) {
+  size_t len = 1 + (with_count ? 4 : 0);
+  for (size_t i = 0; i < count; i++)
+    len += agent_encode_item(NULL, &items[i]);
+  if (len > LOCKER_AGENT_MAX_FRAME_LEN)
+    return reply_status(fd, LOCKER_AGENT_TOO_LARGE);
+
+  unsigned char *payload = sodium_malloc(len);
+  if (!payload) {
+    perror("sodium_malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  payload[0] = LOCKER_AGENT_OK;
+  size_t offset = 1;
+  if (with_count) {
+    put_u32_le(payload + offset, (uint32_t)count);
+    offset += 4;
+  }
+  for (size_t i = 0; i < count; i++)
+    offset += agent_encode_item(payload + offset, &items[i]);
+
+  bool sent = agent_write_frame(fd, payload, (uint32_t)len);
+  sodium_free(payload);
+  return sent;
+}
+
+static bool reply_list(int fd, const locker_item_list_t list[static 1]) {
+  size_t len = 1 + 4;
+  for (size_t i = 0; i < list->items.count; i++)
+    len += 1 + 4 + strlen(list->items.values[i].key);
+  if (len > LOCKER_AGENT_MAX_FRAME_LEN)
+    return reply_status(fd, LOCKER_AGENT_TOO_LARGE);
+
+  unsigned char *payload = malloc(len);
+  if (!payload) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  payload[0] = LOCKER_AGENT_OK;
+  put_u32_le(payload + 1, (uint32_t)list->items.count);
+  size_t offset = 5;
+  for (size_t i = 0; i < list->items.count; i++) {
+    const locker_item_t *item = &list->items.values[i];
+    size_t key_len = strlen(item->key);
+    payload[offset] = (unsigned char)item->type;
+    put_u32_le(payload + offset + 1, (uint32_t)key_len);
+    memcpy(payload + offset + 5, item->key, key_len);
+    offset += 5 + key_len;
+  }
+
+  bool sent = agent_write_frame(fd, payload, (uint32_t)len);
+  free(payload);
+  return sent;
+}
+
+static bool reply_result(int fd, locker_result_t result) {
+  if (result == LOCKER_OK)
+    return reply_status(fd, LOCKER_AGENT_OK);
+
+  unsigned char payload[2] = {LOCKER_AGENT_FAILED, (unsigned char)result};
+  return agent_write_frame(fd, payload, sizeof(payload));
+}
+
+/* the key, query or pattern following the op, NULL when it is not one */
+static char *request_string(const unsigned char *request, uint32_t len,
+                            locker_arena_t arena[static 1]) {
+  if (len - 1 > (LOCKER_ITEM_KEY_MAX_LEN))
+    return NULL;
+
+  char *arg = arena_strndup(arena, (const char *)request + 1, len - 1);
+  return strlen(arg) == len - 1 ? arg : NULL;
+}
+
+static bool handle_request(agent_t *agent, int fd, const unsigned char *request,
+                           uint32_t len, locker_arena_t secrets[static 1]) {
+  if (len == 0)
+    return reply_status(fd, LOCKER_AGENT_BAD_REQUEST);
+
+  locker_agent_op_t op = request[0];
+  if (op == LOCKER_AGENT_OP_ADD) {
+    const unsigned char *p = request + 1;
+    locker_resolved_item_t item;
+    if (!agent_decode_item(&p, request + len, secrets, &item) ||
+        p != request + len || item.type == LOCKER_ITEM_NOTE)
+      return reply_status(fd, LOCKER_AGENT_BAD_REQUEST);
+
+    return reply_result(fd, item.type == LOCKER_ITEM_ACCOUNT
+                                ? locker_add_account(agent->locker, &item.account)
+                                : locker_add_apikey(agent->locker, &item.apikey));
+  }
+
+  char *arg = request_string(request, len, secrets);
+  if (!arg)
+    return reply_status(fd, LOCKER_AGENT_BAD_REQUEST);
+
+  switch (op) {
+  case LOCKER_AGENT_OP_GET: {
+    locker_item_t found;
+    if (!locker_find_item(agent->locker, arg, &found))
+      return reply_status(fd, LOCKER_AGENT_NOT_FOUND);
+
+    /* a NULL is a delete that got in between or a failure in the log */
+    locker_resolved_item_t item = {.type = found.type};
+    if (found.type == LOCKER_ITEM_ACCOUNT) {
+      locker_item_account_t *account = locker_get_account(agent->locker, found.id, secrets);
+      if (!account)
+        return reply_status(fd, LOCKER_AGENT_NOT_FOUND);
+      item.account = *account;
+    } else {
+      locker_item_apikey_t *apikey = locker_get_apikey(agent->locker, found.id, secrets);
+      if (!apikey)
+        return reply_status(fd, LOCKER_AGENT_NOT_FOUND);
+      item.apikey = *apikey;
+    }
+    return reply_items(fd, &item, 1, false);
+  }
+  case LOCKER_AGENT_OP_LIST: {
+    char query[(LOCKER_ITEM_KEY_MAX_LEN) + 1];
+    snprintf(query, sizeof(query), "%s", arg);
+
+    locker_item_list_t list;
+    locker_item_list_init(&list);
+    locker_result_t result = locker_get_items(agent->locker, query, &list);
+    bool sent = result == LOCKER_OK ? reply_list(fd, &list) : reply_result(fd, result);
+    locker_item_list_free(&list);
+    return sent;
+  }
+  case LOCKER_AGENT_OP_RESOLVE: {
+    array_locker_resolved_item_t items;
+    init_item_array((&items));
+    locker_result_t result = locker_resolve_items(agent->locker, arg, secrets, &items);
+    bool sent = result == LOCKER_OK ? reply_items(fd, items.values, items.count, true)
+                                    : reply_result(fd, result);
+    free(items.values);
+    return sent;
+  }
+  case LOCKER_AGENT_OP_DELETE: {
+    locker_item_t found;
+    if (!locker_find_item(agent->locker, arg, &found))
+      return reply_status(fd, LOCKER_AGENT_NOT_FOUND);
+    return reply_result(fd, locker_delete_item(agent->locker, &found));
+  }
+  case LOCKER_AGENT_OP_ADD:
+    break;
+  }
+
+  return reply_status(fd, LOCKER_AGENT_BAD_REQUEST);
+}
+
+/* one request after the other until the client hangs up or goes quiet */
+static void serve_connection(agent_t *agent, int fd) {
+  locker_arena_t secrets;
+  arena_init(&secrets, true);
+
+  unsigned char *request;
+  uint32_t len;
+  while (agent_read_frame(fd, &request, &len)) {
+    bool sent = handle_request(agent, fd, request, len, &secrets);
+    sodium_free(request);
+    arena_reset(&secrets);
+    if (!sent)
+      break;
+  }
+
+  arena_release(&secrets);
+}
+
+static void *agent_worker(void *arg) {
+  agent_worker_t *worker = arg;
+  agent_t *agent = worker->agent;
+  /* workers look items up side by side, each on its own snapshot */
+  locker_attach_thread(agent->locker);
+
+  pthread_mutex_lock(&agent->mutex);
+  while (1) {
+    while (!agent->stopping && agent->queue_len == 0)
+      pthread_cond_wait(&agent->cond, &agent->mutex);
+    if (agent->stopping)
+      break;
+
+    int fd = agent->queue[agent->queue_head];
+    agent->queue_head = (agent->queue_head + 1) % LOCKER_AGENT_QUEUE_LEN;
+    agent->queue_len--;
+    agent->serving[worker->index] = fd;
+    pthread_mutex_unlock(&agent->mutex);
+
+    serve_connection(agent, fd);
+
+    pthread_mutex_lock(&agent->mutex);
+    agent->serving[worker->index] = -1;
+    close(fd);
+  }
+  pthread_mutex_unlock(&agent->mutex);
+
+  locker_detach_thread(agent->locker);
+  return NULL;
+}
+
+static bool peer_uid(int fd, uid_t *uid) {
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+    return false;
+  *uid = cred.uid;
+#else
+  gid_t gid;
+  if (getpeereid(fd, uid, &gid) != 0)
+    return false;
+#endif
+  return true;
+}
+
+static void accept_client(agent_t *agent, int listen_fd) {
+  int fd = accept(listen_fd, NULL, NULL);
+  if (fd < 0)
+    return;
+
+  /* same rule as ssh-agent, only the owner and root get an answer */
+  uid_t uid = (uid_t)-1;
+  if (!peer_uid(fd, &uid) || (uid != 0 && uid != geteuid())) {
+    log_message("Agent refused a connection from uid %ld.", (long)uid);
+    close(fd);
+    return;
+  }
+
+  struct timeval timeout = {.tv_sec = LOCKER_AGENT_IO_TIMEOUT};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  pthread_mutex_lock(&agent->mutex);
+  if (agent->queue_len == LOCKER_AGENT_QUEUE_LEN) {
+    pthread_mutex_unlock(&agent->mutex);
+    log_message("Agent dropped a connection, all workers are busy.");
+    close(fd);
+    return;
+  }
+  agent->queue[(agent->queue_head + agent->queue_len) % LOCKER_AGENT_QUEUE_LEN] =
+      fd;
+  agent->queue_len++;
+  pthread_cond_signal(&agent->cond);
+  pthread_mutex_unlock(&agent->mutex);
+}
+
+int agent_listen(const char path[static 1]) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Agent socket path %s is too long.\n", path);
+    return -1;
+  }
+  memcpy(addr.sun_path, path, strlen(path) + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  /* a socket nobody answers on is left over from an agent that died */
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    fprintf(stderr, "An agent is already serving this locker.\n");
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  unlink(path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  mode_t umask_old = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+  int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+  umask(umask_old);
+
+  if (rc != 0 || listen(fd, LOCKER_AGENT_QUEUE_LEN) != 0) {
+    perror("bind");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void on_signal(int sig) {
+  int saved_errno = errno;
+  char c = (char)sig;
+  if (write(signal_pipe[1], &c, 1) < 0) {
+    /* the loop is woken already when the pipe is full */
+  }
+  errno = saved_errno;
+}
+
+/* milliseconds left until ttl seconds have passed since start, -1 for ever */
+static int ttl_timeout(const struct timespec *start, unsigned ttl) {
+  if (ttl == 0)
+    return -1;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long elapsed_ms = (now.tv_sec - start->tv_sec) * 1000LL +
+                         (now.tv_nsec - start->tv_nsec) / 1000000;
+  long long left_ms = ttl * 1000LL - elapsed_ms;
+  if (left_ms <= 0)
+    return 0;
+  return left_ms > INT_MAX ? INT_MAX : (int)left_ms;
+}
+
+/* wakes the first n workers, drops the connections still queued and joins them */
+static void stop_workers(agent_t agent[static 1], size_t n, pthread_t threads[n]) {
+  pthread_mutex_lock(&agent->mutex);
+  agent->stopping = true;
+  for (size_t i = 0; i < LOCKER_AGENT_WORKERS; i++)
+    if (agent->serving[i] >= 0)
+      shutdown(agent->serving[i], SHUT_RDWR);
+  pthread_cond_broadcast(&agent->cond);
+  pthread_mutex_unlock(&agent->mutex);
+
+  for (size_t i = 0; i < n; i++)
+    pthread_join(threads[i], NULL);
+  for (size_t i = 0; i < agent->queue_len; i++)
+    close(agent->queue[(agent->queue_head + i) % LOCKER_AGENT_QUEUE_LEN]);
+}
+
+/*
+ * The event loop only accepts, every connection is then served by one of the
+ * workers, so a slow client never holds up the others.
+ */
+bool agent_serve(locker_t *locker, int listen_fd, unsigned ttl) {
+  agent_t agent = {.locker = locker};
+  for (size_t i = 0; i < LOCKER_AGENT_WORKERS; i++)
+    agent.serving[i] = -1;
+
+  if (pipe(signal_pipe) != 0) {
+    log_message("Agent cannot create its signal pipe: %s", strerror(errno));
+    return false;
+  }
+  pthread_mutex_init(&agent.mutex, NULL);
+  pthread_cond_init(&agent.cond, NULL);
+  struct sigaction action = {.sa_handler = on_signal};
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  sigaction(SIGHUP, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  pthread_t threads[LOCKER_AGENT_WORKERS];
+  agent_worker_t workers[LOCKER_AGENT_WORKERS];
+  size_t n_threads = 0;
+  for (; n_threads < LOCKER_AGENT_WORKERS; n_threads++) {
+    workers[n_threads] = (agent_worker_t){.agent = &agent, .index = n_threads};
+    int rc = pthread_create(&threads[n_threads], NULL, agent_worker, &workers[n_threads]);
+    if (rc != 0) {
+      log_message("Agent cannot start its workers: %s", strerror(rc));
+      break;
+    }
+  }
+
+  /* nothing was accepted yet, so the workers that did start only have to stop */
+  bool serving = n_threads == LOCKER_AGENT_WORKERS;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (serving)
+    log_message("Agent serving %s.", locker_get_name(locker));
+
+  while (serving) {
+    int timeout = ttl_timeout(&start, ttl);
+    if (timeout == 0) {
+      log_message("Agent for %s reached its %u s lifetime.", locker_get_name(locker), ttl);
+      break;
+    }
+
+    struct pollfd fds[2] = {{.fd = listen_fd, .events = POLLIN},
+                            {.fd = signal_pipe[0], .events = POLLIN}};
+    int n = poll(fds, 2, timeout);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("poll");
+      break;
+    }
+
+    if (fds[1].revents) {
+      log_message("Agent for %s stopped by a signal.", locker_get_name(locker));
+      break;
+    }
+    if (fds[0].revents & POLLIN)
+      accept_client(&agent, listen_fd);
+  }
+
+  stop_workers(&agent, n_threads, threads);
+
+  close(signal_pipe[0]);
+  close(signal_pipe[1]);
+  pthread_cond_destroy(&agent.cond);
+  pthread_mutex_destroy(&agent.mutex);
+  return serving;
+}
@@ -0,0 +1,202 @@
+#include "locker_agent.h"
+#include "locker_utils_private.h"
+#include "sodium.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int agent_connect(const char workdir[static 1],
+                  const char locker_name[static 1]) {
+  char path[PATH_MAX];
+  agent_socket_path(path, workdir, locker_name);
+
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path))
+    return -1;
+  memcpy(addr.sun_path, path, strlen(path) + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  /* an agent going away mid request is reported, not a SIGPIPE */
+  signal(SIGPIPE, SIG_IGN);
+  return fd;
+}
+
+static void malformed_response(void) {
+  fprintf(stderr, "Malformed response from the agent.\n");
+  exit(EXIT_FAILURE);
+}
+
+/* the response payload, its status byte is OK, NOT_FOUND or FAILED */
+static unsigned char *request(int fd, locker_agent_op_t op,
+                              const unsigned char *arg, size_t arg_len,
+                              uint32_t *len) {
+  unsigned char *frame = sodium_malloc(arg_len + 1);
+  if (!frame) {
+    perror("sodium_malloc");
+    exit(EXIT_FAILURE);
+  }
+  frame[0] = (unsigned char)op;
+  memcpy(frame + 1, arg, arg_len);
+
+  unsigned char *response;
+  bool answered = agent_write_frame(fd, frame, (uint32_t)(arg_len + 1)) &&
+                  agent_read_frame(fd, &response, len);
+  sodium_free(frame);
+  if (!answered) {
+    fprintf(stderr, "Lost the connection to the agent.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (*len == 0)
+    malformed_response();
+
+  switch ((locker_agent_status_t)response[0]) {
+  case LOCKER_AGENT_OK:
+  case LOCKER_AGENT_NOT_FOUND:
+  case LOCKER_AGENT_FAILED:
+    return response;
+  case LOCKER_AGENT_BAD_REQUEST:
+    fprintf(stderr, "The agent refused the request.\n");
+    break;
+  case LOCKER_AGENT_TOO_LARGE:
+    fprintf(stderr, "The answer is too large for the agent to send.\n");
+    break;
+  default:
+    malformed_response();
+  }
+  exit(EXIT_FAILURE);
+}
+
+/* exits when the agent could not answer a lookup from its locker */
+static void lookup_failed(const unsigned char *response) {
+  if (response[0] != LOCKER_AGENT_FAILED)
+    return;
+  fprintf(stderr, "The agent could not read its locker, check its log file.\n");
+  exit(EXIT_FAILURE);
+}
+
+static unsigned char *request_string(int fd, locker_agent_op_t op,
+                                     const char arg[static 1], uint32_t *len) {
+  return request(fd, op, (const unsigned char *)arg, strlen(arg), len);
+}
+
+bool agent_get(int fd, const char key[static 1], locker_arena_t arena[static 1],
+               locker_resolved_item_t item[static 1]) {
+  uint32_t len;
+  unsigned char *response = request_string(fd, LOCKER_AGENT_OP_GET, key, &len);
+  lookup_failed(response);
+
+  bool found = response[0] == LOCKER_AGENT_OK;
+  if (found) {
+    const unsigned char *p = response + 1;
+    if (!agent_decode_item(&p, response + len, arena, item) ||
+        p != response + len)
+      malformed_response();
+  }
+
+  sodium_free(response);
+  return found;
+}
+
+/* replaces the contents of list like locker_get_items */
+void agent_list(int fd, const char query[static 1],
+                locker_item_list_t list[static 1]) {
+  locker_item_list_clear(list);
+
+  uint32_t len;
+  unsigned char *response = request_string(fd, LOCKER_AGENT_OP_LIST, query, &len);
+  lookup_failed(response);
+  const unsigned char *p = response + 1, *end = response + len;
+  if (end - p < 4)
+    malformed_response();
+  uint32_t count = get_u32_le(p);
+  p += 4;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (end - p < 5)
+      malformed_response();
+    locker_item_t item = {.type = p[0]};
+    uint32_t key_len = get_u32_le(p + 1);
+    p += 5;
+    if ((size_t)(end - p) < key_len)
+      malformed_response();
+    item.key = arena_strndup(&list->arena, (const char *)p, key_len);
+    p += key_len;
+
+    locker_array_append(&list->items, item);
+  }
+
+  sodium_free(response);
+}
+
+size_t agent_resolve(int fd, const char pattern[static 1],
+                     locker_arena_t arena[static 1],
+                     array_locker_resolved_item_t out[static 1]) {
+  uint32_t len;
+  unsigned char *response = request_string(fd, LOCKER_AGENT_OP_RESOLVE, pattern, &len);
+  lookup_failed(response);
+  const unsigned char *p = response + 1, *end = response + len;
+  if (end - p < 4)
+    malformed_response();
+  uint32_t count = get_u32_le(p);
+  p += 4;
+
+  for (uint32_t i = 0; i < count; i++) {
+    locker_resolved_item_t item;
+    if (!agent_decode_item(&p, end, arena, &item))
+      malformed_response();
+    locker_array_append(out, item);
+  }
+
+  sodium_free(response);
+  return count;
+}
+
+locker_result_t agent_add(int fd, const locker_resolved_item_t item[static 1]) {
+  size_t item_len = agent_encode_item(NULL, item);
+  unsigned char *encoded = sodium_malloc(item_len);
+  if (!encoded) {
+    perror("sodium_malloc");
+    exit(EXIT_FAILURE);
+  }
+  agent_encode_item(encoded, item);
+
+  uint32_t len;
+  unsigned char *response =
+      request(fd, LOCKER_AGENT_OP_ADD, encoded, item_len, &len);
+  sodium_free(encoded);
+
+  locker_result_t result = LOCKER_OK;
+  if (response[0] == LOCKER_AGENT_FAILED) {
+    if (len != 2)
+      malformed_response();
+    result = response[1];
+  }
+
+  sodium_free(response);
+  return result;
+}
+
+bool agent_delete(int fd, const char key[static 1]) {
+  uint32_t len;
+  unsigned char *response =
+      request_string(fd, LOCKER_AGENT_OP_DELETE, key, &len);
+  bool found = response[0] != LOCKER_AGENT_NOT_FOUND;
+  if (response[0] == LOCKER_AGENT_FAILED) {
+    fprintf(stderr, "The agent could not delete %s.\n", key);
+    exit(EXIT_FAILURE);
+  }
+
+  sodium_free(response);
+  return found;
+}
@@ -0,0 +1,101 @@
+#include "locker_utils.h"
+#include "sodium/utils.h"
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void arena_init(locker_arena_t arena[static 1], bool secure) {
+  arena->head = NULL;
+  arena->secure = secure;
+}
+
+static locker_arena_block_t *block_new(const locker_arena_t arena[static 1],
+                                       size_t capacity) {
+  /* sodium_malloc only aligns allocations whose size is a multiple of it */
+  size_t align = alignof(max_align_t);
+  capacity = (capacity + align - 1) & ~(align - 1);
+  size_t size = sizeof(locker_arena_block_t) + capacity;
+  locker_arena_block_t *block =
+      arena->secure ? sodium_malloc(size) : malloc(size);
+  if (!block) {
+    perror(arena->secure ? "sodium_malloc" : "malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  block->next = NULL;
+  block->used = 0;
+  block->capacity = capacity;
+  return block;
+}
+
+static void block_free(const locker_arena_t arena[static 1],
+                       locker_arena_block_t *block) {
+  if (arena->secure) {
+    /* sodium_free wipes the whole allocation on its own */
+    sodium_free(block);
+  } else {
+    free(block);
+  }
+}
+
+static void *arena_alloc_aligned(locker_arena_t arena[static 1], size_t size,
+                                 size_t align) {
+  locker_arena_block_t *block = arena->head;
+  size_t offset = block ? (block->used + align - 1) & ~(align - 1) : 0;
+
+  if (!block || offset + size > block->capacity) {
+    /* blocks double, so a growing arena takes a logarithmic number of them */
+    size_t capacity = block ? block->capacity * 2 : LOCKER_ARENA_BLOCK_LEN;
+    if (capacity < size)
+      capacity = size;
+
+    block = block_new(arena, capacity);
+    block->next = arena->head;
+    arena->head = block;
+    offset = 0;
+  }
+
+  block->used = offset + size;
+  return (unsigned char *)block->data + offset;
+}
+
+void *arena_alloc(locker_arena_t arena[static 1], size_t size) {
+  return arena_alloc_aligned(arena, size, alignof(max_align_t));
+}
+
+char *arena_strndup(locker_arena_t arena[static 1], const char *s,
+                    size_t len) {
+  char *copy = arena_alloc_aligned(arena, len + 1, 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+char *arena_strdup(locker_arena_t arena[static 1], const char s[static 1]) {
+  return arena_strndup(arena, s, strlen(s));
+}
+
+void arena_reset(locker_arena_t arena[static 1]) {
+  locker_arena_block_t *head = arena->head;
+  if (!head)
+    return;
+
+  for (locker_arena_block_t *block = head->next, *next; block; block = next) {
+    next = block->next;
+    block_free(arena, block);
+  }
+
+  if (arena->secure)
+    sodium_memzero(head->data, head->used);
+  head->next = NULL;
+  head->used = 0;
+}
+
+void arena_release(locker_arena_t arena[static 1]) {
+  for (locker_arena_block_t *block = arena->head, *next; block; block = next) {
+    next = block->next;
+    block_free(arena, block);
+  }
+  arena->head = NULL;
+}
@@ -0,0 +1,203 @@
+#include "locker_cache.h"
+#include "sodium.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CACHE_APIKEY_FIELDS 3
+#define CACHE_ACCOUNT_FIELDS 5
+#define CACHE_MAX_FIELDS CACHE_ACCOUNT_FIELDS
+
+static void clear_slot(locker_cache_t cache[static 1], locker_cache_slot_t slot[static 1]) {
+  if (!slot->item_id)
+    return;
+
+  sodium_memzero(slot, sizeof(locker_cache_slot_t));
+  cache->n_used--;
+}
+
+/* the cache stays put while lookups come in less than LOCKER_CACHE_IDLE_SEC apart */
+static void *cache_sweeper(void *arg) {
+  locker_cache_t *cache = arg;
+
+  pthread_mutex_lock(&cache->mutex);
+  while (!cache->stopping) {
+    if (!cache->n_used) {
+      pthread_cond_wait(&cache->cond, &cache->mutex);
+      continue;
+    }
+
+    struct timespec deadline = cache->last_access;
+    deadline.tv_sec += LOCKER_CACHE_IDLE_SEC;
+    if (pthread_cond_timedwait(&cache->cond, &cache->mutex, &deadline) != ETIMEDOUT)
+      continue;
+
+    /* a lookup in the meantime moved the deadline on, the next round waits for it */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec - cache->last_access.tv_sec < LOCKER_CACHE_IDLE_SEC)
+      continue;
+
+    for (size_t i = 0; i < LOCKER_CACHE_SLOTS; i++)
+      clear_slot(cache, &cache->slots[i]);
+  }
+  pthread_mutex_unlock(&cache->mutex);
+
+  return NULL;
+}
+
+ATTR_ALLOC ATTR_NODISCARD locker_cache_t *cache_new(void) {
+  /* guarded and locked, decoded secrets live in here */
+  locker_cache_t *cache = sodium_malloc(sizeof(locker_cache_t));
+  if (!cache) {
+    perror("sodium_malloc");
+    exit(EXIT_FAILURE);
+  }
+  memset(cache, 0, sizeof(locker_cache_t));
+
+  pthread_condattr_t cond_attr;
+  pthread_condattr_init(&cond_attr);
+  /* a clock set back while idle must not keep secrets around longer */
+  pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cache->cond, &cond_attr);
+  pthread_condattr_destroy(&cond_attr);
+  pthread_mutex_init(&cache->mutex, NULL);
+
+  if (pthread_create(&cache->sweeper, NULL, cache_sweeper, cache) != 0) {
+    perror("pthread_create");
+    exit(EXIT_FAILURE);
+  }
+
+  return cache;
+}
+
+void cache_free(locker_cache_t cache[static 1]) {
+  pthread_mutex_lock(&cache->mutex);
+  cache->stopping = true;
+  pthread_cond_signal(&cache->cond);
+  pthread_mutex_unlock(&cache->mutex);
+
+  pthread_join(cache->sweeper, NULL);
+
+  pthread_cond_destroy(&cache->cond);
+  pthread_mutex_destroy(&cache->mutex);
+  sodium_free(cache);
+}
+
+/* called with the mutex held */
+static void touch(locker_cache_t cache[static 1], locker_cache_slot_t slot[static 1]) {
+  slot->last_used = ++cache->clock;
+  clock_gettime(CLOCK_MONOTONIC, &cache->last_access);
+}
+
+/* copies the n fields of item_id into arena, false when it is not cached as type */
+static bool cache_get(locker_cache_t cache[static 1], int64_t item_id, locker_item_type_t type, size_t n, char *fields[n], locker_arena_t arena[static 1]) {
+  bool found = false;
+
+  pthread_mutex_lock(&cache->mutex);
+  for (size_t i = 0; i < LOCKER_CACHE_SLOTS; i++) {
+    locker_cache_slot_t *slot = &cache->slots[i];
+    if (slot->item_id != item_id || slot->type != type)
+      continue;
+
+    const char *field = slot->data;
+    for (size_t j = 0; j < n; j++) {
+      size_t len = strlen(field);
+      fields[j] = arena_strndup(arena, field, len);
+      field += len + 1;
+    }
+    touch(cache, slot);
+    found = true;
+    break;
+  }
+  pthread_mutex_unlock(&cache->mutex);
+
+  return found;
+}
+
+static void cache_put(locker_cache_t cache[static 1], int64_t item_id, locker_item_type_t type, size_t n, const char *const fields[n]) {
+  size_t lens[CACHE_MAX_FIELDS], total = 0;
+  for (size_t j = 0; j < n; j++) {
+    lens[j] = strlen(fields[j]);
+    total += lens[j] + 1;
+  }
+  if (total > LOCKER_CACHE_SLOT_LEN)
+    return;
+
+  pthread_mutex_lock(&cache->mutex);
+  locker_cache_slot_t *slot = &cache->slots[0];
+  for (size_t i = 0; i < LOCKER_CACHE_SLOTS; i++) {
+    locker_cache_slot_t *candidate = &cache->slots[i];
+    /* another thread may have put the item while this one read it */
+    if (candidate->item_id == item_id && candidate->type == type) {
+      slot = candidate;
+      break;
+    }
+    if (candidate->last_used < slot->last_used)
+      slot = candidate;
+  }
+
+  clear_slot(cache, slot);
+  char *field = slot->data;
+  for (size_t j = 0; j < n; j++) {
+    memcpy(field, fields[j], lens[j] + 1);
+    field += lens[j] + 1;
+  }
+  slot->item_id = item_id;
+  slot->type = type;
+  touch(cache, slot);
+
+  if (cache->n_used++ == 0)
+    pthread_cond_signal(&cache->cond);
+  pthread_mutex_unlock(&cache->mutex);
+}
+
+locker_item_apikey_t *cache_get_apikey(locker_cache_t cache[static 1], int64_t item_id, locker_arena_t arena[static 1]) {
+  char *fields[CACHE_APIKEY_FIELDS];
+  if (!cache_get(cache, item_id, LOCKER_ITEM_APIKEY, CACHE_APIKEY_FIELDS, fields, arena))
+    return NULL;
+
+  locker_item_apikey_t *apikey = arena_alloc(arena, sizeof(locker_item_apikey_t));
+  apikey->id = item_id;
+  apikey->key = fields[0];
+  apikey->description = fields[1];
+  apikey->value = fields[2];
+  return apikey;
+}
+
+locker_item_account_t *cache_get_account(locker_cache_t cache[static 1], int64_t item_id, locker_arena_t arena[static 1]) {
+  char *fields[CACHE_ACCOUNT_FIELDS];
+  if (!cache_get(cache, item_id, LOCKER_ITEM_ACCOUNT, CACHE_ACCOUNT_FIELDS, fields, arena))
+    return NULL;
+
+  locker_item_account_t *account = arena_alloc(arena, sizeof(locker_item_account_t));
+  account->id = item_id;
+  account->key = fields[0];
+  account->description = fields[1];
+  account->username = fields[2];
+  account->password = fields[3];
+  account->url = fields[4];
+  return account;
+}
+
+void cache_put_apikey(locker_cache_t cache[static 1], const locker_item_apikey_t apikey[static 1]) {
+  const char *const fields[CACHE_APIKEY_FIELDS] = {apikey->key, apikey->description, apikey->value};
+  cache_put(cache, apikey->id, LOCKER_ITEM_APIKEY, CACHE_APIKEY_FIELDS, fields);
+}
+
+void cache_put_account(locker_cache_t cache[static 1], const locker_item_account_t account[static 1]) {
+  const char *const fields[CACHE_ACCOUNT_FIELDS] = {account->key, account->description, account->username, account->password, account->url};
+  cache_put(cache, account->id, LOCKER_ITEM_ACCOUNT, CACHE_ACCOUNT_FIELDS, fields);
+}
+
+/* the item may be cached under both getters, drops every copy */
+void cache_invalidate(locker_cache_t cache[static 1], int64_t item_id) {
+  pthread_mutex_lock(&cache->mutex);
+  for (size_t i = 0; i < LOCKER_CACHE_SLOTS; i++) {
+    if (cache->slots[i].item_id == item_id)
+      clear_slot(cache, &cache->slots[i]);
+  }
+  pthread_mutex_unlock(&cache->mutex);
+}
@@ -0,0 +1,1088 @@
+#include "locker.h"
+#include "locker_agent.h"
+#include "locker_cli.h"
+#include "locker_logs.h"
+#include "sodium/utils.h"
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CLI_PASSPHRASE_ENV "LOCKER_PASSPHRASE"
+#define CLI_NEW_PASSPHRASE_ENV "LOCKER_NEW_PASSPHRASE"
+#define CLI_LIST_PAGE_SIZE 256
+#define CLI_MAX_FIELDS 6
+#define CLI_NOTE_READ_LEN (1 << 16)
+
+typedef enum {
+  CLI_FORMAT_TEXT = 0,
+  CLI_FORMAT_JSON,
+} cli_format_t;
+
+typedef struct {
+  cli_format_t format;
+  int passphrase_fd;
+  int new_passphrase_fd;
+  const char *keyfile;
+  const char *description;
+  const char *username;
+  const char *url;
+  const char *field;
+  char delimiter;
+  unsigned ttl;
+  bool foreground;
+} cli_options_t;
+
+/* a command is answered by a running agent or by the unlocked locker */
+typedef struct {
+  const char *workdir;
+  const char *locker_name;
+  locker_t *locker;
+  int agent_fd;
+} cli_session_t;
+
+typedef struct {
+  const char *name;
+  const char *value;
+} cli_field_t;
+
+typedef int (*cli_command_fn)(cli_session_t *session,
+                              const cli_options_t *opts, char *args[]);
+
+typedef struct {
+  const char *name;
+  const char *usage;
+  int min_args;
+  int max_args;
+  /* answered by an agent serving the locker when there is one */
+  bool agent;
+  bool unlock;
+  cli_command_fn run;
+} cli_command_t;
+
+static int cli_get(cli_session_t *session, const cli_options_t *opts,
+                   char *args[]);
+static int cli_list(cli_session_t *session, const cli_options_t *opts,
+                    char *args[]);
+static int cli_add(cli_session_t *session, const cli_options_t *opts,
+                   char *args[]);
+static int cli_rm(cli_session_t *session, const cli_options_t *opts,
+                  char *args[]);
+static int cli_export(cli_session_t *session, const cli_options_t *opts,
+                      char *args[]);
+static int cli_query(cli_session_t *session, const cli_options_t *opts,
+                     char *args[]);
+static int cli_agent(cli_session_t *session, const cli_options_t *opts,
+                     char *args[]);
+static int cli_passwd(cli_session_t *session, const cli_options_t *opts,
+                      char *args[]);
+static int cli_keyfile(cli_session_t *session, const cli_options_t *opts,
+                       char *args[]);
+
+/* args are counted after the locker name */
+static const cli_command_t commands[] = {
+    {"get", "<locker> <key> [--field name]", 1, 1, true, true, cli_get},
+    {"list", "<locker> [query]", 0, 1, true, true, cli_list},
+    {"add", "<locker> apikey|account|note <key> [--description text] "
+            "[--username name] [--url url] < secret",
+     2, 2, true, true, cli_add},
+    {"rm", "<locker> <key>", 1, 1, true, true, cli_rm},
+    {"export", "<locker>", 0, 0, true, true, cli_export},
+    {"query", "<locker> [--null] < keys-or-globs", 0, 0, true, true,
+     cli_query},
+    /* unlocks only after it detached from the terminal */
+    {"agent", "<locker> [--ttl seconds] [--foreground]", 0, 0, false, false,
+     cli_agent},
+    /* rewrite key slots of the header, the locker itself is not opened */
+    {"passwd", "<locker> [--new-passphrase-fd N]", 0, 0, false, false,
+     cli_passwd},
+    {"keyfile", "<locker> add|rm <path>", 2, 2, false, false, cli_keyfile},
+};
+
+#define CLI_COMMANDS_LEN (sizeof(commands) / sizeof(commands[0]))
+
+static const struct option options[] = {
+    {"json", no_argument, NULL, 'j'},
+    {"passphrase-fd", required_argument, NULL, 'p'},
+    {"new-passphrase-fd", required_argument, NULL, 'n'},
+    {"keyfile", required_argument, NULL, 'k'},
+    {"description", required_argument, NULL, 'd'},
+    {"username", required_argument, NULL, 'u'},
+    {"url", required_argument, NULL, 'l'},
+    {"field", required_argument, NULL, 'f'},
+    {"null", no_argument, NULL, '0'},
+    {"ttl", required_argument, NULL, 't'},
+    {"foreground", no_argument, NULL, 'F'},
+    {NULL, 0, NULL, 0},
+};
+
+static const cli_command_t *find_command(const char name[static 1]) {
+  for (size_t i = 0; i < CLI_COMMANDS_LEN; i++)
+    if (strcmp(commands[i].name, name) == 0)
+      return &commands[i];
+  return NULL;
+}
+
+bool cli_is_command(const char name[static 1]) {
+  return find_command(name) != NULL;
+}
+
+void cli_print_usage(void) {
+  for (size_t i = 0; i < CLI_COMMANDS_LEN; i++)
+    fprintf(stderr, "       locker %s %s\n", commands[i].name,
+            commands[i].usage);
+  fprintf(stderr, "Common options: --json, --passphrase-fd N, --keyfile path "
+                  "or $" CLI_PASSPHRASE_ENV "\n");
+  fprintf(stderr, "get, list and query are answered by a running agent of "
+                  "the locker without unlocking\n");
+  fprintf(stderr, "passwd takes the new passphrase from --new-passphrase-fd N "
+                  "or $" CLI_NEW_PASSPHRASE_ENV "\n");
+}
+
+static const char *result_message(locker_result_t result) {
+  switch (result) {
+  case LOCKER_OK:
+    return "OK";
+  case LOCKER_NAME_TOO_LONG:
+    return "Locker name is too long";
+  case LOCKER_NAME_EMPTY:
+    return "Locker name is empty";
+  case LOCKER_NAME_FORBIDDEN_CHAR:
+    return "Locker name contains a forbidden character";
+  case LOCKER_INVALID_PASSPRHRASE:
+    return "Invalid passphrase";
+  case LOCKER_MALFORMED_HEADER:
+    return "Locker file is malformed, check the log file";
+  case LOCKER_INVALID_LOCKER_FILE:
+    return "Locker file is corrupted, check the log file";
+  case LOCKER_CONTENT_TOO_LONG:
+    return "Value is too long";
+  case LOCKER_ITEM_KEY_TOO_LONG:
+    return "Item key is too long";
+  case LOCKER_ITEM_DESCRIPTION_TOO_LONG:
+    return "Description is too long";
+  case LOCKER_ITEM_KEY_EXISTS:
+    return "Item with this key already exists";
+  case LOCKER_ITEM_ACCOUNT_USERNAME_TOO_LONG:
+    return "Username is too long";
+  case LOCKER_ITEM_ACCOUNT_PASSWORD_TOO_LONG:
+    return "Password is too long";
+  case LOCKER_ITEM_ACCOUNT_URL_TOO_LONG:
+    return "URL is too long";
+  case LOCKER_INVALID_KEYFILE:
+    return "Invalid keyfile";
+  case LOCKER_NO_FREE_KEY_SLOT:
+    return "No free key slot";
+  case LOCKER_DB_ERROR:
+    return "Locker database failed, check the log file";
+  case LOCKER_BUSY:
+    return "Locker is open in another session, close it first";
+  }
+  return "Unknown error";
+}
+
+static const char *item_type_name(locker_item_type_t type) {
+  switch (type) {
+  case LOCKER_ITEM_ACCOUNT:
+    return "account";
+  case LOCKER_ITEM_APIKEY:
+    return "apikey";
+  case LOCKER_ITEM_NOTE:
+    return "note";
+  }
+  return "unknown";
+}
+
+static void print_json_string(const char s[static 1]) {
+  putchar('"');
+  for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+    switch (*c) {
+    case '"':
+      fputs("\\\"", stdout);
+      break;
+    case '\\':
+      fputs("\\\\", stdout);
+      break;
+    case '\n':
+      fputs("\\n", stdout);
+      break;
+    case '\r':
+      fputs("\\r", stdout);
+      break;
+    case '\t':
+      fputs("\\t", stdout);
+      break;
+    default:
+      if (*c < 0x20)
+        printf("\\u%04x", *c);
+      else
+        putchar(*c);
+    }
+  }
+  putchar('"');
+}
+
+static void print_json_object(const cli_field_t fields[], size_t n_fields) {
+  putchar('{');
+  for (size_t i = 0; i < n_fields; i++) {
+    if (i > 0)
+      putchar(',');
+    print_json_string(fields[i].name);
+    putchar(':');
+    print_json_string(fields[i].value);
+  }
+  putchar('}');
+}
+
+/* one record per line, so tabs, newlines and backslashes are escaped */
+static void print_text_field(const char s[static 1]) {
+  for (const char *c = s; *c; c++) {
+    switch (*c) {
+    case '\\':
+      fputs("\\\\", stdout);
+      break;
+    case '\t':
+      fputs("\\t", stdout);
+      break;
+    case '\n':
+      fputs("\\n", stdout);
+      break;
+    default:
+      putchar(*c);
+    }
+  }
+}
+
+/* key, type and description first, then the fields of the item type */
+static size_t item_fields(const locker_resolved_item_t *resolved,
+                          cli_field_t fields[CLI_MAX_FIELDS]) {
+  size_t n = 0;
+  if (resolved->type == LOCKER_ITEM_ACCOUNT) {
+    const locker_item_account_t *account = &resolved->account;
+    fields[n++] = (cli_field_t){"key", account->key};
+    fields[n++] = (cli_field_t){"type", item_type_name(resolved->type)};
+    fields[n++] = (cli_field_t){"description", account->description};
+    fields[n++] = (cli_field_t){"username", account->username};
+    fields[n++] = (cli_field_t){"password", account->password};
+    fields[n++] = (cli_field_t){"url", account->url};
+  } else {
+    const locker_item_apikey_t *apikey = &resolved->apikey;
+    fields[n++] = (cli_field_t){"key", apikey->key};
+    fields[n++] = (cli_field_t){"type", item_type_name(resolved->type)};
+    fields[n++] = (cli_field_t){"description", apikey->description};
+    fields[n++] = (cli_field_t){"value", apikey->value};
+  }
+  return n;
+}
+
+/* false when the item is gone or could not be read, the log tells which */
+static bool fetch_item(locker_t *locker, const locker_item_t *item,
+                       locker_arena_t arena[static 1],
+                       locker_resolved_item_t resolved[static 1]) {
+  *resolved = (locker_resolved_item_t){.type = item->type};
+  if (item->type == LOCKER_ITEM_ACCOUNT) {
+    locker_item_account_t *account = locker_get_account(locker, item->id, arena);
+    if (!account)
+      return false;
+    resolved->account = *account;
+  } else {
+    locker_item_apikey_t *apikey = locker_get_apikey(locker, item->id, arena);
+    if (!apikey)
+      return false;
+    resolved->apikey = *apikey;
+  }
+  return true;
+}
+
+static bool lookup_item(cli_session_t *session, const char key[static 1],
+                        locker_arena_t arena[static 1],
+                        locker_resolved_item_t resolved[static 1]) {
+  if (session->agent_fd >= 0)
+    return agent_get(session->agent_fd, key, arena, resolved);
+
+  locker_item_t item;
+  return locker_find_item(session->locker, key, &item) &&
+         fetch_item(session->locker, &item, arena, resolved);
+}
+
+/* the note exactly as stored, binary files included, a range at a time */
+static int write_note(locker_t *locker, const locker_item_t *item) {
+  char buffer[CLI_NOTE_READ_LEN];
+  size_t offset = 0, n_read;
+  locker_result_t result;
+
+  while ((result = locker_read_note(locker, item->id, offset, sizeof(buffer),
+                                    buffer, &n_read)) == LOCKER_OK &&
+         n_read > 0) {
+    /* straight to the descriptor, stdio would keep a copy */
+    for (size_t written = 0; written < n_read;) {
+      ssize_t n = write(STDOUT_FILENO, buffer + written, n_read - written);
+      if (n < 0) {
+        perror("write");
+        sodium_memzero(buffer, sizeof(buffer));
+        return EXIT_FAILURE;
+      }
+      written += n;
+    }
+    offset += n_read;
+  }
+
+  sodium_memzero(buffer, sizeof(buffer));
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s.\n", result_message(result));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static int cli_get(cli_session_t *session, const cli_options_t *opts,
+                   char *args[]) {
+  /* the value of a note is streamed from the locker instead of loaded whole */
+  locker_item_t item;
+  if (session->agent_fd < 0 && opts->format == CLI_FORMAT_TEXT &&
+      (!opts->field || strcmp(opts->field, "value") == 0) &&
+      locker_find_item(session->locker, args[0], &item) &&
+      item.type == LOCKER_ITEM_NOTE)
+    return write_note(session->locker, &item);
+
+  locker_arena_t secrets;
+  arena_init(&secrets, true);
+
+  locker_resolved_item_t resolved;
+  if (!lookup_item(session, args[0], &secrets, &resolved)) {
+    fprintf(stderr, "No item with key %s.\n", args[0]);
+    arena_release(&secrets);
+    return EXIT_FAILURE;
+  }
+
+  cli_field_t fields[CLI_MAX_FIELDS];
+  size_t n_fields = item_fields(&resolved, fields);
+
+  int status = EXIT_SUCCESS;
+  if (opts->format == CLI_FORMAT_JSON) {
+    print_json_object(fields, n_fields);
+    putchar('\n');
+  } else {
+    /* the secret itself unless asked otherwise, ready for $(locker get ...) */
+    const char *field = opts->field;
+    if (!field)
+      field = resolved.type == LOCKER_ITEM_ACCOUNT ? "password" : "value";
+
+    size_t i = 0;
+    while (i < n_fields && strcmp(fields[i].name, field) != 0)
+      i++;
+
+    if (i < n_fields) {
+      printf("%s\n", fields[i].value);
+    } else {
+      fprintf(stderr, "%s %s has no field %s.\n",
+              item_type_name(resolved.type), args[0], field);
+      status = EXIT_FAILURE;
+    }
+  }
+
+  fflush(stdout);
+  arena_release(&secrets);
+  return status;
+}
+
+static void print_list_item(const cli_options_t *opts, const locker_item_t *item,
+                            bool first) {
+  if (opts->format == CLI_FORMAT_JSON) {
+    cli_field_t fields[] = {{"key", item->key},
+                            {"type", item_type_name(item->type)}};
+    fputs(first ? "[\n" : ",\n", stdout);
+    print_json_object(fields, 2);
+  } else {
+    printf("%s\n", item->key);
+  }
+}
+
+static void print_list_end(const cli_options_t *opts, bool empty) {
+  if (opts->format == CLI_FORMAT_JSON)
+    fputs(empty ? "[]\n" : "\n]\n", stdout);
+}
+
+static int cli_list(cli_session_t *session, const cli_options_t *opts,
+                    char *args[]) {
+  locker_item_list_t list;
+  locker_item_list_init(&list);
+  locker_result_t result = LOCKER_OK;
+  bool empty = true;
+
+  if (session->agent_fd >= 0) {
+    agent_list(session->agent_fd, args[0] ? args[0] : "", &list);
+    for (size_t i = 0; i < list.items.count; i++, empty = false)
+      print_list_item(opts, &list.items.values[i], empty);
+  } else if (args[0]) {
+    char query[(LOCKER_ITEM_KEY_MAX_LEN) + 1];
+    snprintf(query, sizeof(query), "%s", args[0]);
+
+    result = locker_get_items(session->locker, query, &list);
+    for (size_t i = 0; i < list.items.count; i++, empty = false)
+      print_list_item(opts, &list.items.values[i], empty);
+  } else {
+    /* page through the key index, memory stays flat however many items */
+    locker_item_cursor_t cursor = {0};
+    bool has_more = true;
+    while (has_more && result == LOCKER_OK) {
+      result = locker_get_items_page(session->locker, &cursor,
+                                     LOCKER_PAGE_AFTER, CLI_LIST_PAGE_SIZE,
+                                     &list, &has_more);
+      for (size_t i = 0; i < list.items.count; i++, empty = false)
+        print_list_item(opts, &list.items.values[i], empty);
+      if (list.items.count > 0)
+        locker_item_cursor_set(&cursor,
+                               &list.items.values[list.items.count - 1]);
+    }
+  }
+
+  print_list_end(opts, empty);
+  locker_item_list_free(&list);
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s.\n", result_message(result));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* all of stdin up to cap bytes, without its trailing newline */
+static char *read_secret(locker_arena_t arena[static 1], size_t cap) {
+  /* unbuffered, so the secret is read straight into the arena */
+  setvbuf(stdin, NULL, _IONBF, 0);
+  char *secret = arena_alloc(arena, cap + 2);
+  size_t len = fread(secret, 1, cap + 1, stdin);
+  if (ferror(stdin)) {
+    perror("fread");
+    exit(EXIT_FAILURE);
+  }
+
+  if (len > 0 && secret[len - 1] == '\n')
+    len--;
+  secret[len] = '\0';
+  return secret;
+}
+
+/*
+ * All of stdin as it is, trailing newline and NUL bytes included. Reading
+ * stops once more than cap bytes came in, the locker refuses those.
+ */
+static char *read_note(locker_arena_t arena[static 1], size_t cap,
+                       size_t size[static 1]) {
+  setvbuf(stdin, NULL, _IONBF, 0);
+  size_t capacity = CLI_NOTE_READ_LEN, len = 0, n;
+  char *note = arena_alloc(arena, capacity);
+
+  while (len <= cap && (n = fread(note + len, 1, capacity - len, stdin)) > 0) {
+    len += n;
+    if (len == capacity) {
+      /* the arena wipes the smaller copy when it is released */
+      char *larger = arena_alloc(arena, capacity * 2);
+      memcpy(larger, note, len);
+      note = larger;
+      capacity *= 2;
+    }
+  }
+  if (ferror(stdin)) {
+    perror("fread");
+    exit(EXIT_FAILURE);
+  }
+
+  *size = len;
+  return note;
+}
+
+static int cli_add(cli_session_t *session, const cli_options_t *opts,
+                   char *args[]) {
+  const char *type = args[0];
+  char *key = args[1];
+  char *description = (char *)(opts->description ? opts->description : "");
+
+  if (strcmp(type, "apikey") != 0 && strcmp(type, "account") != 0 &&
+      strcmp(type, "note") != 0) {
+    fprintf(stderr, "Item type must be apikey, account or note.\n");
+    return EXIT_FAILURE;
+  }
+
+  locker_arena_t secrets;
+  arena_init(&secrets, true);
+
+  if (strcmp(type, "note") == 0) {
+    if (session->agent_fd >= 0) {
+      fprintf(stderr, "Notes are added with the locker unlocked, not "
+                      "through its agent.\n");
+      arena_release(&secrets);
+      return EXIT_FAILURE;
+    }
+
+    locker_item_note_t note = {.key = key, .description = description};
+    note.content = read_note(&secrets, LOCKER_ITEM_NOTE_MAX_LEN, &note.size);
+    locker_result_t result = locker_add_note(session->locker, &note);
+    arena_release(&secrets);
+    if (result != LOCKER_OK) {
+      fprintf(stderr, "%s.\n", result_message(result));
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  locker_resolved_item_t item;
+  if (strcmp(type, "apikey") == 0) {
+    item = (locker_resolved_item_t){
+        .type = LOCKER_ITEM_APIKEY,
+        .apikey = {
+            .key = key,
+            .description = description,
+            .value = read_secret(&secrets, LOCKER_ITEM_CONTENT_MAX_LEN),
+        }};
+  } else {
+    item = (locker_resolved_item_t){
+        .type = LOCKER_ITEM_ACCOUNT,
+        .account = {
+            .key = key,
+            .description = description,
+            .username = (char *)(opts->username ? opts->username : ""),
+            .password =
+                read_secret(&secrets, LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN),
+            .url = (char *)(opts->url ? opts->url : ""),
+        }};
+  }
+
+  locker_result_t result;
+  if (session->agent_fd >= 0)
+    result = agent_add(session->agent_fd, &item);
+  else if (item.type == LOCKER_ITEM_ACCOUNT)
+    result = locker_add_account(session->locker, &item.account);
+  else
+    result = locker_add_apikey(session->locker, &item.apikey);
+
+  arena_release(&secrets);
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s.\n", result_message(result));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static int cli_rm(cli_session_t *session, const cli_options_t *opts,
+                  char *args[]) {
+  (void)opts;
+  if (session->agent_fd >= 0) {
+    if (agent_delete(session->agent_fd, args[0]))
+      return EXIT_SUCCESS;
+    fprintf(stderr, "No item with key %s.\n", args[0]);
+    return EXIT_FAILURE;
+  }
+
+  locker_item_t item = {.key = args[0]};
+  if (!locker_find_item(session->locker, args[0], &item)) {
+    fprintf(stderr, "No item with key %s.\n", args[0]);
+    return EXIT_FAILURE;
+  }
+
+  locker_result_t result = locker_delete_item(session->locker, &item);
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s.\n", result_message(result));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static void print_export_item(const cli_options_t *opts,
+                              const locker_resolved_item_t *resolved,
+                              bool first) {
+  cli_field_t fields[CLI_MAX_FIELDS];
+  size_t n_fields = item_fields(resolved, fields);
+
+  if (opts->format == CLI_FORMAT_JSON) {
+    fputs(first ? "[\n" : ",\n", stdout);
+    print_json_object(fields, n_fields);
+  } else {
+    for (size_t f = 0; f < n_fields; f++) {
+      if (f > 0)
+        putchar('\t');
+      print_text_field(fields[f].value);
+    }
+    putchar('\n');
+  }
+
+  /* stdio keeps a copy until it is flushed */
+  fflush(stdout);
+}
+
+static int cli_export(cli_session_t *session, const cli_options_t *opts,
+                      char *args[]) {
+  (void)args;
+  locker_item_list_t list;
+  locker_item_list_init(&list);
+  locker_arena_t secrets;
+  arena_init(&secrets, true);
+  locker_result_t result = LOCKER_OK;
+  bool empty = true;
+
+  if (session->agent_fd >= 0) {
+    /* one item per request keeps every response frame small */
+    agent_list(session->agent_fd, "", &list);
+    for (size_t i = 0; i < list.items.count; i++) {
+      locker_resolved_item_t resolved;
+      if (!agent_get(session->agent_fd, list.items.values[i].key, &secrets,
+                     &resolved))
+        continue;
+      print_export_item(opts, &resolved, empty);
+      empty = false;
+      arena_reset(&secrets);
+    }
+  } else {
+    locker_item_cursor_t cursor = {0};
+    bool has_more = true;
+    while (has_more && result == LOCKER_OK) {
+      result = locker_get_items_page(session->locker, &cursor,
+                                     LOCKER_PAGE_AFTER, CLI_LIST_PAGE_SIZE,
+                                     &list, &has_more);
+      for (size_t i = 0; i < list.items.count; i++) {
+        locker_resolved_item_t resolved;
+        if (!fetch_item(session->locker, &list.items.values[i], &secrets,
+                        &resolved)) {
+          /* an export that silently misses an item is worse than none */
+          result = LOCKER_DB_ERROR;
+          break;
+        }
+        print_export_item(opts, &resolved, empty);
+        empty = false;
+        arena_reset(&secrets);
+      }
+      if (list.items.count > 0)
+        locker_item_cursor_set(&cursor,
+                               &list.items.values[list.items.count - 1]);
+    }
+  }
+
+  print_list_end(opts, empty);
+  arena_release(&secrets);
+  locker_item_list_free(&list);
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s.\n", result_message(result));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* NAME='value' for sh, the key uppercased with every other byte made a '_' */
+static void print_shell_assignment(const char key[static 1],
+                                   const char suffix[static 1],
+                                   const char value[static 1]) {
+  if (*key >= '0' && *key <= '9')
+    putchar('_');
+  for (const char *c = key; *c; c++) {
+    if ((*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))
+      putchar(*c);
+    else if (*c >= 'a' && *c <= 'z')
+      putchar(*c - 'a' + 'A');
+    else
+      putchar('_');
+  }
+  fputs(suffix, stdout);
+
+  putchar('=');
+  putchar('\'');
+  for (const char *c = value; *c; c++) {
+    if (*c == '\'')
+      fputs("'\\''", stdout);
+    else
+      putchar(*c);
+  }
+  fputs("'\n", stdout);
+}
+
+static void print_resolved_item(const cli_options_t *opts,
+                                const locker_resolved_item_t *resolved) {
+  if (opts->format == CLI_FORMAT_JSON) {
+    cli_field_t fields[CLI_MAX_FIELDS];
+    print_json_object(fields, item_fields(resolved, fields));
+    putchar('\n');
+  } else if (resolved->type == LOCKER_ITEM_ACCOUNT) {
+    const locker_item_account_t *account = &resolved->account;
+    print_shell_assignment(account->key, "_USERNAME", account->username);
+    print_shell_assignment(account->key, "_PASSWORD", account->password);
+    print_shell_assignment(account->key, "_URL", account->url);
+  } else {
+    print_shell_assignment(resolved->apikey.key, "", resolved->apikey.value);
+  }
+}
+
+/*
+ * One key or glob per line (or NUL terminated with --null) from stdin, all
+ * answered by the same compiled statement under the single unlock. Results
+ * are streamed as they resolve, patterns matching nothing go to stderr.
+ */
+static int cli_query(cli_session_t *session, const cli_options_t *opts,
+                     char *args[]) {
+  (void)args;
+  locker_arena_t secrets;
+  arena_init(&secrets, true);
+  array_locker_resolved_item_t resolved;
+  init_item_array((&resolved));
+
+  int status = EXIT_SUCCESS;
+  char *line = NULL;
+  size_t line_capacity = 0;
+  ssize_t len;
+  while ((len = getdelim(&line, &line_capacity, opts->delimiter, stdin)) > 0) {
+    if (line[len - 1] == opts->delimiter)
+      line[--len] = '\0';
+    if (len > 0 && line[len - 1] == '\r')
+      line[--len] = '\0';
+    if (len == 0)
+      continue;
+
+    resolved.count = 0;
+    if (session->agent_fd >= 0) {
+      agent_resolve(session->agent_fd, line, &secrets, &resolved);
+    } else {
+      locker_result_t result =
+          locker_resolve_items(session->locker, line, &secrets, &resolved);
+      if (result != LOCKER_OK) {
+        fprintf(stderr, "%s: %s.\n", line, result_message(result));
+        status = EXIT_FAILURE;
+        arena_reset(&secrets);
+        continue;
+      }
+    }
+    if (resolved.count == 0) {
+      fprintf(stderr, "No item matches %s.\n", line);
+      status = EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < resolved.count; i++)
+      print_resolved_item(opts, &resolved.values[i]);
+
+    /* stdio keeps a copy until it is flushed */
+    fflush(stdout);
+    arena_reset(&secrets);
+  }
+
+  free(line);
+  free(resolved.values);
+  arena_release(&secrets);
+  return status;
+}
+
+/* reads up to a newline one byte at a time, so nothing after it is consumed */
+static bool read_passphrase_fd(int fd,
+                               char passphrase[LOCKER_PASSPHRASE_MAX_LEN + 1]) {
+  size_t len = 0;
+  char c;
+  ssize_t n;
+  while ((n = read(fd, &c, 1)) == 1 && c != '\n') {
+    if (len == LOCKER_PASSPHRASE_MAX_LEN) {
+      fprintf(stderr, "Passphrase is too long.\n");
+      return false;
+    }
+    passphrase[len++] = c;
+  }
+  if (n < 0) {
+    perror("read");
+    return false;
+  }
+
+  if (len > 0 && passphrase[len - 1] == '\r')
+    len--;
+  passphrase[len] = '\0';
+  return true;
+}
+
+/* from fd when one was given, otherwise from the environment variable env */
+static bool read_passphrase(int fd, const char env[static 1],
+                            char passphrase[LOCKER_PASSPHRASE_MAX_LEN + 1]) {
+  if (fd >= 0)
+    return read_passphrase_fd(fd, passphrase);
+
+  const char *value = getenv(env);
+  if (!value)
+    return false;
+  snprintf(passphrase, LOCKER_PASSPHRASE_MAX_LEN + 1, "%s", value);
+  return true;
+}
+
+static locker_result_t unlock(locker_t **locker, const char workdir[static 1],
+                              const char locker_name[static 1],
+                              const cli_options_t *opts) {
+  if (opts->keyfile)
+    return locker_open_keyfile(locker, workdir, locker_name, opts->keyfile);
+
+  char passphrase[LOCKER_PASSPHRASE_MAX_LEN + 1];
+  if (!read_passphrase(opts->passphrase_fd, CLI_PASSPHRASE_ENV, passphrase)) {
+    if (opts->passphrase_fd < 0)
+      fprintf(stderr, "No passphrase given, use --passphrase-fd, --keyfile or "
+                      "$" CLI_PASSPHRASE_ENV ".\n");
+    exit(EXIT_FAILURE);
+  }
+
+  locker_result_t result = locker_open(locker, workdir, locker_name, passphrase);
+  sodium_memzero(passphrase, sizeof(passphrase));
+  return result;
+}
+
+/* stdio of a daemon points at /dev/null, logs go to the log file */
+static void detach_stdio(void) {
+  int null_fd = open("/dev/null", O_RDWR);
+  if (null_fd < 0)
+    return;
+  dup2(null_fd, STDIN_FILENO);
+  dup2(null_fd, STDOUT_FILENO);
+  dup2(null_fd, STDERR_FILENO);
+  if (null_fd > STDERR_FILENO)
+    close(null_fd);
+}
+
+/*
+ * Like ssh-agent, returns once the locker is unlocked and leaves a daemon
+ * behind serving it on a socket next to the locker file. The locker is
+ * opened after the fork, its threads would not survive one.
+ */
+static int cli_agent(cli_session_t *session, const cli_options_t *opts,
+                     char *args[]) {
+  (void)args;
+  char path[PATH_MAX];
+  agent_socket_path(path, session->workdir, session->locker_name);
+
+  int listen_fd = agent_listen(path);
+  if (listen_fd < 0)
+    return EXIT_FAILURE;
+
+  /* the daemon writes one byte here once it is unlocked */
+  int ready[2] = {-1, -1};
+  if (!opts->foreground) {
+    if (pipe(ready) != 0) {
+      perror("pipe");
+      exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      exit(EXIT_FAILURE);
+    }
+    if (pid > 0) {
+      close(ready[1]);
+      close(listen_fd);
+      char byte;
+      bool unlocked = read(ready[0], &byte, 1) == 1;
+      close(ready[0]);
+      if (!unlocked)
+        return EXIT_FAILURE;
+
+      fprintf(stderr, "Agent %ld serving %s on %s.\n", (long)pid,
+              session->locker_name, path);
+      return EXIT_SUCCESS;
+    }
+
+    close(ready[0]);
+    setsid();
+  }
+
+  locker_t *locker = NULL;
+  locker_result_t result =
+      unlock(&locker, session->workdir, session->locker_name, opts);
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s: %s.\n", session->locker_name, result_message(result));
+    close(listen_fd);
+    unlink(path);
+    return EXIT_FAILURE;
+  }
+
+  if (opts->foreground) {
+    fprintf(stderr, "Agent serving %s on %s.\n", session->locker_name, path);
+  } else {
+    detach_stdio();
+    if (write(ready[1], "", 1) != 1)
+      exit(EXIT_FAILURE);
+    close(ready[1]);
+  }
+
+  bool served = agent_serve(locker, listen_fd, opts->ttl);
+
+  close(listen_fd);
+  unlink(path);
+  close_locker(locker);
+  return served ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Both passphrases may come through the same descriptor, the current one on
+ * the first line and the new one on the second.
+ */
+static int cli_passwd(cli_session_t *session, const cli_options_t *opts,
+                      char *args[]) {
+  (void)args;
+  char passphrase[LOCKER_PASSPHRASE_MAX_LEN + 1];
+  char new_passphrase[LOCKER_PASSPHRASE_MAX_LEN + 1];
+  int status = EXIT_FAILURE;
+
+  if (!read_passphrase(opts->passphrase_fd, CLI_PASSPHRASE_ENV, passphrase)) {
+    if (opts->passphrase_fd < 0)
+      fprintf(stderr, "No passphrase given, use --passphrase-fd or "
+                      "$" CLI_PASSPHRASE_ENV ".\n");
+  } else if (!read_passphrase(opts->new_passphrase_fd, CLI_NEW_PASSPHRASE_ENV,
+                              new_passphrase)) {
+    if (opts->new_passphrase_fd < 0)
+      fprintf(stderr, "No new passphrase given, use --new-passphrase-fd or "
+                      "$" CLI_NEW_PASSPHRASE_ENV ".\n");
+  } else if (new_passphrase[0] == '\0') {
+    fprintf(stderr, "New passphrase cannot be empty.\n");
+  } else {
+    locker_result_t result = locker_change_passphrase(
+        session->workdir, session->locker_name, passphrase, new_passphrase);
+    if (result == LOCKER_OK)
+      status = EXIT_SUCCESS;
+    else
+      fprintf(stderr, "%s: %s.\n", session->locker_name,
+              result_message(result));
+  }
+
+  sodium_memzero(passphrase, sizeof(passphrase));
+  sodium_memzero(new_passphrase, sizeof(new_passphrase));
+  return status;
+}
+
+/* a keyfile slot is added or dropped under the passphrase of the locker */
+static int cli_keyfile(cli_session_t *session, const cli_options_t *opts,
+                       char *args[]) {
+  bool add = strcmp(args[0], "add") == 0;
+  if (!add && strcmp(args[0], "rm") != 0) {
+    fprintf(stderr, "Unknown keyfile action %s, use add or rm.\n", args[0]);
+    return EXIT_FAILURE;
+  }
+
+  char passphrase[LOCKER_PASSPHRASE_MAX_LEN + 1];
+  if (!read_passphrase(opts->passphrase_fd, CLI_PASSPHRASE_ENV, passphrase)) {
+    if (opts->passphrase_fd < 0)
+      fprintf(stderr, "No passphrase given, use --passphrase-fd or "
+                      "$" CLI_PASSPHRASE_ENV ".\n");
+    return EXIT_FAILURE;
+  }
+
+  locker_result_t result =
+      add ? locker_add_keyfile(session->workdir, session->locker_name,
+                               passphrase, args[1])
+          : locker_remove_keyfile(session->workdir, session->locker_name,
+                                  passphrase, args[1]);
+  sodium_memzero(passphrase, sizeof(passphrase));
+
+  if (result != LOCKER_OK) {
+    fprintf(stderr, "%s: %s.\n", session->locker_name, result_message(result));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int cli_run(int argc, char *argv[]) {
+  const cli_command_t *command = find_command(argv[0]);
+  cli_options_t opts = {.format = CLI_FORMAT_TEXT,
+                        .passphrase_fd = -1,
+                        .new_passphrase_fd = -1,
+                        .delimiter = '\n',
+                        .ttl = LOCKER_AGENT_DEFAULT_TTL};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "0", options, NULL)) != -1) {
+    switch (opt) {
+    case 'j':
+      opts.format = CLI_FORMAT_JSON;
+      break;
+    case 'p': {
+      char *end;
+      long fd = strtol(optarg, &end, 10);
+      if (*optarg == '\0' || *end != '\0' || fd < 0 || fd > INT_MAX) {
+        fprintf(stderr, "--passphrase-fd needs a file descriptor number.\n");
+        return EXIT_FAILURE;
+      }
+      opts.passphrase_fd = (int)fd;
+      break;
+    }
+    case 'n': {
+      char *end;
+      long fd = strtol(optarg, &end, 10);
+      if (*optarg == '\0' || *end != '\0' || fd < 0 || fd > INT_MAX) {
+        fprintf(stderr, "--new-passphrase-fd needs a file descriptor number.\n");
+        return EXIT_FAILURE;
+      }
+      opts.new_passphrase_fd = (int)fd;
+      break;
+    }
+    case 'k':
+      opts.keyfile = optarg;
+      break;
+    case 'd':
+      opts.description = optarg;
+      break;
+    case 'u':
+      opts.username = optarg;
+      break;
+    case 'l':
+      opts.url = optarg;
+      break;
+    case 'f':
+      opts.field = optarg;
+      break;
+    case '0':
+      opts.delimiter = '\0';
+      break;
+    case 't': {
+      char *end;
+      unsigned long ttl = strtoul(optarg, &end, 10);
+      if (*optarg == '\0' || *end != '\0' || ttl > UINT_MAX / 1000) {
+        fprintf(stderr, "--ttl needs a number of seconds.\n");
+        return EXIT_FAILURE;
+      }
+      opts.ttl = (unsigned)ttl;
+      break;
+    }
+    case 'F':
+      opts.foreground = true;
+      break;
+    default:
+      fprintf(stderr, "Usage: locker %s %s\n", command->name, command->usage);
+      return EXIT_FAILURE;
+    }
+  }
+
+  int n_args = argc - optind - 1;
+  if (n_args < command->min_args || n_args > command->max_args) {
+    fprintf(stderr, "Usage: locker %s %s\n", command->name, command->usage);
+    return EXIT_FAILURE;
+  }
+
+  char *workdir = getenv("LOCKER_PATH");
+  if (!workdir) {
+    fprintf(stderr, "$LOCKER_PATH environment variable is missing.\n");
+    return EXIT_FAILURE;
+  }
+  open_log_file(workdir);
+
+  const char *locker_name = argv[optind];
+  cli_session_t session = {
+      .workdir = workdir, .locker_name = locker_name, .agent_fd = -1};
+  if (command->agent)
+    session.agent_fd = agent_connect(workdir, locker_name);
+
+  if (command->unlock && session.agent_fd < 0) {
+    locker_result_t result =
+        unlock(&session.locker, workdir, locker_name, &opts);
+    if (result != LOCKER_OK) {
+      fprintf(stderr, "%s: %s.\n", locker_name, result_message(result));
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* argv ends with NULL, so optional arguments that were left out are NULL */
+  int status = command->run(&session, &opts, argv + optind + 1);
+  if (session.locker)
+    close_locker(session.locker);
+  if (session.agent_fd >= 0)
+    close(session.agent_fd);
+  return status;
+}
@@ -1,14 +1,55 @@
 #include "locker_crypto.h"
+#include "sodium/crypto_stream_chacha20.h"
+#include "sodium/crypto_verify_16.h"
 #include "sodium/randombytes.h"
+#include "sodium/utils.h"
+#include <stdint.h>
 #include <string.h>
 
 int derieve_key(const char *password, unsigned char *key_out, size_t key_len,
-                const unsigned char *salt) {
+                const unsigned char *salt,
+                const locker_crypto_kdf_params_t *params) {
 
   return crypto_pwhash(key_out, key_len, password, strlen(password), salt,
-                       crypto_pwhash_OPSLIMIT_INTERACTIVE,
-                       crypto_pwhash_MEMLIMIT_INTERACTIVE,
-                       crypto_pwhash_ALG_ARGON2ID13);
+                       params->opslimit, params->memlimit, params->alg);
+}
+
+bool kdf_params_valid(const locker_crypto_kdf_params_t *params) {
+  /* Argon2i needs at least 3 passes, Argon2id a single one */
+  unsigned long long min_opslimit =
+      params->alg == crypto_pwhash_ALG_ARGON2I13 ? 3 : 1;
+
+  return (params->alg == crypto_pwhash_ALG_ARGON2ID13 ||
+          params->alg == crypto_pwhash_ALG_ARGON2I13) &&
+         params->opslimit >= min_opslimit &&
+         params->opslimit <= UINT32_MAX &&
+         params->memlimit >= crypto_pwhash_MEMLIMIT_MIN &&
+         params->memlimit <= LOCKER_CRYPTO_KDF_MEMLIMIT_MAX;
+}
+
+/*
+ * Keyfiles are expected to be random already, so a single HKDF-SHA256 pass is
+ * enough and skips the Argon2 cost of a passphrase.
+ */
+int derive_keyfile_key(const unsigned char *keyfile, size_t keyfile_len,
+                       unsigned char *key_out, size_t key_len,
+                       const unsigned char *salt) {
+  static const char context[] = "locker keyfile slot";
+  unsigned char prk[crypto_kdf_hkdf_sha256_KEYBYTES];
+
+  int rc = crypto_kdf_hkdf_sha256_extract(prk, salt, LOCKER_CRYPTO_SALT_LEN,
+                                          keyfile, keyfile_len);
+  if (rc == 0) {
+    rc = crypto_kdf_hkdf_sha256_expand(key_out, key_len, context,
+                                       sizeof(context) - 1, prk);
+  }
+
+  sodium_memzero(prk, sizeof(prk));
+  return rc;
+}
+
+void generate_key(locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN]) {
+  crypto_aead_xchacha20poly1305_ietf_keygen(key);
 }
 
 void generate_salt(unsigned char salt[LOCKER_CRYPTO_SALT_LEN]) {
@@ -18,3 +59,62 @@ void generate_salt(unsigned char salt[LOCKER_CRYPTO_SALT_LEN]) {
 void generate_nonce(unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN]) {
   randombytes_buf(nonce, LOCKER_CRYPTO_NONCE_LEN);
 }
+
+/*
+ * Same construction as crypto_aead_xchacha20poly1305_ietf_*: HChaCha20 subkey,
+ * Poly1305 key from ChaCha20 block 0 and payload from block 1 onwards. No
+ * associated data is used by lockers, so only the ciphertext is MACed.
+ */
+void aead_stream_init(locker_crypto_aead_stream_t *stream,
+                      const unsigned char nonce[LOCKER_CRYPTO_NONCE_LEN],
+                      const locker_crypto_masterkey_t *key) {
+  crypto_core_hchacha20(stream->subkey, nonce, key, NULL);
+
+  memset(stream->nonce, 0, 4);
+  memcpy(stream->nonce + 4, nonce + crypto_core_hchacha20_INPUTBYTES, 8);
+
+  unsigned char block0[64];
+  crypto_stream_chacha20_ietf(block0, sizeof(block0), stream->nonce,
+                              stream->subkey);
+  crypto_onetimeauth_poly1305_init(&stream->mac, block0);
+  sodium_memzero(block0, sizeof(block0));
+
+  stream->mac_len = 0;
+}
+
+void aead_stream_authenticate(locker_crypto_aead_stream_t *stream,
+                              const unsigned char *ciphertext, size_t len) {
+  crypto_onetimeauth_poly1305_update(&stream->mac, ciphertext, len);
+  stream->mac_len += len;
+}
+
+bool aead_stream_verify(locker_crypto_aead_stream_t *stream,
+                        const unsigned char tag[crypto_aead_xchacha20poly1305_ietf_ABYTES]) {
+  static const unsigned char pad[16] = {0};
+  crypto_onetimeauth_poly1305_update(&stream->mac, pad,
+                                     (0x10 - stream->mac_len) & 0xf);
+
+  unsigned char lengths[16] = {0};
+  for (int i = 0; i < 8; i++)
+    lengths[8 + i] = (unsigned char)(stream->mac_len >> (8 * i));
+  crypto_onetimeauth_poly1305_update(&stream->mac, lengths, sizeof(lengths));
+
+  unsigned char computed[crypto_onetimeauth_poly1305_BYTES];
+  crypto_onetimeauth_poly1305_final(&stream->mac, computed);
+
+  return crypto_verify_16(computed, tag) == 0;
+}
+
+void aead_stream_decrypt(const locker_crypto_aead_stream_t *stream,
+                         unsigned char *plaintext,
+                         const unsigned char *ciphertext, size_t len,
+                         unsigned long long offset) {
+  /* offset has to be block aligned, block 0 was spent on the MAC key */
+  crypto_stream_chacha20_ietf_xor_ic(plaintext, ciphertext, len, stream->nonce,
+                                     (uint32_t)(1 + offset / 64),
+                                     stream->subkey);
+}
+
+void aead_stream_wipe(locker_crypto_aead_stream_t *stream) {
+  sodium_memzero(stream, sizeof(locker_crypto_aead_stream_t));
+}
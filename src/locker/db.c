@@ -1,23 +1,119 @@
 #include "attrs.h"
 #include "locker.h"
+#include "locker_account.h"
 #include "locker_db.h"
 #include "locker_logs.h"
 #include "locker_utils.h"
+#include "locker_vfs.h"
+#include "sodium.h"
 #include "sqlite3.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define handle_sqlite_rc(db, rc, message)                                        \
-    do {                                                                         \
-        if (!((rc) == SQLITE_OK || (rc) == SQLITE_DONE)) {                       \
-            log_message("%s:%d %s: %s",                                          \
-                        __FILE__, __LINE__, (message), sqlite3_errmsg(db));      \
-            exit(EXIT_FAILURE);                                                  \
-        }                                                                        \
-    } while (0)
-
-void initdb(sqlite3 *db) {
+/* logs a failed call, the caller hands the failure on to its own caller */
+#define sqlite_failed(db, rc, message)                                           \
+    (!((rc) == SQLITE_OK || (rc) == SQLITE_DONE) &&                              \
+     (log_message("%s:%d %s: %s",                                                \
+                  __FILE__, __LINE__, (message), sqlite3_errmsg(db)),            \
+      true))
+
+/* indexed by locker_stmt_t */
+static const char *const statement_sql[LOCKER_STMT_COUNT] = {
+    [LOCKER_STMT_GET_META] = "SELECT value FROM locker_meta WHERE key = ?1;",
+    [LOCKER_STMT_SET_META] =
+        "INSERT OR REPLACE INTO locker_meta (key, value) VALUES (?1, ?2);",
+    [LOCKER_STMT_ADD_ITEM] =
+        "INSERT INTO items (item_key, description, content, type, "
+        "created_at, updated_at, id) VALUES (?1, ?2, ?3, ?4, strftime('%s','now'), strftime('%s','now'), ?5);",
+    [LOCKER_STMT_LIST_ITEMS] =
+        "SELECT i.id, i.item_key, i.type FROM items AS i WHERE 1=1"
+        " ORDER BY i.item_key ASC;",
+    /* row values walk the item_key index, the id only breaks ties */
+    [LOCKER_STMT_PAGE_ITEMS_AFTER] =
+        "SELECT i.id, i.item_key, i.type FROM items AS i"
+        " WHERE (i.item_key, i.id) > (?1, ?2)"
+        " ORDER BY i.item_key ASC, i.id ASC LIMIT ?3;",
+    [LOCKER_STMT_PAGE_ITEMS_BEFORE] =
+        "SELECT i.id, i.item_key, i.type FROM items AS i"
+        " WHERE (i.item_key, i.id) < (?1, ?2)"
+        " ORDER BY i.item_key DESC, i.id DESC LIMIT ?3;",
+    [LOCKER_STMT_SEARCH_ITEMS] =
+        "SELECT i.id, i.item_key, i.type FROM items AS i WHERE 1=1"
+        " AND (i.item_key LIKE ?1 OR i.description LIKE ?1)"
+        " ORDER BY i.item_key ASC;",
+    /* key hits weigh ten times a description hit */
+    [LOCKER_STMT_MATCH_ITEMS] =
+        "SELECT i.id, i.item_key, i.type FROM items_fts"
+        " JOIN items AS i ON i.id = items_fts.rowid WHERE items_fts MATCH ?1"
+        " ORDER BY bm25(items_fts, 10.0, 1.0), i.item_key ASC;",
+    [LOCKER_STMT_GET_ITEM] =
+        "SELECT i.id, i.item_key, i.description, i.content, i.type FROM items AS i WHERE i.id = ?1;",
+    /*
+     * The literal prefix of the pattern bounds a range of the item_key index.
+     * The unary plus keeps SQLite from recompiling for every bound pattern.
+     */
+    [LOCKER_STMT_RESOLVE_ITEMS] =
+        "SELECT i.id, i.item_key, i.type, i.description, i.content FROM items AS i"
+        " WHERE i.item_key >= ?1 AND i.item_key < ?2 AND i.item_key GLOB +?3"
+        " ORDER BY i.item_key ASC;",
+    [LOCKER_STMT_GET_ITEM_KEY] = "SELECT item_key FROM items WHERE id = ?1;",
+    [LOCKER_STMT_ITEM_KEY_EXISTS] =
+        "SELECT EXISTS(SELECT 1 FROM items WHERE id != ?1 AND item_key = ?2);",
+    [LOCKER_STMT_UPDATE_ITEM] =
+        "UPDATE items SET item_key=?1, description=?2, content=?3, updated_at=strftime('%s', 'now') WHERE id=?4;",
+    [LOCKER_STMT_DELETE_ITEM] = "DELETE FROM items WHERE id = ?1;",
+    /* length() of a blob comes from the record header, no chunk is read */
+    [LOCKER_STMT_NOTE_SIZE] =
+        "SELECT ifnull(sum(length(data)), 0) FROM note_chunks WHERE item_id = ?1;",
+    [LOCKER_STMT_NOTE_CHUNKS] =
+        "SELECT id FROM note_chunks WHERE item_id = ?1 AND seq >= ?2"
+        " ORDER BY seq ASC;",
+    [LOCKER_STMT_ADD_NOTE_CHUNK] =
+        "INSERT INTO note_chunks (item_id, seq, data) VALUES (?1, ?2, zeroblob(?3));",
+    [LOCKER_STMT_DELETE_NOTE_CHUNKS] =
+        "DELETE FROM note_chunks WHERE item_id = ?1;",
+};
+
+/*
+ * Notes keep an empty content in items and their text here. The rowid lets
+ * sqlite3_blob_open reach a chunk directly.
+ */
+static const char note_schema_sql[] =
+    "CREATE TABLE IF NOT EXISTS note_chunks ("
+    "id INTEGER PRIMARY KEY,"
+    "item_id INTEGER NOT NULL,"
+    "seq INTEGER NOT NULL,"
+    "data BLOB NOT NULL,"
+    "UNIQUE (item_id, seq)"
+    ");";
+
+/*
+ * trigram index over item keys and descriptions, it stores no text of its own
+ * and reads it back from items, the triggers keep both in step
+ */
+static const char fts_schema_sql[] =
+    "CREATE VIRTUAL TABLE IF NOT EXISTS items_fts USING fts5("
+    "item_key, description, content='items', content_rowid='id',"
+    "tokenize='trigram'"
+    ");"
+    "CREATE TRIGGER IF NOT EXISTS items_fts_insert AFTER INSERT ON items BEGIN "
+    "INSERT INTO items_fts (rowid, item_key, description) "
+    "VALUES (new.id, new.item_key, new.description);"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS items_fts_delete AFTER DELETE ON items BEGIN "
+    "INSERT INTO items_fts (items_fts, rowid, item_key, description) "
+    "VALUES ('delete', old.id, old.item_key, old.description);"
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS items_fts_update "
+    "AFTER UPDATE OF item_key, description ON items BEGIN "
+    "INSERT INTO items_fts (items_fts, rowid, item_key, description) "
+    "VALUES ('delete', old.id, old.item_key, old.description);"
+    "INSERT INTO items_fts (rowid, item_key, description) "
+    "VALUES (new.id, new.item_key, new.description);"
+    "END;";
+
+bool initdb(sqlite3 *db) {
   const char sql[] = "CREATE TABLE IF NOT EXISTS item_types ("
                      "id INTEGER PRIMARY KEY, name TEXT UNIQUE NOT NULL"
                      ");"
@@ -32,17 +128,231 @@ void initdb(sqlite3 *db) {
                      "created_at INTEGER NOT NULL,"
                      "updated_at INTEGER NOT NULL,"
                      "FOREIGN KEY (type) REFERENCES item_types(id)"
+                     ");"
+                     "CREATE TABLE IF NOT EXISTS locker_meta ("
+                     "key TEXT PRIMARY KEY, value INTEGER NOT NULL"
                      ");";
 
   char *errmsg = NULL;
-  if (sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK) {
+  if (sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK ||
+      sqlite3_exec(db, fts_schema_sql, NULL, NULL, &errmsg) != SQLITE_OK ||
+      sqlite3_exec(db, note_schema_sql, NULL, NULL, &errmsg) != SQLITE_OK) {
     log_message("SQL error: %s", errmsg);
     sqlite3_free(errmsg);
-    sqlite3_close(db);
-    exit(EXIT_FAILURE);
+    return false;
   }
 
   log_message("Database bootstrap succeed.");
+  return true;
+}
+
+static bool db_has_table(sqlite3 *db, const char name[static 1],
+                         bool exists[static 1]) {
+  sqlite3_stmt *stmt;
+  int rc = sqlite3_prepare_v2(
+      db, "SELECT 1 FROM sqlite_schema WHERE type = 'table' AND name = ?1;", -1,
+      &stmt, NULL);
+  if (sqlite_failed(db, rc, "SQL prepare error"))
+    return false;
+
+  rc = sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
+  *exists = rc == SQLITE_ROW;
+  if (*exists)
+    rc = SQLITE_OK;
+
+  bool ok = !sqlite_failed(db, rc, "SQL table lookup error");
+  sqlite3_finalize(stmt);
+  return ok;
+}
+
+/* brings lockers created by older versions up to the current schema */
+bool db_migrate(sqlite3 *db) {
+  const char sql[] = "CREATE TABLE IF NOT EXISTS locker_meta ("
+                     "key TEXT PRIMARY KEY, value INTEGER NOT NULL"
+                     ");";
+
+  char *errmsg = NULL;
+  if (sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK ||
+      sqlite3_exec(db, note_schema_sql, NULL, NULL, &errmsg) != SQLITE_OK) {
+    log_message("SQL error: %s", errmsg);
+    sqlite3_free(errmsg);
+    return false;
+  }
+
+  bool has_fts;
+  if (!db_has_table(db, "items_fts", &has_fts))
+    return false;
+  if (has_fts)
+    return true;
+
+  /* index every existing item once, later writes go through the triggers */
+  if (!db_begin(db))
+    return false;
+  if (sqlite3_exec(db, fts_schema_sql, NULL, NULL, &errmsg) != SQLITE_OK ||
+      sqlite3_exec(db,
+                   "INSERT INTO items_fts (items_fts) VALUES ('rebuild');",
+                   NULL, NULL, &errmsg) != SQLITE_OK) {
+    log_message("SQL error: %s", errmsg);
+    sqlite3_free(errmsg);
+    sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+    return false;
+  }
+  if (!db_commit(db))
+    return false;
+
+  log_message("Built search index for existing items.");
+  return true;
+}
+
+/*
+ * Rewrites accounts stored in the fixed layout of file versions before 5 into
+ * the length prefixed one. Accounts already rewritten are skipped, so it is
+ * safe to run again after an interrupted migration.
+ */
+bool db_compact_accounts(sqlite3 *db, size_t n_compacted[static 1],
+                         sqlite3_int64 bytes_before[static 1],
+                         sqlite3_int64 bytes_after[static 1]) {
+  sqlite3_stmt *select = NULL, *update = NULL;
+  bool ok = false;
+  *n_compacted = 0;
+  *bytes_before = *bytes_after = 0;
+
+  int rc = sqlite3_prepare_v2(
+      db, "SELECT id, content FROM items WHERE type = ?1;", -1, &select, NULL);
+  if (sqlite_failed(db, rc, "SQL prepare error"))
+    goto done;
+  rc = sqlite3_prepare_v2(db, "UPDATE items SET content = ?2 WHERE id = ?1;",
+                          -1, &update, NULL);
+  if (sqlite_failed(db, rc, "SQL prepare error"))
+    goto done;
+
+  rc = sqlite3_bind_int(select, 1, LOCKER_ITEM_ACCOUNT);
+  if (sqlite_failed(db, rc, "SQL bind error"))
+    goto done;
+
+  locker_arena_t secrets;
+  arena_init(&secrets, true);
+
+  while ((rc = sqlite3_step(select)) == SQLITE_ROW) {
+    const unsigned char *content = sqlite3_column_blob(select, 1);
+    int content_size = sqlite3_column_bytes(select, 1);
+    if (account_content_is_compact(content, content_size))
+      continue;
+
+    locker_item_account_t account = {.id = sqlite3_column_int64(select, 0)};
+    arena_reset(&secrets);
+    if (!account_content_decode(content, content_size, &account, &secrets)) {
+      log_message("Account %lld has malformed content, left as is.",
+                  (long long)account.id);
+      continue;
+    }
+
+    size_t size;
+    unsigned char *compact = account_content_encode(
+        account.username, account.password, account.url, &size);
+
+    rc = sqlite3_bind_int64(update, 1, account.id);
+    if (rc == SQLITE_OK)
+      rc = sqlite3_bind_blob(update, 2, compact, (int)size, SQLITE_STATIC);
+    if (rc == SQLITE_OK)
+      rc = sqlite3_step(update);
+    sqlite3_reset(update);
+    sqlite3_clear_bindings(update);
+
+    sodium_memzero(compact, size);
+    free(compact);
+    if (rc != SQLITE_DONE)
+      break;
+
+    *bytes_before += content_size;
+    *bytes_after += size;
+    (*n_compacted)++;
+  }
+  arena_release(&secrets);
+  ok = !sqlite_failed(db, rc, "SQL account rewrite error");
+
+done:
+  sqlite3_finalize(update);
+  sqlite3_finalize(select);
+  return ok;
+}
+
+/*
+ * Statements are compiled once per opened locker and only reset and rebound
+ * afterwards. Statements built from a query shape get one slot per shape.
+ */
+ATTR_ALLOC ATTR_NODISCARD locker_db_t *db_prepare_statements(sqlite3 *conn) {
+  locker_db_t *db = malloc(sizeof(locker_db_t));
+  if (!db) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  db->conn = conn;
+
+  for (int i = 0; i < LOCKER_STMT_COUNT; i++) {
+    int rc = sqlite3_prepare_v3(conn, statement_sql[i], -1,
+                                SQLITE_PREPARE_PERSISTENT, &db->stmts[i], NULL);
+    if (sqlite_failed(conn, rc, "SQL prepare error")) {
+      while (i-- > 0)
+        sqlite3_finalize(db->stmts[i]);
+      free(db);
+      return NULL;
+    }
+  }
+
+  return db;
+}
+
+/* finalizes the cached statements, the connection itself stays open */
+void db_finalize_statements(locker_db_t *db) {
+  for (int i = 0; i < LOCKER_STMT_COUNT; i++) {
+    sqlite3_finalize(db->stmts[i]);
+  }
+  free(db);
+}
+
+/*
+ * Puts a cached statement back, so it does not hold on to rows or bindings.
+ * rc is the last bind or step result, false when that one failed.
+ */
+static bool db_statement_done(locker_db_t *db, sqlite3_stmt *stmt, int rc,
+                              const char message[static 1]) {
+  /* the error message is gone once the statement is reset */
+  bool ok = !sqlite_failed(db->conn, rc, message);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return ok;
+}
+
+/* a key that was never set reads as 0 */
+bool db_get_meta(locker_db_t *db, const char key[static 1],
+                 sqlite_int64 value[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_GET_META];
+
+  *value = 0;
+  int rc = sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    *value = sqlite3_column_int64(stmt, 0);
+    rc = SQLITE_OK;
+  }
+
+  return db_statement_done(db, stmt, rc, "SQL get meta error");
+}
+
+bool db_set_meta(locker_db_t *db, const char key[static 1], sqlite_int64 value) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_SET_META];
+
+  int rc = sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_int64(stmt, 2, value);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
+
+  return db_statement_done(db, stmt, rc, "SQL set meta error");
 }
 
 ATTR_NODISCARD ATTR_ALLOC sqlite3 *get_empty_db(void) {
@@ -57,6 +367,59 @@ ATTR_NODISCARD ATTR_ALLOC sqlite3 *get_empty_db(void) {
   return db;
 }
 
+/*
+ * NULL with result set to LOCKER_INVALID_PASSPRHRASE when the pages do not
+ * authenticate under key, LOCKER_DB_ERROR when the file cannot be opened
+ */
+ATTR_NODISCARD ATTR_ALLOC sqlite3 *
+get_locker_db(const char path[static 1], sqlite3_int64 data_offset,
+              const locker_crypto_masterkey_t key[static 1],
+              locker_result_t result[static 1]) {
+  int rc = locker_vfs_register();
+  if (rc != SQLITE_OK) {
+    log_message("Cannot register locker VFS: %s", sqlite3_errstr(rc));
+    *result = LOCKER_DB_ERROR;
+    return NULL;
+  }
+
+  locker_vfs_params_t params = {.data_offset = data_offset, .key = key};
+
+  sqlite3 *db;
+  rc = locker_vfs_open(path, &params, &db);
+  if (rc == SQLITE_OK) {
+    /* touch the schema so that a wrong key fails here and not on first use */
+    rc = sqlite3_exec(db, "SELECT count(*) FROM sqlite_schema;", NULL, NULL,
+                      NULL);
+  }
+
+  if (sqlite3_extended_errcode(db) == SQLITE_IOERR_DATA) {
+    /* page failed to authenticate - wrong key or tampered file */
+    sqlite3_close(db);
+    *result = LOCKER_INVALID_PASSPRHRASE;
+    return NULL;
+  }
+
+  if (rc != SQLITE_OK) {
+    log_message("Cannot open database: %s", sqlite3_errmsg(db));
+    sqlite3_close(db);
+    *result = LOCKER_DB_ERROR;
+    return NULL;
+  }
+
+  /*
+   * page size only matters for a brand new file; the rollback journal is
+   * encrypted by the VFS as well and temp files are refused by it
+   */
+  sqlite3_exec(db,
+               "PRAGMA page_size = 4096;"
+               "PRAGMA foreign_keys = ON;"
+               "PRAGMA temp_store = MEMORY;",
+               NULL, NULL, NULL);
+
+  *result = LOCKER_OK;
+  return db;
+}
+
 ATTR_NODISCARD ATTR_ALLOC sqlite3 *get_db(sqlite3_int64 size,
                                           unsigned char buffer[size]) {
   sqlite3 *db = get_empty_db();
@@ -69,254 +432,595 @@ ATTR_NODISCARD ATTR_ALLOC sqlite3 *get_db(sqlite3_int64 size,
 
 void db_close(sqlite3 *db) { sqlite3_close(db); }
 
-sqlite3_int64 db_dump(sqlite3 *db, unsigned char **buffer) {
-  sqlite3_int64 size;
-  (*buffer) = sqlite3_serialize(db, "main", &size, 0);
-  return size;
-}
-
-/* sqlite BLOB size is at max INT_MAX (4 bytes) */
-void db_add_item(sqlite3 *db, const char key[static 1],
-                 const char description[static 1], const int content_size,
-                 const unsigned char content[content_size],
-                 locker_item_type_t item_type) {
+bool db_copy(sqlite3 *src, sqlite3 *dst) {
+  sqlite3_backup *backup = sqlite3_backup_init(dst, "main", src, "main");
+  if (!backup) {
+    log_message("SQL backup init error: %s", sqlite3_errmsg(dst));
+    return false;
+  }
 
-  sqlite3_stmt *stmt;
-  int rc = sqlite3_prepare_v2(
-      db,
-      "INSERT INTO items (item_key, description, content, type, "
-      "created_at, updated_at) VALUES (?1, ?2, ?3, ?4, strftime('%s','now'), strftime('%s','now'));",
-      -1, &stmt, NULL);
+  int rc = sqlite3_backup_step(backup, -1);
+  if (rc != SQLITE_DONE)
+    log_message("SQL backup step error: %s", sqlite3_errstr(rc));
 
-  handle_sqlite_rc(db, rc, "SQL prepare error");
+  /* finish reports the step failure again, it is logged once */
+  int finish_rc = sqlite3_backup_finish(backup);
+  if (rc != SQLITE_DONE)
+    return false;
+  return !sqlite_failed(dst, finish_rc, "SQL backup finish error");
+}
 
-  rc = sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
-  handle_sqlite_rc(db, rc, "SQL bind error");
+/* writes a raw database image straight to the file underneath the connection */
+bool db_write_raw(sqlite3 *db, sqlite3_int64 offset, int size,
+                  const unsigned char buffer[size]) {
+  sqlite3_file *file;
+  int rc = sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &file);
+  if (sqlite_failed(db, rc, "SQL file control error"))
+    return false;
+
+  rc = file->pMethods->xWrite(file, buffer, size, offset);
+  if (rc != SQLITE_OK) {
+    log_message("Raw database write failed: %s", sqlite3_errstr(rc));
+    return false;
+  }
+  return true;
+}
 
-  rc = sqlite3_bind_text(stmt, 2, description, -1, SQLITE_TRANSIENT);
-  handle_sqlite_rc(db, rc, "SQL bind error");
+bool db_begin(sqlite3 *db) {
+  int rc = sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+  return !sqlite_failed(db, rc, "SQL begin error");
+}
 
-  rc = sqlite3_bind_blob(stmt, 3, content, content_size, SQLITE_TRANSIENT);
-  handle_sqlite_rc(db, rc, "SQL bind error");
+bool db_commit(sqlite3 *db) {
+  int rc = sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
+  return !sqlite_failed(db, rc, "SQL commit error");
+}
 
-  rc = sqlite3_bind_int(stmt, 4, item_type);
+/*
+ * Steps of one item write inside the long-lived transaction. Writes run one
+ * at a time, so a single savepoint name is enough.
+ */
+bool db_savepoint(sqlite3 *db) {
+  int rc = sqlite3_exec(db, "SAVEPOINT item_write;", NULL, NULL, NULL);
+  return !sqlite_failed(db, rc, "SQL savepoint error");
+}
 
-  rc = sqlite3_step(stmt);
-  handle_sqlite_rc(db, rc, "SQL step error");
+bool db_release_savepoint(sqlite3 *db) {
+  int rc = sqlite3_exec(db, "RELEASE item_write;", NULL, NULL, NULL);
+  return !sqlite_failed(db, rc, "SQL release error");
+}
 
-  rc = sqlite3_finalize(stmt);
-  handle_sqlite_rc(db, rc, "SQL finalize error");
+/* undoes every step since db_savepoint and drops the savepoint */
+void db_rollback_savepoint(sqlite3 *db) {
+  int rc = sqlite3_exec(db, "ROLLBACK TO item_write; RELEASE item_write;", NULL, NULL, NULL);
+  sqlite_failed(db, rc, "SQL rollback to savepoint error");
 }
 
-ATTR_ALLOC ATTR_NODISCARD
-array_locker_item_t *db_list_items(sqlite3 *db, const char query[LOCKER_ITEM_KEY_QUERY_MAX_LEN]) {
-  char sql[512];
-  strcpy(sql, "SELECT i.id, i.item_key, i.type FROM items AS i WHERE 1=1");
+/*
+ * sqlite BLOB size is at max INT_MAX (4 bytes)
+ * item_id of 0 lets sqlite pick the id, journal replay passes the original one
+ * returns the id of the new item, 0 when it could not be added
+ */
+sqlite_int64 db_add_item(locker_db_t *db, sqlite_int64 item_id,
+                         const char key[static 1],
+                         const char description[static 1],
+                         const int content_size,
+                         const unsigned char content[content_size],
+                         locker_item_type_t item_type) {
+
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_ADD_ITEM];
+
+  int rc = sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_text(stmt, 2, description, -1, SQLITE_TRANSIENT);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_blob(stmt, 3, content, content_size, SQLITE_TRANSIENT);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_int(stmt, 4, item_type);
+  if (rc == SQLITE_OK)
+    rc = item_id > 0 ? sqlite3_bind_int64(stmt, 5, item_id)
+                     : sqlite3_bind_null(stmt, 5);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
 
-  if(strlen(query) > 0) {
-      strcat(sql, " AND i.item_key LIKE ?1");
+  if (!db_statement_done(db, stmt, rc, "SQL add item error"))
+    return 0;
+  return sqlite3_last_insert_rowid(db->conn);
+}
+
+/*
+ * Turns a search query into an fts5 expression of quoted phrases, one per
+ * whitespace separated token, which all have to match. Trigrams never match
+ * tokens shorter than 3 characters, so those are left out; returns false when
+ * nothing is left and the query has to be answered by a plain scan.
+ */
+static bool build_match_expr(const char query[static 1], char out[],
+                             size_t out_sz) {
+  size_t n = 0;
+  bool has_phrase = false;
+
+  for (const char *p = query; *p;) {
+    while (*p == ' ' || *p == '\t')
+      p++;
+
+    const char *start = p;
+    size_t n_chars = 0;
+    while (*p && *p != ' ' && *p != '\t') {
+      /* count utf-8 characters, not bytes */
+      if (((unsigned char)*p & 0xC0) != 0x80)
+        n_chars++;
+      p++;
+    }
+    if (n_chars < 3)
+      continue;
+
+    /* worst case: separator, quotes and every character doubled */
+    if (n + 3 + 2 * (size_t)(p - start) >= out_sz)
+      break;
+
+    if (has_phrase)
+      out[n++] = ' ';
+    out[n++] = '"';
+    for (const char *c = start; c < p; c++) {
+      if (*c == '"')
+        out[n++] = '"';
+      out[n++] = *c;
+    }
+    out[n++] = '"';
+    has_phrase = true;
   }
 
-  strcat(sql, " ORDER BY i.item_key ASC;");
+  out[n] = '\0';
+  return has_phrase;
+}
 
-  sqlite3_stmt *stmt;
-  int rc = sqlite3_prepare_v2(
-      db, sql, -1,
-      &stmt, NULL);
-  handle_sqlite_rc(db, rc, "SQL prepare error");
+/* items matching query on key or description, best match first, appended to list */
+bool db_list_items(locker_db_t *db, const char query[LOCKER_ITEM_KEY_QUERY_MAX_LEN], locker_item_list_t list[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_LIST_ITEMS];
+  int rc = SQLITE_OK;
 
   if(strlen(query) > 0) {
-    char like_query[LOCKER_ITEM_KEY_QUERY_MAX_LEN+3];
-    snprintf(like_query, sizeof(like_query), "%%%s%%", query);
+    char match_expr[3*LOCKER_ITEM_KEY_QUERY_MAX_LEN];
+
+    if(build_match_expr(query, match_expr, sizeof(match_expr))) {
+      stmt = db->stmts[LOCKER_STMT_MATCH_ITEMS];
+      rc = sqlite3_bind_text(stmt, 1, match_expr, -1, SQLITE_TRANSIENT);
+    } else {
+      char like_query[LOCKER_ITEM_KEY_QUERY_MAX_LEN+3];
+      snprintf(like_query, sizeof(like_query), "%%%s%%", query);
 
-    rc = sqlite3_bind_text(stmt, 1, like_query, -1, SQLITE_TRANSIENT);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+      stmt = db->stmts[LOCKER_STMT_SEARCH_ITEMS];
+      rc = sqlite3_bind_text(stmt, 1, like_query, -1, SQLITE_TRANSIENT);
+    }
   }
 
-  array_locker_item_t *items = malloc(sizeof(array_str_t));
-  if(!items) {
-      perror("malloc");
-      exit(EXIT_FAILURE);
+  if (rc == SQLITE_OK) {
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      locker_item_t item;
+      item.id = sqlite3_column_int64(stmt, 0);
+      item.key = arena_strndup(&list->arena, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+      item.type = sqlite3_column_int(stmt, 2);
+
+      locker_array_append(&list->items, item);
+    }
   }
-  init_item_array(items);
 
-  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+  return db_statement_done(db, stmt, rc, "SQL list items error");
+}
+
+/*
+ * Appends up to page_size items next to cursor in key order, ascending either
+ * way. One extra row is read to tell whether more follow in that direction.
+ */
+bool db_list_items_page(locker_db_t *db, const locker_item_cursor_t cursor[static 1], locker_page_direction_t direction, size_t page_size, locker_item_list_t list[static 1], bool has_more[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[direction == LOCKER_PAGE_BEFORE ? LOCKER_STMT_PAGE_ITEMS_BEFORE : LOCKER_STMT_PAGE_ITEMS_AFTER];
+
+  /* any blob sorts after every text key, so it stands for the end */
+  int rc = cursor->past_end ? sqlite3_bind_zeroblob(stmt, 1, 0)
+                            : sqlite3_bind_text(stmt, 1, cursor->key, -1, SQLITE_STATIC);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_int64(stmt, 2, cursor->id);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_int64(stmt, 3, (sqlite3_int64)page_size + 1);
+
+  size_t first = list->items.count, n = 0;
+  *has_more = false;
+  while (rc == SQLITE_OK || rc == SQLITE_ROW) {
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW)
+      break;
+    if (n == page_size) {
+      *has_more = true;
+      rc = SQLITE_OK;
+      break;
+    }
+
     locker_item_t item;
     item.id = sqlite3_column_int64(stmt, 0);
-    item.key = strdup((const char *)sqlite3_column_text(stmt, 1));
+    item.key = arena_strndup(&list->arena, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
     item.type = sqlite3_column_int(stmt, 2);
 
-    locker_array_append(items, item);
+    locker_array_append(&list->items, item);
+    n++;
   }
 
-  handle_sqlite_rc(db, rc, "SQL step error");
+  if (direction == LOCKER_PAGE_BEFORE) {
+    locker_item_t *page = list->items.values + first;
+    for (size_t i = 0; i < n / 2; i++) {
+      locker_item_t tmp = page[i];
+      page[i] = page[n - 1 - i];
+      page[n - 1 - i] = tmp;
+    }
+  }
 
-  rc = sqlite3_finalize(stmt);
-  handle_sqlite_rc(db, rc, "SQL finalize error");
+  return db_statement_done(db, stmt, rc, "SQL page items error");
+}
 
-  return items;
+/*
+ * Steps the item statement onto the row of item_id. NULL when there is no
+ * such item or the step failed, the statement is put back in both cases.
+ */
+static sqlite3_stmt *db_step_item(locker_db_t *db, sqlite_int64 item_id) {
+    sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_GET_ITEM];
+
+    int rc = sqlite3_bind_int64(stmt, 1, item_id);
+    if(rc == SQLITE_OK)
+        rc = sqlite3_step(stmt);
+    if(rc == SQLITE_ROW)
+        return stmt;
+
+    db_statement_done(db, stmt, rc, "SQL get item error");
+    return NULL;
 }
 
-ATTR_ALLOC ATTR_NODISCARD locker_item_apikey_t *db_get_apikey(sqlite3 *db, sqlite_int64 item_id) {
-    sqlite3_stmt *stmt;
+static bool db_note_size(locker_db_t *db, sqlite_int64 item_id, size_t size[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_NOTE_SIZE];
 
-    int rc = sqlite3_prepare_v2(
-        db,
-        "SELECT i.id, i.item_key, i.description, i.content FROM items AS i WHERE i.id = ?1;",
-        -1,
-        &stmt,
-        NULL
-    );
-    handle_sqlite_rc(db, rc, "SQL prepare error");
+  *size = 0;
+  int rc = sqlite3_bind_int64(stmt, 1, item_id);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    *size = (size_t)sqlite3_column_int64(stmt, 0);
+    rc = SQLITE_OK;
+  }
 
-    rc = sqlite3_bind_int64(stmt, 1, item_id);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+  return db_statement_done(db, stmt, rc, "SQL note size error");
+}
 
-    rc = sqlite3_step(stmt);
-    if(rc != SQLITE_ROW)
-        handle_sqlite_rc(db, rc, "SQL step error");
+/* the whole text of a note as a string in arena, NULL when it could not be read */
+static char *db_note_value(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]) {
+  size_t size, n_read;
+  if (!db_note_size(db, item_id, &size))
+    return NULL;
+
+  char *value = arena_alloc(arena, size + 1);
+  if (!db_read_note(db, item_id, 0, size, (unsigned char *)value, &n_read))
+    return NULL;
+  value[n_read] = '\0';
+  return value;
+}
 
-    locker_item_apikey_t *apikey = malloc(sizeof(locker_item_apikey_t));
-    if(!apikey) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
-    }
+/* the item and all its strings are allocated from arena, NULL when there is none */
+locker_item_apikey_t *db_get_apikey(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]) {
+    sqlite3_stmt *stmt = db_step_item(db, item_id);
+    if(!stmt)
+        return NULL;
+
+    locker_item_apikey_t *apikey = arena_alloc(arena, sizeof(locker_item_apikey_t));
 
     apikey->id = sqlite3_column_int64(stmt, 0);
-    apikey->key = strdup((const char *)sqlite3_column_text(stmt, 1));
-    apikey->description = strdup((const char *)sqlite3_column_text(stmt, 2));
+    apikey->key = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 1));
 
-    int content_size = sqlite3_column_bytes(stmt, 3);
-    apikey->value = malloc((content_size+1)*sizeof(char));
-    const void *content = sqlite3_column_blob(stmt, 3);
+    const char *description = (const char *)sqlite3_column_text(stmt, 2);
+    apikey->description = arena_strdup(arena, description ? description : "");
 
-    memcpy(apikey->value, (char *)content, content_size);
-    apikey->value[content_size] = '\0';
+    const char *content = sqlite3_column_blob(stmt, 3);
+    bool is_note = sqlite3_column_int(stmt, 4) == LOCKER_ITEM_NOTE;
+    if(!is_note)
+        apikey->value = arena_strndup(arena, content, sqlite3_column_bytes(stmt, 3));
 
-    rc = sqlite3_finalize(stmt);
-    handle_sqlite_rc(db, rc, "SQL finalize error");
+    db_statement_done(db, stmt, SQLITE_OK, "");
 
+    /* notes carry their whole text the way api keys carry their value */
+    if(is_note && !(apikey->value = db_note_value(db, apikey->id, arena)))
+        return NULL;
     return apikey;
 }
 
-ATTR_ALLOC ATTR_NODISCARD locker_item_account_t *db_get_account(sqlite3 *db, sqlite_int64 item_id) {
-    sqlite3_stmt *stmt;
+locker_item_account_t *db_get_account(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]) {
+    sqlite3_stmt *stmt = db_step_item(db, item_id);
+    if(!stmt)
+        return NULL;
 
-    int rc = sqlite3_prepare_v2(
-        db,
-        "SELECT i.id, i.item_key, i.description, i.content FROM items AS i WHERE i.id = ?1;",
-        -1,
-        &stmt,
-        NULL
-    );
-    handle_sqlite_rc(db, rc, "SQL prepare error");
+    locker_item_account_t *account = arena_alloc(arena, sizeof(locker_item_account_t));
 
-    rc = sqlite3_bind_int64(stmt, 1, item_id);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+    account->id = sqlite3_column_int64(stmt, 0);
+    account->key = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 1));
 
-    rc = sqlite3_step(stmt);
-    if(rc != SQLITE_ROW)
-        handle_sqlite_rc(db, rc, "SQL step error");
+    const char *description = (const char *)sqlite3_column_text(stmt, 2);
+    account->description = arena_strdup(arena, description ? description : "");
 
-    locker_item_account_t *account = malloc(sizeof(locker_item_account_t));
-    if(!account) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
+    const unsigned char *content = sqlite3_column_blob(stmt, 3);
+    int content_size = sqlite3_column_bytes(stmt, 3);
+    if(!account_content_decode(content, content_size, account, arena)) {
+        log_message("Account %lld has malformed content.", (long long)account->id);
+        account->username = account->password = account->url = "";
     }
 
-    account->id = sqlite3_column_int64(stmt, 0);
-    account->key = strdup((const char *)sqlite3_column_text(stmt, 1));
+    db_statement_done(db, stmt, SQLITE_OK, "");
+    return account;
+}
+
+/* key, description and size of a note, its text is read with db_read_note */
+locker_item_note_t *db_get_note(locker_db_t *db, sqlite_int64 item_id, locker_arena_t arena[static 1]) {
+    sqlite3_stmt *stmt = db_step_item(db, item_id);
+    if(!stmt)
+        return NULL;
+
+    locker_item_note_t *note = arena_alloc(arena, sizeof(locker_item_note_t));
+
+    note->id = sqlite3_column_int64(stmt, 0);
+    note->key = arena_strdup(arena, (const char *)sqlite3_column_text(stmt, 1));
 
     const char *description = (const char *)sqlite3_column_text(stmt, 2);
-    if(description)
-        account->description = strdup(description);
-    else
-        account->description = NULL;
+    note->description = arena_strdup(arena, description ? description : "");
+    note->content = NULL;
 
-    const char *content = sqlite3_column_blob(stmt, 3);
-    account->username = strdup(content);
-    account->password = strdup(content+LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN);
-    account->url = strdup(content+LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN);
+    db_statement_done(db, stmt, SQLITE_OK, "");
 
-    rc = sqlite3_finalize(stmt);
-    handle_sqlite_rc(db, rc, "SQL finalize error");
+    if(!db_note_size(db, note->id, &note->size))
+        return NULL;
+    return note;
+}
 
-    return account;
+/*
+ * Binds the smallest and the first too large key starting with the part of
+ * pattern before its first wildcard. Any text sorts before a blob, so an
+ * empty blob is the upper bound when there is no prefix to increment.
+ */
+static int bind_glob_range(sqlite3_stmt *stmt, const char pattern[static 1]) {
+  size_t prefix_len = strcspn(pattern, "*?[");
+  char upper[(LOCKER_ITEM_KEY_MAX_LEN) + 1];
+  if (prefix_len > LOCKER_ITEM_KEY_MAX_LEN)
+    prefix_len = LOCKER_ITEM_KEY_MAX_LEN;
+  memcpy(upper, pattern, prefix_len);
+
+  int rc = sqlite3_bind_text(stmt, 1, pattern, (int)prefix_len, SQLITE_STATIC);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  size_t upper_len = prefix_len;
+  while (upper_len > 0 && (unsigned char)upper[upper_len - 1] == 0xFF)
+    upper_len--;
+
+  if (upper_len > 0) {
+    upper[upper_len - 1]++;
+    return sqlite3_bind_text(stmt, 2, upper, (int)upper_len, SQLITE_TRANSIENT);
+  }
+  return sqlite3_bind_zeroblob(stmt, 2, 0);
 }
 
-bool db_item_key_exists(sqlite3 *db, sqlite_int64 item_id, const char key[static 1]) {
-  sqlite3_stmt *stmt;
+/* every item matching pattern with its secrets, appended to out */
+bool db_resolve_items(locker_db_t *db, const char pattern[static 1], locker_arena_t arena[static 1], array_locker_resolved_item_t out[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_RESOLVE_ITEMS];
 
-  int rc = sqlite3_prepare_v2(
-      db, "SELECT EXISTS(SELECT 1 FROM items WHERE id != ?1 AND item_key = ?2);", -1, &stmt, NULL);
-  handle_sqlite_rc(db, rc, "SQL prepare error");
+  int rc = bind_glob_range(stmt, pattern);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_text(stmt, 3, pattern, -1, SQLITE_STATIC);
+  bool notes_read = true;
 
-  rc = sqlite3_bind_int64(stmt, 1, item_id);
-  handle_sqlite_rc(db, rc, "SQL bind error");
+  while (rc == SQLITE_OK || rc == SQLITE_ROW) {
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW)
+      break;
+
+    locker_resolved_item_t resolved = {.type = sqlite3_column_int(stmt, 2)};
+
+    sqlite_int64 id = sqlite3_column_int64(stmt, 0);
+    char *key = arena_strndup(arena, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+    const char *description = (const char *)sqlite3_column_text(stmt, 3);
+    description = arena_strdup(arena, description ? description : "");
+
+    const unsigned char *content = sqlite3_column_blob(stmt, 4);
+    int content_size = sqlite3_column_bytes(stmt, 4);
+
+    if (resolved.type == LOCKER_ITEM_ACCOUNT) {
+      locker_item_account_t *account = &resolved.account;
+      account->id = id;
+      account->key = key;
+      account->description = (char *)description;
+      if (!account_content_decode(content, content_size, account, arena)) {
+        log_message("Account %lld has malformed content.", (long long)id);
+        account->username = account->password = account->url = "";
+      }
+    } else {
+      /* notes carry their text the way api keys carry their value */
+      locker_item_apikey_t *apikey = &resolved.apikey;
+      apikey->id = id;
+      apikey->key = key;
+      apikey->description = (char *)description;
+      if (resolved.type == LOCKER_ITEM_NOTE) {
+        apikey->value = db_note_value(db, id, arena);
+        notes_read = notes_read && apikey->value;
+        if (!apikey->value)
+          apikey->value = "";
+      } else {
+        apikey->value = arena_strndup(arena, (const char *)content, content_size);
+      }
+    }
 
-  rc = sqlite3_bind_text(stmt, 2, key, -1, SQLITE_TRANSIENT);
-  handle_sqlite_rc(db, rc, "SQL bind error");
+    locker_array_append(out, resolved);
+  }
 
-  rc = sqlite3_step(stmt);
-  if(rc != SQLITE_ROW)
-      handle_sqlite_rc(db, rc, "SQL step error");
+  return db_statement_done(db, stmt, rc, "SQL resolve items error") && notes_read;
+}
 
-  int exists = sqlite3_column_int(stmt, 0);
+/* NULL when there is no such item or it could not be read */
+ATTR_ALLOC ATTR_NODISCARD char *db_get_item_key(locker_db_t *db, sqlite_int64 item_id) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_GET_ITEM_KEY];
 
-  rc = sqlite3_finalize(stmt);
-  handle_sqlite_rc(db, rc, "SQL finalize error");
+  char *key = NULL;
+  int rc = sqlite3_bind_int64(stmt, 1, item_id);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    key = strdup((const char *)sqlite3_column_text(stmt, 0));
+    if (!key) {
+      perror("strdup");
+      exit(EXIT_FAILURE);
+    }
+    rc = SQLITE_OK;
+  }
+
+  db_statement_done(db, stmt, rc, "SQL get item key error");
+  return key;
+}
+
+/* whether an item other than item_id already has key */
+bool db_item_key_exists(locker_db_t *db, sqlite_int64 item_id, const char key[static 1], bool exists[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_ITEM_KEY_EXISTS];
 
-  return exists == 1;
+  *exists = false;
+  int rc = sqlite3_bind_int64(stmt, 1, item_id);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_text(stmt, 2, key, -1, SQLITE_TRANSIENT);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    *exists = sqlite3_column_int(stmt, 0) == 1;
+    rc = SQLITE_OK;
+  }
+
+  return db_statement_done(db, stmt, rc, "SQL key exists error");
 }
 
 
-void db_item_update(
-    sqlite3 *db,
+bool db_item_update(
+    locker_db_t *db,
     sqlite_int64 item_id,
     const char key[static 1],
     const char description[static 1],
     const int content_size,
     const unsigned char content[content_size]
 ) {
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(
-        db,
-        "UPDATE items SET item_key=?1, description=?2, content=?3, updated_at=strftime('%s', 'now') WHERE id=?4;",
-        -1, &stmt, NULL);
+    sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_UPDATE_ITEM];
+
+    int rc = sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
+    if(rc == SQLITE_OK)
+        rc = sqlite3_bind_text(stmt, 2, description, -1, SQLITE_TRANSIENT);
+    if(rc == SQLITE_OK)
+        rc = sqlite3_bind_blob(stmt, 3, content, content_size, SQLITE_TRANSIENT);
+    if(rc == SQLITE_OK)
+        rc = sqlite3_bind_int64(stmt, 4, item_id);
+    if(rc == SQLITE_OK)
+        rc = sqlite3_step(stmt);
+
+    return db_statement_done(db, stmt, rc, "SQL update item error");
+}
 
-    handle_sqlite_rc(db, rc, "SQL prepare error");
 
-    rc = sqlite3_bind_text(stmt, 1, key, -1, SQLITE_TRANSIENT);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+static bool db_delete_note_chunks(locker_db_t *db, sqlite_int64 item_id) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_DELETE_NOTE_CHUNKS];
 
-    rc = sqlite3_bind_text(stmt, 2, description, -1, SQLITE_TRANSIENT);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+  int rc = sqlite3_bind_int64(stmt, 1, item_id);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_step(stmt);
 
-    rc = sqlite3_bind_blob(stmt, 3, content, content_size, SQLITE_TRANSIENT);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+  return db_statement_done(db, stmt, rc, "SQL delete note error");
+}
 
-    rc = sqlite3_bind_int64(stmt, 4, item_id);
+/* the chunks of a note go with it, items of other types have none */
+bool db_item_delete(locker_db_t *db, sqlite_int64 item_id) {
+    sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_DELETE_ITEM];
 
-    rc = sqlite3_step(stmt);
-    handle_sqlite_rc(db, rc, "SQL step error");
+    int rc = sqlite3_bind_int64(stmt, 1, item_id);
+    if(rc == SQLITE_OK)
+        rc = sqlite3_step(stmt);
 
-    rc = sqlite3_finalize(stmt);
-    handle_sqlite_rc(db, rc, "SQL finalize error");
+    return db_statement_done(db, stmt, rc, "SQL delete item error") &&
+           db_delete_note_chunks(db, item_id);
 }
 
+/*
+ * Replaces the text of a note. Each chunk is inserted as a zeroblob and
+ * filled through one blob handle moved from row to row, so the text goes
+ * from content into the pages without another copy of it being built.
+ */
+bool db_write_note(locker_db_t *db, sqlite_int64 item_id, size_t size, const unsigned char content[size]) {
+  if (!db_delete_note_chunks(db, item_id))
+    return false;
 
-void db_item_delete(sqlite3 *db, sqlite_int64 item_id) {
-    sqlite3_stmt *stmt;
-    int rc = sqlite3_prepare_v2(db, "DELETE FROM items WHERE id = ?1;",-1,&stmt,NULL);
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_ADD_NOTE_CHUNK];
+  sqlite3_blob *blob = NULL;
+  int rc = SQLITE_OK;
 
-    handle_sqlite_rc(db, rc, "SQL prepare error");
+  for (size_t offset = 0, seq = 0; offset < size; seq++) {
+    int len = size - offset < LOCKER_NOTE_CHUNK_LEN ? (int)(size - offset) : LOCKER_NOTE_CHUNK_LEN;
 
     rc = sqlite3_bind_int64(stmt, 1, item_id);
-    handle_sqlite_rc(db, rc, "SQL bind error");
+    if (rc == SQLITE_OK)
+      rc = sqlite3_bind_int64(stmt, 2, (sqlite3_int64)seq);
+    if (rc == SQLITE_OK)
+      rc = sqlite3_bind_int(stmt, 3, len);
+    if (rc == SQLITE_OK)
+      rc = sqlite3_step(stmt);
+    if (!db_statement_done(db, stmt, rc, "SQL add note chunk error"))
+      break;
+
+    sqlite3_int64 chunk_id = sqlite3_last_insert_rowid(db->conn);
+    rc = blob ? sqlite3_blob_reopen(blob, chunk_id)
+              : sqlite3_blob_open(db->conn, "main", "note_chunks", "data", chunk_id, 1, &blob);
+    if (rc == SQLITE_OK)
+      rc = sqlite3_blob_write(blob, content + offset, len, 0);
+    if (sqlite_failed(db->conn, rc, "SQL write note error"))
+      break;
+
+    offset += len;
+  }
+
+  sqlite3_blob_close(blob);
+  return rc == SQLITE_OK || rc == SQLITE_DONE;
+}
 
+/*
+ * Copies up to size bytes from offset of the note into out, n_read is short
+ * when the note ends before. Only the chunks the range spans are opened.
+ */
+bool db_read_note(locker_db_t *db, sqlite_int64 item_id, size_t offset, size_t size, unsigned char out[size], size_t n_read[static 1]) {
+  sqlite3_stmt *stmt = db->stmts[LOCKER_STMT_NOTE_CHUNKS];
+  sqlite3_blob *blob = NULL;
+  size_t chunk_offset = offset % LOCKER_NOTE_CHUNK_LEN;
+
+  *n_read = 0;
+  int rc = sqlite3_bind_int64(stmt, 1, item_id);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_bind_int64(stmt, 2, (sqlite3_int64)(offset / LOCKER_NOTE_CHUNK_LEN));
+
+  while (rc == SQLITE_OK && *n_read < size) {
     rc = sqlite3_step(stmt);
-    handle_sqlite_rc(db, rc, "SQL step error");
+    if (rc != SQLITE_ROW)
+      break;
+
+    sqlite3_int64 chunk_id = sqlite3_column_int64(stmt, 0);
+    rc = blob ? sqlite3_blob_reopen(blob, chunk_id)
+              : sqlite3_blob_open(db->conn, "main", "note_chunks", "data", chunk_id, 0, &blob);
+    if (rc != SQLITE_OK)
+      break;
+
+    size_t chunk_len = (size_t)sqlite3_blob_bytes(blob);
+    if (chunk_offset < chunk_len) {
+      size_t len = chunk_len - chunk_offset;
+      if (len > size - *n_read)
+        len = size - *n_read;
+      rc = sqlite3_blob_read(blob, out + *n_read, (int)len, (int)chunk_offset);
+      *n_read += len;
+    }
+    chunk_offset = 0;
+  }
 
-    rc = sqlite3_finalize(stmt);
-    handle_sqlite_rc(db, rc, "SQL finalize_error");
+  /* the error message is gone once the blob is closed */
+  bool ok = db_statement_done(db, stmt, rc == SQLITE_ROW ? SQLITE_OK : rc, "SQL read note error");
+  sqlite3_blob_close(blob);
+  return ok;
 }
@@ -0,0 +1,591 @@
+#include "locker_fuzzy.h"
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOCKER_FUZZY_X86 1
+#endif
+
+/* scoring in the spirit of fzf: matches on word boundaries and runs win */
+#define SCORE_MATCH 16
+#define SCORE_GAP_START (-3)
+#define SCORE_GAP_EXTENSION (-1)
+#define SCORE_TYPO (-2 * SCORE_MATCH)
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_CAMEL (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+#define SCORE_NONE (INT_MIN / 4)
+/* gaps keep subtracting from SCORE_NONE, anything down there is no match */
+#define SCORE_VALID(score) ((score) > SCORE_NONE / 2)
+
+#define FUZZY_COMPACT_MIN_REMOVED 1024
+
+/* letters and digits get a bit each, everything else shares the rest */
+static uint64_t char_class_bit(unsigned char c) {
+  c = (unsigned char)tolower(c);
+  if (c >= 'a' && c <= 'z')
+    return 1ULL << (c - 'a');
+  if (c >= '0' && c <= '9')
+    return 1ULL << (26 + c - '0');
+  return 1ULL << (36 + c % 28);
+}
+
+static uint64_t char_class_mask(const char *s, size_t len) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < len; i++)
+    mask |= char_class_bit((unsigned char)s[i]);
+  return mask;
+}
+
+static bool is_separator(char c) {
+  return c == '/' || c == '-' || c == '_' || c == '.' || c == ' ' ||
+         c == ':' || c == '@';
+}
+
+static int position_bonus(const char *key, size_t j) {
+  if (j == 0 || is_separator(key[j - 1]))
+    return BONUS_BOUNDARY;
+  if ((islower((unsigned char)key[j - 1]) && isupper((unsigned char)key[j])) ||
+      (!isdigit((unsigned char)key[j - 1]) && isdigit((unsigned char)key[j])))
+    return BONUS_CAMEL;
+  return 0;
+}
+
+/*
+ * Prefilters: a key is a candidate when its mask has every class of the
+ * query, or all but one when a typo is allowed. Each appends the indexes of
+ * the candidates to out and returns how many there are.
+ */
+static size_t prefilter_scalar_from(const locker_fuzzy_t *fuzzy, size_t i,
+                                    uint64_t query_mask, int typos,
+                                    uint32_t out[], size_t n) {
+  for (; i < fuzzy->count; i++) {
+    uint64_t missing = query_mask & ~fuzzy->masks[i];
+    if (typos)
+      missing &= missing - 1;
+    if (missing == 0)
+      out[n++] = (uint32_t)i;
+  }
+  return n;
+}
+
+static size_t prefilter_scalar(const locker_fuzzy_t *fuzzy, uint64_t query_mask,
+                               int typos, uint32_t out[]) {
+  return prefilter_scalar_from(fuzzy, 0, query_mask, typos, out, 0);
+}
+
+#ifdef LOCKER_FUZZY_X86
+__attribute__((target("sse2"))) static size_t
+prefilter_sse2(const locker_fuzzy_t *fuzzy, uint64_t query_mask, int typos,
+               uint32_t out[]) {
+  const __m128i query = _mm_set1_epi64x((long long)query_mask);
+  const __m128i one = _mm_set1_epi64x(1);
+  const __m128i zero = _mm_setzero_si128();
+
+  size_t i = 0, n = 0;
+  for (; i + 2 <= fuzzy->count; i += 2) {
+    __m128i masks = _mm_loadu_si128((const __m128i *)(fuzzy->masks + i));
+    __m128i missing = _mm_andnot_si128(masks, query);
+    if (typos)
+      missing = _mm_and_si128(missing, _mm_sub_epi64(missing, one));
+
+    /* no 64-bit compare in SSE2, both 32-bit halves have to be zero */
+    __m128i eq = _mm_cmpeq_epi32(missing, zero);
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    int hits = _mm_movemask_pd(_mm_castsi128_pd(eq));
+
+    if (hits & 1)
+      out[n++] = (uint32_t)i;
+    if (hits & 2)
+      out[n++] = (uint32_t)i + 1;
+  }
+
+  return prefilter_scalar_from(fuzzy, i, query_mask, typos, out, n);
+}
+
+__attribute__((target("avx2"))) static size_t
+prefilter_avx2(const locker_fuzzy_t *fuzzy, uint64_t query_mask, int typos,
+               uint32_t out[]) {
+  const __m256i query = _mm256_set1_epi64x((long long)query_mask);
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i zero = _mm256_setzero_si256();
+
+  size_t i = 0, n = 0;
+  for (; i + 4 <= fuzzy->count; i += 4) {
+    __m256i masks = _mm256_loadu_si256((const __m256i *)(fuzzy->masks + i));
+    __m256i missing = _mm256_andnot_si256(masks, query);
+    if (typos)
+      missing = _mm256_and_si256(missing, _mm256_sub_epi64(missing, one));
+
+    int hits = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(missing, zero)));
+    while (hits) {
+      out[n++] = (uint32_t)i + __builtin_ctz(hits);
+      hits &= hits - 1;
+    }
+  }
+
+  return prefilter_scalar_from(fuzzy, i, query_mask, typos, out, n);
+}
+#endif
+
+locker_fuzzy_prefilter_fn fuzzy_prefilter_named(const char name[static 1]) {
+#ifdef LOCKER_FUZZY_X86
+  __builtin_cpu_init();
+  if (strcmp(name, "avx2") == 0)
+    return __builtin_cpu_supports("avx2") ? prefilter_avx2 : NULL;
+  if (strcmp(name, "sse2") == 0)
+    return __builtin_cpu_supports("sse2") ? prefilter_sse2 : NULL;
+#endif
+  return strcmp(name, "scalar") == 0 ? prefilter_scalar : NULL;
+}
+
+/* the widest one the CPU runs */
+static locker_fuzzy_prefilter_fn select_prefilter(void) {
+  locker_fuzzy_prefilter_fn prefilter = fuzzy_prefilter_named("avx2");
+  if (!prefilter)
+    prefilter = fuzzy_prefilter_named("sse2");
+  return prefilter ? prefilter : prefilter_scalar;
+}
+
+ATTR_ALLOC ATTR_NODISCARD locker_fuzzy_t *fuzzy_new(void) {
+  locker_fuzzy_t *fuzzy = calloc(1, sizeof(locker_fuzzy_t));
+  if (!fuzzy) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  fuzzy->prefilter = select_prefilter();
+  return fuzzy;
+}
+
+void fuzzy_free(locker_fuzzy_t fuzzy[static 1]) {
+  free(fuzzy->keys);
+  free(fuzzy->folded);
+  free(fuzzy->offsets);
+  free(fuzzy->lens);
+  free(fuzzy->masks);
+  free(fuzzy->item_ids);
+  free(fuzzy->item_types);
+  free(fuzzy->candidates);
+  free(fuzzy);
+}
+
+static void *grow(void *ptr, size_t n, size_t size) {
+  ptr = realloc(ptr, n * size);
+  if (!ptr) {
+    perror("realloc");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+void fuzzy_add(locker_fuzzy_t fuzzy[static 1], const char key[static 1],
+               sqlite3_int64 item_id, int item_type) {
+  size_t len = strlen(key);
+  if (len > UINT16_MAX)
+    len = UINT16_MAX;
+
+  if (fuzzy->count == fuzzy->capacity) {
+    fuzzy->capacity = fuzzy->capacity ? fuzzy->capacity * 2 : 256;
+    fuzzy->offsets = grow(fuzzy->offsets, fuzzy->capacity, sizeof(uint32_t));
+    fuzzy->lens = grow(fuzzy->lens, fuzzy->capacity, sizeof(uint16_t));
+    fuzzy->masks = grow(fuzzy->masks, fuzzy->capacity, sizeof(uint64_t));
+    fuzzy->item_ids =
+        grow(fuzzy->item_ids, fuzzy->capacity, sizeof(sqlite3_int64));
+    fuzzy->item_types = grow(fuzzy->item_types, fuzzy->capacity, sizeof(int));
+  }
+
+  if (fuzzy->keys_len + len + 1 > fuzzy->keys_capacity) {
+    fuzzy->keys_capacity = (fuzzy->keys_len + len + 1) * 2;
+    fuzzy->keys = grow(fuzzy->keys, fuzzy->keys_capacity, 1);
+    fuzzy->folded = grow(fuzzy->folded, fuzzy->keys_capacity, 1);
+  }
+
+  char *dst = fuzzy->keys + fuzzy->keys_len;
+  char *folded = fuzzy->folded + fuzzy->keys_len;
+  memcpy(dst, key, len);
+  dst[len] = '\0';
+  for (size_t i = 0; i < len; i++)
+    folded[i] = (char)tolower((unsigned char)key[i]);
+  folded[len] = '\0';
+
+  size_t i = fuzzy->count++;
+  fuzzy->offsets[i] = (uint32_t)fuzzy->keys_len;
+  fuzzy->lens[i] = (uint16_t)len;
+  fuzzy->masks[i] = char_class_mask(key, len);
+  fuzzy->item_ids[i] = item_id;
+  fuzzy->item_types[i] = item_type;
+
+  fuzzy->keys_len += len + 1;
+  if (len > fuzzy->max_len)
+    fuzzy->max_len = len;
+
+  fuzzy->has_last = false;
+}
+
+/* drops tombstones once they make up half of the index */
+static void fuzzy_compact(locker_fuzzy_t fuzzy[static 1]) {
+  size_t n = 0, keys_len = 0;
+  for (size_t i = 0; i < fuzzy->count; i++) {
+    if (fuzzy->item_ids[i] == 0)
+      continue;
+
+    size_t len = fuzzy->lens[i];
+    memmove(fuzzy->keys + keys_len, fuzzy->keys + fuzzy->offsets[i], len + 1);
+    memmove(fuzzy->folded + keys_len, fuzzy->folded + fuzzy->offsets[i],
+            len + 1);
+
+    fuzzy->offsets[n] = (uint32_t)keys_len;
+    fuzzy->lens[n] = fuzzy->lens[i];
+    fuzzy->masks[n] = fuzzy->masks[i];
+    fuzzy->item_ids[n] = fuzzy->item_ids[i];
+    fuzzy->item_types[n] = fuzzy->item_types[i];
+
+    keys_len += len + 1;
+    n++;
+  }
+
+  fuzzy->count = n;
+  fuzzy->keys_len = keys_len;
+  fuzzy->n_removed = 0;
+}
+
+void fuzzy_remove(locker_fuzzy_t fuzzy[static 1], sqlite3_int64 item_id) {
+  for (size_t i = 0; i < fuzzy->count; i++) {
+    if (fuzzy->item_ids[i] != item_id)
+      continue;
+
+    fuzzy->item_ids[i] = 0;
+    fuzzy->masks[i] = 0;
+    fuzzy->n_removed++;
+    fuzzy->has_last = false;
+    break;
+  }
+
+  if (fuzzy->n_removed >= FUZZY_COMPACT_MIN_REMOVED &&
+      fuzzy->n_removed * 2 >= fuzzy->count)
+    fuzzy_compact(fuzzy);
+}
+
+/*
+ * Exact check whether query is a subsequence of key, with query[0] fixed and
+ * up to typos other query characters left out. fwd[i] is the earliest end
+ * of a match of query[0..i], a skip at i needs query[i+1..] to fit after it.
+ */
+static bool is_candidate(const char *query, size_t qlen, const char *key,
+                         size_t klen, int typos, size_t fwd[]) {
+  size_t j = 0;
+  size_t matched = 0;
+  for (; matched < qlen; matched++) {
+    while (j < klen && key[j] != query[matched])
+      j++;
+    if (j == klen)
+      break;
+    fwd[matched] = j++;
+  }
+
+  if (matched == qlen)
+    return true;
+  if (!typos || matched == 0)
+    return false;
+
+  /* latest start for query[i..] matched backwards, tried at every skip */
+  size_t bwd = klen;
+  for (size_t i = qlen; i-- > 1;) {
+    /* skipping query[i]: query[0..i-1] has to end before query[i+1..] starts */
+    if (i - 1 < matched && fwd[i - 1] < bwd)
+      return true;
+
+    size_t k = bwd;
+    while (k > 0 && key[k - 1] != query[i])
+      k--;
+    if (k == 0)
+      return false;
+    bwd = k - 1;
+  }
+  return false;
+}
+
+typedef struct {
+  int pos;
+  int score;
+} fuzzy_cell_t;
+
+/*
+ * One row of the alignment for query character c: every position in key
+ * holding c, scored from the best cell of the previous row before it. A gap
+ * from p to j costs SCORE_GAP_START plus SCORE_GAP_EXTENSION for every
+ * character past the first, which is prev + p - j - 1 with the values above.
+ */
+static size_t score_row(const fuzzy_cell_t prev[], size_t n_prev, char c,
+                        const char *key, const char *folded, size_t klen,
+                        fuzzy_cell_t out[]) {
+  const char *end = folded + klen;
+  size_t n = 0, p = 0;
+  int best_gap = SCORE_NONE;
+
+  for (const char *at = memchr(folded, c, klen); at;
+       at = memchr(at + 1, c, (size_t)(end - at - 1))) {
+    int j = (int)(at - folded);
+
+    while (p < n_prev && prev[p].pos <= j - 2) {
+      if (prev[p].score + prev[p].pos > best_gap)
+        best_gap = prev[p].score + prev[p].pos;
+      p++;
+    }
+
+    int bonus = position_bonus(key, j);
+    int best = SCORE_VALID(best_gap) ? best_gap - j - 1 + bonus : SCORE_NONE;
+    if (p < n_prev && prev[p].pos == j - 1) {
+      int run = bonus > BONUS_CONSECUTIVE ? bonus : BONUS_CONSECUTIVE;
+      if (prev[p].score + run > best)
+        best = prev[p].score + run;
+    }
+
+    if (SCORE_VALID(best))
+      out[n++] = (fuzzy_cell_t){.pos = j, .score = best + SCORE_MATCH};
+  }
+
+  return n;
+}
+
+/* merges skip cells into matched cells, keeping the best score per position */
+static size_t merge_rows(const fuzzy_cell_t a[], size_t n_a,
+                         const fuzzy_cell_t b[], size_t n_b, int b_penalty,
+                         fuzzy_cell_t out[]) {
+  size_t i = 0, k = 0, n = 0;
+  while (i < n_a || k < n_b) {
+    if (k == n_b || (i < n_a && a[i].pos < b[k].pos)) {
+      out[n++] = a[i++];
+    } else if (i == n_a || b[k].pos < a[i].pos) {
+      out[n++] = (fuzzy_cell_t){.pos = b[k].pos, .score = b[k].score + b_penalty};
+      k++;
+    } else {
+      int skip = b[k].score + b_penalty;
+      out[n++] = (fuzzy_cell_t){.pos = a[i].pos,
+                                .score = a[i].score > skip ? a[i].score : skip};
+      i++;
+      k++;
+    }
+  }
+  return n;
+}
+
+/*
+ * Smith-Waterman style alignment with affine gaps, computed only on the
+ * positions where query characters occur. Every query character is matched
+ * in order, except for at most typos of them which cost SCORE_TYPO; layer 0
+ * has no character skipped, layer 1 has one. cells holds 5 rows of klen.
+ */
+static int score_key(const char *query, size_t qlen, const char *key,
+                     const char *folded, size_t klen, int typos,
+                     fuzzy_cell_t cells[]) {
+  fuzzy_cell_t *prev0 = cells, *cur0 = cells + klen;
+  fuzzy_cell_t *prev1 = cells + 2 * klen, *cur1 = cells + 3 * klen;
+  fuzzy_cell_t *matched1 = cells + 4 * klen;
+  const char *end = folded + klen;
+  size_t n_prev0 = 0, n_prev1 = 0;
+
+  for (const char *at = memchr(folded, query[0], klen); at;
+       at = memchr(at + 1, query[0], (size_t)(end - at - 1))) {
+    int j = (int)(at - folded);
+    prev0[n_prev0++] = (fuzzy_cell_t){
+        .pos = j,
+        .score = SCORE_MATCH +
+                 position_bonus(key, j) * BONUS_FIRST_CHAR_MULTIPLIER};
+  }
+
+  for (size_t i = 1; i < qlen; i++) {
+    size_t n_cur0 =
+        score_row(prev0, n_prev0, query[i], key, folded, klen, cur0);
+
+    size_t n_cur1 = 0;
+    if (typos) {
+      size_t n_matched1 =
+          score_row(prev1, n_prev1, query[i], key, folded, klen, matched1);
+      n_cur1 = merge_rows(matched1, n_matched1, prev0, n_prev0, SCORE_TYPO,
+                          cur1);
+    }
+
+    fuzzy_cell_t *tmp = prev0;
+    prev0 = cur0;
+    cur0 = tmp;
+    n_prev0 = n_cur0;
+
+    tmp = prev1;
+    prev1 = cur1;
+    cur1 = tmp;
+    n_prev1 = n_cur1;
+  }
+
+  int best = SCORE_NONE;
+  for (size_t j = 0; j < n_prev0; j++) {
+    if (prev0[j].score > best)
+      best = prev0[j].score;
+  }
+  for (size_t j = 0; j < n_prev1; j++) {
+    if (prev1[j].score > best)
+      best = prev1[j].score;
+  }
+  return best;
+}
+
+/* higher score first, then shorter keys, then the order keys came in */
+static bool result_better(const locker_fuzzy_t *fuzzy, int score_a, uint32_t a,
+                          int score_b, uint32_t b) {
+  if (score_a != score_b)
+    return score_a > score_b;
+  if (fuzzy->lens[a] != fuzzy->lens[b])
+    return fuzzy->lens[a] < fuzzy->lens[b];
+  return a < b;
+}
+
+typedef struct {
+  int score;
+  uint32_t index;
+} fuzzy_hit_t;
+
+/* min-heap on result_better, the root is the worst hit kept so far */
+static void heap_sift_down(const locker_fuzzy_t *fuzzy, fuzzy_hit_t heap[],
+                           size_t n, size_t i) {
+  while (1) {
+    size_t worst = i, l = 2 * i + 1, r = 2 * i + 2;
+    if (l < n && result_better(fuzzy, heap[worst].score, heap[worst].index,
+                               heap[l].score, heap[l].index))
+      worst = l;
+    if (r < n && result_better(fuzzy, heap[worst].score, heap[worst].index,
+                               heap[r].score, heap[r].index))
+      worst = r;
+    if (worst == i)
+      return;
+
+    fuzzy_hit_t tmp = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = tmp;
+    i = worst;
+  }
+}
+
+static void heap_push(const locker_fuzzy_t *fuzzy, fuzzy_hit_t heap[],
+                      size_t *n, size_t max, fuzzy_hit_t hit) {
+  if (*n < max) {
+    size_t i = (*n)++;
+    heap[i] = hit;
+    while (i > 0) {
+      size_t parent = (i - 1) / 2;
+      if (!result_better(fuzzy, heap[parent].score, heap[parent].index,
+                         heap[i].score, heap[i].index))
+        break;
+      fuzzy_hit_t tmp = heap[i];
+      heap[i] = heap[parent];
+      heap[parent] = tmp;
+      i = parent;
+    }
+  } else if (result_better(fuzzy, hit.score, hit.index, heap[0].score,
+                           heap[0].index)) {
+    heap[0] = hit;
+    heap_sift_down(fuzzy, heap, *n, 0);
+  }
+}
+
+/*
+ * Fills out with the best max_results keys for query, best first. When query
+ * extends the previous one, only the keys that matched that one are looked
+ * at again, anything else goes through the prefilter over all keys.
+ */
+size_t fuzzy_search(locker_fuzzy_t fuzzy[static 1], const char query[static 1],
+                    size_t max_results,
+                    locker_fuzzy_result_t out[max_results]) {
+  char folded_query[LOCKER_FUZZY_QUERY_MAX_LEN + 1];
+  size_t qlen = 0;
+  for (; query[qlen] && qlen < LOCKER_FUZZY_QUERY_MAX_LEN; qlen++)
+    folded_query[qlen] = (char)tolower((unsigned char)query[qlen]);
+  folded_query[qlen] = '\0';
+
+  if (qlen == 0 || max_results == 0 || fuzzy->count == 0) {
+    fuzzy->has_last = false;
+    return 0;
+  }
+
+  int typos = qlen >= LOCKER_FUZZY_TYPO_MIN_QUERY_LEN ? 1 : 0;
+  uint64_t query_mask = char_class_mask(folded_query, qlen);
+
+  /* a longer query only ever matches a subset of what the shorter one did */
+  bool refine = fuzzy->has_last && typos <= fuzzy->last_typos &&
+                strncmp(folded_query, fuzzy->last_query,
+                        strlen(fuzzy->last_query)) == 0;
+
+  uint32_t *candidates = fuzzy->candidates;
+  size_t n_candidates = fuzzy->n_candidates;
+  if (!refine) {
+    candidates = grow(fuzzy->candidates, fuzzy->count ? fuzzy->count : 1,
+                      sizeof(uint32_t));
+    n_candidates = fuzzy->prefilter(fuzzy, query_mask, typos, candidates);
+  }
+
+  size_t *fwd = malloc(qlen * sizeof(size_t));
+  fuzzy_cell_t *cells = malloc(5 * (fuzzy->max_len + 1) * sizeof(fuzzy_cell_t));
+  fuzzy_hit_t *heap = malloc(max_results * sizeof(fuzzy_hit_t));
+  if (!fwd || !cells || !heap) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t n_matched = 0, n_heap = 0;
+  for (size_t c = 0; c < n_candidates; c++) {
+    uint32_t i = candidates[c];
+    if (fuzzy->item_ids[i] == 0)
+      continue;
+
+    if (refine) {
+      uint64_t missing = query_mask & ~fuzzy->masks[i];
+      if (typos)
+        missing &= missing - 1;
+      if (missing)
+        continue;
+    }
+
+    const char *key = fuzzy->keys + fuzzy->offsets[i];
+    const char *folded = fuzzy->folded + fuzzy->offsets[i];
+    size_t klen = fuzzy->lens[i];
+    if (!is_candidate(folded_query, qlen, folded, klen, typos, fwd))
+      continue;
+
+    /* survivors are compacted in place, they seed the next refinement */
+    candidates[n_matched++] = i;
+
+    int score = score_key(folded_query, qlen, key, folded, klen, typos, cells);
+    heap_push(fuzzy, heap, &n_heap, max_results,
+              (fuzzy_hit_t){.score = score, .index = i});
+  }
+
+  fuzzy->candidates = candidates;
+  fuzzy->n_candidates = n_matched;
+  memcpy(fuzzy->last_query, folded_query, qlen + 1);
+  fuzzy->last_typos = typos;
+  fuzzy->has_last = true;
+
+  /* popping the worst hit first fills out back to front */
+  for (size_t n = n_heap; n > 0; n--) {
+    fuzzy_hit_t hit = heap[0];
+    heap[0] = heap[n - 1];
+    heap_sift_down(fuzzy, heap, n - 1, 0);
+
+    out[n - 1] = (locker_fuzzy_result_t){
+        .item_id = fuzzy->item_ids[hit.index],
+        .item_type = fuzzy->item_types[hit.index],
+        .key = fuzzy->keys + fuzzy->offsets[hit.index],
+        .score = hit.score,
+    };
+  }
+
+  free(fwd);
+  free(cells);
+  free(heap);
+  return n_heap;
+}
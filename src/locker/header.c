@@ -0,0 +1,135 @@
+#include "locker_header.h"
+#include "locker_utils.h"
+#include "locker_utils_private.h"
+#include <assert.h>
+#include <string.h>
+
+#define HEADER_MAGIC_OFFSET 0
+#define HEADER_VERSION_OFFSET 8
+#define HEADER_SIZE_OFFSET 12
+#define HEADER_NAME_OFFSET 16
+#define HEADER_SALT_OFFSET (HEADER_NAME_OFFSET + LOCKER_NAME_MAX_LEN + 1)
+#define HEADER_NONCE_OFFSET (HEADER_SALT_OFFSET + LOCKER_CRYPTO_SALT_LEN)
+#define HEADER_LOCKER_SIZE_OFFSET (HEADER_NONCE_OFFSET + LOCKER_CRYPTO_NONCE_LEN)
+#define HEADER_END (HEADER_LOCKER_SIZE_OFFSET + 8)
+
+#define SLOT_TYPE_OFFSET 0
+#define SLOT_KDF_ALG_OFFSET 1
+#define SLOT_KDF_OPSLIMIT_OFFSET 4
+#define SLOT_KDF_MEMLIMIT_OFFSET 8
+#define SLOT_SALT_OFFSET 16
+#define SLOT_NONCE_OFFSET 32
+#define SLOT_WRAPPED_KEY_OFFSET 56
+
+static_assert(SLOT_WRAPPED_KEY_OFFSET + LOCKER_WRAPPED_KEY_LEN <= LOCKER_KEY_SLOT_SIZE);
+static_assert(LOCKER_KEY_SLOTS_OFFSET + LOCKER_KEY_SLOTS * LOCKER_KEY_SLOT_SIZE <= LOCKER_HEADER_SIZE);
+
+/* legacy struct: u32 version, padding, u64 magic, fields, padding, u64 size */
+#define LEGACY_VERSION_OFFSET 0
+#define LEGACY_MAGIC_OFFSET 8
+#define LEGACY_NAME_OFFSET 16
+#define LEGACY_SALT_OFFSET (LEGACY_NAME_OFFSET + LOCKER_NAME_MAX_LEN + 1)
+#define LEGACY_NONCE_OFFSET (LEGACY_SALT_OFFSET + LOCKER_CRYPTO_SALT_LEN)
+#define LEGACY_LOCKER_SIZE_OFFSET 128
+
+void key_slot_serialize(const locker_key_slot_t slot[static 1],
+                        unsigned char out[LOCKER_KEY_SLOT_SIZE]) {
+  memset(out, 0, LOCKER_KEY_SLOT_SIZE);
+  if (slot->type == LOCKER_KEY_SLOT_EMPTY)
+    return;
+
+  out[SLOT_TYPE_OFFSET] = (unsigned char)slot->type;
+  if (slot->type == LOCKER_KEY_SLOT_PASSPHRASE) {
+    out[SLOT_KDF_ALG_OFFSET] = (unsigned char)slot->kdf.alg;
+    put_u32_le(out + SLOT_KDF_OPSLIMIT_OFFSET, (uint32_t)slot->kdf.opslimit);
+    put_u64_le(out + SLOT_KDF_MEMLIMIT_OFFSET, slot->kdf.memlimit);
+  }
+  memcpy(out + SLOT_SALT_OFFSET, slot->salt, LOCKER_CRYPTO_SALT_LEN);
+  memcpy(out + SLOT_NONCE_OFFSET, slot->nonce, LOCKER_CRYPTO_NONCE_LEN);
+  memcpy(out + SLOT_WRAPPED_KEY_OFFSET, slot->wrapped_key,
+         LOCKER_WRAPPED_KEY_LEN);
+}
+
+static void key_slot_parse(const unsigned char in[LOCKER_KEY_SLOT_SIZE],
+                           locker_key_slot_t slot[static 1]) {
+  slot->type = in[SLOT_TYPE_OFFSET];
+  if (slot->type != LOCKER_KEY_SLOT_PASSPHRASE &&
+      slot->type != LOCKER_KEY_SLOT_KEYFILE) {
+    /* unknown slot types are left alone, they cannot unlock anything */
+    slot->type = LOCKER_KEY_SLOT_EMPTY;
+    return;
+  }
+
+  if (slot->type == LOCKER_KEY_SLOT_PASSPHRASE) {
+    slot->kdf.alg = in[SLOT_KDF_ALG_OFFSET];
+    slot->kdf.opslimit = get_u32_le(in + SLOT_KDF_OPSLIMIT_OFFSET);
+    slot->kdf.memlimit = (size_t)get_u64_le(in + SLOT_KDF_MEMLIMIT_OFFSET);
+    if (!kdf_params_valid(&slot->kdf)) {
+      slot->type = LOCKER_KEY_SLOT_EMPTY;
+      return;
+    }
+  }
+
+  memcpy(slot->salt, in + SLOT_SALT_OFFSET, LOCKER_CRYPTO_SALT_LEN);
+  memcpy(slot->nonce, in + SLOT_NONCE_OFFSET, LOCKER_CRYPTO_NONCE_LEN);
+  memcpy(slot->wrapped_key, in + SLOT_WRAPPED_KEY_OFFSET,
+         LOCKER_WRAPPED_KEY_LEN);
+}
+
+void header_serialize(const locker_header_t header[static 1],
+                      unsigned char out[LOCKER_HEADER_SIZE]) {
+  memset(out, 0, LOCKER_HEADER_SIZE);
+
+  put_u64_le(out + HEADER_MAGIC_OFFSET, LOCKER_MAGIC);
+  put_u32_le(out + HEADER_VERSION_OFFSET, header->file_version);
+  put_u32_le(out + HEADER_SIZE_OFFSET, LOCKER_HEADER_SIZE);
+  strncpy((char *)out + HEADER_NAME_OFFSET, header->locker_name,
+          LOCKER_NAME_MAX_LEN);
+  memcpy(out + HEADER_SALT_OFFSET, header->salt, LOCKER_CRYPTO_SALT_LEN);
+  memcpy(out + HEADER_NONCE_OFFSET, header->nonce, LOCKER_CRYPTO_NONCE_LEN);
+  put_u64_le(out + HEADER_LOCKER_SIZE_OFFSET, header->locker_size);
+
+  for (int i = 0; i < LOCKER_KEY_SLOTS; i++) {
+    key_slot_serialize(&header->key_slots[i],
+                       out + LOCKER_KEY_SLOTS_OFFSET + i * LOCKER_KEY_SLOT_SIZE);
+  }
+}
+
+bool header_parse(const unsigned char *in, size_t len,
+                  locker_header_t header[static 1]) {
+  memset(header, 0, sizeof(locker_header_t));
+
+  if (len >= HEADER_END && get_u64_le(in + HEADER_MAGIC_OFFSET) == LOCKER_MAGIC) {
+    uint32_t header_size = get_u32_le(in + HEADER_SIZE_OFFSET);
+    if (header_size < HEADER_END)
+      return false;
+
+    header->file_version = get_u32_le(in + HEADER_VERSION_OFFSET);
+    header->data_offset = header_size;
+    memcpy(header->locker_name, in + HEADER_NAME_OFFSET, LOCKER_NAME_MAX_LEN);
+    memcpy(header->salt, in + HEADER_SALT_OFFSET, LOCKER_CRYPTO_SALT_LEN);
+    memcpy(header->nonce, in + HEADER_NONCE_OFFSET, LOCKER_CRYPTO_NONCE_LEN);
+    header->locker_size = get_u64_le(in + HEADER_LOCKER_SIZE_OFFSET);
+
+    if (header_size >= LOCKER_HEADER_SIZE && len >= LOCKER_HEADER_SIZE) {
+      for (int i = 0; i < LOCKER_KEY_SLOTS; i++) {
+        key_slot_parse(in + LOCKER_KEY_SLOTS_OFFSET + i * LOCKER_KEY_SLOT_SIZE,
+                       &header->key_slots[i]);
+      }
+    }
+    return true;
+  }
+
+  if (len >= LOCKER_LEGACY_HEADER_SIZE &&
+      get_u64_le(in + LEGACY_MAGIC_OFFSET) == LOCKER_MAGIC) {
+    header->file_version = get_u32_le(in + LEGACY_VERSION_OFFSET);
+    header->data_offset = LOCKER_LEGACY_HEADER_SIZE;
+    memcpy(header->locker_name, in + LEGACY_NAME_OFFSET, LOCKER_NAME_MAX_LEN);
+    memcpy(header->salt, in + LEGACY_SALT_OFFSET, LOCKER_CRYPTO_SALT_LEN);
+    memcpy(header->nonce, in + LEGACY_NONCE_OFFSET, LOCKER_CRYPTO_NONCE_LEN);
+    header->locker_size = get_u64_le(in + LEGACY_LOCKER_SIZE_OFFSET);
+    return true;
+  }
+
+  return false;
+}
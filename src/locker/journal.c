@@ -0,0 +1,342 @@
+#include "locker_journal.h"
+#include "locker_crypto.h"
+#include "locker_db.h"
+#include "locker_logs.h"
+#include "locker_utils.h"
+#include "locker_utils_private.h"
+#include "sodium/crypto_aead_xchacha20poly1305.h"
+#include "sodium/utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/syslimits.h>
+#include <unistd.h>
+
+/*
+ * Every record is
+ *   u32 sealed_len | u64 seq | nonce | XChaCha20-Poly1305(payload)
+ * sealed with the locker key; the locker salt and seq are the associated data,
+ * so records can be neither moved between lockers nor reordered.
+ */
+#define RECORD_PREFIX_LEN (4 + 8 + LOCKER_CRYPTO_NONCE_LEN)
+#define RECORD_AD_LEN (LOCKER_CRYPTO_SALT_LEN + 8)
+
+static void record_ad(const locker_journal_t *journal, uint64_t seq,
+                      unsigned char ad[RECORD_AD_LEN]) {
+  memcpy(ad, journal->salt, LOCKER_CRYPTO_SALT_LEN);
+  put_u64_le(ad + LOCKER_CRYPTO_SALT_LEN, seq);
+}
+
+void journal_filepath(char out[], size_t out_sz,
+                      const char locker_filepath[static 1]) {
+  snprintf(out, out_sz, "%s%s", locker_filepath,
+           LOCKER_JOURNAL_FILE_EXTENSION);
+}
+
+ATTR_ALLOC ATTR_NODISCARD locker_journal_t *
+journal_open(const char locker_filepath[static 1],
+             const unsigned char salt[LOCKER_CRYPTO_SALT_LEN],
+             const locker_crypto_masterkey_t key[static 1],
+             locker_result_t result[static 1]) {
+  char filepath[PATH_MAX] = {0};
+  journal_filepath(filepath, sizeof(filepath), locker_filepath);
+
+  locker_journal_t *journal = malloc(sizeof(locker_journal_t));
+  if (!journal) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  journal->fd = open(filepath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (journal->fd < 0) {
+    log_message("Cannot open journal %s: %s", filepath, strerror(errno));
+    free(journal);
+    *result = LOCKER_DB_ERROR;
+    return NULL;
+  }
+
+  /*
+   * records are numbered from the seq of the handle that writes them, two
+   * handles would hand out the same numbers and replay would skip one of them
+   */
+  if (flock(journal->fd, LOCK_EX | LOCK_NB) != 0) {
+    *result = errno == EWOULDBLOCK ? LOCKER_BUSY : LOCKER_DB_ERROR;
+    if (*result == LOCKER_BUSY)
+      log_message("%s is open in another session.", locker_filepath);
+    else
+      log_message("Cannot lock journal %s: %s", filepath, strerror(errno));
+    close(journal->fd);
+    free(journal);
+    return NULL;
+  }
+
+  journal->size = lseek(journal->fd, 0, SEEK_END);
+  journal->seq = 0;
+  journal->broken = false;
+  journal->key = key;
+  memcpy(journal->salt, salt, LOCKER_CRYPTO_SALT_LEN);
+
+  *result = LOCKER_OK;
+  return journal;
+}
+
+static bool apply_record(locker_db_t *db,
+                         const locker_journal_record_t record[static 1]) {
+  /* a note keeps its text in chunks and an empty content in items */
+  bool is_note = record->item_type == LOCKER_ITEM_NOTE;
+  int content_size = is_note ? 0 : record->content_size;
+
+  switch (record->op) {
+  case LOCKER_JOURNAL_ADD:
+    return db_add_item(db, record->item_id, record->key, record->description,
+                       content_size, record->content, record->item_type) != 0 &&
+           (!is_note || db_write_note(db, record->item_id,
+                                      (size_t)record->content_size,
+                                      record->content));
+  case LOCKER_JOURNAL_UPDATE:
+    return db_item_update(db, record->item_id, record->key,
+                          record->description, content_size,
+                          record->content) &&
+           (!is_note || db_write_note(db, record->item_id,
+                                      (size_t)record->content_size,
+                                      record->content));
+  case LOCKER_JOURNAL_DELETE:
+    return db_item_delete(db, record->item_id);
+  }
+  return true;
+}
+
+static bool decode_record(unsigned char *payload, size_t len,
+                          locker_journal_record_t record[static 1]) {
+  /* op | item_id | item_type | key_len key | desc_len desc | content_len content */
+  if (len < 1 + 8 + 1 + 4)
+    return false;
+
+  record->op = payload[0];
+  record->item_id = (sqlite3_int64)get_u64_le(payload + 1);
+  record->item_type = payload[9];
+
+  size_t offset = 10;
+  uint32_t field_len[3];
+  unsigned char *field[3];
+  for (int i = 0; i < 3; i++) {
+    if (offset + 4 > len)
+      return false;
+    field_len[i] = get_u32_le(payload + offset);
+    offset += 4;
+    if (field_len[i] > len - offset)
+      return false;
+    field[i] = payload + offset;
+    offset += field_len[i];
+  }
+
+  /* key and description are stored with their terminating NUL */
+  if ((field_len[0] && field[0][field_len[0] - 1] != '\0') ||
+      (field_len[1] && field[1][field_len[1] - 1] != '\0'))
+    return false;
+
+  record->key = field_len[0] ? (const char *)field[0] : "";
+  record->description = field_len[1] ? (const char *)field[1] : "";
+  record->content_size = (int)field_len[2];
+  record->content = field[2];
+  return true;
+}
+
+/*
+ * false when the database refused a record, the journal is then left as it
+ * is so the next open replays it again
+ */
+bool journal_replay(locker_journal_t journal[static 1], locker_db_t *db,
+                    sqlite3_uint64 applied_seq) {
+  journal->seq = applied_seq;
+
+  int fd = dup(journal->fd);
+  FILE *f = fd < 0 ? NULL : fdopen(fd, "rb");
+  if (!f) {
+    log_message("Cannot read the journal: %s", strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  fseeko(f, 0, SEEK_SET);
+
+  off_t good_size = 0;
+  size_t n_applied = 0;
+  bool failed = false;
+  unsigned char prefix[RECORD_PREFIX_LEN];
+
+  while (fread(prefix, 1, sizeof(prefix), f) == sizeof(prefix)) {
+    uint32_t sealed_len = get_u32_le(prefix);
+    uint64_t seq = get_u64_le(prefix + 4);
+
+    if (sealed_len < crypto_aead_xchacha20poly1305_IETF_ABYTES ||
+        good_size + (off_t)sizeof(prefix) + sealed_len > journal->size)
+      break;
+
+    unsigned char *sealed = malloc(sealed_len);
+    unsigned char *payload = malloc(sealed_len);
+    if (!sealed || !payload) {
+      perror("malloc");
+      exit(EXIT_FAILURE);
+    }
+
+    if (fread(sealed, 1, sealed_len, f) != sealed_len) {
+      free(sealed);
+      free(payload);
+      break;
+    }
+
+    unsigned char ad[RECORD_AD_LEN];
+    record_ad(journal, seq, ad);
+
+    unsigned long long payload_len = 0;
+    int rc = crypto_aead_xchacha20poly1305_ietf_decrypt(
+        payload, &payload_len, NULL, sealed, sealed_len, ad, sizeof(ad),
+        prefix + 12, journal->key);
+    free(sealed);
+
+    locker_journal_record_t record;
+    bool valid = rc == 0 && decode_record(payload, payload_len, &record);
+
+    if (valid && seq > journal->seq) {
+      failed = !apply_record(db, &record);
+      journal->seq = seq;
+      n_applied++;
+    }
+
+    sodium_memzero(payload, sealed_len);
+    free(payload);
+
+    if (!valid || failed)
+      break;
+
+    good_size += sizeof(prefix) + sealed_len;
+  }
+  fclose(f);
+
+  if (failed) {
+    log_message("Journal record %llu could not be replayed.",
+                (unsigned long long)journal->seq);
+    return false;
+  }
+
+  if (good_size != journal->size) {
+    /* torn or foreign tail left behind by a crash, drop it */
+    log_message("Dropping %lld trailing journal bytes that failed to verify.",
+                (long long)(journal->size - good_size));
+    if (ftruncate(journal->fd, good_size) != 0) {
+      /* records appended behind the tail would never be replayed */
+      log_message("Cannot drop the journal tail: %s", strerror(errno));
+      return false;
+    }
+    journal->size = good_size;
+  }
+
+  if (n_applied > 0)
+    log_message("Replayed %zu journal records.", n_applied);
+  return true;
+}
+
+/*
+ * false when the record is not durable, whatever part of it reached the file
+ * is cut off again so the next open does not replay it
+ */
+bool journal_append(locker_journal_t journal[static 1],
+                    const locker_journal_record_t record[static 1]) {
+  if (journal->broken) {
+    log_message("Journal has a tail that could not be dropped, refusing writes.");
+    return false;
+  }
+
+  size_t key_len = record->key ? strlen(record->key) + 1 : 0;
+  size_t description_len =
+      record->description ? strlen(record->description) + 1 : 0;
+  size_t content_len = record->content ? (size_t)record->content_size : 0;
+
+  size_t payload_len = 1 + 8 + 1 + 4 + key_len + 4 + description_len + 4 +
+                       content_len;
+  size_t sealed_len = payload_len + crypto_aead_xchacha20poly1305_IETF_ABYTES;
+
+  unsigned char *payload = malloc(payload_len);
+  unsigned char *out = malloc(RECORD_PREFIX_LEN + sealed_len);
+  if (!payload || !out) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  unsigned char *p = payload;
+  *p++ = (unsigned char)record->op;
+  put_u64_le(p, (uint64_t)record->item_id);
+  p += 8;
+  *p++ = (unsigned char)record->item_type;
+
+  const void *fields[] = {record->key, record->description, record->content};
+  size_t field_lens[] = {key_len, description_len, content_len};
+  for (int i = 0; i < 3; i++) {
+    put_u32_le(p, (uint32_t)field_lens[i]);
+    p += 4;
+    if (field_lens[i])
+      memcpy(p, fields[i], field_lens[i]);
+    p += field_lens[i];
+  }
+
+  uint64_t seq = journal->seq + 1;
+  put_u32_le(out, (uint32_t)sealed_len);
+  put_u64_le(out + 4, seq);
+  generate_nonce(out + 12);
+
+  unsigned char ad[RECORD_AD_LEN];
+  record_ad(journal, seq, ad);
+
+  crypto_aead_xchacha20poly1305_ietf_encrypt(out + RECORD_PREFIX_LEN, NULL,
+                                             payload, payload_len, ad,
+                                             sizeof(ad), NULL, out + 12,
+                                             journal->key);
+
+  /* set memory used for payload to 0 to remove it from registers */
+  sodium_memzero(payload, payload_len);
+  free(payload);
+
+  size_t total = RECORD_PREFIX_LEN + sealed_len;
+  bool written = true;
+  for (size_t done = 0; written && done < total;) {
+    ssize_t n = write(journal->fd, out + done, total - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    written = n >= 0;
+    done += written ? (size_t)n : 0;
+  }
+  free(out);
+
+  if (!written || fsync(journal->fd) != 0) {
+    log_message("Cannot write to the journal: %s", strerror(errno));
+    /* later records would sit behind a tail replay stops at */
+    journal->broken = ftruncate(journal->fd, journal->size) != 0;
+    return false;
+  }
+
+  journal->size += total;
+  journal->seq = seq;
+  return true;
+}
+
+/* false leaves the records in place, replay skips them as already applied */
+bool journal_truncate(locker_journal_t journal[static 1]) {
+  if (ftruncate(journal->fd, 0) != 0 || fsync(journal->fd) != 0) {
+    log_message("Cannot truncate the journal: %s", strerror(errno));
+    return false;
+  }
+  journal->size = 0;
+  return true;
+}
+
+/* closing the descriptor lets go of the lock */
+void journal_close(locker_journal_t journal[static 1]) {
+  close(journal->fd);
+  free(journal);
+}
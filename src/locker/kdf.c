@@ -0,0 +1,112 @@
+#include "locker_kdf.h"
+#include "locker_logs.h"
+#include "locker_utils.h"
+#include "locker_utils_private.h"
+#include "sodium/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syslimits.h>
+#include <time.h>
+
+/*
+ * Parameters new passphrase key slots are sealed with. Written by
+ * `locker calibrate` into the locker workdir, defaults apply without it.
+ */
+locker_crypto_kdf_params_t kdf_params_load(const char locker_dir[static 1]) {
+  char config_path[PATH_MAX] = {0};
+  snprintf(config_path, PATH_MAX, "%s/%s", locker_dir,
+           LOCKER_KDF_CONFIG_FILENAME);
+
+  FILE *f = fopen(config_path, "r");
+  if (!f)
+    return LOCKER_CRYPTO_KDF_DEFAULT_PARAMS;
+
+  locker_crypto_kdf_params_t params;
+  int n = fscanf(f, "alg=%d opslimit=%llu memlimit=%zu", &params.alg,
+                 &params.opslimit, &params.memlimit);
+  fclose(f);
+
+  if (n != 3 || !kdf_params_valid(&params)) {
+    log_message("%s is malformed, using default key derivation parameters.",
+                config_path);
+    return LOCKER_CRYPTO_KDF_DEFAULT_PARAMS;
+  }
+
+  return params;
+}
+
+void kdf_params_store(const char locker_dir[static 1],
+                      const locker_crypto_kdf_params_t params[static 1]) {
+  char config_path[PATH_MAX] = {0};
+  snprintf(config_path, PATH_MAX, "%s/%s", locker_dir,
+           LOCKER_KDF_CONFIG_FILENAME);
+
+  FILE *f = fopen(config_path, "w");
+  if (!f) {
+    perror("fopen");
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(f, "alg=%d\nopslimit=%llu\nmemlimit=%zu\n", params->alg,
+          params->opslimit, params->memlimit);
+  fclose(f);
+}
+
+static double time_derieve_key(const locker_crypto_kdf_params_t params[static 1]) {
+  unsigned char salt[LOCKER_CRYPTO_SALT_LEN];
+  locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  generate_salt(salt);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int rc = derieve_key("locker calibration", key, sizeof(key), salt, params);
+  double elapsed_ms = elapsed_ms_since(&start);
+
+  sodium_memzero(key, sizeof(key));
+  if (rc != 0) {
+    /* crypto_pwhash fails only when it cannot allocate memlimit bytes */
+    perror("derieve_key");
+    exit(EXIT_FAILURE);
+  }
+
+  return elapsed_ms;
+}
+
+/*
+ * Memory is raised first as it is what makes Argon2 expensive to attack, the
+ * remaining time budget then goes into passes. Argon2 cost is close to linear
+ * in both. The result never drops below the default parameters.
+ */
+locker_kdf_calibration_t kdf_calibrate(double target_ms, size_t max_memlimit) {
+  locker_crypto_kdf_params_t params = LOCKER_CRYPTO_KDF_DEFAULT_PARAMS;
+  params.opslimit = 1;
+
+  double elapsed_ms = time_derieve_key(&params);
+  while (params.memlimit <= max_memlimit / 2 && elapsed_ms * 2 <= target_ms) {
+    params.memlimit *= 2;
+    elapsed_ms = time_derieve_key(&params);
+  }
+
+  /* allocating and filling memory costs once, every extra pass adds the same */
+  params.opslimit = 2;
+  double pass_ms = time_derieve_key(&params) - elapsed_ms;
+  if (pass_ms <= 0)
+    pass_ms = elapsed_ms;
+  double setup_ms = elapsed_ms - pass_ms;
+
+  double passes = (target_ms - setup_ms) / pass_ms + 0.5;
+  params.opslimit = passes < 1 ? 1 : (unsigned long long)passes;
+  if (params.memlimit == crypto_pwhash_MEMLIMIT_INTERACTIVE &&
+      params.opslimit < crypto_pwhash_OPSLIMIT_INTERACTIVE) {
+    params.opslimit = crypto_pwhash_OPSLIMIT_INTERACTIVE;
+  } else if (params.opslimit < 1) {
+    params.opslimit = 1;
+  }
+
+  locker_kdf_calibration_t calibration = {.params = params};
+  calibration.elapsed_ms = time_derieve_key(&params);
+  calibration.throughput = (double)params.memlimit * params.opslimit /
+                           (1 << 20) / (calibration.elapsed_ms / 1e3);
+
+  return calibration;
+}
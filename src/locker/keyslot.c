@@ -0,0 +1,105 @@
+#include "locker_keyslot.h"
+#include "sodium/utils.h"
+#include <string.h>
+
+/*
+ * The slot type and the locker salt are the associated data of the wrapped
+ * key, so a slot cannot be copied into another locker or retyped.
+ */
+#define SLOT_AD_LEN (1 + LOCKER_CRYPTO_SALT_LEN)
+
+static void slot_ad(locker_key_slot_type_t type,
+                    const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN],
+                    unsigned char ad[SLOT_AD_LEN]) {
+  ad[0] = (unsigned char)type;
+  memcpy(ad + 1, locker_salt, LOCKER_CRYPTO_SALT_LEN);
+}
+
+static void seal_with_kek(locker_key_slot_t slot[static 1],
+                          const locker_crypto_masterkey_t kek[static 1],
+                          const locker_crypto_masterkey_t data_key[static 1],
+                          const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN]) {
+  unsigned char ad[SLOT_AD_LEN];
+  slot_ad(slot->type, locker_salt, ad);
+
+  generate_nonce(slot->nonce);
+  crypto_aead_xchacha20poly1305_ietf_encrypt(
+      slot->wrapped_key, NULL, data_key, LOCKER_CRYPTO_MASTER_KEY_LEN, ad,
+      sizeof(ad), NULL, slot->nonce, kek);
+}
+
+static bool open_with_kek(const locker_key_slot_t slot[static 1],
+                          const locker_crypto_masterkey_t kek[static 1],
+                          const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN],
+                          locker_crypto_masterkey_t data_key[static 1]) {
+  unsigned char ad[SLOT_AD_LEN];
+  slot_ad(slot->type, locker_salt, ad);
+
+  return crypto_aead_xchacha20poly1305_ietf_decrypt(
+             data_key, NULL, NULL, slot->wrapped_key, LOCKER_WRAPPED_KEY_LEN,
+             ad, sizeof(ad), slot->nonce, kek) == 0;
+}
+
+int key_slot_seal_passphrase(locker_key_slot_t slot[static 1],
+                             const char passphrase[static 1],
+                             const locker_crypto_kdf_params_t kdf[static 1],
+                             const locker_crypto_masterkey_t data_key[static 1],
+                             const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN]) {
+  locker_crypto_masterkey_t kek[LOCKER_CRYPTO_MASTER_KEY_LEN];
+
+  slot->type = LOCKER_KEY_SLOT_PASSPHRASE;
+  slot->kdf = *kdf;
+  generate_salt(slot->salt);
+  if (derieve_key(passphrase, kek, sizeof(kek), slot->salt, &slot->kdf) != 0)
+    return -1;
+
+  seal_with_kek(slot, kek, data_key, locker_salt);
+  sodium_memzero(kek, sizeof(kek));
+  return 0;
+}
+
+int key_slot_seal_keyfile(locker_key_slot_t slot[static 1],
+                          const unsigned char *keyfile, size_t keyfile_len,
+                          const locker_crypto_masterkey_t data_key[static 1],
+                          const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN]) {
+  locker_crypto_masterkey_t kek[LOCKER_CRYPTO_MASTER_KEY_LEN];
+
+  slot->type = LOCKER_KEY_SLOT_KEYFILE;
+  generate_salt(slot->salt);
+  if (derive_keyfile_key(keyfile, keyfile_len, kek, sizeof(kek), slot->salt) != 0)
+    return -1;
+
+  seal_with_kek(slot, kek, data_key, locker_salt);
+  sodium_memzero(kek, sizeof(kek));
+  return 0;
+}
+
+bool key_slot_open_passphrase(const locker_key_slot_t slot[static 1],
+                              const char passphrase[static 1],
+                              const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN],
+                              locker_crypto_masterkey_t data_key[static 1]) {
+  if (slot->type != LOCKER_KEY_SLOT_PASSPHRASE)
+    return false;
+
+  locker_crypto_masterkey_t kek[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  bool opened = derieve_key(passphrase, kek, sizeof(kek), slot->salt,
+                            &slot->kdf) == 0 &&
+                open_with_kek(slot, kek, locker_salt, data_key);
+  sodium_memzero(kek, sizeof(kek));
+  return opened;
+}
+
+bool key_slot_open_keyfile(const locker_key_slot_t slot[static 1],
+                           const unsigned char *keyfile, size_t keyfile_len,
+                           const unsigned char locker_salt[LOCKER_CRYPTO_SALT_LEN],
+                           locker_crypto_masterkey_t data_key[static 1]) {
+  if (slot->type != LOCKER_KEY_SLOT_KEYFILE)
+    return false;
+
+  locker_crypto_masterkey_t kek[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  bool opened = derive_keyfile_key(keyfile, keyfile_len, kek, sizeof(kek),
+                                   slot->salt) == 0 &&
+                open_with_kek(slot, kek, locker_salt, data_key);
+  sodium_memzero(kek, sizeof(kek));
+  return opened;
+}
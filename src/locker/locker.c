@@ -1,21 +1,37 @@
+/* pthread_rwlockattr_setkind_np on glibc */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include "locker.h"
 #include "attrs.h"
+#include "locker_account.h"
+#include "locker_cache.h"
 #include "locker_db.h"
+#include "locker_journal.h"
+#include "locker_kdf.h"
+#include "locker_keyslot.h"
 #include "locker_logs.h"
+#include "locker_manifest.h"
+#include "locker_prefetch.h"
+#include "locker_private.h"
+#include "locker_readers.h"
+#include "locker_saver.h"
 #include "locker_stringutils.h"
 #include "locker_utils.h"
+#include "locker_utils_private.h"
 #include "locker_version.h"
 #include "sodium/crypto_aead_xchacha20poly1305.h"
 #include "sodium/utils.h"
 #include <dirent.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/syslimits.h>
+#include <time.h>
 #include <unistd.h>
 
-#define LOCKER_MAGIC 0xCA80D4219AB3F102
-
 ATTR_NODISCARD ATTR_ALLOC char *
 generate_locker_filename(const char locker_name[static 1]) {
   char *locker_filename =
@@ -33,29 +49,59 @@ generate_locker_filename(const char locker_name[static 1]) {
   return locker_filename;
 }
 
-void write_locker_file(
-    const char locker_dir[static 1],
-    const char locker_name[static 1],
-    const locker_header_t header[static 1],
-    const unsigned char encrypted_buffer[static 1]
-) {
-
+void get_locker_filepath(char filepath[PATH_MAX], const char locker_dir[static 1],
+                        const char locker_name[static 1]) {
   char *locker_filename = generate_locker_filename(locker_name);
-  char locker_filepath[PATH_MAX] = {0};
-  snprintf(locker_filepath, PATH_MAX, "%s/lockers/%s", locker_dir, locker_filename);
+  snprintf(filepath, PATH_MAX, "%s/lockers/%s", locker_dir, locker_filename);
+  free(locker_filename);
+}
+
+void write_locker_header(const char filepath[static 1],
+                         const locker_header_t header[static 1]) {
+  unsigned char buffer[LOCKER_HEADER_SIZE];
+  header_serialize(header, buffer);
 
-  FILE *f = fopen(locker_filepath, "wb");
+  FILE *f = fopen(filepath, "wb");
   if (!f) {
     perror("fopen");
     exit(EXIT_FAILURE);
   }
-  fwrite(header, sizeof(locker_header_t), 1, f);
-  fwrite(encrypted_buffer, sizeof(unsigned char), header->locker_size, f);
-
-  free(locker_filename);
+  fwrite(buffer, sizeof(buffer), 1, f);
   fclose(f);
 }
 
+/* rewrites len bytes of the header in place, the body is left untouched */
+void update_locker_header_bytes(const char filepath[static 1], off_t offset,
+                                const unsigned char *bytes, size_t len) {
+  int fd = open(filepath, O_WRONLY);
+  if (fd < 0) {
+    perror("open");
+    exit(EXIT_FAILURE);
+  }
+
+  if (pwrite(fd, bytes, len, offset) != (ssize_t)len || fsync(fd) != 0) {
+    perror("pwrite");
+    exit(EXIT_FAILURE);
+  }
+  close(fd);
+}
+
+void update_locker_header(const char filepath[static 1],
+                          const locker_header_t header[static 1]) {
+  unsigned char buffer[LOCKER_HEADER_SIZE];
+  header_serialize(header, buffer);
+  update_locker_header_bytes(filepath, 0, buffer, sizeof(buffer));
+}
+
+void update_locker_key_slot(const char filepath[static 1],
+                            const locker_header_t header[static 1], int slot) {
+  unsigned char buffer[LOCKER_KEY_SLOT_SIZE];
+  key_slot_serialize(&header->key_slots[slot], buffer);
+  update_locker_header_bytes(
+      filepath, LOCKER_KEY_SLOTS_OFFSET + slot * LOCKER_KEY_SLOT_SIZE, buffer,
+      sizeof(buffer));
+}
+
 locker_result_t locker_create(
     const char locker_dir[static 1],
     const char locker_name[static 1],
@@ -63,7 +109,7 @@ locker_result_t locker_create(
 ) {
   locker_header_t header = {0};
   header.file_version = LOCKER_FILE_VERSION;
-  header.magic = LOCKER_MAGIC;
+  header.data_offset = LOCKER_HEADER_SIZE;
 
   if (!str_alphnum(locker_name)) {
     log_message("Locker name must contain only alpha numeric characters!");
@@ -85,9 +131,11 @@ locker_result_t locker_create(
 
   locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN];
   generate_salt(header.salt);
+  generate_key(key);
 
-  int rc =
-      derieve_key(passphrase, key, LOCKER_CRYPTO_MASTER_KEY_LEN, header.salt);
+  locker_crypto_kdf_params_t kdf = kdf_params_load(locker_dir);
+  int rc = key_slot_seal_passphrase(&header.key_slots[0], passphrase, &kdf,
+                                    key, header.salt);
   if (rc != 0) {
     /* TODO: handle it more gently - currently I'm not sure what error is thrown
      * in each situation */
@@ -96,32 +144,33 @@ locker_result_t locker_create(
     exit(EXIT_FAILURE);
   }
 
-  sqlite3 *db = get_empty_db();
-  initdb(db);
-
-  unsigned char *serialized_db;
-  long long db_size = db_dump(db, &serialized_db);
-
-  if (db_size < 0) {
-    log_message("Negative database size. WTF");
-    exit(EXIT_FAILURE);
+  char filepath[PATH_MAX] = {0};
+  get_locker_filepath(filepath, locker_dir, locker_name);
+  write_locker_header(filepath, &header);
+
+  /* a journal left behind by a previous locker of the same name is stale */
+  char journal_path[PATH_MAX] = {0};
+  journal_filepath(journal_path, sizeof(journal_path), filepath);
+  unlink(journal_path);
+
+  locker_result_t result;
+  sqlite3 *db = get_locker_db(filepath, header.data_offset, key, &result);
+  if (!db) {
+    sodium_memzero(key, sizeof(key));
+    log_message("Could not open freshly created locker %s.", filepath);
+    unlink(filepath);
+    return LOCKER_DB_ERROR;
   }
 
-  generate_nonce(header.nonce);
-
-  unsigned char *encrypted_db =
-      malloc(sizeof(unsigned char) *
-             (db_size + crypto_aead_xchacha20poly1305_IETF_ABYTES));
-
-  crypto_aead_xchacha20poly1305_ietf_encrypt(encrypted_db, &header.locker_size,
-                                             serialized_db, db_size, NULL, 0,
-                                             NULL, header.nonce, key);
-
-  write_locker_file(locker_dir, locker_name, &header, encrypted_db);
-
-  free(encrypted_db);
-  sqlite3_free(serialized_db);
+  bool ok = db_begin(db) && initdb(db) && db_commit(db);
   db_close(db);
+  sodium_memzero(key, sizeof(key));
+  if (!ok) {
+    /* a locker without its tables could never be opened */
+    unlink(filepath);
+    return LOCKER_DB_ERROR;
+  }
+
   return LOCKER_OK;
 }
 
@@ -150,11 +199,7 @@ array_str_t *locker_files_lookup(const char path[static 1]) {
   while ((entry = readdir(dir)) != NULL) {
     if (entry->d_type == DT_DIR)
       continue;
-    if (has_extension(entry->d_name, ".locker")) {
-        if (filenames->count >= LOCKER_MAX_LOCKER_FILE_NUMBER) {
-          /* do not allow for cap overflow if there are somehow to many files */
-          break;
-        }
+    if (has_extension(entry->d_name, LOCKER_FILE_EXTENSION)) {
         locker_array_append(filenames, strdup(entry->d_name));
     }
   }
@@ -164,18 +209,17 @@ array_str_t *locker_files_lookup(const char path[static 1]) {
 }
 
 ATTR_NODISCARD ATTR_ALLOC locker_header_t *
-read_locker_header(const char filename[static 1]) {
-  FILE *f = fopen(filename, "rb");
-  if (!f) {
-    /*should not happen as check for locker files is done before */
-    perror("fopen");
-    exit(EXIT_FAILURE);
-  }
+read_locker_header(FILE *f, const char filename[static 1]) {
+  unsigned char buffer[LOCKER_HEADER_SIZE];
+  size_t len = fread(buffer, 1, sizeof(buffer), f);
 
   locker_header_t *header = malloc(sizeof(locker_header_t));
-  fread(header, sizeof(locker_header_t), 1, f);
+  if (!header) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
 
-  if (header->magic != LOCKER_MAGIC) {
+  if (!header_parse(buffer, len, header)) {
     log_message("%s file header is malformed. Locker Magic does not match.",
                 filename);
     free(header);
@@ -185,80 +229,313 @@ read_locker_header(const char filename[static 1]) {
   return header;
 }
 
-ATTR_ALLOC ATTR_NODISCARD
-array_str_t *lockers_list(const char locker_dir[static 1]) {
-  char lockers_path[PATH_MAX] = {0};
-  snprintf(lockers_path, PATH_MAX, "%s/%s", locker_dir, "lockers");
+ATTR_ALLOC ATTR_NODISCARD array_locker_manifest_entry_t *
+scan_lockers(const char lockers_path[static 1]) {
   array_str_t *locker_files = locker_files_lookup(lockers_path);
 
   if (!locker_files) {
     exit(EXIT_FAILURE);
   }
 
-  array_str_t *lockers = malloc(sizeof(array_str_t));
-  init_item_array(lockers);
-
-  if (locker_files->count == 0) {
-    locker_array_t_free(locker_files, free);
-    return lockers;
+  array_locker_manifest_entry_t *entries =
+      malloc(sizeof(array_locker_manifest_entry_t));
+  if (!entries) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
   }
+  init_item_array(entries);
 
   for (size_t i = 0; i < locker_files->count; i++) {
     char locker_filepath[PATH_MAX] = {0};
     snprintf(locker_filepath, PATH_MAX, "%s/%s", lockers_path, locker_files->values[i]);
-    locker_header_t *header = read_locker_header(locker_filepath);
+
+    FILE *f = fopen(locker_filepath, "rb");
+    if (!f) {
+      /* removed between readdir and now */
+      continue;
+    }
+
+    struct stat st;
+    fstat(fileno(f), &st);
+    locker_header_t *header = read_locker_header(f, locker_filepath);
+    fclose(f);
+
     if (!header) {
       continue;
     }
-    locker_array_append(lockers, strdup(header->locker_name));
+
+    locker_manifest_entry_t entry = {
+        .filename = strdup(locker_files->values[i]),
+        .locker_name = strdup(header->locker_name),
+        .size = (long long)st.st_size,
+        .mtime = (long long)st.st_mtime,
+    };
+    locker_array_append(entries, entry);
     free(header);
   }
 
   locker_array_t_free(locker_files, free);
-  return lockers;
+  free(locker_files);
+  return entries;
 }
 
-locker_result_t locker_open(locker_t **locker, const char locker_dir[static 1], const char locker_name[static 1], const char passphrase[static 1]) {
-  const char *filename = generate_locker_filename(locker_name);
-  char filepath[PATH_MAX] = {0};
-  snprintf(filepath, PATH_MAX, "%s/lockers/%s", locker_dir, filename);
+/*
+ * Locker names come from the manifest as long as the lockers directory mtime
+ * did not move, so listing does not open a single locker file. Only a change
+ * to the directory (a locker added, removed or renamed) triggers a rescan.
+ */
+ATTR_ALLOC ATTR_NODISCARD
+array_str_t *lockers_list(const char locker_dir[static 1]) {
+  char lockers_path[PATH_MAX] = {0};
+  snprintf(lockers_path, PATH_MAX, "%s/%s", locker_dir, "lockers");
 
-  FILE *f = fopen(filepath, "rb");
-  if (!f) {
-    perror("fopen");
+  struct stat dir_st;
+  if (stat(lockers_path, &dir_st) != 0) {
+    perror("stat");
+    exit(EXIT_FAILURE);
+  }
+  long long dir_mtime = (long long)dir_st.st_mtime;
+
+  array_locker_manifest_entry_t *entries = manifest_load(locker_dir, dir_mtime);
+  if (!entries) {
+    entries = scan_lockers(lockers_path);
+
+    /*
+     * mtime has a one second granularity, a directory changed within the
+     * current second could change again unnoticed - do not trust it yet
+     */
+    long long stored_mtime = dir_mtime >= (long long)time(NULL) - 1 ? -1 : dir_mtime;
+    manifest_store(locker_dir, stored_mtime, entries);
+  }
+
+  array_str_t *lockers = malloc(sizeof(array_str_t));
+  if (!lockers) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  init_item_array(lockers);
+
+  for (size_t i = 0; i < entries->count; i++) {
+    locker_array_append(lockers, strdup(entries->values[i].locker_name));
+  }
+
+  locker_array_t_free(entries, manifest_free_entry);
+  free(entries);
+  return lockers;
+}
+
+/*
+ * Version 1 files keep the whole database as a single AEAD message. It is
+ * authenticated in a first pass and decrypted in a second one, chunk by chunk,
+ * straight into a file of the current version, so neither the ciphertext nor
+ * the plaintext is ever held in memory as a whole.
+ */
+locker_result_t migrate_v1_locker(const char filepath[static 1], FILE *f,
+                                  locker_header_t header[static 1],
+                                  const locker_crypto_masterkey_t key[static 1]) {
+  if (header->locker_size < crypto_aead_xchacha20poly1305_IETF_ABYTES) {
     return LOCKER_INVALID_LOCKER_FILE;
   }
 
-  locker_header_t *header = malloc(sizeof(locker_header_t));
-  if (!header) {
+  unsigned long long body_len =
+      header->locker_size - crypto_aead_xchacha20poly1305_IETF_ABYTES;
+  off_t body_offset = header->data_offset;
+  fseeko(f, body_offset, SEEK_SET);
+
+  unsigned char *chunk = malloc(LOCKER_CRYPTO_STREAM_CHUNK_LEN);
+  unsigned char *plain_chunk = malloc(LOCKER_CRYPTO_STREAM_CHUNK_LEN);
+  if (!chunk || !plain_chunk) {
     perror("malloc");
     exit(EXIT_FAILURE);
   }
 
-  fread(header, sizeof(locker_header_t), 1, f);
+  locker_crypto_aead_stream_t stream;
+  aead_stream_init(&stream, header->nonce, key);
+
+  for (unsigned long long done = 0; done < body_len;) {
+    size_t n = body_len - done < LOCKER_CRYPTO_STREAM_CHUNK_LEN
+                   ? body_len - done
+                   : LOCKER_CRYPTO_STREAM_CHUNK_LEN;
+    if (fread(chunk, 1, n, f) != n) {
+      free(chunk);
+      free(plain_chunk);
+      aead_stream_wipe(&stream);
+      return LOCKER_INVALID_LOCKER_FILE;
+    }
+    aead_stream_authenticate(&stream, chunk, n);
+    done += n;
+  }
 
-  if (header->magic != LOCKER_MAGIC) {
-    free(header);
-    fclose(f);
+  unsigned char tag[crypto_aead_xchacha20poly1305_IETF_ABYTES];
+  if (fread(tag, 1, sizeof(tag), f) != sizeof(tag) ||
+      !aead_stream_verify(&stream, tag)) {
+    free(chunk);
+    free(plain_chunk);
+    aead_stream_wipe(&stream);
+    return LOCKER_INVALID_PASSPRHRASE;
+  }
 
-    log_message("%s file header is malformed. Locker Magic does not match.",
-                filename);
+  char migrated_filepath[PATH_MAX] = {0};
+  snprintf(migrated_filepath, PATH_MAX, "%s.migrating", filepath);
+
+  header->file_version = LOCKER_FILE_VERSION_KEY_SLOTS;
+  header->data_offset = LOCKER_HEADER_SIZE;
+  header->locker_size = 0;
+  memset(header->nonce, 0, LOCKER_CRYPTO_NONCE_LEN);
+  write_locker_header(migrated_filepath, header);
+
+  locker_result_t result;
+  sqlite3 *db = get_locker_db(migrated_filepath, header->data_offset, key,
+                              &result);
+  bool written = db != NULL;
+
+  /* version 1 body is a serialized sqlite database, i.e. a raw file image */
+  fseeko(f, body_offset, SEEK_SET);
+  for (unsigned long long done = 0; written && done < body_len;) {
+    size_t n = body_len - done < LOCKER_CRYPTO_STREAM_CHUNK_LEN
+                   ? body_len - done
+                   : LOCKER_CRYPTO_STREAM_CHUNK_LEN;
+    if (fread(chunk, 1, n, f) != n) {
+      perror("fread");
+      exit(EXIT_FAILURE);
+    }
+    aead_stream_decrypt(&stream, plain_chunk, chunk, n, done);
+    written = db_write_raw(db, done, n, plain_chunk);
+    done += n;
+  }
 
-    return LOCKER_MALFORMED_HEADER;
+  sodium_memzero(plain_chunk, LOCKER_CRYPTO_STREAM_CHUNK_LEN);
+  free(plain_chunk);
+  free(chunk);
+  aead_stream_wipe(&stream);
+  if (db)
+    db_close(db);
+
+  if (!written) {
+    /* the original file is untouched, the migration runs again next time */
+    log_message("Could not write migrated locker %s.", migrated_filepath);
+    unlink(migrated_filepath);
+    return LOCKER_DB_ERROR;
   }
 
-  *locker = malloc(sizeof(locker_t));
-  if (!(*locker)) {
+  if (rename(migrated_filepath, filepath) != 0) {
+    perror("rename");
+    exit(EXIT_FAILURE);
+  }
+
+  log_message("%s migrated to locker file version %d.", filepath,
+              LOCKER_FILE_VERSION_KEY_SLOTS);
+  return LOCKER_OK;
+}
+
+/*
+ * Version 2 files differ only by the raw, platform dependent header struct.
+ * Page frames do not depend on their file offset, so they are copied as is.
+ */
+void migrate_v2_locker(const char filepath[static 1], FILE *f,
+                       locker_header_t header[static 1]) {
+  char migrated_filepath[PATH_MAX] = {0};
+  snprintf(migrated_filepath, PATH_MAX, "%s.migrating", filepath);
+
+  fseeko(f, header->data_offset, SEEK_SET);
+
+  header->file_version = LOCKER_FILE_VERSION_KEY_SLOTS;
+  header->data_offset = LOCKER_HEADER_SIZE;
+  write_locker_header(migrated_filepath, header);
+
+  FILE *out = fopen(migrated_filepath, "ab");
+  if (!out) {
+    perror("fopen");
+    exit(EXIT_FAILURE);
+  }
+
+  unsigned char *chunk = malloc(LOCKER_CRYPTO_STREAM_CHUNK_LEN);
+  if (!chunk) {
     perror("malloc");
     exit(EXIT_FAILURE);
   }
 
-  strncpy((*locker)->locker_name, locker_name, LOCKER_NAME_MAX_LEN);
-  /* should read at most LOCKER_NAME_MAX_LEN chars */
-  (*locker)->_header = header;
+  size_t n;
+  while ((n = fread(chunk, 1, LOCKER_CRYPTO_STREAM_CHUNK_LEN, f)) > 0) {
+    if (fwrite(chunk, 1, n, out) != n) {
+      perror("fwrite");
+      exit(EXIT_FAILURE);
+    }
+  }
+  free(chunk);
+
+  if (fclose(out) != 0 || rename(migrated_filepath, filepath) != 0) {
+    perror("rename");
+    exit(EXIT_FAILURE);
+  }
+
+  log_message("%s migrated to locker file version %d.", filepath,
+              LOCKER_FILE_VERSION_KEY_SLOTS);
+}
+
+/* false when nothing was folded in, the journal is then kept as it is */
+bool compact_locker(locker_t locker[static 1]) {
+  sqlite3 *conn = locker->_db->conn;
+
+  /*
+   * base snapshot remembers the last folded record, so a crash between the
+   * commit and the truncate only makes the next replay skip those records
+   */
+  if (db_set_meta(locker->_db, "journal_seq", locker->_journal->seq) &&
+      db_commit(conn)) {
+    /* a journal left in place only has records the next replay skips */
+    journal_truncate(locker->_journal);
+    return db_begin(conn);
+  }
+
+  if (!sqlite3_get_autocommit(conn))
+    return false;
+
+  /*
+   * the failed commit rolled back every edit since the last compaction, they
+   * are all still in the journal and go back in the way an open replays them
+   */
+  sqlite_int64 applied_seq;
+  if (db_begin(conn) &&
+      db_get_meta(locker->_db, "journal_seq", &applied_seq) &&
+      journal_replay(locker->_journal, locker->_db, applied_seq))
+    log_message("Locker save failed, edits stay in the journal.");
+  else
+    log_message("Locker save failed and edits since the last save are only "
+                "in the journal until the locker is opened again.");
+  return false;
+}
 
-  int rc = derieve_key(passphrase, (*locker)->_key, LOCKER_CRYPTO_MASTER_KEY_LEN,
-                       header->salt);
+/* runs on the saver thread */
+bool save_job(void *arg) {
+  locker_t *locker = arg;
+  bool saved = true;
+
+  pthread_rwlock_wrlock(locker->_lock);
+  /* changes are durable once journaled, fold them in only past the threshold */
+  if (locker->_journal->size >= LOCKER_JOURNAL_COMPACT_THRESHOLD) {
+    saved = compact_locker(locker);
+    /* committed, or rolled back and replayed, the file changed under readers */
+    readers_invalidate(locker->_readers);
+  }
+  pthread_rwlock_unlock(locker->_lock);
+
+  return saved;
+}
+
+/*
+ * Before version 4 the passphrase derived key encrypted the body directly. It
+ * is kept as the data key and wrapped into the first passphrase slot, so no
+ * page has to be re-encrypted.
+ */
+locker_result_t upgrade_legacy_locker(const char filepath[static 1], FILE *f,
+                                      locker_header_t header[static 1],
+                                      const char passphrase[static 1],
+                                      locker_crypto_masterkey_t key[static 1]) {
+  /* lockers without key slots always paid the default cost */
+  locker_crypto_kdf_params_t kdf = LOCKER_CRYPTO_KDF_DEFAULT_PARAMS;
+  int rc = derieve_key(passphrase, key, LOCKER_CRYPTO_MASTER_KEY_LEN,
+                       header->salt, &kdf);
   if (rc != 0) {
     /* TODO: handle it more gently - currently I'm not sure what error is
      * thrown in each situation */
@@ -267,88 +544,572 @@ locker_result_t locker_open(locker_t **locker, const char locker_dir[static 1],
     exit(EXIT_FAILURE);
   }
 
-  unsigned char *encrypted_db =
-      malloc(sizeof(unsigned char) * header->locker_size);
-  if (!encrypted_db) {
-    perror("malloc");
+  /* version 1 body is authenticated by the migration itself */
+  if (header->file_version != 1) {
+    locker_result_t result;
+    sqlite3 *db = get_locker_db(filepath, header->data_offset, key, &result);
+    if (!db) {
+      return result;
+    }
+    db_close(db);
+  }
+
+  memset(header->key_slots, 0, sizeof(header->key_slots));
+  if (key_slot_seal_passphrase(&header->key_slots[0], passphrase, &kdf, key,
+                               header->salt) != 0) {
+    perror("key_slot_seal_passphrase");
     exit(EXIT_FAILURE);
   }
 
-  fread(encrypted_db, 1, header->locker_size, f);
+  if (header->file_version == 1) {
+    return migrate_v1_locker(filepath, f, header, key);
+  }
+
+  if (header->file_version == 2) {
+    migrate_v2_locker(filepath, f, header);
+    return LOCKER_OK;
+  }
+
+  header->file_version = LOCKER_FILE_VERSION_KEY_SLOTS;
+  update_locker_header(filepath, header);
+  log_message("%s migrated to locker file version %d.", filepath,
+              LOCKER_FILE_VERSION_KEY_SLOTS);
+  return LOCKER_OK;
+}
+
+/* exactly one of passphrase and keyfile is set */
+typedef struct {
+  const char *passphrase;
+  const unsigned char *keyfile;
+  size_t keyfile_len;
+} locker_secret_t;
+
+int unlock_key_slots(const locker_header_t header[static 1],
+                     const locker_secret_t secret[static 1],
+                     locker_crypto_masterkey_t key[static 1]) {
+  for (int i = 0; i < LOCKER_KEY_SLOTS; i++) {
+    const locker_key_slot_t *slot = &header->key_slots[i];
+    bool opened =
+        secret->passphrase
+            ? key_slot_open_passphrase(slot, secret->passphrase, header->salt,
+                                       key)
+            : key_slot_open_keyfile(slot, secret->keyfile,
+                                    secret->keyfile_len, header->salt, key);
+    if (opened)
+      return i;
+  }
+
+  return -1;
+}
+
+/*
+ * Reads the header of the locker file and recovers its data key with the
+ * given secret, upgrading lockers of older versions on the way.
+ */
+locker_result_t unlock_locker_file(const char filepath[static 1],
+                                   const locker_secret_t secret[static 1],
+                                   locker_header_t **header,
+                                   locker_crypto_masterkey_t key[static 1],
+                                   int *slot) {
+  FILE *f = fopen(filepath, "rb");
+  if (!f) {
+    perror("fopen");
+    return LOCKER_INVALID_LOCKER_FILE;
+  }
+
+  *header = read_locker_header(f, filepath);
+  if (!(*header)) {
+    fclose(f);
+    return LOCKER_MALFORMED_HEADER;
+  }
+
+  locker_result_t result = LOCKER_OK;
+  if ((*header)->file_version > LOCKER_FILE_VERSION) {
+    log_message("%s was written by a newer Locker (file version %u).",
+                filepath, (*header)->file_version);
+    result = LOCKER_MALFORMED_HEADER;
+  } else if ((*header)->file_version < LOCKER_FILE_VERSION_KEY_SLOTS) {
+    /* older lockers have no key slots, only the passphrase can open them */
+    result = secret->passphrase
+                 ? upgrade_legacy_locker(filepath, f, *header,
+                                         secret->passphrase, key)
+                 : LOCKER_INVALID_KEYFILE;
+    *slot = 0;
+  } else {
+    *slot = unlock_key_slots(*header, secret, key);
+    if (*slot < 0) {
+      result = secret->passphrase ? LOCKER_INVALID_PASSPRHRASE
+                                  : LOCKER_INVALID_KEYFILE;
+    }
+  }
   fclose(f);
 
-  unsigned char *decrypted_db =
-      malloc(sizeof(unsigned char) * header->locker_size -
-             crypto_aead_xchacha20poly1305_IETF_ABYTES);
-  if (!decrypted_db) {
-    perror("malloc");
+  if (result == LOCKER_INVALID_PASSPRHRASE) {
+    log_message("Given passphrase does not match original one.");
+  } else if (result == LOCKER_INVALID_KEYFILE) {
+    log_message("Given keyfile does not unlock %s.", filepath);
+  }
+
+  if (result != LOCKER_OK) {
+    sodium_memzero(key, LOCKER_CRYPTO_MASTER_KEY_LEN);
+    free(*header);
+    *header = NULL;
+  }
+
+  return result;
+}
+
+locker_result_t read_keyfile(const char keyfile_path[static 1],
+                             unsigned char keyfile[LOCKER_KEYFILE_MAX_LEN],
+                             size_t *keyfile_len) {
+  FILE *f = fopen(keyfile_path, "rb");
+  if (!f) {
+    perror("fopen");
+    return LOCKER_INVALID_KEYFILE;
+  }
+
+  *keyfile_len = fread(keyfile, 1, LOCKER_KEYFILE_MAX_LEN, f);
+  bool too_long = fgetc(f) != EOF;
+  fclose(f);
+
+  if (too_long || *keyfile_len < LOCKER_KEYFILE_MIN_LEN) {
+    log_message("Keyfile %s must hold between %d and %d bytes.", keyfile_path,
+                LOCKER_KEYFILE_MIN_LEN, LOCKER_KEYFILE_MAX_LEN);
+    sodium_memzero(keyfile, LOCKER_KEYFILE_MAX_LEN);
+    return LOCKER_INVALID_KEYFILE;
+  }
+
+  return LOCKER_OK;
+}
+
+/* keeps the in-memory key indexes in step with the items table */
+static void index_item(const locker_t locker[static 1], sqlite_int64 item_id,
+                       const char key[static 1], locker_item_type_t item_type) {
+  trie_insert(locker->_index, key, item_id, item_type);
+  fuzzy_add(locker->_fuzzy, key, item_id, item_type);
+}
+
+/* takes ownership of key, the one the item was indexed under */
+static void unindex_item(const locker_t locker[static 1], sqlite_int64 item_id,
+                         char *key) {
+  if (key) {
+    trie_remove(locker->_index, key);
+    free(key);
+  }
+  fuzzy_remove(locker->_fuzzy, item_id);
+}
+
+static off_t file_size(const char filepath[static 1]) {
+  struct stat st;
+  return stat(filepath, &st) == 0 ? st.st_size : 0;
+}
+
+/*
+ * Accounts written before version 5 take the whole fixed field layout. They
+ * are rewritten and committed together with the replayed journal before the
+ * header is bumped, so an interrupted migration simply runs again.
+ */
+static bool migrate_account_content(locker_t locker[static 1],
+                                    const char filepath[static 1]) {
+  off_t size_before = file_size(filepath);
+
+  size_t n_accounts;
+  sqlite3_int64 bytes_before, bytes_after;
+  if (!db_compact_accounts(locker->_db->conn, &n_accounts, &bytes_before,
+                           &bytes_after) ||
+      !compact_locker(locker))
+    return false;
+
+  /* give the freed pages back, the file would only reuse them otherwise */
+  if (!db_commit(locker->_db->conn))
+    return false;
+  char *errmsg = NULL;
+  if (sqlite3_exec(locker->_db->conn, "VACUUM;", NULL, NULL, &errmsg) !=
+      SQLITE_OK) {
+    log_message("VACUUM failed, freed pages stay in the locker: %s", errmsg);
+    sqlite3_free(errmsg);
+  }
+  if (!db_begin(locker->_db->conn))
+    return false;
+
+  locker->_header->file_version = LOCKER_FILE_VERSION_COMPACT_ACCOUNTS;
+  update_locker_header(filepath, locker->_header);
+
+  off_t size_after = file_size(filepath);
+  log_message("%s migrated to locker file version %d: re-encoded %zu accounts "
+              "from %lld to %lld bytes, file shrank from %lld to %lld bytes "
+              "(saved %lld).",
+              filepath, LOCKER_FILE_VERSION_COMPACT_ACCOUNTS, n_accounts,
+              (long long)bytes_before, (long long)bytes_after,
+              (long long)size_before, (long long)size_after,
+              (long long)(size_before - size_after));
+  return true;
+}
+
+/*
+ * Opens the body of an unlocked locker, brings it up to date and builds the
+ * key indexes from it. Leaves nothing behind when it fails.
+ */
+static locker_result_t load_locker(locker_t locker[static 1],
+                                   const char filepath[static 1]) {
+  locker_header_t *header = locker->_header;
+
+  /* taken first, a second handle stops here instead of on a locked database */
+  locker_result_t result;
+  locker->_journal = journal_open(filepath, header->salt, locker->_key, &result);
+  if (!locker->_journal)
+    return result;
+
+  sqlite3 *db = get_locker_db(filepath, header->data_offset, locker->_key,
+                              &result);
+  if (!db) {
+    if (result == LOCKER_INVALID_PASSPRHRASE) {
+      /* key slot opened fine, so the pages themselves do not verify */
+      log_message("%s body failed to verify.", filepath);
+      result = LOCKER_INVALID_LOCKER_FILE;
+    }
+    journal_close(locker->_journal);
+    return result;
+  }
+
+  /*
+   * edits stay in the page cache until the journal is compacted, the journal
+   * itself is what makes them durable in the meantime
+   */
+  if (!db_migrate(db) || !db_begin(db) ||
+      !(locker->_db = db_prepare_statements(db))) {
+    db_close(db);
+    journal_close(locker->_journal);
+    return LOCKER_DB_ERROR;
+  }
+
+  sqlite_int64 applied_seq;
+  if (!db_get_meta(locker->_db, "journal_seq", &applied_seq) ||
+      !journal_replay(locker->_journal, locker->_db, applied_seq))
+    goto failed;
+
+  if (header->file_version < LOCKER_FILE_VERSION_COMPACT_ACCOUNTS &&
+      !migrate_account_content(locker, filepath))
+    goto failed;
+
+  /* the key indexes only live in memory and are rebuilt on every open */
+  locker->_index = trie_new();
+  locker->_fuzzy = fuzzy_new();
+  locker_item_list_t list;
+  locker_item_list_init(&list);
+  bool listed = db_list_items(locker->_db, "", &list);
+  for (size_t i = 0; listed && i < list.items.count; i++) {
+    index_item(locker, list.items.values[i].id, list.items.values[i].key,
+               list.items.values[i].type);
+  }
+  locker_item_list_free(&list);
+
+  if (listed)
+    return LOCKER_OK;
+
+  trie_free(locker->_index);
+  fuzzy_free(locker->_fuzzy);
+failed:
+  /* the open transaction rolls back, the journal still has every edit */
+  journal_close(locker->_journal);
+  db_finalize_statements(locker->_db);
+  db_close(db);
+  return LOCKER_DB_ERROR;
+}
+
+locker_result_t locker_open_with(locker_t **locker,
+                                 const char locker_dir[static 1],
+                                 const char locker_name[static 1],
+                                 const locker_secret_t secret[static 1]) {
+  char filepath[PATH_MAX] = {0};
+  get_locker_filepath(filepath, locker_dir, locker_name);
+
+  /* guarded and locked, the data key lives in here */
+  *locker = sodium_malloc(sizeof(locker_t));
+  if (!(*locker)) {
+    perror("sodium_malloc");
     exit(EXIT_FAILURE);
   }
-  unsigned long long decrypted_len = 0;
 
-  rc = crypto_aead_xchacha20poly1305_ietf_decrypt(decrypted_db, &decrypted_len, NULL, encrypted_db, header->locker_size, NULL, 0, header->nonce, (*locker)->_key);
-  free(encrypted_db);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
-  if (rc != 0) {
-    log_message("Given passphrase does not match original one.");
-    free(decrypted_db);
+  /* disk reads run on a worker while this thread is busy in Argon2 */
+  locker_prefetch_t *prefetch = prefetch_start(filepath);
+
+  int slot;
+  locker_result_t result = unlock_locker_file(
+      filepath, secret, &(*locker)->_header, (*locker)->_key, &slot);
+  double unlock_ms = elapsed_ms_since(&start);
+
+  double prefetch_ms = prefetch_finish(prefetch);
+  double ready_ms = elapsed_ms_since(&start);
+
+  if (result != LOCKER_OK) {
+    sodium_free(*locker);
+    *locker = NULL;
+    return result;
+  }
+
+  strncpy((*locker)->locker_name, locker_name, LOCKER_NAME_MAX_LEN);
+  /* should read at most LOCKER_NAME_MAX_LEN chars */
+  (*locker)->locker_name[LOCKER_NAME_MAX_LEN] = '\0';
+
+  result = load_locker(*locker, filepath);
+  if (result != LOCKER_OK) {
     free((*locker)->_header);
-    free(*locker);
+    sodium_free(*locker);
+    *locker = NULL;
+    return result;
+  }
 
-    return LOCKER_INVALID_PASSPRHRASE;
+  (*locker)->_lock = malloc(sizeof(pthread_rwlock_t));
+  if (!(*locker)->_lock) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
   }
+  pthread_rwlockattr_t lock_attr;
+  pthread_rwlockattr_init(&lock_attr);
+#ifdef __GLIBC__
+  /* glibc lets a steady stream of lookups hold off a write forever otherwise */
+  pthread_rwlockattr_setkind_np(&lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+  pthread_rwlock_init((*locker)->_lock, &lock_attr);
+  pthread_rwlockattr_destroy(&lock_attr);
+  locker_vfs_params_t params = {.data_offset = (*locker)->_header->data_offset,
+                                .key = (*locker)->_key};
+  (*locker)->_readers = readers_new((*locker)->_db, filepath, &params);
+  (*locker)->_saver = saver_start(save_job, *locker);
+  (*locker)->_cache = cache_new();
+
+  /* run back to back, key derivation and prefetch would take their sum */
+  log_message("Unlocked %s in %.1f ms: key derivation %.1f ms, prefetch %.1f "
+              "ms, overlap saved %.1f ms.",
+              filepath, elapsed_ms_since(&start), unlock_ms, prefetch_ms,
+              unlock_ms + prefetch_ms - ready_ms);
 
-  sqlite3 *db = get_db(decrypted_len, decrypted_db);
-  /* do not free decrypted_db buffer as it ownership was given to sqlite db */
-  (*locker)->_db = db;
+  return LOCKER_OK;
+}
+
+locker_result_t locker_open(locker_t **locker, const char locker_dir[static 1], const char locker_name[static 1], const char passphrase[static 1]) {
+  locker_secret_t secret = {.passphrase = passphrase};
+  return locker_open_with(locker, locker_dir, locker_name, &secret);
+}
+
+locker_result_t locker_open_keyfile(locker_t **locker,
+                                    const char locker_dir[static 1],
+                                    const char locker_name[static 1],
+                                    const char keyfile_path[static 1]) {
+  unsigned char keyfile[LOCKER_KEYFILE_MAX_LEN];
+  locker_secret_t secret = {.keyfile = keyfile};
+
+  locker_result_t result =
+      read_keyfile(keyfile_path, keyfile, &secret.keyfile_len);
+  if (result == LOCKER_OK) {
+    result = locker_open_with(locker, locker_dir, locker_name, &secret);
+  }
 
+  sodium_memzero(keyfile, sizeof(keyfile));
+  return result;
+}
+
+/* only the key slot that matched the old passphrase is rewritten */
+locker_result_t locker_change_passphrase(const char locker_dir[static 1],
+                                         const char locker_name[static 1],
+                                         const char old_passphrase[static 1],
+                                         const char new_passphrase[static 1]) {
+  char filepath[PATH_MAX] = {0};
+  get_locker_filepath(filepath, locker_dir, locker_name);
+
+  locker_secret_t secret = {.passphrase = old_passphrase};
+  locker_header_t *header;
+  locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  int slot;
+
+  locker_result_t result =
+      unlock_locker_file(filepath, &secret, &header, key, &slot);
+  if (result != LOCKER_OK) {
+    return result;
+  }
+
+  /* the new slot picks up the currently calibrated cost */
+  locker_crypto_kdf_params_t kdf = kdf_params_load(locker_dir);
+  if (key_slot_seal_passphrase(&header->key_slots[slot], new_passphrase, &kdf,
+                               key, header->salt) != 0) {
+    perror("key_slot_seal_passphrase");
+    exit(EXIT_FAILURE);
+  }
+  update_locker_key_slot(filepath, header, slot);
+
+  sodium_memzero(key, sizeof(key));
+  free(header);
   return LOCKER_OK;
 }
 
-locker_result_t save_locker(locker_t locker[static 1], const char locker_dir[static 1]) {
-    unsigned char *serialized_db;
-    sqlite3_int64 db_size = db_dump(locker->_db, &serialized_db);
+locker_result_t locker_add_keyfile(const char locker_dir[static 1],
+                                   const char locker_name[static 1],
+                                   const char passphrase[static 1],
+                                   const char keyfile_path[static 1]) {
+  unsigned char keyfile[LOCKER_KEYFILE_MAX_LEN];
+  size_t keyfile_len;
+
+  locker_result_t result = read_keyfile(keyfile_path, keyfile, &keyfile_len);
+  if (result != LOCKER_OK) {
+    return result;
+  }
+
+  char filepath[PATH_MAX] = {0};
+  get_locker_filepath(filepath, locker_dir, locker_name);
+
+  locker_secret_t secret = {.passphrase = passphrase};
+  locker_header_t *header;
+  locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  int slot;
 
-    if (db_size < 0) {
-      log_message("Negative database size. WTF");
+  result = unlock_locker_file(filepath, &secret, &header, key, &slot);
+  if (result != LOCKER_OK) {
+    sodium_memzero(keyfile, sizeof(keyfile));
+    return result;
+  }
+
+  result = LOCKER_NO_FREE_KEY_SLOT;
+  for (int i = 0; i < LOCKER_KEY_SLOTS; i++) {
+    if (header->key_slots[i].type != LOCKER_KEY_SLOT_EMPTY)
+      continue;
+
+    if (key_slot_seal_keyfile(&header->key_slots[i], keyfile, keyfile_len, key,
+                              header->salt) != 0) {
+      perror("key_slot_seal_keyfile");
       exit(EXIT_FAILURE);
     }
+    update_locker_key_slot(filepath, header, i);
+    result = LOCKER_OK;
+    break;
+  }
 
-    generate_nonce(locker->_header->nonce);
+  if (result == LOCKER_NO_FREE_KEY_SLOT) {
+    log_message("%s has no free key slot left.", filepath);
+  }
 
-    unsigned char *encrypted_db =
-        malloc(sizeof(unsigned char) *
-               (db_size + crypto_aead_xchacha20poly1305_IETF_ABYTES));
+  sodium_memzero(keyfile, sizeof(keyfile));
+  sodium_memzero(key, sizeof(key));
+  free(header);
+  return result;
+}
 
-    /* XChaCha20-Poly1305 can encrypt at max the file of size 2^64 bytes */
-    crypto_aead_xchacha20poly1305_ietf_encrypt(
-        encrypted_db, &(locker->_header->locker_size), serialized_db, db_size,
-        NULL, 0, NULL, locker->_header->nonce, locker->_key);
+/* drops every key slot the keyfile opens, passphrase slots are kept */
+locker_result_t locker_remove_keyfile(const char locker_dir[static 1],
+                                      const char locker_name[static 1],
+                                      const char passphrase[static 1],
+                                      const char keyfile_path[static 1]) {
+  unsigned char keyfile[LOCKER_KEYFILE_MAX_LEN];
+  size_t keyfile_len;
+
+  locker_result_t result = read_keyfile(keyfile_path, keyfile, &keyfile_len);
+  if (result != LOCKER_OK) {
+    return result;
+  }
 
-    /* set memory used for serialized db to 0 to remove it from registers */
-    sodium_memzero(serialized_db, db_size);
-    sqlite3_free(serialized_db);
+  char filepath[PATH_MAX] = {0};
+  get_locker_filepath(filepath, locker_dir, locker_name);
 
-    write_locker_file(locker_dir, locker->locker_name, locker->_header, encrypted_db);
-    free(encrypted_db);
+  locker_secret_t secret = {.passphrase = passphrase};
+  locker_header_t *header;
+  locker_crypto_masterkey_t key[LOCKER_CRYPTO_MASTER_KEY_LEN];
+  int slot;
 
-    return LOCKER_OK;
+  result = unlock_locker_file(filepath, &secret, &header, key, &slot);
+  if (result != LOCKER_OK) {
+    sodium_memzero(keyfile, sizeof(keyfile));
+    return result;
+  }
+
+  result = LOCKER_INVALID_KEYFILE;
+  for (int i = 0; i < LOCKER_KEY_SLOTS; i++) {
+    locker_crypto_masterkey_t slot_key[LOCKER_CRYPTO_MASTER_KEY_LEN];
+    if (!key_slot_open_keyfile(&header->key_slots[i], keyfile, keyfile_len,
+                               header->salt, slot_key))
+      continue;
+
+    sodium_memzero(slot_key, sizeof(slot_key));
+    memset(&header->key_slots[i], 0, sizeof(locker_key_slot_t));
+    update_locker_key_slot(filepath, header, i);
+    result = LOCKER_OK;
+  }
+
+  sodium_memzero(keyfile, sizeof(keyfile));
+  sodium_memzero(key, sizeof(key));
+  free(header);
+  return result;
 }
 
-locker_result_t close_locker(locker_t locker[static 1]) {
-  db_close(locker->_db);
-  free(locker);
+const char *locker_get_name(const locker_t *locker) {
+  return locker->locker_name;
+}
 
+/* returns right away, the save itself runs on the saver thread */
+locker_result_t save_locker(locker_t *locker) {
+  saver_request(locker->_saver);
   return LOCKER_OK;
 }
 
-locker_result_t locker_add_apikey(const locker_t locker[static 1], const locker_item_apikey_t apikey[static 1]) {
+locker_save_state_t locker_save_state(const locker_t *locker) {
+  return saver_state(locker->_saver);
+}
+
+locker_result_t close_locker(locker_t *locker) {
+  saver_stop(locker->_saver);
+  readers_free(locker->_readers);
+  cache_free(locker->_cache);
+
+  /* journaled changes that were not compacted are replayed on next open */
+  sqlite3 *conn = locker->_db->conn;
+  db_finalize_statements(locker->_db);
+  db_close(conn);
+  journal_close(locker->_journal);
+  trie_free(locker->_index);
+  fuzzy_free(locker->_fuzzy);
+
+  pthread_rwlock_destroy(locker->_lock);
+  free(locker->_lock);
+
+  /* wipes the key along with the rest */
+  free(locker->_header);
+  sodium_free(locker);
+
+  return LOCKER_OK;
+}
+
+/* LOCKER_OK when no item other than item_id is stored under key */
+static locker_result_t check_key_free(const locker_t locker[static 1], sqlite_int64 item_id, const char key[static 1]) {
+  bool exists;
+  if (!db_item_key_exists(locker->_db, item_id, key, &exists)) {
+    return LOCKER_DB_ERROR;
+  }
+  return exists ? LOCKER_ITEM_KEY_EXISTS : LOCKER_OK;
+}
+
+/*
+ * A write is durable once its record is in the journal, one the journal cannot
+ * take is rolled back to the savepoint taken before it
+ */
+static bool finish_item_write(const locker_t locker[static 1], bool written,
+                              const locker_journal_record_t record[static 1]) {
+  sqlite3 *conn = locker->_db->conn;
+  if (written && journal_append(locker->_journal, record) && db_release_savepoint(conn))
+    return true;
+  db_rollback_savepoint(conn);
+  return false;
+}
+
+static locker_result_t add_apikey(const locker_t locker[static 1], const locker_item_apikey_t apikey[static 1]) {
   if (strlen(apikey->key) > LOCKER_ITEM_KEY_MAX_LEN) {
     return LOCKER_ITEM_KEY_TOO_LONG;
   }
 
-  if (db_item_key_exists(locker->_db, apikey->id, apikey->key)) {
-    return LOCKER_ITEM_KEY_EXISTS;
+  locker_result_t result = check_key_free(locker, apikey->id, apikey->key);
+  if (result != LOCKER_OK) {
+    return result;
   }
 
   if (strlen(apikey->description) > LOCKER_ITEM_DESCRIPTION_MAX_LEN) {
@@ -359,18 +1120,27 @@ locker_result_t locker_add_apikey(const locker_t locker[static 1], const locker_
     return LOCKER_CONTENT_TOO_LONG;
   }
 
-  db_add_item(locker->_db, apikey->key, apikey->description, strlen(apikey->value), (unsigned char *)apikey->value, LOCKER_ITEM_APIKEY);
+  if (!db_savepoint(locker->_db->conn)) {
+    return LOCKER_DB_ERROR;
+  }
+  sqlite_int64 item_id = db_add_item(locker->_db, 0, apikey->key, apikey->description, strlen(apikey->value), (unsigned char *)apikey->value, LOCKER_ITEM_APIKEY);
+  locker_journal_record_t record = {.op = LOCKER_JOURNAL_ADD, .item_id = item_id, .item_type = LOCKER_ITEM_APIKEY, .key = apikey->key, .description = apikey->description, .content_size = strlen(apikey->value), .content = (const unsigned char *)apikey->value};
+  if (!finish_item_write(locker, item_id, &record)) {
+    return LOCKER_DB_ERROR;
+  }
+  index_item(locker, item_id, apikey->key, LOCKER_ITEM_APIKEY);
 
   return LOCKER_OK;
 }
 
-locker_result_t locker_update_apikey(const locker_t locker[static 1], const locker_item_apikey_t apikey[static 1]) {
+static locker_result_t update_apikey(const locker_t locker[static 1], const locker_item_apikey_t apikey[static 1]) {
   if (strlen(apikey->key) > LOCKER_ITEM_KEY_MAX_LEN) {
     return LOCKER_ITEM_KEY_TOO_LONG;
   }
 
-  if (db_item_key_exists(locker->_db, apikey->id, apikey->key)) {
-    return LOCKER_ITEM_KEY_EXISTS;
+  locker_result_t result = check_key_free(locker, apikey->id, apikey->key);
+  if (result != LOCKER_OK) {
+    return result;
   }
 
   if (strlen(apikey->description) > LOCKER_ITEM_DESCRIPTION_MAX_LEN) {
@@ -381,18 +1151,30 @@ locker_result_t locker_update_apikey(const locker_t locker[static 1], const lock
     return LOCKER_CONTENT_TOO_LONG;
   }
 
-  db_item_update(locker->_db, apikey->id, apikey->key, apikey->description, strlen(apikey->value), (const unsigned char *)apikey->value);
+  if (!db_savepoint(locker->_db->conn)) {
+    return LOCKER_DB_ERROR;
+  }
+  char *old_key = db_get_item_key(locker->_db, apikey->id);
+  bool updated = db_item_update(locker->_db, apikey->id, apikey->key, apikey->description, strlen(apikey->value), (const unsigned char *)apikey->value);
+  locker_journal_record_t record = {.op = LOCKER_JOURNAL_UPDATE, .item_id = apikey->id, .item_type = LOCKER_ITEM_APIKEY, .key = apikey->key, .description = apikey->description, .content_size = strlen(apikey->value), .content = (const unsigned char *)apikey->value};
+  if (!finish_item_write(locker, updated, &record)) {
+    free(old_key);
+    return LOCKER_DB_ERROR;
+  }
+  unindex_item(locker, apikey->id, old_key);
+  index_item(locker, apikey->id, apikey->key, LOCKER_ITEM_APIKEY);
 
   return LOCKER_OK;
 }
 
-locker_result_t locker_add_account(const locker_t locker[static 1], const locker_item_account_t account[static 1]) {
+static locker_result_t add_account(const locker_t locker[static 1], const locker_item_account_t account[static 1]) {
     if (strlen(account->key) > LOCKER_ITEM_KEY_MAX_LEN) {
       return LOCKER_ITEM_KEY_TOO_LONG;
     }
 
-    if (db_item_key_exists(locker->_db, account->id, account->key)) {
-      return LOCKER_ITEM_KEY_EXISTS;
+    locker_result_t result = check_key_free(locker, account->id, account->key);
+    if (result != LOCKER_OK) {
+      return result;
     }
 
     if (strlen(account->description) > LOCKER_ITEM_DESCRIPTION_MAX_LEN) {
@@ -409,31 +1191,33 @@ locker_result_t locker_add_account(const locker_t locker[static 1], const locker
         return LOCKER_ITEM_ACCOUNT_URL_TOO_LONG;
     }
 
-    char *content = calloc(LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN+ LOCKER_ITEM_ACCOUNT_URL_MAX_LEN, sizeof(char));
-    if(!content) {
-        perror("calloc");
-        exit(EXIT_FAILURE);
+    size_t content_size;
+    unsigned char *content = account_content_encode(account->username, account->password, account->url, &content_size);
+
+    bool added = false;
+    if (db_savepoint(locker->_db->conn)) {
+      sqlite_int64 item_id = db_add_item(locker->_db, 0, account->key, account->description, content_size, content, LOCKER_ITEM_ACCOUNT);
+      locker_journal_record_t record = {.op = LOCKER_JOURNAL_ADD, .item_id = item_id, .item_type = LOCKER_ITEM_ACCOUNT, .key = account->key, .description = account->description, .content_size = content_size, .content = content};
+      added = finish_item_write(locker, item_id, &record);
+      if (added) {
+        index_item(locker, item_id, account->key, LOCKER_ITEM_ACCOUNT);
+      }
     }
 
-    memcpy(content, account->username, strlen(account->username));
-    memcpy(content+LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN, account->password, strlen(account->password));
-    memcpy(content+LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN, account->url, strlen(account->url));
-
-    db_add_item(locker->_db, account->key, account->description, LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN+LOCKER_ITEM_ACCOUNT_URL_MAX_LEN, (const unsigned char *)content, LOCKER_ITEM_ACCOUNT);
-
     /* set memory used for content to 0 to remove it from registers */
-    sodium_memzero(content, LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN+LOCKER_ITEM_ACCOUNT_URL_MAX_LEN);
+    sodium_memzero(content, content_size);
     free(content);
-    return LOCKER_OK;
+    return added ? LOCKER_OK : LOCKER_DB_ERROR;
 }
 
-locker_result_t locker_update_account(const locker_t locker[static 1], const locker_item_account_t account[static 1]) {
+static locker_result_t update_account(const locker_t locker[static 1], const locker_item_account_t account[static 1]) {
     if (strlen(account->key) > LOCKER_ITEM_KEY_MAX_LEN) {
       return LOCKER_ITEM_KEY_TOO_LONG;
     }
 
-    if (db_item_key_exists(locker->_db, account->id, account->key)) {
-      return LOCKER_ITEM_KEY_EXISTS;
+    locker_result_t result = check_key_free(locker, account->id, account->key);
+    if (result != LOCKER_OK) {
+      return result;
     }
 
     if (strlen(account->description) > LOCKER_ITEM_DESCRIPTION_MAX_LEN) {
@@ -450,68 +1234,337 @@ locker_result_t locker_update_account(const locker_t locker[static 1], const loc
         return LOCKER_ITEM_ACCOUNT_URL_TOO_LONG;
     }
 
-    char *content = calloc(LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN+ LOCKER_ITEM_ACCOUNT_URL_MAX_LEN, sizeof(char));
-    if(!content) {
-        perror("calloc");
-        exit(EXIT_FAILURE);
+    size_t content_size;
+    unsigned char *content = account_content_encode(account->username, account->password, account->url, &content_size);
+
+    bool updated = false;
+    if (db_savepoint(locker->_db->conn)) {
+      char *old_key = db_get_item_key(locker->_db, account->id);
+      locker_journal_record_t record = {.op = LOCKER_JOURNAL_UPDATE, .item_id = account->id, .item_type = LOCKER_ITEM_ACCOUNT, .key = account->key, .description = account->description, .content_size = content_size, .content = content};
+      updated = finish_item_write(locker, db_item_update(locker->_db, account->id, account->key, account->description, content_size, content), &record);
+      if (updated) {
+        unindex_item(locker, account->id, old_key);
+        index_item(locker, account->id, account->key, LOCKER_ITEM_ACCOUNT);
+      } else {
+        free(old_key);
+      }
     }
 
-    memcpy(content, account->username, strlen(account->username));
-    memcpy(content+LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN, account->password, strlen(account->password));
-    memcpy(content+LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN, account->url, strlen(account->url));
-
-    db_item_update(locker->_db, account->id, account->key, account->description, LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN+LOCKER_ITEM_ACCOUNT_URL_MAX_LEN, (const unsigned char *)content);
-
     /* set memory used for content to 0 to remove it from registers */
-    sodium_memzero(content, LOCKER_ITEM_ACCOUNT_USERNAME_MAX_LEN+LOCKER_ITEM_ACCOUNT_PASSWORD_MAX_LEN+LOCKER_ITEM_ACCOUNT_URL_MAX_LEN);
+    sodium_memzero(content, content_size);
     free(content);
-    return LOCKER_OK;
+    return updated ? LOCKER_OK : LOCKER_DB_ERROR;
+}
+
+static locker_result_t check_note(const locker_t locker[static 1], const locker_item_note_t note[static 1]) {
+  if (strlen(note->key) > LOCKER_ITEM_KEY_MAX_LEN) {
+    return LOCKER_ITEM_KEY_TOO_LONG;
+  }
+
+  locker_result_t result = check_key_free(locker, note->id, note->key);
+  if (result != LOCKER_OK) {
+    return result;
+  }
+
+  if (strlen(note->description) > LOCKER_ITEM_DESCRIPTION_MAX_LEN) {
+    return LOCKER_ITEM_DESCRIPTION_TOO_LONG;
+  }
+
+  if (note->size > LOCKER_ITEM_NOTE_MAX_LEN) {
+    return LOCKER_CONTENT_TOO_LONG;
+  }
+  return LOCKER_OK;
+}
+
+/* the row in items keeps an empty content, the text goes into chunks */
+static locker_result_t add_note(const locker_t locker[static 1], const locker_item_note_t note[static 1]) {
+  locker_result_t result = check_note(locker, note);
+  if (result != LOCKER_OK) {
+    return result;
+  }
+
+  /* the row goes away again when its chunks cannot be written */
+  const unsigned char *content = (const unsigned char *)note->content;
+  if (!db_savepoint(locker->_db->conn)) {
+    return LOCKER_DB_ERROR;
+  }
+  sqlite_int64 item_id = db_add_item(locker->_db, 0, note->key, note->description, 0, (const unsigned char *)"", LOCKER_ITEM_NOTE);
+  locker_journal_record_t record = {.op = LOCKER_JOURNAL_ADD, .item_id = item_id, .item_type = LOCKER_ITEM_NOTE, .key = note->key, .description = note->description, .content_size = (int)note->size, .content = content};
+  if (!finish_item_write(locker, item_id && db_write_note(locker->_db, item_id, note->size, content), &record)) {
+    return LOCKER_DB_ERROR;
+  }
+  index_item(locker, item_id, note->key, LOCKER_ITEM_NOTE);
+
+  return LOCKER_OK;
 }
 
-locker_result_t locker_delete_item(const locker_t locker[static 1], const locker_item_t item[static 1]) {
-    db_item_delete(locker->_db, item->id);
+static locker_result_t update_note(const locker_t locker[static 1], const locker_item_note_t note[static 1]) {
+  locker_result_t result = check_note(locker, note);
+  if (result != LOCKER_OK) {
+    return result;
+  }
+
+  /* new key and description never end up next to the old chunks */
+  const unsigned char *content = (const unsigned char *)note->content;
+  if (!db_savepoint(locker->_db->conn)) {
+    return LOCKER_DB_ERROR;
+  }
+  char *old_key = db_get_item_key(locker->_db, note->id);
+  bool updated = db_item_update(locker->_db, note->id, note->key, note->description, 0, (const unsigned char *)"") &&
+                 db_write_note(locker->_db, note->id, note->size, content);
+  locker_journal_record_t record = {.op = LOCKER_JOURNAL_UPDATE, .item_id = note->id, .item_type = LOCKER_ITEM_NOTE, .key = note->key, .description = note->description, .content_size = (int)note->size, .content = content};
+  if (!finish_item_write(locker, updated, &record)) {
+    free(old_key);
+    return LOCKER_DB_ERROR;
+  }
+  unindex_item(locker, note->id, old_key);
+  index_item(locker, note->id, note->key, LOCKER_ITEM_NOTE);
+
+  return LOCKER_OK;
+}
+
+static locker_result_t delete_item(const locker_t locker[static 1], const locker_item_t item[static 1]) {
+    if (!db_savepoint(locker->_db->conn)) {
+      return LOCKER_DB_ERROR;
+    }
+    char *old_key = db_get_item_key(locker->_db, item->id);
+    locker_journal_record_t record = {.op = LOCKER_JOURNAL_DELETE, .item_id = item->id, .item_type = item->type};
+    if (!finish_item_write(locker, db_item_delete(locker->_db, item->id), &record)) {
+      free(old_key);
+      return LOCKER_DB_ERROR;
+    }
+    unindex_item(locker, item->id, old_key);
     return LOCKER_OK;
 }
 
+/*
+ * The saver thread compacts through the same connection, so it takes
+ * locker->_lock exclusively like every write. Writes leave the cached pages
+ * of attached threads behind, the next lookup of each drops its own.
+ */
+static void begin_write(const locker_t locker[static 1]) {
+  pthread_rwlock_wrlock(locker->_lock);
+}
+
+static locker_result_t end_write(const locker_t locker[static 1], locker_result_t result) {
+  /* a rolled back write leaves pages to flush behind as well */
+  readers_invalidate(locker->_readers);
+  pthread_rwlock_unlock(locker->_lock);
+  return result;
+}
+
+locker_result_t locker_add_apikey(const locker_t *locker, const locker_item_apikey_t apikey[static 1]) {
+  begin_write(locker);
+  return end_write(locker, add_apikey(locker, apikey));
+}
+
+locker_result_t locker_update_apikey(const locker_t *locker, const locker_item_apikey_t apikey[static 1]) {
+  begin_write(locker);
+  cache_invalidate(locker->_cache, apikey->id);
+  return end_write(locker, update_apikey(locker, apikey));
+}
+
+locker_result_t locker_add_account(const locker_t *locker, const locker_item_account_t account[static 1]) {
+  begin_write(locker);
+  return end_write(locker, add_account(locker, account));
+}
+
+locker_result_t locker_update_account(const locker_t *locker, const locker_item_account_t account[static 1]) {
+  begin_write(locker);
+  cache_invalidate(locker->_cache, account->id);
+  return end_write(locker, update_account(locker, account));
+}
+
+locker_result_t locker_add_note(const locker_t *locker, const locker_item_note_t note[static 1]) {
+  begin_write(locker);
+  return end_write(locker, add_note(locker, note));
+}
+
+locker_result_t locker_update_note(const locker_t *locker, const locker_item_note_t note[static 1]) {
+  begin_write(locker);
+  cache_invalidate(locker->_cache, note->id);
+  return end_write(locker, update_note(locker, note));
+}
+
+locker_result_t locker_delete_item(const locker_t *locker, const locker_item_t item[static 1]) {
+  begin_write(locker);
+  cache_invalidate(locker->_cache, item->id);
+  return end_write(locker, delete_item(locker, item));
+}
+
+/* exclusive, attaching may have to flush the primary connection */
+void locker_attach_thread(locker_t *locker) {
+  pthread_rwlock_wrlock(locker->_lock);
+  readers_attach(locker->_readers);
+  pthread_rwlock_unlock(locker->_lock);
+}
+
+void locker_detach_thread(locker_t *locker) {
+  readers_detach(locker->_readers);
+}
+
+/* shared lock plus the connection this thread reads from */
+static locker_db_t *begin_read(const locker_t locker[static 1]) {
+  pthread_rwlock_rdlock(locker->_lock);
+  return readers_acquire(locker->_readers);
+}
+
+static void end_read(const locker_t locker[static 1], locker_db_t *db) {
+  readers_release(locker->_readers, db);
+  pthread_rwlock_unlock(locker->_lock);
+}
+
+/* replaces the contents of list, reusing its memory */
+locker_result_t locker_get_items(locker_t *locker, const char query[LOCKER_ITEM_KEY_MAX_LEN], locker_item_list_t list[static 1]) {
+  locker_item_list_clear(list);
+  locker_db_t *db = begin_read(locker);
+  bool ok = db_list_items(db, query, list);
+  end_read(locker, db);
+  return ok ? LOCKER_OK : LOCKER_DB_ERROR;
+}
+
+locker_result_t locker_get_items_page(locker_t *locker, const locker_item_cursor_t cursor[static 1], locker_page_direction_t direction, size_t page_size, locker_item_list_t list[static 1], bool has_more[static 1]) {
+  locker_item_list_clear(list);
+  locker_db_t *db = begin_read(locker);
+  bool ok = db_list_items_page(db, cursor, direction, page_size, list, has_more);
+  end_read(locker, db);
+  return ok ? LOCKER_OK : LOCKER_DB_ERROR;
+}
+
+/* moves cursor onto item, a page after it starts with the next item */
+void locker_item_cursor_set(locker_item_cursor_t cursor[static 1], const locker_item_t item[static 1]) {
+  snprintf(cursor->key, sizeof(cursor->key), "%s", item->key);
+  cursor->id = item->id;
+  cursor->past_end = false;
+}
+
+void locker_item_cursor_set_end(locker_item_cursor_t cursor[static 1]) {
+  cursor->key[0] = '\0';
+  cursor->id = 0;
+  cursor->past_end = true;
+}
+
+/* one namespace level below prefix, answered from the key index */
 ATTR_ALLOC ATTR_NODISCARD
-array_locker_item_t *locker_get_items(locker_t locker[static 1], const char query[LOCKER_ITEM_KEY_MAX_LEN]) {
-  return db_list_items(locker->_db, query);
+array_locker_trie_entry_t *locker_browse_items(locker_t *locker, const char prefix[static 1]) {
+  pthread_rwlock_rdlock(locker->_lock);
+  array_locker_trie_entry_t *entries = trie_browse(locker->_index, prefix, LOCKER_ITEM_KEY_SEPARATOR);
+  pthread_rwlock_unlock(locker->_lock);
+  return entries;
 }
 
-ATTR_ALLOC ATTR_NODISCARD locker_item_apikey_t *locker_get_apikey(const locker_t locker[static 1], sqlite_int64 item_id) {
-    return db_get_apikey(locker->_db, item_id);
+locker_result_t locker_resolve_items(locker_t *locker, const char pattern[static 1], locker_arena_t arena[static 1], array_locker_resolved_item_t out[static 1]) {
+  locker_db_t *db = begin_read(locker);
+  bool ok = db_resolve_items(db, pattern, arena, out);
+  end_read(locker, db);
+  return ok ? LOCKER_OK : LOCKER_DB_ERROR;
 }
-ATTR_ALLOC ATTR_NODISCARD locker_item_account_t *locker_get_account(const locker_t locker[static 1], sqlite_int64 item_id) {
-    return db_get_account(locker->_db, item_id);
+
+bool locker_find_item(locker_t *locker, const char key[static 1], locker_item_t item[static 1]) {
+  sqlite3_int64 item_id;
+  int item_type;
+  pthread_rwlock_rdlock(locker->_lock);
+  bool found = trie_find(locker->_index, key, &item_id, &item_type);
+  pthread_rwlock_unlock(locker->_lock);
+
+  if (found) {
+    item->id = item_id;
+    item->type = (locker_item_type_t)item_type;
+  }
+  return found;
 }
 
-void locker_free_item(locker_item_t item) {
-    free(item.key);
+size_t locker_count_items(locker_t *locker, const char prefix[static 1]) {
+  pthread_rwlock_rdlock(locker->_lock);
+  size_t count = trie_count_prefix(locker->_index, prefix);
+  pthread_rwlock_unlock(locker->_lock);
+  return count;
 }
 
-void locker_free_apikey(locker_item_apikey_t item[static 1]) {
-    free(item->key);
-    free(item->description);
+size_t locker_complete_item_key(locker_t *locker, const char prefix[static 1], char out[], size_t out_sz) {
+  pthread_rwlock_rdlock(locker->_lock);
+  size_t len = trie_complete(locker->_index, prefix, out, out_sz);
+  pthread_rwlock_unlock(locker->_lock);
+  return len;
+}
 
-    /* set memory used for storing apikey to 0 to remove it from registers */
-    sodium_memzero(item->value, strlen(item->value));
-    free(item->value);
+/* best max_results fuzzy matches for query, best first, replacing list */
+void locker_fuzzy_find_items(locker_t *locker, const char query[static 1], size_t max_results, locker_item_list_t list[static 1]) {
+  locker_fuzzy_result_t *results = malloc(max_results * sizeof(locker_fuzzy_result_t));
+  if (!results) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  locker_item_list_clear(list);
+
+  /* the matcher keeps the candidates of the last query, searching changes it */
+  pthread_rwlock_wrlock(locker->_lock);
+  size_t n = fuzzy_search(locker->_fuzzy, query, max_results, results);
+  for (size_t i = 0; i < n; i++) {
+    /* keys point into the index, copy them while it cannot change */
+    locker_item_t item = {.id = results[i].item_id, .key = arena_strdup(&list->arena, results[i].key), .type = results[i].item_type};
+    locker_array_append(&list->items, item);
+  }
+  pthread_rwlock_unlock(locker->_lock);
 
-    free(item);
+  free(results);
 }
 
-void locker_free_account(locker_item_account_t item[static 1]) {
-    free(item->key);
-    free(item->description);
+/* a cached item is copied out without a connection, no page is read for it */
+locker_item_apikey_t *locker_get_apikey(const locker_t *locker, int64_t item_id, locker_arena_t arena[static 1]) {
+    pthread_rwlock_rdlock(locker->_lock);
+    locker_item_apikey_t *apikey = cache_get_apikey(locker->_cache, item_id, arena);
+    if (!apikey) {
+        locker_db_t *db = readers_acquire(locker->_readers);
+        apikey = db_get_apikey(db, item_id, arena);
+        readers_release(locker->_readers, db);
+        if (apikey)
+            cache_put_apikey(locker->_cache, apikey);
+    }
+    pthread_rwlock_unlock(locker->_lock);
+    return apikey;
+}
+
+locker_item_account_t *locker_get_account(const locker_t *locker, int64_t item_id, locker_arena_t arena[static 1]) {
+    pthread_rwlock_rdlock(locker->_lock);
+    locker_item_account_t *account = cache_get_account(locker->_cache, item_id, arena);
+    if (!account) {
+        locker_db_t *db = readers_acquire(locker->_readers);
+        account = db_get_account(db, item_id, arena);
+        readers_release(locker->_readers, db);
+        if (account)
+            cache_put_account(locker->_cache, account);
+    }
+    pthread_rwlock_unlock(locker->_lock);
+    return account;
+}
 
-    /* set memory used for storing username to 0 to remove it from registers */
-    sodium_memzero(item->username, strlen(item->username));
-    free(item->username);
+locker_item_note_t *locker_get_note(const locker_t *locker, int64_t item_id, locker_arena_t arena[static 1]) {
+    locker_db_t *db = begin_read(locker);
+    locker_item_note_t *note = db_get_note(db, item_id, arena);
+    end_read(locker, db);
+    return note;
+}
 
-    /* set memory used for storing password to 0 to remove it from registers */
-    sodium_memzero(item->password, strlen(item->password));
-    free(item->password);
+locker_result_t locker_read_note(const locker_t *locker, int64_t item_id, size_t offset, size_t size, char out[size], size_t n_read[static 1]) {
+    locker_db_t *db = begin_read(locker);
+    bool ok = db_read_note(db, item_id, offset, size, (unsigned char *)out, n_read);
+    end_read(locker, db);
+    return ok ? LOCKER_OK : LOCKER_DB_ERROR;
+}
+
+void locker_item_list_init(locker_item_list_t list[static 1]) {
+    init_item_array((&list->items));
+    arena_init(&list->arena, false);
+}
+
+void locker_item_list_clear(locker_item_list_t list[static 1]) {
+    list->items.count = 0;
+    arena_reset(&list->arena);
+}
 
-    free(item->url);
-    free(item);
+void locker_item_list_free(locker_item_list_t list[static 1]) {
+    free(list->items.values);
+    arena_release(&list->arena);
+    locker_item_list_init(list);
 }
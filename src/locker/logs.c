@@ -4,6 +4,9 @@
 #include <sys/syslimits.h>
 #include <time.h>
 
+/* where log_message writes, stderr unless a log file was opened */
+static FILE *log_stream;
+
 void turn_on_logging(const char *workdir) {
     char log_filepath[PATH_MAX] = {0};
     snprintf(log_filepath, PATH_MAX, "%s/%s", workdir, "locker.log");
@@ -11,6 +14,15 @@ void turn_on_logging(const char *workdir) {
     setvbuf(stderr, NULL, _IOLBF, 0);
 }
 
+/* log messages go to the log file while stderr stays on the terminal */
+void open_log_file(const char *workdir) {
+  char log_filepath[PATH_MAX] = {0};
+  snprintf(log_filepath, PATH_MAX, "%s/%s", workdir, "locker.log");
+  log_stream = fopen(log_filepath, "a");
+  if (log_stream)
+    setvbuf(log_stream, NULL, _IOLBF, 0);
+}
+
 void log_message(const char *fmt, ...) {
   va_list args;
   va_start(args, fmt);
@@ -26,9 +38,10 @@ void log_message(const char *fmt, ...) {
   char datetime[32];
   strftime(datetime, sizeof(datetime), "%Y-%m-%d %H:%M:%S UTC", &tm_utc);
 
-  fprintf(stderr, "[%s] ", datetime);
-  vfprintf(stderr, fmt, args);
-  fprintf(stderr, "\n");
+  FILE *out = log_stream ? log_stream : stderr;
+  fprintf(out, "[%s] ", datetime);
+  vfprintf(out, fmt, args);
+  fprintf(out, "\n");
 
   va_end(args);
 }
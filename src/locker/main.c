@@ -1,7 +1,75 @@
+#include "locker_cli.h"
+#include "locker_kdf.h"
 #include "locker_tui.h"
+#include "sodium/core.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+void print_usage(void) {
+  fprintf(stderr, "Usage: locker [calibrate [target-ms] [max-memory-MiB]]\n");
+  cli_print_usage();
+}
+
+int calibrate(int argc, char *argv[]) {
+  char *path = getenv("LOCKER_PATH");
+  if (!path) {
+    printf("$LOCKER_PATH environment variable is missing.\n");
+    return EXIT_FAILURE;
+  }
+
+  double target_ms = LOCKER_KDF_DEFAULT_TARGET_MS;
+  size_t max_memlimit = LOCKER_KDF_DEFAULT_MAX_MEMLIMIT;
+
+  if (argc > 0 && (target_ms = strtod(argv[0], NULL)) <= 0) {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+
+  if (argc > 1) {
+    unsigned long long max_memory_mib = strtoull(argv[1], NULL, 10);
+    if (max_memory_mib < 64) {
+      fprintf(stderr, "max-memory-MiB must be at least 64.\n");
+      return EXIT_FAILURE;
+    }
+    max_memlimit = max_memory_mib << 20;
+    if (max_memlimit > LOCKER_CRYPTO_KDF_MEMLIMIT_MAX)
+      max_memlimit = LOCKER_CRYPTO_KDF_MEMLIMIT_MAX;
+  }
+
+  printf("Calibrating Argon2id for %.0f ms unlock time...\n", target_ms);
+  locker_kdf_calibration_t calibration = kdf_calibrate(target_ms, max_memlimit);
+
+  printf("opslimit:   %llu\n", calibration.params.opslimit);
+  printf("memlimit:   %zu MiB\n", calibration.params.memlimit >> 20);
+  printf("unlock:     %.0f ms\n", calibration.elapsed_ms);
+  printf("throughput: %.0f MiB/s\n", calibration.throughput);
+
+  kdf_params_store(path, &calibration.params);
+  printf("New lockers and changed passphrases use these parameters from now on.\n");
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  if (sodium_init() < 0) {
+    fprintf(stderr, "libsodium could not be initialized.\n");
+    return EXIT_FAILURE;
+  }
+
+  if (argc > 1) {
+    if (strcmp(argv[1], "calibrate") == 0) {
+      return calibrate(argc - 2, argv + 2);
+    }
+
+    /* subcommands run headless, the TUI and ncurses are never started */
+    if (cli_is_command(argv[1])) {
+      return cli_run(argc - 1, argv + 1);
+    }
+
+    print_usage();
+    return EXIT_FAILURE;
+  }
 
-int main(void) {
   run();
   return EXIT_SUCCESS;
 }
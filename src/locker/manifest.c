@@ -0,0 +1,151 @@
+#include "locker_manifest.h"
+#include "locker_logs.h"
+#include "locker_utils.h"
+#include "locker_utils_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syslimits.h>
+
+/*
+ * Cache of the lockers directory, kept in the locker workdir and not in the
+ * lockers directory itself so that rewriting it does not bump the mtime it is
+ * keyed on:
+ *   "LKMF" | u32 version | i64 lockers dir mtime | u32 count
+ *   count * (i64 size | i64 mtime | u16 len filename | u16 len locker name)
+ */
+#define MANIFEST_MAGIC "LKMF"
+#define MANIFEST_VERSION 1
+#define MANIFEST_PREAMBLE_LEN (4 + 4 + 8 + 4)
+
+void manifest_free_entry(locker_manifest_entry_t entry) {
+  free(entry.filename);
+  free(entry.locker_name);
+}
+
+ATTR_NODISCARD char *read_manifest_str(FILE *f) {
+  unsigned char len_buf[2];
+  if (fread(len_buf, 1, sizeof(len_buf), f) != sizeof(len_buf))
+    return NULL;
+
+  uint16_t len = get_u16_le(len_buf);
+  char *s = malloc(len + 1);
+  if (!s) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  if (fread(s, 1, len, f) != len) {
+    free(s);
+    return NULL;
+  }
+  s[len] = '\0';
+  return s;
+}
+
+ATTR_ALLOC ATTR_NODISCARD array_locker_manifest_entry_t *
+manifest_load(const char locker_dir[static 1], long long dir_mtime) {
+  char manifest_path[PATH_MAX] = {0};
+  snprintf(manifest_path, PATH_MAX, "%s/%s", locker_dir,
+           LOCKER_MANIFEST_FILENAME);
+
+  FILE *f = fopen(manifest_path, "rb");
+  if (!f)
+    return NULL;
+
+  unsigned char preamble[MANIFEST_PREAMBLE_LEN];
+  if (fread(preamble, 1, sizeof(preamble), f) != sizeof(preamble) ||
+      memcmp(preamble, MANIFEST_MAGIC, 4) != 0 ||
+      get_u32_le(preamble + 4) != MANIFEST_VERSION ||
+      (long long)get_u64_le(preamble + 8) != dir_mtime) {
+    /* missing, foreign or stale: caller rescans the directory */
+    fclose(f);
+    return NULL;
+  }
+
+  uint32_t count = get_u32_le(preamble + 16);
+
+  array_locker_manifest_entry_t *entries =
+      malloc(sizeof(array_locker_manifest_entry_t));
+  if (!entries) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  init_item_array(entries);
+
+  for (uint32_t i = 0; i < count; i++) {
+    unsigned char numbers[16];
+    if (fread(numbers, 1, sizeof(numbers), f) != sizeof(numbers))
+      goto malformed;
+
+    locker_manifest_entry_t entry = {
+        .size = (long long)get_u64_le(numbers),
+        .mtime = (long long)get_u64_le(numbers + 8),
+    };
+    entry.filename = read_manifest_str(f);
+    entry.locker_name = entry.filename ? read_manifest_str(f) : NULL;
+    if (!entry.locker_name) {
+      free(entry.filename);
+      goto malformed;
+    }
+
+    locker_array_append(entries, entry);
+  }
+
+  fclose(f);
+  return entries;
+
+malformed:
+  log_message("%s is malformed, rescanning lockers.", manifest_path);
+  locker_array_t_free(entries, manifest_free_entry);
+  free(entries);
+  fclose(f);
+  return NULL;
+}
+
+void write_manifest_str(FILE *f, const char s[static 1]) {
+  unsigned char len_buf[2];
+  size_t len = strlen(s);
+  put_u16_le(len_buf, (uint16_t)len);
+  fwrite(len_buf, 1, sizeof(len_buf), f);
+  fwrite(s, 1, len, f);
+}
+
+void manifest_store(const char locker_dir[static 1], long long dir_mtime,
+                    const array_locker_manifest_entry_t entries[static 1]) {
+  char manifest_path[PATH_MAX] = {0};
+  snprintf(manifest_path, PATH_MAX, "%s/%s", locker_dir,
+           LOCKER_MANIFEST_FILENAME);
+
+  char tmp_path[PATH_MAX] = {0};
+  snprintf(tmp_path, PATH_MAX, "%s.tmp", manifest_path);
+
+  FILE *f = fopen(tmp_path, "wb");
+  if (!f) {
+    /* the manifest is only a cache, listing keeps working without it */
+    perror("fopen");
+    return;
+  }
+
+  unsigned char preamble[MANIFEST_PREAMBLE_LEN];
+  memcpy(preamble, MANIFEST_MAGIC, 4);
+  put_u32_le(preamble + 4, MANIFEST_VERSION);
+  put_u64_le(preamble + 8, (uint64_t)dir_mtime);
+  put_u32_le(preamble + 16, (uint32_t)entries->count);
+  fwrite(preamble, 1, sizeof(preamble), f);
+
+  for (size_t i = 0; i < entries->count; i++) {
+    unsigned char numbers[16];
+    put_u64_le(numbers, (uint64_t)entries->values[i].size);
+    put_u64_le(numbers + 8, (uint64_t)entries->values[i].mtime);
+    fwrite(numbers, 1, sizeof(numbers), f);
+
+    write_manifest_str(f, entries->values[i].filename);
+    write_manifest_str(f, entries->values[i].locker_name);
+  }
+
+  if (fclose(f) != 0 || rename(tmp_path, manifest_path) != 0) {
+    perror("manifest_store");
+    remove(tmp_path);
+  }
+}
@@ -0,0 +1,197 @@
+#include "locker_readers.h"
+#include "locker_logs.h"
+#include "sqlite3.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct locker_reader {
+  locker_readers_t *readers;
+  /* NULL until the first read, statements need the schema */
+  sqlite3 *conn;
+  locker_db_t *db;
+  uint64_t generation;
+  locker_reader_t *prev;
+  locker_reader_t *next;
+};
+
+static void reader_close(locker_reader_t reader[static 1]) {
+  if (reader->db)
+    db_finalize_statements(reader->db);
+  if (reader->conn)
+    db_close(reader->conn);
+  free(reader);
+}
+
+static void reader_unlink(locker_reader_t reader[static 1]) {
+  locker_readers_t *readers = reader->readers;
+
+  pthread_mutex_lock(&readers->list_lock);
+  if (reader->prev)
+    reader->prev->next = reader->next;
+  else
+    readers->head = reader->next;
+  if (reader->next)
+    reader->next->prev = reader->prev;
+  pthread_mutex_unlock(&readers->list_lock);
+}
+
+/* key destructor, runs when an attached thread exits without detaching */
+static void reader_exit(void *arg) {
+  reader_unlink(arg);
+  reader_close(arg);
+}
+
+/* false leaves the connection closed, the next read tries again */
+static bool reader_open(locker_readers_t readers[static 1],
+                        locker_reader_t reader[static 1]) {
+  int rc = locker_vfs_open_reader(readers->path, &readers->params,
+                                  &reader->conn);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_exec(reader->conn, "PRAGMA temp_store = MEMORY;", NULL,
+                      NULL, NULL);
+  if (rc == SQLITE_OK && (reader->db = db_prepare_statements(reader->conn))) {
+    reader->generation = readers->versions.generation;
+    return true;
+  }
+
+  log_message("Cannot open a read connection: %s",
+              reader->conn ? sqlite3_errmsg(reader->conn) : sqlite3_errstr(rc));
+  db_close(reader->conn);
+  reader->conn = NULL;
+  return false;
+}
+
+/*
+ * Writes the pages the open transaction changed to the file, it stays open,
+ * and starts the generation they were marked with. Runs under the exclusive
+ * lock, attached threads read from the primary connection until a flush
+ * succeeds again.
+ */
+static void flush_primary(locker_readers_t readers[static 1]) {
+  int rc = sqlite3_db_cacheflush(readers->primary->conn);
+  readers->versions.generation++;
+  readers->flushed = rc == SQLITE_OK;
+  if (!readers->flushed)
+    log_message("Cannot flush the locker for its readers: %s",
+                sqlite3_errstr(rc));
+}
+
+ATTR_ALLOC ATTR_NODISCARD locker_readers_t *
+readers_new(locker_db_t *primary, const char path[static 1],
+            const locker_vfs_params_t params[static 1]) {
+  locker_readers_t *readers = malloc(sizeof(locker_readers_t));
+  if (!readers || !(readers->path = strdup(path))) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  readers->primary = primary;
+  readers->params = *params;
+  readers->params.versions = &readers->versions;
+  readers->versions = (locker_vfs_versions_t){0};
+  locker_vfs_track_writes(primary->conn, &readers->versions);
+  pthread_mutex_init(&readers->primary_lock, NULL);
+  pthread_mutex_init(&readers->list_lock, NULL);
+  readers->head = NULL;
+  readers->flushed = false;
+  if (pthread_key_create(&readers->key, reader_exit) != 0) {
+    perror("pthread_key_create");
+    exit(EXIT_FAILURE);
+  }
+
+  return readers;
+}
+
+void readers_free(locker_readers_t readers[static 1]) {
+  /* no destructor runs past this, threads still attached are closed here */
+  pthread_key_delete(readers->key);
+
+  locker_reader_t *reader = readers->head;
+  while (reader) {
+    locker_reader_t *next = reader->next;
+    reader_close(reader);
+    reader = next;
+  }
+
+  locker_vfs_track_writes(readers->primary->conn, NULL);
+  free(readers->versions.block_generations);
+  pthread_mutex_destroy(&readers->list_lock);
+  pthread_mutex_destroy(&readers->primary_lock);
+  free(readers->path);
+  free(readers);
+}
+
+/* the connection itself is opened by the first read */
+void readers_attach(locker_readers_t readers[static 1]) {
+  if (pthread_getspecific(readers->key))
+    return;
+
+  locker_reader_t *reader = calloc(1, sizeof(locker_reader_t));
+  if (!reader) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+  reader->readers = readers;
+
+  pthread_mutex_lock(&readers->list_lock);
+  reader->next = readers->head;
+  if (readers->head)
+    readers->head->prev = reader;
+  readers->head = reader;
+  pthread_mutex_unlock(&readers->list_lock);
+
+  pthread_setspecific(readers->key, reader);
+
+  /* writes made while nobody was attached may only be in the cache */
+  if (!readers->flushed)
+    flush_primary(readers);
+}
+
+void readers_detach(locker_readers_t readers[static 1]) {
+  locker_reader_t *reader = pthread_getspecific(readers->key);
+  if (!reader)
+    return;
+
+  pthread_setspecific(readers->key, NULL);
+  reader_unlink(reader);
+  reader_close(reader);
+}
+
+locker_db_t *readers_acquire(locker_readers_t readers[static 1]) {
+  locker_reader_t *reader = pthread_getspecific(readers->key);
+  if (reader && readers->flushed) {
+    if (reader->conn && reader->generation != readers->versions.generation) {
+      /*
+       * sqlite cannot drop single pages, its cache is refilled from the
+       * blocks the reader keeps, only the changed ones are decrypted
+       */
+      sqlite3_db_release_memory(reader->conn);
+      reader->generation = readers->versions.generation;
+    }
+    if (reader->conn || reader_open(readers, reader))
+      return reader->db;
+  }
+
+  /* reads stay correct on the primary connection, the next one retries */
+  pthread_mutex_lock(&readers->primary_lock);
+  return readers->primary;
+}
+
+void readers_release(locker_readers_t readers[static 1], locker_db_t *db) {
+  if (db == readers->primary)
+    pthread_mutex_unlock(&readers->primary_lock);
+}
+
+void readers_invalidate(locker_readers_t readers[static 1]) {
+  /* with nobody attached the flush waits for the next attach */
+  pthread_mutex_lock(&readers->list_lock);
+  bool attached = readers->head != NULL;
+  pthread_mutex_unlock(&readers->list_lock);
+  if (attached) {
+    flush_primary(readers);
+  } else {
+    readers->versions.generation++;
+    readers->flushed = false;
+  }
+}
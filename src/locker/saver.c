@@ -0,0 +1,87 @@
+#include "locker_saver.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void *saver_worker(void *arg) {
+  locker_saver_t *saver = arg;
+
+  pthread_mutex_lock(&saver->mutex);
+  while (1) {
+    while (!saver->requested && !saver->stopping)
+      pthread_cond_wait(&saver->cond, &saver->mutex);
+
+    /* a pending save still runs when stopping, nothing is dropped */
+    if (!saver->requested)
+      break;
+
+    saver->requested = false;
+    saver->running = true;
+    pthread_mutex_unlock(&saver->mutex);
+
+    bool saved = saver->save(saver->arg);
+
+    pthread_mutex_lock(&saver->mutex);
+    saver->running = false;
+    saver->failed = !saved;
+  }
+  pthread_mutex_unlock(&saver->mutex);
+
+  return NULL;
+}
+
+ATTR_ALLOC ATTR_NODISCARD locker_saver_t *saver_start(locker_save_fn save,
+                                                      void *arg) {
+  locker_saver_t *saver = malloc(sizeof(locker_saver_t));
+  if (!saver) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  pthread_mutex_init(&saver->mutex, NULL);
+  pthread_cond_init(&saver->cond, NULL);
+  saver->save = save;
+  saver->arg = arg;
+  saver->requested = false;
+  saver->running = false;
+  saver->failed = false;
+  saver->stopping = false;
+
+  if (pthread_create(&saver->thread, NULL, saver_worker, saver) != 0) {
+    perror("pthread_create");
+    exit(EXIT_FAILURE);
+  }
+
+  return saver;
+}
+
+void saver_request(locker_saver_t saver[static 1]) {
+  pthread_mutex_lock(&saver->mutex);
+  saver->requested = true;
+  pthread_cond_signal(&saver->cond);
+  pthread_mutex_unlock(&saver->mutex);
+}
+
+locker_save_state_t saver_state(locker_saver_t saver[static 1]) {
+  pthread_mutex_lock(&saver->mutex);
+  locker_save_state_t state = saver->running     ? LOCKER_SAVE_RUNNING
+                              : saver->requested ? LOCKER_SAVE_PENDING
+                              : saver->failed    ? LOCKER_SAVE_FAILED
+                                                 : LOCKER_SAVE_IDLE;
+  pthread_mutex_unlock(&saver->mutex);
+
+  return state;
+}
+
+/* waits for the pending save, if any, before the writer thread exits */
+void saver_stop(locker_saver_t saver[static 1]) {
+  pthread_mutex_lock(&saver->mutex);
+  saver->stopping = true;
+  pthread_cond_signal(&saver->cond);
+  pthread_mutex_unlock(&saver->mutex);
+
+  pthread_join(saver->thread, NULL);
+
+  pthread_cond_destroy(&saver->cond);
+  pthread_mutex_destroy(&saver->mutex);
+  free(saver);
+}
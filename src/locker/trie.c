@@ -0,0 +1,375 @@
+#include "locker_trie.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static locker_trie_node_t *node_new(const char *label, size_t label_len) {
+  locker_trie_node_t *node = calloc(1, sizeof(locker_trie_node_t));
+  char *node_label = malloc(label_len + 1);
+  if (!node || !node_label) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  memcpy(node_label, label, label_len);
+  node_label[label_len] = '\0';
+  node->label = node_label;
+  node->label_len = label_len;
+
+  return node;
+}
+
+static void node_free(locker_trie_node_t *node) {
+  for (size_t i = 0; i < node->n_children; i++)
+    node_free(node->children[i]);
+  free(node->children);
+  free(node->label);
+  free(node);
+}
+
+/* binary search on the first label byte, idx is the insertion point on a miss */
+static bool find_child(const locker_trie_node_t *node, unsigned char c,
+                       size_t *idx) {
+  size_t lo = 0, hi = node->n_children;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    unsigned char first = (unsigned char)node->children[mid]->label[0];
+    if (first == c) {
+      *idx = mid;
+      return true;
+    }
+    if (first < c)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *idx = lo;
+  return false;
+}
+
+static void insert_child(locker_trie_node_t *node, size_t idx,
+                         locker_trie_node_t *child) {
+  locker_trie_node_t **children =
+      realloc(node->children, (node->n_children + 1) * sizeof(*children));
+  if (!children) {
+    perror("realloc");
+    exit(EXIT_FAILURE);
+  }
+
+  memmove(children + idx + 1, children + idx,
+          (node->n_children - idx) * sizeof(*children));
+  children[idx] = child;
+  node->children = children;
+  node->n_children++;
+}
+
+static void remove_child(locker_trie_node_t *node, size_t idx) {
+  memmove(node->children + idx, node->children + idx + 1,
+          (node->n_children - idx - 1) * sizeof(*node->children));
+  node->n_children--;
+}
+
+static bool node_insert(locker_trie_node_t *node, const char *key,
+                        size_t key_len, sqlite3_int64 item_id, int item_type) {
+  if (key_len == 0) {
+    bool added = node->item_id == 0;
+    node->item_id = item_id;
+    node->item_type = item_type;
+    if (added)
+      node->count++;
+    return added;
+  }
+
+  size_t idx;
+  if (!find_child(node, (unsigned char)key[0], &idx)) {
+    locker_trie_node_t *leaf = node_new(key, key_len);
+    leaf->item_id = item_id;
+    leaf->item_type = item_type;
+    leaf->count = 1;
+    insert_child(node, idx, leaf);
+    node->count++;
+    return true;
+  }
+
+  locker_trie_node_t *child = node->children[idx];
+  size_t common = 0;
+  while (common < child->label_len && common < key_len &&
+         child->label[common] == key[common])
+    common++;
+
+  if (common < child->label_len) {
+    /* key leaves the edge halfway, split it at the divergence point */
+    locker_trie_node_t *split = node_new(child->label, common);
+    split->count = child->count;
+    insert_child(split, 0, child);
+
+    memmove(child->label, child->label + common, child->label_len - common);
+    child->label_len -= common;
+    child->label[child->label_len] = '\0';
+
+    node->children[idx] = split;
+    child = split;
+  }
+
+  bool added =
+      node_insert(child, key + common, key_len - common, item_id, item_type);
+  if (added)
+    node->count++;
+  return added;
+}
+
+static bool node_remove(locker_trie_node_t *node, const char *key,
+                        size_t key_len) {
+  if (key_len == 0) {
+    if (node->item_id == 0)
+      return false;
+    node->item_id = 0;
+    node->count--;
+    return true;
+  }
+
+  size_t idx;
+  if (!find_child(node, (unsigned char)key[0], &idx))
+    return false;
+
+  locker_trie_node_t *child = node->children[idx];
+  if (child->label_len > key_len ||
+      memcmp(child->label, key, child->label_len) != 0)
+    return false;
+
+  if (!node_remove(child, key + child->label_len, key_len - child->label_len))
+    return false;
+  node->count--;
+
+  if (child->count == 0) {
+    /* nothing is left below, so it has no children either */
+    remove_child(node, idx);
+    node_free(child);
+  } else if (child->item_id == 0 && child->n_children == 1) {
+    /* a pass-through node, fold it into its only child */
+    locker_trie_node_t *only = child->children[0];
+    char *label = malloc(child->label_len + only->label_len + 1);
+    if (!label) {
+      perror("malloc");
+      exit(EXIT_FAILURE);
+    }
+    memcpy(label, child->label, child->label_len);
+    memcpy(label + child->label_len, only->label, only->label_len + 1);
+
+    free(only->label);
+    only->label = label;
+    only->label_len += child->label_len;
+
+    child->n_children = 0;
+    node_free(child);
+    node->children[idx] = only;
+  }
+
+  return true;
+}
+
+/*
+ * Walks down along prefix, which may end inside an edge. label_off is how
+ * much of the returned node's label the prefix covers.
+ */
+static const locker_trie_node_t *node_find(const locker_trie_node_t *node,
+                                           const char *prefix,
+                                           size_t *label_off) {
+  size_t len = strlen(prefix);
+  *label_off = node->label_len;
+
+  while (len > 0) {
+    size_t idx;
+    if (!find_child(node, (unsigned char)prefix[0], &idx))
+      return NULL;
+
+    node = node->children[idx];
+    size_t n = len < node->label_len ? len : node->label_len;
+    if (memcmp(node->label, prefix, n) != 0)
+      return NULL;
+
+    prefix += n;
+    len -= n;
+    *label_off = n;
+  }
+
+  return node;
+}
+
+ATTR_ALLOC ATTR_NODISCARD locker_trie_t *trie_new(void) {
+  locker_trie_t *trie = calloc(1, sizeof(locker_trie_t));
+  if (!trie) {
+    perror("calloc");
+    exit(EXIT_FAILURE);
+  }
+
+  trie->root.label = strdup("");
+  if (!trie->root.label) {
+    perror("strdup");
+    exit(EXIT_FAILURE);
+  }
+
+  return trie;
+}
+
+void trie_free(locker_trie_t trie[static 1]) {
+  for (size_t i = 0; i < trie->root.n_children; i++)
+    node_free(trie->root.children[i]);
+  free(trie->root.children);
+  free(trie->root.label);
+  free(trie);
+}
+
+/* an existing key keeps its place and only gets the new item id */
+void trie_insert(locker_trie_t trie[static 1], const char key[static 1],
+                 sqlite3_int64 item_id, int item_type) {
+  node_insert(&trie->root, key, strlen(key), item_id, item_type);
+}
+
+bool trie_remove(locker_trie_t trie[static 1], const char key[static 1]) {
+  return node_remove(&trie->root, key, strlen(key));
+}
+
+/* exact key lookup, a prefix ending inside an edge is no key */
+bool trie_find(const locker_trie_t trie[static 1], const char key[static 1],
+               sqlite3_int64 *item_id, int *item_type) {
+  size_t label_off;
+  const locker_trie_node_t *node = node_find(&trie->root, key, &label_off);
+  if (!node || label_off != node->label_len || node->item_id == 0)
+    return false;
+
+  *item_id = node->item_id;
+  *item_type = node->item_type;
+  return true;
+}
+
+size_t trie_count_prefix(const locker_trie_t trie[static 1],
+                         const char prefix[static 1]) {
+  size_t label_off;
+  const locker_trie_node_t *node = node_find(&trie->root, prefix, &label_off);
+  return node ? node->count : 0;
+}
+
+static size_t append_bounded(char out[], size_t out_sz, size_t n,
+                             const char *s, size_t len) {
+  if (n + len >= out_sz)
+    len = out_sz - 1 - n;
+  memcpy(out + n, s, len);
+  return n + len;
+}
+
+/*
+ * Extends prefix for as long as every key below it agrees, which is the rest
+ * of the edge plus any chain of single-child nodes no key ends on.
+ */
+size_t trie_complete(const locker_trie_t trie[static 1],
+                     const char prefix[static 1], char out[], size_t out_sz) {
+  if (out_sz == 0)
+    return 0;
+
+  size_t n = append_bounded(out, out_sz, 0, prefix, strlen(prefix));
+
+  size_t label_off;
+  const locker_trie_node_t *node = node_find(&trie->root, prefix, &label_off);
+  if (node && node->count > 0) {
+    n = append_bounded(out, out_sz, n, node->label + label_off,
+                       node->label_len - label_off);
+    while (node->item_id == 0 && node->n_children == 1) {
+      node = node->children[0];
+      n = append_bounded(out, out_sz, n, node->label, node->label_len);
+    }
+  }
+
+  out[n] = '\0';
+  return n;
+}
+
+typedef struct {
+  char *path;
+  size_t len;
+  size_t capacity;
+  char separator;
+  array_locker_trie_entry_t *entries;
+} browse_ctx_t;
+
+static void browse_append(browse_ctx_t *ctx, const char *s, size_t len) {
+  if (ctx->len + len + 1 > ctx->capacity) {
+    ctx->capacity = (ctx->len + len + 1) * 2;
+    ctx->path = realloc(ctx->path, ctx->capacity);
+    if (!ctx->path) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+  }
+  memcpy(ctx->path + ctx->len, s, len);
+  ctx->len += len;
+  ctx->path[ctx->len] = '\0';
+}
+
+static void browse_emit(browse_ctx_t *ctx, size_t count, sqlite3_int64 item_id,
+                        int item_type) {
+  locker_trie_entry_t entry = {.name = strdup(ctx->path),
+                               .count = count,
+                               .item_id = item_id,
+                               .item_type = item_type};
+  if (!entry.name) {
+    perror("strdup");
+    exit(EXIT_FAILURE);
+  }
+  locker_array_append(ctx->entries, entry);
+}
+
+/* stops at the first separator, so only one namespace level is visited */
+static void browse_node(browse_ctx_t *ctx, const locker_trie_node_t *node,
+                        size_t label_off) {
+  size_t mark = ctx->len;
+  const char *rest = node->label + label_off;
+  size_t rest_len = node->label_len - label_off;
+
+  const char *sep = memchr(rest, ctx->separator, rest_len);
+  if (sep) {
+    browse_append(ctx, rest, sep - rest + 1);
+    browse_emit(ctx, node->count, 0, 0);
+    ctx->len = mark;
+    return;
+  }
+
+  browse_append(ctx, rest, rest_len);
+  /* the prefix itself is not below the prefix */
+  if (node->item_id != 0 && ctx->len > 0)
+    browse_emit(ctx, 1, node->item_id, node->item_type);
+
+  for (size_t i = 0; i < node->n_children; i++)
+    browse_node(ctx, node->children[i], 0);
+
+  ctx->len = mark;
+}
+
+/*
+ * Names below prefix up to and including the next separator, in byte order.
+ * Costs one visit per node above the next separator, not one per key.
+ */
+ATTR_ALLOC ATTR_NODISCARD array_locker_trie_entry_t *
+trie_browse(const locker_trie_t trie[static 1], const char prefix[static 1],
+            char separator) {
+  array_locker_trie_entry_t *entries = malloc(sizeof(array_locker_trie_entry_t));
+  if (!entries) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  init_item_array(entries);
+
+  size_t label_off;
+  const locker_trie_node_t *node = node_find(&trie->root, prefix, &label_off);
+  if (!node)
+    return entries;
+
+  browse_ctx_t ctx = {.separator = separator, .entries = entries};
+  browse_append(&ctx, "", 0);
+  browse_node(&ctx, node, label_off);
+  free(ctx.path);
+
+  return entries;
+}
+
+void trie_free_entry(locker_trie_entry_t entry) { free(entry.name); }
@@ -1,11 +1,14 @@
 #include "attrs.h"
 #include "locker.h"
 #include "locker_logs.h"
+#include "locker_tui_events.h"
 #include "locker_tui_utils.h"
 #include "locker_utils.h"
 #include "locker_version.h"
 #include "sodium/utils.h"
 #include "ncursesw/ncurses.h"
+#include <ctype.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +25,7 @@ typedef enum {
   VIEW_LOCKER,
   VIEW_ADD_ITEM,
   VIEW_ITEM_LIST,
+  VIEW_ITEM_TREE,
   VIEW_EXIT,
 } view_t;
 
@@ -74,6 +78,21 @@ void free_account_form_rows(account_form_t *form) {
     free(form->url);
 }
 
+typedef struct {
+    char *key;
+    char *description;
+    char *text;
+} note_form_t;
+
+void free_note_form_rows(note_form_t *form) {
+    free(form->key);
+    free(form->description);
+
+    /* set memory used for storing note to 0 to remove it from registers */
+    sodium_memzero(form->text, strlen(form->text));
+    free(form->text);
+}
+
 void startup_view(context_t *ctx) {
   clear();
 
@@ -135,8 +154,7 @@ void locker_list_view(context_t *ctx) {
 
   while(1){
     mvprintw(2, 2, "Passphrase: ");
-    refresh();
-    getnstr(passphrase, sizeof(passphrase) - 1);
+    get_user_line(sizeof(passphrase), passphrase, 2, 2+strlen("Passphrase: "), false);
 
     locker_result_t rc = locker_open(&(ctx->locker), ctx->workdir, lockers->values[locker], passphrase);
     if (rc == LOCKER_OK) {
@@ -146,11 +164,17 @@ void locker_list_view(context_t *ctx) {
         mvprintw(4, 2, "Invalid passphrase.");
     } else if (rc == LOCKER_MALFORMED_HEADER) {
         mvprintw(4, 2, "Locker file you're trying to access is malformed. Check log file for more information.");
+    } else if (rc == LOCKER_INVALID_LOCKER_FILE) {
+        mvprintw(4, 2, "Locker file you're trying to access is corrupted. Check log file for more information.");
+    } else if (rc == LOCKER_DB_ERROR) {
+        mvprintw(4, 2, "Locker you're trying to access could not be read. Check log file for more information.");
+    } else if (rc == LOCKER_BUSY) {
+        mvprintw(4, 2, "Locker you're trying to access is open in another session.");
     }
 
     print_control_panel(sizeof(unlock_file_control_options)/sizeof(char*), unlock_file_control_options, 1+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
 
-    int ch = getch();
+    int ch = tui_wait_key();
     if(ch == BACKSPACE_KEY) {
         locker_array_t_free(lockers, free);
         return;
@@ -164,10 +188,84 @@ void locker_list_view(context_t *ctx) {
   }
 
   mvprintw(3, PRINTW_DEFAULT_X_OFFSET, "Something went wrong. Check logs for more information.");
-  getch();
+  tui_wait_key();
   ctx->view = VIEW_LOCKER_LIST;
 }
 
+typedef struct {
+    const char **rows;
+    char **rows_content;
+    const unsigned int *rows_max_len;
+    int n_rows;
+    int highlight;
+    /* set once CTRL-X found the form complete */
+    bool save;
+} new_locker_form_t;
+
+bool new_locker_form_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+    (void)loop;
+    new_locker_form_t *form = arg;
+    int n_rows = form->n_rows;
+
+    if(event->type == TUI_EVENT_KEY) {
+        switch (event->value) {
+        case KEY_UP:
+            if (form->highlight == 0)
+                form->highlight = n_rows;
+            form->highlight--;
+            break;
+        case KEY_DOWN:
+            form->highlight++;
+            if (form->highlight >= n_rows)
+                form->highlight = 0;
+            break;
+        case CTRL_X_KEY:
+            if(strlen(form->rows_content[0])<1) {
+                mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Locker name cannot be empty.");
+                clrtoeol();
+                break;
+            }
+            if(strlen(form->rows_content[1])<1) {
+                mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Passphrase cannot be empty.");
+                clrtoeol();
+                break;
+            }
+            if (strcmp(form->rows_content[1], form->rows_content[2]) == 0) {
+                form->save = true;
+                return false;
+            }
+            mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Passphrases do not match!");
+            clrtoeol();
+            break;
+        case BACKSPACE_KEY:
+            return false;
+        case ENTER_KEY: {
+            /* passphrases are typed blind */
+            bool typing = form->highlight == 0;
+            get_user_str(form->rows_max_len[form->highlight], form->rows_content[form->highlight], form->highlight + 2,
+                        strlen(form->rows[form->highlight]) + 3, n_rows + 4, PRINTW_DEFAULT_X_OFFSET, typing, typing, A_STANDOUT);
+            break;
+        }
+        }
+    }
+
+    for (int i = 0; i < n_rows; i++) {
+        if (i == form->highlight)
+            attron(A_STANDOUT);
+        if (i > 0)
+            mvprintw(i + 2, PRINTW_DEFAULT_X_OFFSET, "%s", form->rows[i]);
+        else
+            mvprintw(i + 2, PRINTW_DEFAULT_X_OFFSET, "%s %s", form->rows[i], form->rows_content[i]);
+        if (i == form->highlight)
+            attroff(A_STANDOUT);
+    }
+
+    const char *control_options[] = {"CTRL-X: Add", "BACKSPACE: Return"};
+    print_control_panel(sizeof(control_options)/sizeof(char *), control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+n_rows, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+    refresh();
+    return true;
+}
+
 void new_locker_view(context_t *ctx) {
   clear();
 
@@ -202,82 +300,19 @@ void new_locker_view(context_t *ctx) {
   }
 
 
-  const char *control_options[] = {"CTRL-X: Add", "BACKSPACE: Return"};
-
   int rc = 0;
   do {
-    bool save = false;
-    int highlight = 0;
-    while (!save) {
-        for (int i = 0; i < n_rows; i++) {
-        if (i == highlight)
-            attron(A_STANDOUT);
-        if (i > 0)
-            mvprintw(i + 2, PRINTW_DEFAULT_X_OFFSET, "%s", rows[i]);
-        else
-            mvprintw(i + 2, PRINTW_DEFAULT_X_OFFSET, "%s %s", rows[i], rows_content[i]);
-        if (i == highlight)
-            attroff(A_STANDOUT);
-        }
-
-        print_control_panel(sizeof(control_options)/sizeof(char *), control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+n_rows, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
-        refresh();
-
-        bool typing = true;
-        bool show_cursor = true;
-
-        int ch = getch();
-        switch (ch) {
-        case KEY_UP:
-            if (highlight == 0)
-                highlight = n_rows;
-            highlight--;
-            break;
-        case KEY_DOWN:
-            highlight++;
-            if (highlight >= n_rows)
-                highlight = 0;
-            break;
-        case CTRL_X_KEY:
-            if(strlen(rows_content[0])<1) {
-                mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Locker name cannot be empty.");
-                clrtoeol();
-                break;
-            }
-            if(strlen(rows_content[1])<1) {
-                mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Passphrase cannot be empty.");
-                clrtoeol();
-                break;
-            }
-            if (strcmp(rows_content[1], rows_content[2]) == 0)
-                save = true;
-            else {
-              mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Passphrases do not match!");
-              clrtoeol();
-            }
-            break;
-        case BACKSPACE_KEY:
-            free(rows_content[0]);
-            free(rows_content[1]);
-            free(rows_content[2]);
-            ctx->view = VIEW_STARTUP;
-            return;
-        case ENTER_KEY:
-            if(highlight>0){
-                typing = false;
-                show_cursor = false;
-            } else {
-                typing = true;
-                show_cursor = true;
-            }
-
-            get_user_str(rows_max_len[highlight], rows_content[highlight], highlight + 2,
-                        strlen(rows[highlight]) + 3, n_rows + 4, PRINTW_DEFAULT_X_OFFSET, typing, show_cursor, A_STANDOUT);
-            break;
-        }
-  }
+    new_locker_form_t form = {.rows = rows, .rows_content = rows_content, .rows_max_len = rows_max_len, .n_rows = n_rows};
+    tui_events_run(new_locker_form_handle, &form);
+    if(!form.save) {
+        free(rows_content[0]);
+        free(rows_content[1]);
+        free(rows_content[2]);
+        ctx->view = VIEW_STARTUP;
+        return;
+    }
 
-    locker_result_t rc = locker_create(ctx->workdir, rows_content[0], rows_content[1]);
+    rc = locker_create(ctx->workdir, rows_content[0], rows_content[1]);
 
     if(rc == LOCKER_NAME_FORBIDDEN_CHAR) {
         mvprintw(n_rows+3, PRINTW_DEFAULT_X_OFFSET, "Locker name can only contain alphanumeric characers.");
@@ -296,6 +331,39 @@ void new_locker_view(context_t *ctx) {
   ctx->view = VIEW_LOCKER;
 }
 
+void print_save_status(const context_t *ctx) {
+  move(ctx->win_size.rows-1, PRINTW_DEFAULT_X_OFFSET);
+  clrtoeol();
+
+  locker_save_state_t state = locker_save_state(ctx->locker);
+  if (state == LOCKER_SAVE_FAILED) {
+    mvprintw(ctx->win_size.rows-1, PRINTW_DEFAULT_X_OFFSET, "Could not save your Locker, edits are kept in its journal. Check log file for more information.");
+  } else if (state != LOCKER_SAVE_IDLE) {
+    attron(A_DIM);
+    mvprintw(ctx->win_size.rows-1, PRINTW_DEFAULT_X_OFFSET, "Saving...");
+    attroff(A_DIM);
+  }
+}
+
+/* the save state is polled only while a save runs, an idle view sleeps until a key */
+void update_save_status(const context_t *ctx, tui_loop_t *loop) {
+  print_save_status(ctx);
+  locker_save_state_t state = locker_save_state(ctx->locker);
+  if (state == LOCKER_SAVE_PENDING || state == LOCKER_SAVE_RUNNING)
+    tui_timer_start(loop, SAVE_STATUS_TIMER, SAVE_STATUS_REFRESH_MS);
+  else
+    tui_timer_stop(loop, SAVE_STATUS_TIMER);
+}
+
+/* true when the terminal changed size since the last call */
+bool update_win_size(context_t *ctx) {
+  window_size_t size;
+  getmaxyx(stdscr, size.rows, size.cols);
+  bool changed = size.rows != ctx->win_size.rows || size.cols != ctx->win_size.cols;
+  ctx->win_size = size;
+  return changed;
+}
+
 void locker_view(context_t *ctx) {
   if (!ctx->locker) {
     ctx->view = VIEW_LOCKER_LIST;
@@ -305,11 +373,12 @@ void locker_view(context_t *ctx) {
   clear();
 
   attron(A_BOLD);
-  mvprintw(1, PRINTW_DEFAULT_X_OFFSET, "%s", ctx->locker->locker_name);
+  mvprintw(1, PRINTW_DEFAULT_X_OFFSET, "%s", locker_get_name(ctx->locker));
   attroff(A_BOLD);
 
   const char *choices[] = {
       "List items",
+      "Browse items",
       "Add item",
       "Save and close",
   };
@@ -318,6 +387,7 @@ void locker_view(context_t *ctx) {
   const char *control_options[] = {"BACKSPACE: Return"};
 
   print_control_panel(sizeof(control_options)/sizeof(char*), control_options, n_choices+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+  print_save_status(ctx);
   int option = choice_selector(sizeof(choices) / sizeof(char *), choices, 1);
 
   switch (option) {
@@ -325,11 +395,14 @@ void locker_view(context_t *ctx) {
     ctx->view = VIEW_ITEM_LIST;
     break;
   case 1:
+    ctx->view = VIEW_ITEM_TREE;
+    break;
+  case 2:
     ctx->view = VIEW_ADD_ITEM;
     break;
 
   case RETURN_OPTION:
-  case 2:
+  case 3:
     close_locker(ctx->locker);
     ctx->locker = NULL;
     ctx->view = VIEW_LOCKER_LIST;
@@ -338,6 +411,115 @@ void locker_view(context_t *ctx) {
 }
 
 
+/* prints text up to its first line break and the screen edge, noting the lines left out */
+void print_first_line(const char *text) {
+    int y, x;
+    getyx(stdscr, y, x);
+    (void)y;
+
+    const char *newline = strchr(text, '\n');
+    size_t len = newline ? (size_t)(newline - text) : strlen(text);
+    int room = getmaxx(stdscr) - x;
+    addnstr(text, (int)MIN(len, (size_t)MAX(room, 0)));
+
+    if (newline) {
+        size_t n_lines = 1;
+        for (const char *c = newline; *c; c++)
+            n_lines += *c == '\n';
+        printw(" (%zu lines)", n_lines);
+    }
+}
+
+typedef struct {
+    char **rows;
+    char **rows_content;
+    const unsigned int *rows_max_len;
+    /* message shown when a required row is left empty, NULL for optional rows */
+    const char **missing;
+    /* rows edited as text of several lines, NULL when there are none */
+    const bool *multiline;
+    int n_rows;
+    int y_offset;
+    int x_offset;
+    int n_control_options;
+    const char **control_options;
+    int highlight;
+    /* 0 once saved, BACKSPACE_KEY when the form was left */
+    int result;
+} item_form_t;
+
+bool item_form_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+    (void)loop;
+    item_form_t *form = arg;
+    int n_rows = form->n_rows;
+
+    if (event->type == TUI_EVENT_KEY) {
+        switch (event->value) {
+        case KEY_UP:
+            if (form->highlight == 0)
+                form->highlight = n_rows;
+            form->highlight--;
+            break;
+        case KEY_DOWN:
+            form->highlight++;
+            if (form->highlight >= n_rows)
+                form->highlight = 0;
+            break;
+        case CTRL_X_KEY:
+            for (int i = 0; i < n_rows; i++) {
+                if (form->missing[i] && strlen(form->rows_content[i]) < 1) {
+                    mvprintw(6, form->x_offset, "%s", form->missing[i]);
+                    clrtoeol();
+                    goto draw;
+                }
+            }
+            /* clear sensitive information in case scrollback is on */
+            clear_lines_inplace(form->y_offset, n_rows);
+            form->result = 0;
+            return false;
+        case BACKSPACE_KEY:
+            /* clear sensitive information in case scrollback is on */
+            clear_lines_inplace(form->y_offset, n_rows);
+            form->result = BACKSPACE_KEY;
+            return false;
+        case ENTER_KEY: {
+            int y = form->highlight + form->y_offset, x = strlen(form->rows[form->highlight]) + 3;
+            if (form->multiline && form->multiline[form->highlight]) {
+                /* the text gets the screen below its label, the controls go on the last row */
+                int n_lines = MAX(getmaxy(stdscr) - y - 2, 1);
+                move(y, 0);
+                clrtobot();
+                mvprintw(y, form->x_offset, "%s", form->rows[form->highlight]);
+                get_user_text(form->rows_max_len[form->highlight], form->rows_content[form->highlight], y, x,
+                        n_lines, MAX(getmaxx(stdscr) - x - 1, 1), y + n_lines + 1, form->x_offset);
+                /* clear sensitive information in case scrollback is on */
+                move(y, 0);
+                clrtobot();
+            } else {
+                get_user_str(form->rows_max_len[form->highlight], form->rows_content[form->highlight], y,
+                        x, n_rows + PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, form->x_offset, true, true, A_STANDOUT);
+            }
+            break;
+        }
+        }
+    }
+
+draw:
+    for (int i = 0; i < n_rows; i++) {
+        if (i == form->highlight)
+            attron(A_STANDOUT);
+        mvprintw(i + form->y_offset, form->x_offset, "%s ", form->rows[i]);
+        print_first_line(form->rows_content[i]);
+        if (i == form->highlight)
+            attroff(A_STANDOUT);
+        clrtoeol();
+    }
+
+    print_control_panel(form->n_control_options, form->control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+n_rows, form->x_offset, TAB_LEN);
+    refresh();
+    return true;
+}
+
 int apikey_form(apikey_form_t form[static 1], locker_item_apikey_t *apikey, int y_offset, int x_offset, int n_control_options, const char **control_options) {
     char *rows[] = {
         "Key:",
@@ -365,55 +547,17 @@ int apikey_form(apikey_form_t form[static 1], locker_item_apikey_t *apikey, int
 
     char *rows_content[] = {form->key, form->description, form->value};
 
-    int highlight = 0;
-    while (1) {
-        for (int i = 0; i < n_rows; i++) {
-        if (i == highlight)
-            attron(A_STANDOUT);
-        mvprintw(i + y_offset, x_offset, "%s %s", rows[i], rows_content[i]);
-        if (i == highlight)
-            attroff(A_STANDOUT);
-        }
-
-        print_control_panel(n_control_options, control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+n_rows, x_offset, TAB_LEN);
-        refresh();
+    /* the API key itself is required as well */
+    const char *missing[] = {"Item key is missing.", NULL, "API Key is missing."};
+    /* certificates and config files are pasted in whole */
+    const bool multiline[] = {false, false, true};
 
-        int ch = getch();
-        switch (ch) {
-        case KEY_UP:
-        if (highlight == 0)
-            highlight = n_rows;
-        highlight--;
-        break;
-        case KEY_DOWN:
-        highlight++;
-        if (highlight >= n_rows)
-            highlight = 0;
-        break;
-        case CTRL_X_KEY:
-            if(strlen(form->key)<1) {
-                mvprintw(6, x_offset, "Item key is missing.");
-                clrtoeol();
-                break;
-            }
-            if(strlen(form->value)<1) {
-                mvprintw(6, x_offset, "API Key is missing.");
-                clrtoeol();
-                break;
-            }
-            /* clear sensitive information in case scrollback is on */
-            clear_lines_inplace(y_offset, n_rows);
-            return 0;
-        case BACKSPACE_KEY:
-            /* clear sensitive information in case scrollback is on */
-            clear_lines_inplace(y_offset, n_rows);
-            return BACKSPACE_KEY;
-        case ENTER_KEY:
-            get_user_str(rows_max_len[highlight], rows_content[highlight], highlight + y_offset,
-                    strlen(rows[highlight]) + 3, n_rows + PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, x_offset, true, true, A_STANDOUT);
-            break;
-        }
-    }
+    item_form_t item_form = {
+        .rows = rows, .rows_content = rows_content, .rows_max_len = rows_max_len, .missing = missing, .multiline = multiline, .n_rows = n_rows,
+        .y_offset = y_offset, .x_offset = x_offset, .n_control_options = n_control_options, .control_options = control_options,
+    };
+    tui_events_run(item_form_handle, &item_form);
+    return item_form.result;
 }
 
 int account_form(account_form_t form[static 1], locker_item_account_t *account, int y_offset, int x_offset, int n_control_options, const char **control_options) {
@@ -448,50 +592,53 @@ int account_form(account_form_t form[static 1], locker_item_account_t *account,
 
     char *rows_content[] = {form->key, form->description, form->username, form->password, form->url};
 
-    int highlight = 0;
-    while (1) {
-        for (int i = 0; i < n_rows; i++) {
-        if (i == highlight)
-            attron(A_STANDOUT);
-        mvprintw(i + y_offset, x_offset, "%s %s", rows[i], rows_content[i]);
-        if (i == highlight)
-            attroff(A_STANDOUT);
-        }
+    const char *missing[] = {"Item key is missing.", NULL, NULL, NULL, NULL};
 
-        print_control_panel(n_control_options, control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+n_rows, x_offset, TAB_LEN);
-        refresh();
+    item_form_t item_form = {
+        .rows = rows, .rows_content = rows_content, .rows_max_len = rows_max_len, .missing = missing, .n_rows = n_rows,
+        .y_offset = y_offset, .x_offset = x_offset, .n_control_options = n_control_options, .control_options = control_options,
+    };
+    tui_events_run(item_form_handle, &item_form);
+    return item_form.result;
+}
 
-        int ch = getch();
-        switch (ch) {
-        case KEY_UP:
-        if (highlight == 0)
-            highlight = n_rows;
-        highlight--;
-        break;
-        case KEY_DOWN:
-        highlight++;
-        if (highlight >= n_rows)
-            highlight = 0;
-        break;
-        case CTRL_X_KEY:
-            if(strlen(form->key)<1) {
-                mvprintw(6, x_offset, "Item key is missing.");
-                clrtoeol();
-                break;
-            }
-            /* clear sensitive data in case scrollback is on */
-            clear_lines_inplace(y_offset, n_rows);
-            return 0;
-        case BACKSPACE_KEY:
-            /* clear sensitive data in case scrollback is on */
-            clear_lines_inplace(y_offset, n_rows);
-            return BACKSPACE_KEY;
-        case ENTER_KEY:
-        get_user_str(rows_max_len[highlight], rows_content[highlight], highlight + y_offset,
-                    strlen(rows[highlight]) + 3, n_rows + PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, x_offset, true, true, A_STANDOUT);
-        break;
-        }
+/* the text may be as long as a note can be, calloc leaves untouched pages unmapped */
+int note_form(note_form_t form[static 1], const locker_item_note_t *note, int y_offset, int x_offset, int n_control_options, const char **control_options) {
+    char *rows[] = {
+        "Key:",
+        "Description:",
+        "Text:",
+    };
+    unsigned int rows_max_len[] = {LOCKER_ITEM_KEY_MAX_LEN,
+                               LOCKER_ITEM_DESCRIPTION_MAX_LEN, LOCKER_ITEM_NOTE_MAX_LEN};
+    int n_rows = sizeof(rows) / sizeof(char *);
+
+    form->key = calloc((LOCKER_ITEM_KEY_MAX_LEN) + 1, sizeof(char));
+    form->description = calloc((LOCKER_ITEM_DESCRIPTION_MAX_LEN) + 1, sizeof(char));
+    form->text = calloc((LOCKER_ITEM_NOTE_MAX_LEN)+1, sizeof(char));
+
+    if (!form->key || !form->description || !form->text) {
+      perror("calloc");
+      exit(EXIT_FAILURE);
+    }
+
+    if(note) {
+        memcpy(form->key, note->key, strlen(note->key));
+        memcpy(form->description, note->description, strlen(note->description));
+        memcpy(form->text, note->content, note->size);
     }
+
+    char *rows_content[] = {form->key, form->description, form->text};
+
+    const char *missing[] = {"Item key is missing.", NULL, NULL};
+    const bool multiline[] = {false, false, true};
+
+    item_form_t item_form = {
+        .rows = rows, .rows_content = rows_content, .rows_max_len = rows_max_len, .missing = missing, .multiline = multiline, .n_rows = n_rows,
+        .y_offset = y_offset, .x_offset = x_offset, .n_control_options = n_control_options, .control_options = control_options,
+    };
+    tui_events_run(item_form_handle, &item_form);
+    return item_form.result;
 }
 
 void add_apikey_view(context_t ctx[static 1]) {
@@ -517,6 +664,9 @@ void add_apikey_view(context_t ctx[static 1]) {
     if (rc == LOCKER_ITEM_KEY_EXISTS) {
         mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Given key already exisit in your Locker.");
         clrtoeol();
+    } else if (rc == LOCKER_DB_ERROR) {
+        mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Could not write to your Locker. Check log file for more information.");
+        clrtoeol();
     }
 
   } while(rc != LOCKER_OK);
@@ -526,7 +676,13 @@ void add_apikey_view(context_t ctx[static 1]) {
 }
 
 void edit_apikey_view(context_t *ctx, locker_item_t item[static 1]) {
-    locker_item_apikey_t *apikey = locker_get_apikey(ctx->locker, item->id);
+    locker_arena_t secrets;
+    arena_init(&secrets, true);
+    locker_item_apikey_t *apikey = locker_get_apikey(ctx->locker, item->id, &secrets);
+    if (!apikey) {
+        arena_release(&secrets);
+        return;
+    }
 
     clear();
 
@@ -540,6 +696,7 @@ void edit_apikey_view(context_t *ctx, locker_item_t item[static 1]) {
     int rc = 0;
     do {
         if(apikey_form(&form, apikey, 2, PRINTW_DEFAULT_X_OFFSET, sizeof(control_options)/sizeof(char*), control_options) == BACKSPACE_KEY) {
+            arena_release(&secrets);
             return;
         }
 
@@ -548,7 +705,7 @@ void edit_apikey_view(context_t *ctx, locker_item_t item[static 1]) {
     } while(rc != LOCKER_OK);
 
     free_apikey_form_rows(&form);
-    locker_free_apikey(apikey);
+    arena_release(&secrets);
 }
 
 void add_account_view(context_t *ctx) {
@@ -574,6 +731,9 @@ void add_account_view(context_t *ctx) {
     if (rc == LOCKER_ITEM_KEY_EXISTS) {
         mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Given key already exisit in your Locker.");
         clrtoeol();
+    } else if (rc == LOCKER_DB_ERROR) {
+        mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Could not write to your Locker. Check log file for more information.");
+        clrtoeol();
     }
 
   } while(rc != LOCKER_OK);
@@ -584,7 +744,13 @@ void add_account_view(context_t *ctx) {
 }
 
 void edit_account_view(context_t *ctx, locker_item_t item[static 1]) {
-    locker_item_account_t *account = locker_get_account(ctx->locker, item->id);
+    locker_arena_t secrets;
+    arena_init(&secrets, true);
+    locker_item_account_t *account = locker_get_account(ctx->locker, item->id, &secrets);
+    if (!account) {
+        arena_release(&secrets);
+        return;
+    }
 
     clear();
 
@@ -599,6 +765,7 @@ void edit_account_view(context_t *ctx, locker_item_t item[static 1]) {
     int rc = 0;
     do {
         if(account_form(&form, account, 2, PRINTW_DEFAULT_X_OFFSET, sizeof(control_options)/sizeof(char*), control_options) == BACKSPACE_KEY) {
+            arena_release(&secrets);
             return;
         }
 
@@ -607,11 +774,108 @@ void edit_account_view(context_t *ctx, locker_item_t item[static 1]) {
         if (rc == LOCKER_ITEM_KEY_EXISTS) {
             mvprintw(8, PRINTW_DEFAULT_X_OFFSET, "Given key already exisit in your Locker.");
             clrtoeol();
+        } else if (rc == LOCKER_DB_ERROR) {
+            mvprintw(8, PRINTW_DEFAULT_X_OFFSET, "Could not write to your Locker. Check log file for more information.");
+            clrtoeol();
         }
     } while(rc != LOCKER_OK);
 
     free_account_form_rows(&form);
-    locker_free_account(account);
+    arena_release(&secrets);
+}
+
+void add_note_view(context_t *ctx) {
+  clear();
+
+  attron(A_BOLD);
+  mvprintw(1, PRINTW_DEFAULT_X_OFFSET, "Add Item");
+  attroff(A_BOLD);
+
+  const char *control_options[] = {"CTRL-X: Add", "BACKSPACE: Return"};
+
+  note_form_t form = {0};
+
+  int rc = 0;
+  do {
+      if(note_form(&form, NULL, 2, PRINTW_DEFAULT_X_OFFSET, sizeof(control_options)/sizeof(char*), control_options) == BACKSPACE_KEY) {
+          free_note_form_rows(&form);
+          ctx->view = VIEW_LOCKER;
+          return;
+      }
+
+    locker_item_note_t item = {.id=0, .key=form.key, .description=form.description, .size=strlen(form.text), .content=form.text};
+    rc = locker_add_note(ctx->locker, &item);
+    /* the next form starts from fresh rows */
+    free_note_form_rows(&form);
+    if (rc == LOCKER_ITEM_KEY_EXISTS) {
+        mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Given key already exisit in your Locker.");
+        clrtoeol();
+    } else if (rc == LOCKER_DB_ERROR) {
+        mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Could not write to your Locker. Check log file for more information.");
+        clrtoeol();
+    }
+  } while(rc != LOCKER_OK);
+
+  ctx->view = VIEW_ITEM_LIST;
+}
+
+/* the note is read whole for editing, binary ones are only replaced from the command line */
+void edit_note_view(context_t *ctx, locker_item_t item[static 1]) {
+    locker_arena_t secrets;
+    arena_init(&secrets, true);
+    locker_item_note_t *note = locker_get_note(ctx->locker, item->id, &secrets);
+    if (!note) {
+        arena_release(&secrets);
+        return;
+    }
+
+    clear();
+
+    attron(A_BOLD);
+    mvprintw(1, PRINTW_DEFAULT_X_OFFSET, "Edit Note");
+    attroff(A_BOLD);
+
+    char *text = arena_alloc(&secrets, note->size + 1);
+    size_t n_read;
+    if (locker_read_note(ctx->locker, item->id, 0, note->size, text, &n_read) != LOCKER_OK) {
+        mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Could not read your Locker. Check log file for more information.");
+        tui_wait_key();
+        arena_release(&secrets);
+        return;
+    }
+    if (memchr(text, '\0', n_read)) {
+        mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "This note holds binary data, replace it with locker add.");
+        tui_wait_key();
+        arena_release(&secrets);
+        return;
+    }
+    note->content = text;
+    note->size = n_read;
+
+    const char *control_options[] = {"CTRL-X: Save", "BACKSPACE: Return"};
+
+    note_form_t form = {0};
+    int rc = 0;
+    do {
+        if(note_form(&form, note, 2, PRINTW_DEFAULT_X_OFFSET, sizeof(control_options)/sizeof(char*), control_options) == BACKSPACE_KEY) {
+            free_note_form_rows(&form);
+            arena_release(&secrets);
+            return;
+        }
+
+        locker_item_note_t updated_note = {.id=note->id, .key=form.key, .description=form.description, .size=strlen(form.text), .content=form.text};
+        rc = locker_update_note(ctx->locker, &updated_note);
+        free_note_form_rows(&form);
+        if (rc == LOCKER_ITEM_KEY_EXISTS) {
+            mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Given key already exisit in your Locker.");
+            clrtoeol();
+        } else if (rc == LOCKER_DB_ERROR) {
+            mvprintw(6, PRINTW_DEFAULT_X_OFFSET, "Could not write to your Locker. Check log file for more information.");
+            clrtoeol();
+        }
+    } while(rc != LOCKER_OK);
+
+    arena_release(&secrets);
 }
 
 void add_item_view(context_t *ctx) {
@@ -624,6 +888,7 @@ void add_item_view(context_t *ctx) {
     const char *choices[] = {
         "Account",
         "Api Key",
+        "Note",
     };
     size_t n_choices = sizeof(choices)/sizeof(char*);
 
@@ -642,9 +907,12 @@ void add_item_view(context_t *ctx) {
         case 1:
             add_apikey_view(ctx);
             break;
+        case 2:
+            add_note_view(ctx);
+            break;
     }
 
-    save_locker(ctx->locker, ctx->workdir);
+    save_locker(ctx->locker);
 }
 
 const char *get_item_type_str(locker_item_type_t type) {
@@ -658,10 +926,42 @@ const char *get_item_type_str(locker_item_type_t type) {
     }
 }
 
-void print_apikey(context_t *ctx, const locker_item_t *item) {
-    locker_item_apikey_t *apikey = locker_get_apikey(ctx->locker, item->id);
+/* prints the lines of text from y down, cut at the screen edge, at most max_rows of them */
+int print_lines(int y, int x, const char *text, int max_rows) {
+    int room = MAX(getmaxx(stdscr) - x, 0);
+    int n_rows = 0;
+
+    while (n_rows < max_rows) {
+        const char *newline = strchr(text, '\n');
+        size_t len = newline ? (size_t)(newline - text) : strlen(text);
+
+        if (newline && n_rows == max_rows - 1) {
+            size_t n_left = 1;
+            for (const char *c = newline; *c; c++)
+                n_left += *c == '\n';
+            attron(A_DIM);
+            mvprintw(y + n_rows, x, "(%zu more lines)", n_left);
+            attroff(A_DIM);
+            return max_rows;
+        }
+
+        mvaddnstr(y + n_rows++, x, text, (int)MIN(len, (size_t)room));
+        if (!newline)
+            break;
+        text = newline + 1;
+    }
+    return MAX(n_rows, 1);
+}
+
+/* returns the rows the item took, a value of several lines is printed down the screen */
+int print_apikey(context_t *ctx, const locker_item_t *item, locker_arena_t secrets[static 1], int max_rows) {
+    locker_item_apikey_t *apikey = locker_get_apikey(ctx->locker, item->id, secrets);
 
     size_t x_offset = PRINTW_DEFAULT_X_OFFSET;
+    if (!apikey) {
+        mvprintw(1, x_offset, "Item could not be read. Check log file for more information.");
+        return 1;
+    }
 
     attron(A_BOLD);
     mvprintw(1, x_offset, "Key");
@@ -681,15 +981,20 @@ void print_apikey(context_t *ctx, const locker_item_t *item) {
     mvprintw(1, x_offset, "Value");
     attroff(A_BOLD);
 
-    mvprintw(2, x_offset, "%s", apikey->value);
+    int n_rows = print_lines(2, x_offset, apikey->value, max_rows);
 
-    locker_free_apikey(apikey);
+    arena_reset(secrets);
+    return n_rows;
 }
 
-void print_account(context_t *ctx, const locker_item_t *item) {
-    locker_item_account_t *account = locker_get_account(ctx->locker, item->id);
+int print_account(context_t *ctx, const locker_item_t *item, locker_arena_t secrets[static 1]) {
+    locker_item_account_t *account = locker_get_account(ctx->locker, item->id, secrets);
 
     size_t x_offset = PRINTW_DEFAULT_X_OFFSET;
+    if (!account) {
+        mvprintw(1, x_offset, "Item could not be read. Check log file for more information.");
+        return 1;
+    }
 
     attron(A_BOLD);
     mvprintw(1, x_offset, "Key");
@@ -727,43 +1032,135 @@ void print_account(context_t *ctx, const locker_item_t *item) {
 
     mvprintw(2, x_offset, "%s", account->url);
 
-    locker_free_account(account);
+    arena_reset(secrets);
+    return 1;
 }
 
-bool view_item(context_t *ctx, locker_item_t item[static 1]) {
-    bool item_changed = false;
+DEFINE_LOCKER_ARRAY_T(size_t, note_page);
 
-    while(1) {
-        clear();
+/* a note is paged through, only the bytes of the page on screen are read */
+typedef struct {
+    /* offsets where the pages shown so far start, the last one is on screen */
+    array_note_page_t starts;
+    /* where the page after the one on screen starts */
+    size_t next;
+    size_t size;
+} note_pages_t;
+
+void note_pages_key(note_pages_t pages[static 1], int ch) {
+    switch(ch) {
+        case KEY_NPAGE:
+        case KEY_DOWN:
+            if(pages->next < pages->size)
+                locker_array_append(&pages->starts, pages->next);
+            break;
+        case KEY_PPAGE:
+        case KEY_UP:
+            if(pages->starts.count > 1)
+                pages->starts.count--;
+            break;
+        case KEY_HOME:
+            pages->starts.count = MIN(pages->starts.count, 1);
+            break;
+    }
+}
 
-        switch(item->type) {
-            case LOCKER_ITEM_APIKEY:
-                print_apikey(ctx, item);
-                break;
-            case LOCKER_ITEM_ACCOUNT:
-                print_account(ctx, item);
-                break;
-            case LOCKER_ITEM_NOTE:
-                /* Not covered yet */
-                exit(EXIT_FAILURE);
-                break;
-        }
+/* returns the rows the note took, its text goes below key and description at full width */
+int print_note(context_t *ctx, const locker_item_t *item, locker_arena_t secrets[static 1], int max_rows, note_pages_t pages[static 1]) {
+    locker_item_note_t *note = locker_get_note(ctx->locker, item->id, secrets);
 
-        const char *control_options[] = {"CTRL-X: Edit", "CTRL-D: Remove", "BACKSPACE: Return"};
+    size_t x_offset = PRINTW_DEFAULT_X_OFFSET;
+    if (!note) {
+        mvprintw(1, x_offset, "Item could not be read. Check log file for more information.");
+        return 1;
+    }
 
-        print_control_panel(sizeof(control_options)/sizeof(char *), control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+1, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
-        refresh();
+    if(pages->starts.count == 0)
+        locker_array_append(&pages->starts, (size_t)0);
+    size_t offset = pages->starts.values[pages->starts.count - 1];
+    pages->size = note->size;
 
-        int ch = getch();
+    attron(A_BOLD);
+    mvprintw(1, x_offset, "Key");
+    attroff(A_BOLD);
+
+    mvprintw(2, x_offset, "%s", note->key);
+    x_offset += MAX(strlen(note->key), strlen("Key")) + TAB_LEN;
+
+    attron(A_BOLD);
+    mvprintw(1, x_offset, "Description");
+    attroff(A_BOLD);
+
+    mvprintw(2, x_offset, "%s", note->description);
+    x_offset += MAX(strlen(note->description), strlen("Description"))+ TAB_LEN;
+
+    attron(A_BOLD);
+    mvprintw(1, x_offset, "Size");
+    attroff(A_BOLD);
+
+    mvprintw(2, x_offset, "%zu bytes, page %zu", note->size, pages->starts.count);
+
+    /* no more of the note is read than the rows left could show */
+    int n_cols = MAX(getmaxx(stdscr) - PRINTW_DEFAULT_X_OFFSET, 1);
+    int n_text_rows = MAX(max_rows - 2, 1);
+    size_t page_len = (size_t)n_cols * n_text_rows;
+    char *page = arena_alloc(secrets, page_len);
+
+    size_t n_read;
+    if (locker_read_note(ctx->locker, item->id, offset, page_len, page, &n_read) != LOCKER_OK) {
+        mvprintw(4, PRINTW_DEFAULT_X_OFFSET, "Note could not be read. Check log file for more information.");
+        arena_reset(secrets);
+        return 3;
+    }
+
+    size_t pos = 0;
+    int row = 0;
+    for (; row < n_text_rows && pos < n_read; row++) {
+        move(4 + row, PRINTW_DEFAULT_X_OFFSET);
+        for (int col = 0; col < n_cols && pos < n_read && page[pos] != '\n'; col++, pos++) {
+            unsigned char c = page[pos];
+            /* the screen is not in a UTF-8 locale, anything past ASCII would take several cells */
+            addch(c == '\t' ? ' ' : c < ' ' || c >= 127 ? '.' : c);
+        }
+        if (pos < n_read && page[pos] == '\n')
+            pos++;
+    }
+    pages->next = offset + pos;
+
+    arena_reset(secrets);
+    /* the control panel stays put while paging */
+    bool paged = pages->starts.count > 1 || pages->next < pages->size;
+    return 2 + (paged ? n_text_rows : MAX(row, 1));
+}
+
+typedef struct {
+    context_t *ctx;
+    locker_item_t *item;
+    /* one secure block serves every redraw, wiped after each of them */
+    locker_arena_t secrets;
+    bool item_changed;
+    /* rows the item took on screen, cleared when it is left */
+    int n_rows;
+    note_pages_t pages;
+} item_view_t;
+
+bool view_item_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+    (void)loop;
+    item_view_t *view = arg;
+    context_t *ctx = view->ctx;
+    locker_item_t *item = view->item;
+
+    if(event->type == TUI_EVENT_KEY) {
+        int ch = event->value;
         if(ch == BACKSPACE_KEY) {
             /* clear sensitive information in case scrollback is on */
-            clear_line_inplace(2, 0);
+            clear_lines_inplace(2, view->n_rows);
 
             clear();
-            return item_changed;
+            return false;
         } else if(ch == CTRL_X_KEY) {
             /* clear sensitive information in case scrollback is on */
-            clear_line_inplace(2, 0);
+            clear_lines_inplace(2, view->n_rows);
             switch(item->type) {
                 case LOCKER_ITEM_APIKEY:
                     edit_apikey_view(ctx, item);
@@ -772,89 +1169,607 @@ bool view_item(context_t *ctx, locker_item_t item[static 1]) {
                     edit_account_view(ctx, item);
                     break;
                 case LOCKER_ITEM_NOTE:
+                    edit_note_view(ctx, item);
+                    /* the text may have changed under every page */
+                    view->pages.starts.count = 0;
                     break;
             }
-            item_changed = true;
+            view->item_changed = true;
         } else if(ch == CTRL_D_KEY) {
             /* clear sensitive information in case scrollback is on */
-            clear_line_inplace(2, 0);
+            clear_lines_inplace(2, view->n_rows);
 
             clear();
             locker_delete_item(ctx->locker, item);
-            return true;
+            view->item_changed = true;
+            return false;
+        } else if(item->type == LOCKER_ITEM_NOTE) {
+            note_pages_key(&view->pages, ch);
         }
     }
+
+    clear();
+    update_win_size(ctx);
+
+    switch(item->type) {
+        case LOCKER_ITEM_APIKEY:
+            /* what is left above the control panel */
+            view->n_rows = print_apikey(ctx, item, &view->secrets, MAX(ctx->win_size.rows - PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET - 2, 1));
+            break;
+        case LOCKER_ITEM_ACCOUNT:
+            view->n_rows = print_account(ctx, item, &view->secrets);
+            break;
+        case LOCKER_ITEM_NOTE:
+            view->n_rows = print_note(ctx, item, &view->secrets, MAX(ctx->win_size.rows - PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET - 2, 1), &view->pages);
+            break;
+    }
+
+    const char *control_options[] = {"CTRL-X: Edit", "CTRL-D: Remove", "BACKSPACE: Return", "PGUP/PGDN: Page"};
+    /* only notes are paged */
+    size_t n_control_options = sizeof(control_options)/sizeof(char *) - (item->type != LOCKER_ITEM_NOTE);
+
+    print_control_panel(n_control_options, control_options, PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET+view->n_rows, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+    refresh();
+    return true;
 }
 
-void item_list_view(context_t *ctx) {
-    const char *control_options[] = {"CTRL-F: Search", "BACKSPACE: Return"};
-    char search_query[LOCKER_ITEM_KEY_QUERY_MAX_LEN] = {0};
+bool view_item(context_t *ctx, locker_item_t item[static 1]) {
+    item_view_t view = {.ctx = ctx, .item = item};
+    arena_init(&view.secrets, true);
 
-    while(1) {
-        clear();
-        array_locker_item_t *items = locker_get_items(ctx->locker, search_query);
-        size_t key_max_len = 0;
+    tui_events_run(view_item_handle, &view);
 
-        for(size_t i = 0; i<items->count; i++) {
-            key_max_len = MAX(strlen(items->values[i].key), key_max_len);
+    free(view.pages.starts.values);
+    arena_release(&view.secrets);
+    return view.item_changed;
+}
+
+/*
+ * Rows of the item list that fit on screen, a window derived from stdscr.
+ * Each cell remembers the item drawn in it, so a frame only touches the cells
+ * that show something else, and rows that scrolled are moved, not redrawn.
+ */
+typedef struct {
+    WINDOW *win;
+    size_t n_rows;
+    size_t n_cols;
+    size_t col_width;
+    /* id of the item drawn in every cell, 0 for a blank one */
+    int64_t *drawn;
+    size_t drawn_highlight;
+} item_grid_t;
+
+void item_grid_free(item_grid_t grid[static 1]) {
+    if(grid->win)
+        delwin(grid->win);
+    free(grid->drawn);
+    memset(grid, 0, sizeof(item_grid_t));
+}
+
+/* true when the grid was laid out anew, everything under the title is blank then */
+bool item_grid_layout(item_grid_t grid[static 1], size_t n_rows, size_t n_cols, size_t col_width, size_t width) {
+    bool unchanged = grid->n_rows == n_rows && grid->n_cols == n_cols && grid->col_width == col_width;
+    if(unchanged && (grid->win || n_rows == 0))
+        return false;
+
+    item_grid_free(grid);
+    move(2, 0);
+    clrtobot();
+
+    grid->n_cols = n_cols;
+    grid->col_width = col_width;
+    grid->drawn_highlight = SIZE_MAX;
+    if(n_rows == 0)
+        return true;
+
+    /* no room for the rows on a tiny screen, nothing gets drawn then */
+    grid->win = derwin(stdscr, (int)n_rows, (int)width, 2, PRINTW_DEFAULT_X_OFFSET);
+    if(!grid->win)
+        return true;
+    /* changes reach stdscr, so a plain refresh() shows them */
+    syncok(grid->win, true);
+
+    grid->drawn = calloc(n_rows*n_cols, sizeof(int64_t));
+    if(!grid->drawn) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    grid->n_rows = n_rows;
+    return true;
+}
+
+void item_grid_draw_cell(item_grid_t grid[static 1], size_t cell, const locker_item_t *item, bool highlighted) {
+    int y = (int)(cell/grid->n_cols);
+    int x = (int)((cell%grid->n_cols)*grid->col_width);
+    /* a key wider than the window is cut at its edge */
+    int span = MIN((int)grid->col_width, getmaxx(grid->win) - x);
+
+    mvwhline(grid->win, y, x, ' ', span);
+    if(!item)
+        return;
+
+    if(highlighted) wattron(grid->win, A_STANDOUT);
+    mvwaddnstr(grid->win, y, x, item->key, MIN((int)grid->col_width - TAB_LEN, span));
+    if(highlighted) wattroff(grid->win, A_STANDOUT);
+}
+
+/* id of the item a cell shows when the window starts at first, 0 past the end */
+int64_t item_grid_cell_id(const array_locker_item_t *items, size_t first, size_t cell) {
+    return first+cell < items->count ? items->values[first+cell].id : 0;
+}
+
+/*
+ * Shows items from first on, highlight is a cell or SIZE_MAX. When the item
+ * on top used to be a few rows further down or up, the window is scrolled by
+ * that much first and only the uncovered rows are left to draw.
+ */
+void item_grid_sync(item_grid_t grid[static 1], const array_locker_item_t *items, size_t first, size_t highlight) {
+    if(!grid->win)
+        return;
+
+    size_t n_cols = grid->n_cols;
+    size_t n_cells = grid->n_rows*n_cols;
+
+    long shift = 0;
+    int64_t top_id = item_grid_cell_id(items, first, 0);
+    for(size_t k = 1; k < grid->n_rows && shift == 0 && top_id != grid->drawn[0]; k++) {
+        if(top_id != 0 && grid->drawn[k*n_cols] == top_id)
+            shift = (long)k;
+        else if(grid->drawn[0] != 0 && item_grid_cell_id(items, first, k*n_cols) == grid->drawn[0])
+            shift = -(long)k;
+    }
+
+    if(shift != 0) {
+        size_t gap = (size_t)labs(shift)*n_cols, kept = n_cells - gap;
+        scrollok(grid->win, true);
+        wscrl(grid->win, (int)shift);
+        scrollok(grid->win, false);
+
+        if(shift > 0) {
+            memmove(grid->drawn, grid->drawn+gap, kept*sizeof(int64_t));
+            memset(grid->drawn+kept, 0, gap*sizeof(int64_t));
+        } else {
+            memmove(grid->drawn+gap, grid->drawn, kept*sizeof(int64_t));
+            memset(grid->drawn, 0, gap*sizeof(int64_t));
         }
 
-        size_t n_cols = (ctx->win_size.cols-PRINTW_DEFAULT_X_OFFSET)/(key_max_len+TAB_LEN);
-        size_t n_rows = (items->count + n_cols-1)/n_cols;
+        if(grid->drawn_highlight != SIZE_MAX) {
+            long row = (long)(grid->drawn_highlight/n_cols) - shift;
+            grid->drawn_highlight = row >= 0 && row < (long)grid->n_rows ? (size_t)row*n_cols + grid->drawn_highlight%n_cols : SIZE_MAX;
+        }
+    }
 
-        size_t highlight_col = 0, highlight_row = 0;
-        while(1) {
-            attron(A_BOLD);
-            mvprintw(1, PRINTW_DEFAULT_X_OFFSET, "Items");
-            attroff(A_BOLD);
-            print_control_panel(sizeof(control_options)/sizeof(char *), control_options, n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+    for(size_t i = 0; i<n_cells; i++) {
+        int64_t id = item_grid_cell_id(items, first, i);
+        bool highlighted = i == highlight;
+        if(id == grid->drawn[i] && highlighted == (i == grid->drawn_highlight))
+            continue;
 
-            move(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET);
-            clrtoeol();
-            if(strlen(search_query)>0) {
-                attron(A_UNDERLINE);
-                mvprintw(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET, "Search: %s", search_query);
-                attroff(A_UNDERLINE);
-            }
+        item_grid_draw_cell(grid, i, id != 0 ? &items->values[first+i] : NULL, highlighted);
+        grid->drawn[i] = id;
+    }
+    grid->drawn_highlight = highlight;
+}
 
-            for(size_t i = 0; i<n_rows; i++) {
-                for(size_t j = 0; i*n_cols+j < items->count && j<n_cols; j++) {
-                    if(highlight_row == i && highlight_col == j) attron(A_STANDOUT);
-                    mvprintw(2+i, PRINTW_DEFAULT_X_OFFSET+j*(TAB_LEN+key_max_len),  "%s", items->values[i*n_cols+j].key);
-                    if(highlight_row == i && highlight_col == j) attroff(A_STANDOUT);
-                }
+/*
+ * Without a query the list holds a page read after top, which lies just
+ * before its first item, and the window slides over it, reading the next page
+ * only once it runs out. Search results are capped, so they are held whole.
+ * Either way first_row is the list row at the top of the window.
+ */
+typedef struct {
+    context_t *ctx;
+    char search_query[LOCKER_ITEM_KEY_QUERY_MAX_LEN];
+    /* while searching, keys go to the query and results follow every key press */
+    bool searching;
+    /* refilled in place on every reload, so redraws do not allocate */
+    locker_item_list_t list, prev;
+    item_grid_t grid;
+
+    locker_item_cursor_t top;
+    size_t first_row, highlight_col, highlight_row;
+    /* widest key since the query changed, columns only get narrower on a new query */
+    size_t key_max_len;
+    bool has_more, read_failed;
+    bool reload, chrome_changed;
+
+    /* the frame on screen, keys are handled against it */
+    bool paged;
+    size_t n_visible, n_cols, n_rows, last_first_row;
+    bool more_below;
+} item_list_t;
+
+void item_list_render(item_list_t view[static 1]) {
+    context_t *ctx = view->ctx;
+
+    view->paged = strlen(view->search_query) == 0;
+    /* rows left between the title and the control panel */
+    size_t n_visible = MAX(ctx->win_size.rows - PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET - 3, 1);
+    size_t width = MAX(ctx->win_size.cols - PRINTW_DEFAULT_X_OFFSET, 1);
+
+    while(view->reload) {
+        view->reload = false;
+        bool failed_before = view->read_failed;
+        view->read_failed = false;
+        view->has_more = false;
+
+        if(view->paged) {
+            /* columns only get narrower, so today's layout bounds the page */
+            size_t page_cols = MAX(width/(MAX(view->key_max_len, 1)+TAB_LEN), 1);
+            /* a screen beyond the window, so it slides a while before the next read */
+            if(locker_get_items_page(ctx->locker, &view->top, LOCKER_PAGE_AFTER, (view->first_row+2*n_visible)*page_cols, &view->list, &view->has_more) != LOCKER_OK) {
+                locker_item_list_clear(&view->list);
+                view->has_more = false;
+                view->read_failed = true;
             }
-            refresh();
-
-            int ch = getch();
-            if(ch == BACKSPACE_KEY) {
-                ctx->view = VIEW_LOCKER;
-                locker_array_t_free(items, locker_free_item);
-                return;
-            } else if(ch == ENTER_KEY) {
-                bool item_changed = view_item(ctx, &items->values[highlight_row*n_cols + highlight_col]);
-                if(item_changed) {
-                    /*item list will be recreated */
-                    save_locker(ctx->locker, ctx->workdir);
-                    break;
-                }
-            } else if(ch == CTRL_F_KEY) {
-                mvprintw(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET, "Search: %s", search_query);
-                get_user_str(sizeof(search_query), search_query, n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET+strlen("Search: "), n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, true, true, 0);
-                break;
-            } else if (ch == KEY_UP) {
-                if(highlight_row > 0) highlight_row--;
-            } else if (ch == KEY_DOWN) {
-                if(highlight_row < n_rows-1 && ((highlight_row+1)*n_cols + highlight_col) < items->count) highlight_row++;
-            } else if(ch == KEY_RIGHT) {
-                if(highlight_col < n_cols-1 && (highlight_row*n_cols + highlight_col) < (items->count-1)) highlight_col++;
-            } else if(ch == KEY_LEFT) {
-                if(highlight_col > 0) highlight_col--;
+        } else {
+            locker_fuzzy_find_items(ctx->locker, view->search_query, SEARCH_MAX_RESULTS, &view->list);
+        }
+
+        for(size_t i = 0; i<view->list.items.count; i++) {
+            view->key_max_len = MAX(strlen(view->list.items.values[i].key), view->key_max_len);
+        }
+        if(view->read_failed != failed_before)
+            view->chrome_changed = true;
+
+        if(view->paged && view->list.items.count == 0 && view->top.id != 0 && !view->read_failed) {
+            /* the window emptied under us, start over from the first item */
+            memset(&view->top, 0, sizeof(view->top));
+            view->first_row = 0;
+            view->reload = true;
+        }
+    }
+
+    array_locker_item_t *items = &view->list.items;
+    size_t n_cols = MAX(width/(view->key_max_len+TAB_LEN), 1);
+    size_t n_total_rows = (items->count + n_cols-1)/n_cols;
+    view->first_row = MIN(view->first_row, n_total_rows > 0 ? n_total_rows-1 : 0);
+    size_t n_rows = MIN(n_total_rows - view->first_row, n_visible);
+
+    view->n_visible = n_visible;
+    view->n_cols = n_cols;
+    view->n_rows = n_rows;
+    /* rows past the window are in memory or, when paged, in the locker */
+    view->more_below = view->first_row + n_rows < n_total_rows || view->has_more;
+    /* where the window stops when it cannot read any further */
+    view->last_first_row = n_total_rows > n_visible ? n_total_rows - n_visible : 0;
+
+    /* keep the highlight on an item after the list shrank */
+    if(n_rows == 0) {
+        view->highlight_row = view->highlight_col = 0;
+    } else {
+        view->highlight_row = MIN(view->highlight_row, n_rows-1);
+        view->highlight_col = MIN(view->highlight_col, n_cols-1);
+        while((view->first_row+view->highlight_row)*n_cols + view->highlight_col >= items->count) {
+            if(view->highlight_col > 0) view->highlight_col--;
+            else view->highlight_row--;
+        }
+    }
+
+    if(item_grid_layout(&view->grid, n_rows, n_cols, view->key_max_len+TAB_LEN, width))
+        view->chrome_changed = true;
+
+    if(view->chrome_changed) {
+        const char *control_options[] = {"CTRL-F: Search", "PGUP/PGDN/HOME/END: Scroll", "BACKSPACE: Return"};
+        const char *search_control_options[] = {"ENTER: Done", "BACKSPACE: Delete"};
+
+        move(1, PRINTW_DEFAULT_X_OFFSET);
+        clrtoeol();
+        attron(A_BOLD);
+        mvprintw(1, PRINTW_DEFAULT_X_OFFSET, view->read_failed ? "Items could not be read. Check log file for more information." : "Items");
+        attroff(A_BOLD);
+        /* the panels differ, what one leaves between its options the other would not cover */
+        move(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, 0);
+        clrtoeol();
+        if(view->searching)
+            print_control_panel(sizeof(search_control_options)/sizeof(char *), search_control_options, n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+        else
+            print_control_panel(sizeof(control_options)/sizeof(char *), control_options, n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+
+        move(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET);
+        clrtoeol();
+        if(view->searching || strlen(view->search_query)>0) {
+            attron(A_UNDERLINE);
+            mvprintw(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET, "Search: %s", view->search_query);
+            attroff(A_UNDERLINE);
+        }
+        view->chrome_changed = false;
+    }
+
+    item_grid_sync(&view->grid, items, view->first_row*n_cols, n_rows > 0 ? view->highlight_row*n_cols + view->highlight_col : SIZE_MAX);
+}
+
+/* false when the list was left */
+bool item_list_key(item_list_t view[static 1], int ch) {
+    context_t *ctx = view->ctx;
+    array_locker_item_t *items = &view->list.items;
+    size_t n_visible = view->n_visible, n_cols = view->n_cols, n_rows = view->n_rows;
+
+    size_t highlighted = (view->first_row+view->highlight_row)*n_cols + view->highlight_col;
+    /* rows to move the window by, negative is up */
+    long scroll = 0;
+    if(view->searching) {
+        size_t query_len = strlen(view->search_query);
+        if(ch == ENTER_KEY || ch == CTRL_X_KEY) {
+            view->searching = false;
+            curs_set(0);
+            view->chrome_changed = true;
+        } else if(ch == BACKSPACE_KEY && query_len > 0) {
+            view->search_query[query_len-1] = '\0';
+            view->reload = true;
+        } else if(ch < KEY_MIN && isprint(ch) && query_len < sizeof(view->search_query)-1) {
+            view->search_query[query_len] = (char)ch;
+            view->search_query[query_len+1] = '\0';
+            view->reload = true;
+        }
+        if(view->reload) {
+            memset(&view->top, 0, sizeof(view->top));
+            view->first_row = view->highlight_row = view->highlight_col = view->key_max_len = 0;
+            view->chrome_changed = true;
+        }
+    } else if(ch == BACKSPACE_KEY) {
+        ctx->view = VIEW_LOCKER;
+        return false;
+    } else if(ch == ENTER_KEY && highlighted < items->count) {
+        bool item_changed = view_item(ctx, &items->values[highlighted]);
+        /* the item view took the whole screen */
+        item_grid_free(&view->grid);
+        view->chrome_changed = true;
+        if(item_changed) {
+            /*item list will be recreated */
+            save_locker(ctx->locker);
+            view->reload = true;
+        }
+    } else if(ch == CTRL_F_KEY) {
+        view->searching = true;
+        curs_set(1);
+        view->chrome_changed = true;
+    } else if (ch == KEY_UP) {
+        if(view->highlight_row > 0) view->highlight_row--;
+        else scroll = -1;
+    } else if (ch == KEY_DOWN) {
+        if(view->highlight_row+1 < n_rows && highlighted+n_cols < items->count) view->highlight_row++;
+        else if(view->highlight_row+1 == n_rows && view->more_below) scroll = 1;
+    } else if(ch == KEY_RIGHT) {
+        if(view->highlight_col < n_cols-1 && highlighted+1 < items->count) view->highlight_col++;
+    } else if(ch == KEY_LEFT) {
+        if(view->highlight_col > 0) view->highlight_col--;
+    } else if(ch == KEY_NPAGE) {
+        if(view->more_below) scroll = (long)n_visible;
+        else view->highlight_row = SIZE_MAX;
+    } else if(ch == KEY_PPAGE) {
+        if(view->first_row > 0 || (view->paged && view->top.id != 0)) scroll = -(long)n_visible;
+        else view->highlight_row = 0;
+    } else if(ch == KEY_HOME) {
+        if(view->paged && view->top.id != 0) {
+            memset(&view->top, 0, sizeof(view->top));
+            view->reload = true;
+        }
+        view->first_row = view->highlight_row = view->highlight_col = 0;
+    } else if(ch == KEY_END) {
+        if(view->paged && view->has_more) {
+            /* a window's worth before the end, then the page after the item ahead of it */
+            locker_item_cursor_t end;
+            locker_item_cursor_set_end(&end);
+            bool more_before;
+            if(locker_get_items_page(ctx->locker, &end, LOCKER_PAGE_BEFORE, n_visible*n_cols+1, &view->prev, &more_before) == LOCKER_OK && view->prev.items.count == n_visible*n_cols+1)
+                locker_item_cursor_set(&view->top, &view->prev.items.values[0]);
+            else
+                memset(&view->top, 0, sizeof(view->top));
+            view->first_row = 0;
+            view->reload = true;
+        } else {
+            view->first_row = view->last_first_row;
+        }
+        view->highlight_row = view->highlight_col = SIZE_MAX;
+    }
+
+    if(scroll > 0) {
+        view->first_row += (size_t)scroll;
+        if(!(view->paged && view->has_more)) {
+            view->first_row = MIN(view->first_row, view->last_first_row);
+        } else if((view->first_row+n_visible)*n_cols > items->count) {
+            /* the window runs past the page, read on from the row now on top */
+            size_t first = MIN(view->first_row*n_cols, items->count);
+            locker_item_cursor_set(&view->top, &items->values[first-1]);
+            view->first_row = 0;
+            view->reload = true;
+        }
+    } else if(scroll < 0) {
+        size_t back = (size_t)-scroll;
+        if(view->first_row >= back || !view->paged || view->top.id == 0) {
+            view->first_row -= MIN(view->first_row, back);
+        } else {
+            /* the rows above the page are read with a window to spare, then the page from them */
+            size_t missing = back - view->first_row, n_read = MAX(missing, n_visible);
+            locker_item_cursor_t first;
+            locker_item_cursor_set(&first, &items->values[0]);
+            bool more_before;
+            bool read = locker_get_items_page(ctx->locker, &first, LOCKER_PAGE_BEFORE, n_read*n_cols+1, &view->prev, &more_before) == LOCKER_OK;
+            if(read && view->prev.items.count == n_read*n_cols+1) {
+                locker_item_cursor_set(&view->top, &view->prev.items.values[0]);
+                view->first_row = n_read - missing;
+            } else {
+                /* less than that is left, rows start over from the first item */
+                size_t rows_before = read ? view->prev.items.count/n_cols : 0;
+                memset(&view->top, 0, sizeof(view->top));
+                view->first_row = rows_before > missing ? rows_before - missing : 0;
             }
+            view->reload = true;
+        }
+    }
+    return true;
+}
+
+bool item_list_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+    item_list_t *view = arg;
+    context_t *ctx = view->ctx;
+
+    if(event->type == TUI_EVENT_KEY && !item_list_key(view, event->value))
+        return false;
+
+    if(update_win_size(ctx)) {
+        /* everything is laid out again for the new size */
+        clear();
+        item_grid_free(&view->grid);
+        view->chrome_changed = true;
+    }
+
+    item_list_render(view);
+    update_save_status(ctx, loop);
+    if(view->searching)
+        move(view->n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET+strlen("Search: ")+strlen(view->search_query));
+    refresh();
+    return true;
+}
+
+void item_list_view(context_t *ctx) {
+    item_list_t view = {.ctx = ctx, .reload = true, .chrome_changed = true};
+    locker_item_list_init(&view.list);
+    locker_item_list_init(&view.prev);
+
+    clear();
+    tui_events_run(item_list_handle, &view);
+
+    item_grid_free(&view.grid);
+    locker_item_list_free(&view.list);
+    locker_item_list_free(&view.prev);
+}
+
+/* drops the last namespace level of prefix, "a/b/" becomes "a/" */
+void tree_prefix_up(char prefix[static 1]) {
+    size_t len = strlen(prefix);
+    if(len > 0 && prefix[len-1] == LOCKER_ITEM_KEY_SEPARATOR) len--;
+    while(len > 0 && prefix[len-1] != LOCKER_ITEM_KEY_SEPARATOR) len--;
+    prefix[len] = '\0';
+}
+
+typedef struct {
+    context_t *ctx;
+    char prefix[(LOCKER_ITEM_KEY_MAX_LEN)+1];
+    array_locker_trie_entry_t *entries;
+    size_t n_rows, highlight, top;
+    bool reload;
+} item_tree_t;
+
+/* false when the tree was left */
+bool item_tree_key(item_tree_t tree[static 1], int ch) {
+    context_t *ctx = tree->ctx;
+    array_locker_trie_entry_t *entries = tree->entries;
+    size_t n_rows = tree->n_rows;
+
+    if(ch == BACKSPACE_KEY) {
+        if(strlen(tree->prefix) == 0) {
+            ctx->view = VIEW_LOCKER;
+            return false;
         }
+        tree_prefix_up(tree->prefix);
+        tree->reload = true;
+    } else if(ch == ENTER_KEY && entries->count > 0) {
+        const locker_trie_entry_t *entry = &entries->values[tree->highlight];
+        if(entry->item_id == 0) {
+            strncat(tree->prefix, entry->name, sizeof(tree->prefix)-strlen(tree->prefix)-1);
+            tree->reload = true;
+        } else {
+            char key[2*(LOCKER_ITEM_KEY_MAX_LEN)+1];
+            snprintf(key, sizeof(key), "%s%s", tree->prefix, entry->name);
+            locker_item_t item = {.id = entry->item_id, .key = key, .type = entry->item_type};
+
+            if(view_item(ctx, &item))
+                save_locker(ctx->locker);
+            /* the item view took the whole screen */
+            tree->reload = true;
+        }
+    } else if(ch == CTRL_F_KEY) {
+        char target[(LOCKER_ITEM_KEY_MAX_LEN)+1] = {0};
+        strcpy(target, tree->prefix);
 
-        locker_array_t_free(items, locker_free_item);
+        move(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET);
+        clrtoeol();
+        mvprintw(n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET, "Go to: %s", target);
+        get_user_str(sizeof(target)-1, target, n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET-1, PRINTW_DEFAULT_X_OFFSET+strlen("Go to: "), n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, true, true, 0);
+
+        /* extend what was typed as far as the keys agree, then open its namespace */
+        locker_complete_item_key(ctx->locker, target, tree->prefix, sizeof(tree->prefix));
+        char *last_sep = strrchr(tree->prefix, LOCKER_ITEM_KEY_SEPARATOR);
+        if(last_sep)
+            last_sep[1] = '\0';
+        else
+            tree->prefix[0] = '\0';
+        tree->reload = true;
+    } else if(ch == KEY_UP) {
+        if(tree->highlight > 0) tree->highlight--;
+    } else if(ch == KEY_DOWN) {
+        if(tree->highlight+1 < entries->count) tree->highlight++;
     }
+    return true;
+}
+
+bool item_tree_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+    item_tree_t *tree = arg;
+    context_t *ctx = tree->ctx;
+
+    if(event->type == TUI_EVENT_KEY && !item_tree_key(tree, event->value))
+        return false;
+
+    bool resized = update_win_size(ctx);
+    if(tree->reload) {
+        if(tree->entries) {
+            locker_array_t_free(tree->entries, trie_free_entry);
+            free(tree->entries);
+        }
+        tree->entries = locker_browse_items(ctx->locker, tree->prefix);
+        tree->highlight = tree->top = 0;
+    }
+    array_locker_trie_entry_t *entries = tree->entries;
+
+    if(tree->reload || resized) {
+        tree->reload = false;
+        clear();
+        /* rows left between the title and the control panel */
+        size_t n_visible = MAX(ctx->win_size.rows - PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET - 3, 1);
+        tree->n_rows = MIN(MAX(entries->count, 1), n_visible);
+    }
+    size_t n_rows = tree->n_rows;
+
+    if(tree->highlight < tree->top) tree->top = tree->highlight;
+    if(tree->highlight >= tree->top+n_rows) tree->top = tree->highlight-n_rows+1;
+
+    const char *control_options[] = {"ENTER: Open", "CTRL-F: Go to", "BACKSPACE: Up"};
+    attron(A_BOLD);
+    mvprintw(1, PRINTW_DEFAULT_X_OFFSET, "Items /%s", tree->prefix);
+    attroff(A_BOLD);
+    printw(" (%zu)", locker_count_items(ctx->locker, tree->prefix));
+    print_control_panel(sizeof(control_options)/sizeof(char *), control_options, n_rows+PRINTW_CONTROL_PANEL_DEFAULT_Y_OFFSET, PRINTW_DEFAULT_X_OFFSET, TAB_LEN);
+
+    if(entries->count == 0)
+        mvprintw(2, PRINTW_DEFAULT_X_OFFSET, "No items.");
+
+    for(size_t i = 0; i < n_rows && tree->top+i < entries->count; i++) {
+        const locker_trie_entry_t *entry = &entries->values[tree->top+i];
+        move(2+i, PRINTW_DEFAULT_X_OFFSET);
+        clrtoeol();
+
+        if(tree->top+i == tree->highlight) attron(A_STANDOUT);
+        if(entry->item_id == 0)
+            printw("%s (%zu)", entry->name, entry->count);
+        else
+            printw("%s", entry->name);
+        if(tree->top+i == tree->highlight) attroff(A_STANDOUT);
+    }
+    update_save_status(ctx, loop);
+    refresh();
+    return true;
+}
+
+/* walks item keys one namespace level at a time, like directories */
+void item_tree_view(context_t *ctx) {
+    item_tree_t tree = {.ctx = ctx, .reload = true};
+
+    tui_events_run(item_tree_handle, &tree);
+
+    locker_array_t_free(tree.entries, trie_free_entry);
+    free(tree.entries);
 }
 
 int run(void) {
@@ -868,10 +1783,11 @@ int run(void) {
     initscr();
     turn_off_user_typing();
     keypad(stdscr, true);
+    tui_events_init();
 
     context_t context = {.win_size = {0, 0}, .view = VIEW_STARTUP, .workdir=path, .locker = NULL};
 
-    getmaxyx(stdscr, context.win_size.rows, context.win_size.cols);
+    update_win_size(&context);
 
     curs_set(0);
 
@@ -896,12 +1812,16 @@ int run(void) {
         case VIEW_ITEM_LIST:
             item_list_view(&context);
             break;
+        case VIEW_ITEM_TREE:
+            item_tree_view(&context);
+            break;
         case VIEW_EXIT:
             running = false;
             break;
         }
     }
 
+    tui_events_close();
     curs_set(1);
     clear();
     refresh();
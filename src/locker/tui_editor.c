@@ -0,0 +1,346 @@
+#include "locker_tui_editor.h"
+#include "locker_tui_events.h"
+#include "locker_tui_utils.h"
+#include "ncursesw/ncurses.h"
+#include "sodium/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GAP_BUFFER_MIN_CAPACITY 256
+/* keys already waiting are inserted together, a paste is drawn once per read */
+#define EDITOR_PASTE_CHUNK 512
+
+/* moves the text after the gap to the end of a larger block */
+static void gap_buffer_grow(gap_buffer_t gb[static 1], size_t min_capacity) {
+  size_t capacity = gb->capacity ? gb->capacity : GAP_BUFFER_MIN_CAPACITY;
+  while (capacity < min_capacity)
+    capacity *= 2;
+  if (capacity > gb->max_len)
+    capacity = gb->max_len > min_capacity ? gb->max_len : min_capacity;
+  if (capacity == 0)
+    capacity = 1;
+
+  char *data = sodium_malloc(capacity);
+  if (!data) {
+    perror("sodium_malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  size_t tail = gb->capacity - gb->gap_end;
+  if (gb->data) {
+    memcpy(data, gb->data, gb->gap_start);
+    memcpy(data + capacity - tail, gb->data + gb->gap_end, tail);
+    /* sodium_free wipes the old copy */
+    sodium_free(gb->data);
+  }
+
+  gb->data = data;
+  gb->gap_end = capacity - tail;
+  gb->capacity = capacity;
+}
+
+void gap_buffer_init(gap_buffer_t gb[static 1], size_t max_len, const char *text, size_t len) {
+  memset(gb, 0, sizeof(gap_buffer_t));
+  gb->max_len = max_len;
+  if (len > max_len)
+    len = max_len;
+
+  gap_buffer_grow(gb, len);
+  memcpy(gb->data, text, len);
+  gb->gap_start = len;
+}
+
+void gap_buffer_free(gap_buffer_t gb[static 1]) {
+  if (gb->data)
+    sodium_free(gb->data);
+  memset(gb, 0, sizeof(gap_buffer_t));
+}
+
+size_t gap_buffer_len(const gap_buffer_t gb[static 1]) {
+  return gb->capacity - (gb->gap_end - gb->gap_start);
+}
+
+char gap_buffer_at(const gap_buffer_t gb[static 1], size_t pos) {
+  return pos < gb->gap_start ? gb->data[pos] : gb->data[pos + gb->gap_end - gb->gap_start];
+}
+
+void gap_buffer_move(gap_buffer_t gb[static 1], size_t pos) {
+  if (pos < gb->gap_start) {
+    size_t n = gb->gap_start - pos;
+    memmove(gb->data + gb->gap_end - n, gb->data + pos, n);
+    gb->gap_start -= n;
+    gb->gap_end -= n;
+  } else if (pos > gb->gap_start) {
+    size_t n = pos - gb->gap_start;
+    memmove(gb->data + gb->gap_start, gb->data + gb->gap_end, n);
+    gb->gap_start += n;
+    gb->gap_end += n;
+  }
+}
+
+size_t gap_buffer_insert(gap_buffer_t gb[static 1], const char *text, size_t len) {
+  size_t total = gap_buffer_len(gb);
+  if (len > gb->max_len - total)
+    len = gb->max_len - total;
+
+  if (len > gb->gap_end - gb->gap_start)
+    gap_buffer_grow(gb, total + len);
+
+  memcpy(gb->data + gb->gap_start, text, len);
+  gb->gap_start += len;
+  return len;
+}
+
+void gap_buffer_delete(gap_buffer_t gb[static 1], size_t before, size_t after) {
+  if (before > gb->gap_start)
+    before = gb->gap_start;
+  if (after > gb->capacity - gb->gap_end)
+    after = gb->capacity - gb->gap_end;
+
+  /* what leaves the text does not linger in the gap */
+  gb->gap_start -= before;
+  sodium_memzero(gb->data + gb->gap_start, before);
+  sodium_memzero(gb->data + gb->gap_end, after);
+  gb->gap_end += after;
+}
+
+void gap_buffer_copy(const gap_buffer_t gb[static 1], char *out) {
+  size_t tail = gb->capacity - gb->gap_end;
+  memcpy(out, gb->data, gb->gap_start);
+  memcpy(out + gb->gap_start, gb->data + gb->gap_end, tail);
+  out[gb->gap_start + tail] = '\0';
+}
+
+/*
+ * A line of the text takes len/n_cols+1 rows of the box, so the cursor after
+ * its last character always has a cell. The line and row of the cursor and
+ * the line of the top row are kept as the cursor moves, a key only reads the
+ * characters it passes over and the rows of the box, however long the line.
+ */
+typedef struct {
+  gap_buffer_t *gb;
+  tui_editor_box_t box;
+  /* first character of the row at the top of the box, and of its line */
+  size_t top;
+  size_t top_line;
+  /* first character of the line and of the row the cursor is on */
+  size_t line;
+  size_t row;
+} editor_t;
+
+static size_t editor_row_start(const editor_t editor[static 1], size_t line, size_t pos) {
+  size_t n_cols = (size_t)editor->box.n_cols;
+  return line + (pos - line) / n_cols * n_cols;
+}
+
+/* scans back no further than the top of the box when pos is below it */
+static size_t editor_line_start(const editor_t editor[static 1], size_t pos) {
+  size_t stop = pos >= editor->top ? editor->top : 0, start = pos;
+  while (start > stop && gap_buffer_at(editor->gb, start - 1) != '\n')
+    start--;
+  return start == editor->top ? editor->top_line : start;
+}
+
+/* the end of the row, before the line break or the next wrapped row */
+static size_t editor_row_end(const editor_t editor[static 1], size_t row) {
+  size_t len = gap_buffer_len(editor->gb), end = row;
+  while (end < len && end < row + (size_t)editor->box.n_cols && gap_buffer_at(editor->gb, end) != '\n')
+    end++;
+  return end;
+}
+
+static bool editor_next_row(const editor_t editor[static 1], size_t row, size_t next[static 1]) {
+  size_t end = editor_row_end(editor, row);
+  if (end == row + (size_t)editor->box.n_cols) {
+    *next = end;
+    return true;
+  }
+  if (end < gap_buffer_len(editor->gb)) {
+    *next = end + 1;
+    return true;
+  }
+  return false;
+}
+
+/* the row above the cursor, the last of the line before or the one it wrapped from */
+static bool editor_prev_row(const editor_t editor[static 1], size_t prev[static 1], size_t line[static 1]) {
+  if (editor->row == 0)
+    return false;
+  if (editor->row > editor->line) {
+    *line = editor->line;
+    *prev = editor->row - (size_t)editor->box.n_cols;
+  } else {
+    *line = editor_line_start(editor, editor->row - 1);
+    *prev = editor_row_start(editor, *line, editor->row - 1);
+  }
+  return true;
+}
+
+/* moves the cursor to the same column of another row, or the end of a shorter one */
+static void editor_move_to_row(editor_t editor[static 1], size_t row, size_t col) {
+  size_t end = editor_row_end(editor, row);
+  gap_buffer_move(editor->gb, row + col < end ? row + col : end);
+}
+
+/* finds the line and row of the cursor from where it was before the key */
+static void editor_locate(editor_t editor[static 1], size_t from) {
+  size_t cursor = editor->gb->gap_start;
+  if (cursor >= from) {
+    for (size_t pos = from; pos < cursor; pos++)
+      if (gap_buffer_at(editor->gb, pos) == '\n')
+        editor->line = pos + 1;
+  } else if (cursor < editor->line) {
+    editor->line = editor_line_start(editor, cursor);
+  }
+  editor->row = editor_row_start(editor, editor->line, cursor);
+}
+
+static bool editor_is_text(const editor_t editor[static 1], int ch) {
+  if (ch == ENTER_KEY)
+    return editor->box.multiline;
+  return ch < KEY_MIN && (ch == '\t' || (ch >= ' ' && ch != BACKSPACE_KEY));
+}
+
+static void editor_insert_pending(editor_t editor[static 1], int ch) {
+  char chunk[EDITOR_PASTE_CHUNK];
+  size_t n = 0;
+  chunk[n++] = (char)ch;
+
+  while ((ch = getch()) != ERR) {
+    if (!editor_is_text(editor, ch)) {
+      /* left for the event loop to hand over next */
+      ungetch(ch);
+      break;
+    }
+    chunk[n++] = (char)ch;
+    if (n == sizeof(chunk)) {
+      gap_buffer_insert(editor->gb, chunk, n);
+      n = 0;
+    }
+  }
+  gap_buffer_insert(editor->gb, chunk, n);
+  sodium_memzero(chunk, sizeof(chunk));
+}
+
+/* keeps the row of the cursor inside the box, scrolling as little as it can */
+static void editor_scroll(editor_t editor[static 1]) {
+  if (editor->row < editor->top) {
+    editor->top = editor->row;
+    editor->top_line = editor->line;
+    return;
+  }
+
+  /* the top follows n_lines-1 rows behind, over the rows the cursor moved down */
+  size_t row = editor->top;
+  for (int below = 0; row != editor->row && editor_next_row(editor, row, &row);) {
+    if (++below < editor->box.n_lines)
+      continue;
+    size_t next;
+    editor_next_row(editor, editor->top, &next);
+    if (gap_buffer_at(editor->gb, next - 1) == '\n')
+      editor->top_line = next;
+    editor->top = next;
+  }
+}
+
+static void editor_draw(const editor_t editor[static 1]) {
+  const tui_editor_box_t *box = &editor->box;
+  size_t row = editor->top;
+  bool more = true;
+  int cursor_y = 0;
+
+  for (int i = 0; i < box->n_lines; i++) {
+    move(box->y + i, box->x);
+    int col = 0;
+    if (more) {
+      if (row == editor->row)
+        cursor_y = i;
+
+      size_t end = editor_row_end(editor, row);
+      attron(box->attrs);
+      for (size_t pos = row; pos < end; pos++, col++) {
+        char c = gap_buffer_at(editor->gb, pos);
+        /* a tab takes one cell like any other character */
+        addch(c == '\t' ? ' ' : (unsigned char)c);
+      }
+      attroff(box->attrs);
+      more = editor_next_row(editor, row, &row);
+    }
+    hline(' ', box->n_cols - col);
+  }
+
+  move(box->y + cursor_y, box->x + (int)(editor->gb->gap_start - editor->row));
+}
+
+static bool editor_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+  (void)loop;
+  editor_t *editor = arg;
+  gap_buffer_t *gb = editor->gb;
+  size_t cursor = gb->gap_start, row = editor->row, other, line;
+
+  if (event->type == TUI_EVENT_KEY) {
+    int ch = event->value;
+    switch (ch) {
+    case CTRL_X_KEY:
+      return false;
+    case KEY_LEFT:
+      if (cursor > 0)
+        gap_buffer_move(gb, cursor - 1);
+      break;
+    case KEY_RIGHT:
+      if (cursor < gap_buffer_len(gb))
+        gap_buffer_move(gb, cursor + 1);
+      break;
+    case KEY_UP:
+      if (editor_prev_row(editor, &other, &line)) {
+        /* known already, editor_locate keeps it */
+        editor->line = line;
+        editor_move_to_row(editor, other, cursor - row);
+      }
+      break;
+    case KEY_DOWN:
+      if (editor_next_row(editor, row, &other))
+        editor_move_to_row(editor, other, cursor - row);
+      break;
+    case KEY_HOME:
+      gap_buffer_move(gb, row);
+      break;
+    case KEY_END:
+      gap_buffer_move(gb, editor_row_end(editor, row));
+      break;
+    case BACKSPACE_KEY:
+    case KEY_BACKSPACE:
+      gap_buffer_delete(gb, 1, 0);
+      break;
+    case KEY_DC:
+      gap_buffer_delete(gb, 0, 1);
+      break;
+    default:
+      if (editor_is_text(editor, ch))
+        editor_insert_pending(editor, ch);
+      break;
+    }
+    editor_locate(editor, cursor);
+  }
+
+  if (!editor->box.typing)
+    return true;
+
+  editor_scroll(editor);
+  editor_draw(editor);
+  refresh();
+  return true;
+}
+
+void tui_edit(gap_buffer_t gb[static 1], const tui_editor_box_t box[static 1]) {
+  editor_t editor = {.gb = gb, .box = *box};
+  if (editor.box.n_lines < 1)
+    editor.box.n_lines = 1;
+  if (editor.box.n_cols < 1)
+    editor.box.n_cols = 1;
+  editor.line = editor_line_start(&editor, gb->gap_start);
+  editor.row = editor_row_start(&editor, editor.line, gb->gap_start);
+
+  tui_events_run(editor_handle, &editor);
+}
@@ -0,0 +1,197 @@
+#include "locker_tui_events.h"
+#include "locker_logs.h"
+#include "ncursesw/ncurses.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  int id;
+  int interval_ms;
+  int64_t deadline_ms;
+  bool active;
+} tui_timer_t;
+
+struct tui_loop {
+  tui_timer_t timers[TUI_MAX_TIMERS];
+};
+
+/* the SIGWINCH handler writes here, so a resize cannot slip in before poll() */
+static int wake_pipe[2] = {-1, -1};
+static struct sigaction curses_winch;
+
+static int64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ncurses notes the resize for the next getch(), the byte wakes poll() */
+static void on_winch(int sig, siginfo_t *info, void *context) {
+  int saved_errno = errno;
+
+  if (curses_winch.sa_flags & SA_SIGINFO)
+    curses_winch.sa_sigaction(sig, info, context);
+  else if (curses_winch.sa_handler != SIG_DFL && curses_winch.sa_handler != SIG_IGN)
+    curses_winch.sa_handler(sig);
+
+  /* a full pipe already holds a wake-up */
+  char byte = 0;
+  ssize_t rc = write(wake_pipe[1], &byte, 1);
+  (void)rc;
+
+  errno = saved_errno;
+}
+
+static void set_fd_flags(int fd) {
+  if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+      fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+    perror("fcntl");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void tui_events_init(void) {
+  if (pipe(wake_pipe) < 0) {
+    perror("pipe");
+    exit(EXIT_FAILURE);
+  }
+  set_fd_flags(wake_pipe[0]);
+  set_fd_flags(wake_pipe[1]);
+
+  /* initscr installed the ncurses handler, it keeps running ahead of ours */
+  struct sigaction action = {0};
+  action.sa_sigaction = on_winch;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGWINCH, &action, &curses_winch) < 0) {
+    perror("sigaction");
+    exit(EXIT_FAILURE);
+  }
+
+  nodelay(stdscr, true);
+}
+
+void tui_events_close(void) {
+  sigaction(SIGWINCH, &curses_winch, NULL);
+  close(wake_pipe[0]);
+  close(wake_pipe[1]);
+  wake_pipe[0] = wake_pipe[1] = -1;
+}
+
+/* -1 without a running timer, as poll() takes it */
+static int next_timeout(const tui_loop_t *loop, int64_t now) {
+  int64_t timeout = -1;
+  for (int i = 0; i < TUI_MAX_TIMERS; i++) {
+    const tui_timer_t *timer = &loop->timers[i];
+    if (!timer->active)
+      continue;
+
+    int64_t left = timer->deadline_ms > now ? timer->deadline_ms - now : 0;
+    if (timeout < 0 || left < timeout)
+      timeout = left;
+  }
+  return (int)timeout;
+}
+
+void tui_events_run(tui_handler_fn handler, void *arg) {
+  tui_loop_t loop = {0};
+  tui_event_t event = {.type = TUI_EVENT_RESIZE};
+  bool running = handler(&loop, &event, arg);
+
+  while (running) {
+    /* poll() does not see keys ncurses has already read ahead, take them first */
+    int ch;
+    while (running && (ch = getch()) != ERR) {
+      event.type = ch == KEY_RESIZE ? TUI_EVENT_RESIZE : TUI_EVENT_KEY;
+      event.value = ch;
+      running = handler(&loop, &event, arg);
+    }
+    if (!running)
+      break;
+
+    struct pollfd fds[] = {
+        {.fd = STDIN_FILENO, .events = POLLIN},
+        {.fd = wake_pipe[0], .events = POLLIN},
+    };
+    if (poll(fds, 2, next_timeout(&loop, now_ms())) < 0 && errno != EINTR) {
+      perror("poll");
+      exit(EXIT_FAILURE);
+    }
+
+    if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+      /* nobody is left to read from, unsaved edits are in the journal */
+      endwin();
+      log_message("Terminal closed, exiting.");
+      exit(EXIT_FAILURE);
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char buffer[64];
+      while (read(wake_pipe[0], buffer, sizeof(buffer)) > 0)
+        ;
+    }
+
+    int64_t now = now_ms();
+    for (int i = 0; running && i < TUI_MAX_TIMERS; i++) {
+      tui_timer_t *timer = &loop.timers[i];
+      if (!timer->active || timer->deadline_ms > now)
+        continue;
+
+      /* a loop that fell behind fires once, not once per missed interval */
+      timer->deadline_ms = now + timer->interval_ms;
+      event.type = TUI_EVENT_TIMER;
+      event.value = timer->id;
+      running = handler(&loop, &event, arg);
+    }
+  }
+}
+
+void tui_timer_start(tui_loop_t *loop, int id, int interval_ms) {
+  tui_timer_t *slot = NULL;
+  for (int i = 0; i < TUI_MAX_TIMERS; i++) {
+    tui_timer_t *timer = &loop->timers[i];
+    if (timer->active && timer->id == id)
+      return;
+    if (!timer->active && !slot)
+      slot = timer;
+  }
+
+  if (!slot) {
+    log_message("No free TUI timer for timer %d.", id);
+    exit(EXIT_FAILURE);
+  }
+
+  slot->id = id;
+  slot->interval_ms = interval_ms;
+  slot->deadline_ms = now_ms() + interval_ms;
+  slot->active = true;
+}
+
+void tui_timer_stop(tui_loop_t *loop, int id) {
+  for (int i = 0; i < TUI_MAX_TIMERS; i++) {
+    if (loop->timers[i].active && loop->timers[i].id == id)
+      loop->timers[i].active = false;
+  }
+}
+
+static bool wait_key_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+  (void)loop;
+  if (event->type != TUI_EVENT_KEY)
+    return true;
+
+  *(int *)arg = event->value;
+  return false;
+}
+
+int tui_wait_key(void) {
+  int key = ERR;
+  tui_events_run(wait_key_handle, &key);
+  return key;
+}
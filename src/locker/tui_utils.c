@@ -1,5 +1,7 @@
 #include <string.h>
 #include <ncursesw/ncurses.h>
+#include "locker_tui_editor.h"
+#include "locker_tui_events.h"
 #include "locker_tui_utils.h"
 
 void turn_off_user_typing(void) {
@@ -26,113 +28,129 @@ void print_control_panel(size_t n_options, const char *options[], int y_offset,
     attroff(A_BOLD);
 }
 
-void get_user_str(size_t buffer_sz, char buffer[buffer_sz], int win_y,
-                  int win_x, int controls_y, int controls_x, bool typing, bool show_cursor, int attrs) {
-
+/* buffer holds up to buffer_sz characters and a NUL */
+static void edit_buffer(size_t buffer_sz, char *buffer, const tui_editor_box_t box[static 1], int controls_y, int controls_x, bool show_cursor) {
   const char *control_options[] = {"CTRL-X: Save"};
   print_control_panel(sizeof(control_options)/sizeof(char *), control_options, controls_y, controls_x, TAB_LEN);
 
-  size_t len = strlen(buffer);
-  size_t cursor = len;
-
   if(show_cursor)
       curs_set(1);
 
-  attron(attrs);
+  /* the text is edited in locked memory and only copied back once */
+  gap_buffer_t gb;
+  gap_buffer_init(&gb, buffer_sz, buffer, strlen(buffer));
+  tui_edit(&gb, box);
+  gap_buffer_copy(&gb, buffer);
+  gap_buffer_free(&gb);
 
-  while (1) {
-    move(win_y, win_x + cursor);
-    int ch = getch();
-    switch (ch) {
-    case KEY_LEFT:
-      if (cursor > 0)
-        cursor--;
-      break;
-    case KEY_RIGHT:
-      if (cursor < len)
-        cursor++;
-      break;
-    case CTRL_X_KEY:
-      move(controls_y, controls_x);
-      clrtoeol();
-      attroff(attrs);
-
-      if(show_cursor)
-        curs_set(0);
-      return;
-    case KEY_UP:
-    case KEY_DOWN:
-    case ENTER_KEY:
-      break;
-    case BACKSPACE_KEY:
-      if (cursor <= 0) {
-        break;
-      }
-
-      cursor--;
-      len--;
-      if (cursor == len) {
-        buffer[cursor] = '\0';
-      } else {
-        memmove(buffer + cursor, buffer + cursor + 1, len - cursor);
-        buffer[len] = '\0';
-      }
-      break;
-    default:
-      if (len >= buffer_sz) {
-        break;
-      }
-
-      if (cursor == len) {
-        buffer[cursor] = (char)ch;
-      } else {
-        memmove(buffer + cursor + 1, buffer + cursor, len - cursor);
-        buffer[cursor] = (char)ch;
-      }
-      cursor++;
-      len++;
-      break;
-    }
+  move(controls_y, controls_x);
+  clrtoeol();
 
-    if(typing)
-        mvprintw(win_y, win_x, "%s", buffer);
+  if(show_cursor)
+    curs_set(0);
+}
 
-    clrtoeol();
-    refresh();
-  }
+void get_user_str(size_t buffer_sz, char buffer[buffer_sz], int win_y,
+                  int win_x, int controls_y, int controls_x, bool typing, bool show_cursor, int attrs) {
+  /* one row up to the right edge, longer text wraps within it */
+  tui_editor_box_t box = {.y = win_y, .x = win_x, .n_lines = 1, .n_cols = getmaxx(stdscr) - win_x, .typing = typing, .attrs = attrs};
+  edit_buffer(buffer_sz, buffer, &box, controls_y, controls_x, show_cursor);
 }
 
-int choice_selector(int n_choices, const char *choices[],
-                    int row_offset) {
-  int highlight = 0;
-  while (1) {
-    for (int i = 0; i < n_choices; i++) {
-      if (i == highlight)
-        attron(A_STANDOUT);
-      mvprintw(row_offset + i + 1, PRINTW_DEFAULT_X_OFFSET, "%u. %s", i + 1, choices[i]);
-      if (i == highlight)
-        attroff(A_STANDOUT);
+void get_user_text(size_t buffer_sz, char buffer[buffer_sz], int win_y, int win_x, int n_lines, int n_cols, int controls_y, int controls_x) {
+  tui_editor_box_t box = {.y = win_y, .x = win_x, .n_lines = n_lines, .n_cols = n_cols, .multiline = true, .typing = true};
+  edit_buffer(buffer_sz, buffer, &box, controls_y, controls_x, true);
+}
+
+typedef struct {
+  size_t buffer_sz;
+  char *buffer;
+  int win_y;
+  int win_x;
+  bool typing;
+  size_t len;
+} user_line_t;
+
+static bool user_line_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+  (void)loop;
+  user_line_t *input = arg;
+
+  if (event->type == TUI_EVENT_KEY) {
+    int ch = event->value;
+    if (ch == ENTER_KEY || ch == KEY_ENTER) {
+      return false;
+    } else if (ch == BACKSPACE_KEY || ch == KEY_BACKSPACE) {
+      if (input->len > 0)
+        input->buffer[--input->len] = '\0';
+    } else if (ch < KEY_MIN && input->len + 1 < input->buffer_sz) {
+      input->buffer[input->len++] = (char)ch;
+      input->buffer[input->len] = '\0';
     }
-    refresh();
+  }
 
-    int ch = getch();
-    switch (ch) {
+  move(input->win_y, input->win_x);
+  if (input->typing)
+    printw("%s", input->buffer);
+  clrtoeol();
+  refresh();
+  return true;
+}
+
+void get_user_line(size_t buffer_sz, char buffer[buffer_sz], int win_y, int win_x, bool typing) {
+  buffer[0] = '\0';
+  user_line_t input = {.buffer_sz = buffer_sz, .buffer = buffer, .win_y = win_y, .win_x = win_x, .typing = typing};
+  tui_events_run(user_line_handle, &input);
+}
+
+typedef struct {
+  int n_choices;
+  const char **choices;
+  int row_offset;
+  int highlight;
+  int choice;
+} choice_selector_t;
+
+static bool choice_selector_handle(tui_loop_t *loop, const tui_event_t event[static 1], void *arg) {
+  (void)loop;
+  choice_selector_t *selector = arg;
+
+  if (event->type == TUI_EVENT_KEY) {
+    switch (event->value) {
     case KEY_UP:
-      if (highlight == 0)
-        highlight = n_choices;
-      highlight--;
+      if (selector->highlight == 0)
+        selector->highlight = selector->n_choices;
+      selector->highlight--;
       break;
     case KEY_DOWN:
-      highlight++;
-      if (highlight >= n_choices)
-        highlight = 0;
+      selector->highlight++;
+      if (selector->highlight >= selector->n_choices)
+        selector->highlight = 0;
       break;
     case BACKSPACE_KEY:
-      return RETURN_OPTION;
+      selector->choice = RETURN_OPTION;
+      return false;
     case ENTER_KEY:
-      return highlight;
+      selector->choice = selector->highlight;
+      return false;
     }
   }
+
+  for (int i = 0; i < selector->n_choices; i++) {
+    if (i == selector->highlight)
+      attron(A_STANDOUT);
+    mvprintw(selector->row_offset + i + 1, PRINTW_DEFAULT_X_OFFSET, "%u. %s", i + 1, selector->choices[i]);
+    if (i == selector->highlight)
+      attroff(A_STANDOUT);
+  }
+  refresh();
+  return true;
+}
+
+int choice_selector(int n_choices, const char *choices[],
+                    int row_offset) {
+  choice_selector_t selector = {.n_choices = n_choices, .choices = choices, .row_offset = row_offset};
+  tui_events_run(choice_selector_handle, &selector);
+  return selector.choice;
 }
 
 void clear_line_inplace(int y, int x) {
@@ -0,0 +1,627 @@
+#include "locker_vfs.h"
+#include "locker_crypto.h"
+#include "locker_logs.h"
+#include "sodium/crypto_aead_xchacha20poly1305.h"
+#include "sodium/utils.h"
+#include "sqlite3.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOCKER_VFS_AD_LEN 9
+#define LOCKER_VFS_DOMAIN_DB 'D'
+#define LOCKER_VFS_DOMAIN_JOURNAL 'J'
+
+typedef struct {
+  /* -1 when empty */
+  sqlite3_int64 index;
+  uint64_t generation;
+} locker_vfs_slot_t;
+
+typedef struct {
+  sqlite3_file base;
+  sqlite3_file *real;
+  sqlite3_int64 data_offset;
+  unsigned char domain;
+  locker_crypto_masterkey_t *key;
+  unsigned char *block;
+  /* the writer marks what it writes, a reader checks what it keeps */
+  locker_vfs_versions_t *versions;
+  /* readers only, block i lives in slot i % LOCKER_VFS_READER_BLOCKS */
+  locker_vfs_slot_t *slots;
+  unsigned char *slot_blocks;
+  unsigned char frame[LOCKER_VFS_FRAME_SIZE];
+} locker_vfs_file_t;
+
+static pthread_mutex_t vfs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * sqlite opens the main database file from inside sqlite3_open_v2, so the key
+ * is handed over to xOpen through this slot while vfs_mutex is held.
+ */
+static const locker_vfs_params_t *pending_params = NULL;
+
+#define ROOT_VFS(vfs) ((sqlite3_vfs *)(vfs)->pAppData)
+
+static sqlite3_int64 frame_offset(const locker_vfs_file_t *f,
+                                  sqlite3_int64 index) {
+  return f->data_offset + index * LOCKER_VFS_FRAME_SIZE;
+}
+
+static void block_ad(const locker_vfs_file_t *f, sqlite3_int64 index,
+                     unsigned char ad[LOCKER_VFS_AD_LEN]) {
+  /* bind every frame to its position so frames cannot be swapped around */
+  ad[0] = f->domain;
+  for (int i = 0; i < 8; i++)
+    ad[i + 1] = (unsigned char)((sqlite3_uint64)index >> (8 * i));
+}
+
+static int block_count(locker_vfs_file_t *f, sqlite3_int64 *count) {
+  sqlite3_int64 size;
+  int rc = f->real->pMethods->xFileSize(f->real, &size);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  *count = size <= f->data_offset
+               ? 0
+               : (size - f->data_offset) / LOCKER_VFS_FRAME_SIZE;
+  return SQLITE_OK;
+}
+
+static int read_block(locker_vfs_file_t *f, sqlite3_int64 index,
+                      unsigned char block[LOCKER_VFS_BLOCK_SIZE]) {
+  int rc = f->real->pMethods->xRead(f->real, f->frame, LOCKER_VFS_FRAME_SIZE,
+                                    frame_offset(f, index));
+  if (rc != SQLITE_OK)
+    return rc;
+
+  unsigned char ad[LOCKER_VFS_AD_LEN];
+  block_ad(f, index, ad);
+
+  if (crypto_aead_xchacha20poly1305_ietf_decrypt(
+          block, NULL, NULL, f->frame + LOCKER_CRYPTO_NONCE_LEN,
+          LOCKER_VFS_FRAME_SIZE - LOCKER_CRYPTO_NONCE_LEN, ad, sizeof(ad),
+          f->frame, f->key) != 0) {
+    return SQLITE_IOERR_DATA;
+  }
+
+  return SQLITE_OK;
+}
+
+static void mark_written(locker_vfs_versions_t *versions, sqlite3_int64 index) {
+  if (index >= versions->n_blocks) {
+    sqlite3_int64 n = versions->n_blocks * 2 > index ? versions->n_blocks * 2
+                                                     : index + 1;
+    uint64_t *grown =
+        realloc(versions->block_generations, (size_t)n * sizeof(uint64_t));
+    if (!grown) {
+      perror("realloc");
+      exit(EXIT_FAILURE);
+    }
+    memset(grown + versions->n_blocks, 0,
+           (size_t)(n - versions->n_blocks) * sizeof(uint64_t));
+    versions->block_generations = grown;
+    versions->n_blocks = n;
+  }
+  versions->block_generations[index] = versions->generation + 1;
+}
+
+static int write_block(locker_vfs_file_t *f, sqlite3_int64 index) {
+  if (f->versions)
+    mark_written(f->versions, index);
+
+  unsigned char ad[LOCKER_VFS_AD_LEN];
+  block_ad(f, index, ad);
+
+  /* fresh random nonce on every write, XChaCha20 nonces are wide enough */
+  generate_nonce(f->frame);
+  crypto_aead_xchacha20poly1305_ietf_encrypt(
+      f->frame + LOCKER_CRYPTO_NONCE_LEN, NULL, f->block,
+      LOCKER_VFS_BLOCK_SIZE, ad, sizeof(ad), NULL, f->frame, f->key);
+
+  return f->real->pMethods->xWrite(f->real, f->frame, LOCKER_VFS_FRAME_SIZE,
+                                   frame_offset(f, index));
+}
+
+/*
+ * The open write transaction of the primary connection pins page 1, so the
+ * file keeps it as of the last commit while later pages are flushed. Its page
+ * count may be short, a version-valid-for number that differs from the change
+ * counter makes sqlite count the pages by the file size instead.
+ */
+static void reader_header(unsigned char block[LOCKER_VFS_BLOCK_SIZE]) {
+  for (int i = 0; i < 4; i++)
+    block[92 + i] = block[24 + i] ^ 0xff;
+}
+
+static int vfs_close(sqlite3_file *file) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  int rc = f->real->pMethods->xClose(f->real);
+
+  sodium_free(f->key);
+  sodium_free(f->block);
+  free(f->slots);
+  sodium_free(f->slot_blocks);
+  return rc;
+}
+
+static int vfs_read(sqlite3_file *file, void *buffer, int amount,
+                    sqlite3_int64 offset) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  unsigned char *out = buffer;
+
+  while (amount > 0) {
+    sqlite3_int64 index = offset / LOCKER_VFS_BLOCK_SIZE;
+    int in_block = offset % LOCKER_VFS_BLOCK_SIZE;
+    int n = LOCKER_VFS_BLOCK_SIZE - in_block;
+    if (n > amount)
+      n = amount;
+
+    int rc = read_block(f, index, f->block);
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+      /* sqlite expects the unread tail to be zeroed */
+      memset(out, 0, amount);
+      return SQLITE_IOERR_SHORT_READ;
+    }
+    if (rc != SQLITE_OK)
+      return rc;
+
+    memcpy(out, f->block + in_block, n);
+    out += n;
+    offset += n;
+    amount -= n;
+  }
+
+  return SQLITE_OK;
+}
+
+static int vfs_write(sqlite3_file *file, const void *buffer, int amount,
+                     sqlite3_int64 offset) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  const unsigned char *in = buffer;
+
+  sqlite3_int64 n_blocks;
+  int rc = block_count(f, &n_blocks);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  /* a write past the end must not leave holes that would fail to decrypt */
+  memset(f->block, 0, LOCKER_VFS_BLOCK_SIZE);
+  for (; n_blocks < offset / LOCKER_VFS_BLOCK_SIZE; n_blocks++) {
+    rc = write_block(f, n_blocks);
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+
+  while (amount > 0) {
+    sqlite3_int64 index = offset / LOCKER_VFS_BLOCK_SIZE;
+    int in_block = offset % LOCKER_VFS_BLOCK_SIZE;
+    int n = LOCKER_VFS_BLOCK_SIZE - in_block;
+    if (n > amount)
+      n = amount;
+
+    if (n != LOCKER_VFS_BLOCK_SIZE) {
+      if (index < n_blocks) {
+        rc = read_block(f, index, f->block);
+        if (rc != SQLITE_OK)
+          return rc;
+      } else {
+        memset(f->block, 0, LOCKER_VFS_BLOCK_SIZE);
+      }
+    }
+
+    memcpy(f->block + in_block, in, n);
+    rc = write_block(f, index);
+    if (rc != SQLITE_OK)
+      return rc;
+
+    if (index >= n_blocks)
+      n_blocks = index + 1;
+
+    in += n;
+    offset += n;
+    amount -= n;
+  }
+
+  return SQLITE_OK;
+}
+
+static int vfs_truncate(sqlite3_file *file, sqlite3_int64 size) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  sqlite3_int64 n_blocks =
+      (size + LOCKER_VFS_BLOCK_SIZE - 1) / LOCKER_VFS_BLOCK_SIZE;
+  return f->real->pMethods->xTruncate(f->real, frame_offset(f, n_blocks));
+}
+
+static int vfs_sync(sqlite3_file *file, int flags) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  return f->real->pMethods->xSync(f->real, flags);
+}
+
+static int vfs_file_size(sqlite3_file *file, sqlite3_int64 *size) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  sqlite3_int64 n_blocks;
+  int rc = block_count(f, &n_blocks);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  *size = n_blocks * LOCKER_VFS_BLOCK_SIZE;
+  return SQLITE_OK;
+}
+
+static int vfs_lock(sqlite3_file *file, int lock) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  return f->real->pMethods->xLock(f->real, lock);
+}
+
+static int vfs_unlock(sqlite3_file *file, int lock) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  return f->real->pMethods->xUnlock(f->real, lock);
+}
+
+static int vfs_check_reserved_lock(sqlite3_file *file, int *out) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  return f->real->pMethods->xCheckReservedLock(f->real, out);
+}
+
+static int vfs_file_control(sqlite3_file *file, int op, void *arg) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  return f->real->pMethods->xFileControl(f->real, op, arg);
+}
+
+static int vfs_sector_size(sqlite3_file *file) {
+  (void)file;
+  return LOCKER_VFS_BLOCK_SIZE;
+}
+
+static int vfs_device_characteristics(sqlite3_file *file) {
+  /*
+   * a partial block write rewrites the whole frame, so none of the atomic or
+   * powersafe-overwrite guarantees of the underlying file hold
+   */
+  (void)file;
+  return 0;
+}
+
+/* version 1 methods: no shared memory and no mmap, so WAL cannot be used */
+static const sqlite3_io_methods locker_vfs_io_methods = {
+    .iVersion = 1,
+    .xClose = vfs_close,
+    .xRead = vfs_read,
+    .xWrite = vfs_write,
+    .xTruncate = vfs_truncate,
+    .xSync = vfs_sync,
+    .xFileSize = vfs_file_size,
+    .xLock = vfs_lock,
+    .xUnlock = vfs_unlock,
+    .xCheckReservedLock = vfs_check_reserved_lock,
+    .xFileControl = vfs_file_control,
+    .xSectorSize = vfs_sector_size,
+    .xDeviceCharacteristics = vfs_device_characteristics,
+};
+
+/* the slot of block index, decrypted again when it was written since */
+static int reader_block(locker_vfs_file_t *f, sqlite3_int64 index,
+                        unsigned char *block[static 1]) {
+  const locker_vfs_versions_t *versions = f->versions;
+  size_t i = (size_t)(index % LOCKER_VFS_READER_BLOCKS);
+  locker_vfs_slot_t *slot = &f->slots[i];
+  *block = f->slot_blocks + i * LOCKER_VFS_BLOCK_SIZE;
+
+  uint64_t written =
+      index < versions->n_blocks ? versions->block_generations[index] : 0;
+  if (slot->index == index && slot->generation >= written)
+    return SQLITE_OK;
+
+  slot->index = -1;
+  int rc = read_block(f, index, *block);
+  if (rc != SQLITE_OK)
+    return rc;
+
+  if (index == 0)
+    reader_header(*block);
+  slot->index = index;
+  slot->generation = versions->generation;
+  return SQLITE_OK;
+}
+
+static int reader_read(sqlite3_file *file, void *buffer, int amount,
+                       sqlite3_int64 offset) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  unsigned char *out = buffer;
+
+  while (amount > 0) {
+    sqlite3_int64 index = offset / LOCKER_VFS_BLOCK_SIZE;
+    int in_block = offset % LOCKER_VFS_BLOCK_SIZE;
+    int n = LOCKER_VFS_BLOCK_SIZE - in_block;
+    if (n > amount)
+      n = amount;
+
+    unsigned char *block;
+    int rc = reader_block(f, index, &block);
+    if (rc == SQLITE_IOERR_SHORT_READ) {
+      memset(out, 0, amount);
+      return SQLITE_IOERR_SHORT_READ;
+    }
+    if (rc != SQLITE_OK)
+      return rc;
+
+    memcpy(out, block + in_block, n);
+    out += n;
+    offset += n;
+    amount -= n;
+  }
+
+  return SQLITE_OK;
+}
+
+static int reader_write(sqlite3_file *file, const void *buffer, int amount,
+                        sqlite3_int64 offset) {
+  (void)file;
+  (void)buffer;
+  (void)amount;
+  (void)offset;
+  return SQLITE_READONLY;
+}
+
+static int reader_truncate(sqlite3_file *file, sqlite3_int64 size) {
+  (void)file;
+  (void)size;
+  return SQLITE_READONLY;
+}
+
+static int reader_lock(sqlite3_file *file, int lock) {
+  (void)file;
+  (void)lock;
+  return SQLITE_OK;
+}
+
+static int reader_check_reserved_lock(sqlite3_file *file, int *out) {
+  (void)file;
+  *out = 0;
+  return SQLITE_OK;
+}
+
+static const sqlite3_io_methods locker_vfs_reader_io_methods = {
+    .iVersion = 1,
+    .xClose = vfs_close,
+    .xRead = reader_read,
+    .xWrite = reader_write,
+    .xTruncate = reader_truncate,
+    .xSync = vfs_sync,
+    .xFileSize = vfs_file_size,
+    .xLock = reader_lock,
+    .xUnlock = reader_lock,
+    .xCheckReservedLock = reader_check_reserved_lock,
+    .xFileControl = vfs_file_control,
+    .xSectorSize = vfs_sector_size,
+    .xDeviceCharacteristics = vfs_device_characteristics,
+};
+
+static sqlite3_vfs locker_vfs_reader;
+
+static int vfs_open(sqlite3_vfs *vfs, sqlite3_filename name, sqlite3_file *file,
+                    int flags, int *out_flags) {
+  locker_vfs_file_t *f = (locker_vfs_file_t *)file;
+  memset(f, 0, sizeof(locker_vfs_file_t));
+
+  const locker_crypto_masterkey_t *key;
+  bool reader = vfs == &locker_vfs_reader;
+  if (reader && (!(flags & SQLITE_OPEN_MAIN_DB) || !pending_params ||
+                 !pending_params->versions)) {
+    /* a read-only connection has no business with any other file */
+    log_message("Locker reader VFS refused to open file with flags 0x%x.",
+                flags);
+    return SQLITE_CANTOPEN;
+  }
+
+  if (flags & SQLITE_OPEN_MAIN_DB) {
+    if (!pending_params)
+      return SQLITE_CANTOPEN;
+
+    key = pending_params->key;
+    f->data_offset = pending_params->data_offset;
+    f->domain = LOCKER_VFS_DOMAIN_DB;
+  } else if (flags & SQLITE_OPEN_MAIN_JOURNAL) {
+    const locker_vfs_file_t *db =
+        (const locker_vfs_file_t *)sqlite3_database_file_object(name);
+
+    key = db->key;
+    f->data_offset = 0;
+    f->domain = LOCKER_VFS_DOMAIN_JOURNAL;
+  } else {
+    /* refuse anything else, plaintext temp files must never touch the disk */
+    log_message("Locker VFS refused to open file with flags 0x%x.", flags);
+    return SQLITE_CANTOPEN;
+  }
+
+  f->key = sodium_malloc(LOCKER_CRYPTO_MASTER_KEY_LEN);
+  f->block = sodium_malloc(LOCKER_VFS_BLOCK_SIZE);
+  if (reader) {
+    f->versions = (locker_vfs_versions_t *)pending_params->versions;
+    f->slots = malloc(LOCKER_VFS_READER_BLOCKS * sizeof(locker_vfs_slot_t));
+    f->slot_blocks =
+        sodium_malloc(LOCKER_VFS_READER_BLOCKS * LOCKER_VFS_BLOCK_SIZE);
+  }
+  if (!f->key || !f->block || (reader && (!f->slots || !f->slot_blocks))) {
+    sodium_free(f->key);
+    sodium_free(f->block);
+    free(f->slots);
+    sodium_free(f->slot_blocks);
+    return SQLITE_NOMEM;
+  }
+  for (size_t i = 0; reader && i < LOCKER_VFS_READER_BLOCKS; i++)
+    f->slots[i].index = -1;
+  memcpy(f->key, key, LOCKER_CRYPTO_MASTER_KEY_LEN);
+
+  f->real = (sqlite3_file *)&f[1];
+  int rc = ROOT_VFS(vfs)->xOpen(ROOT_VFS(vfs), name, f->real, flags, out_flags);
+  if (rc != SQLITE_OK) {
+    if (f->real->pMethods)
+      f->real->pMethods->xClose(f->real);
+    sodium_free(f->key);
+    sodium_free(f->block);
+    free(f->slots);
+    sodium_free(f->slot_blocks);
+    return rc;
+  }
+
+  f->base.pMethods = reader ? &locker_vfs_reader_io_methods
+                            : &locker_vfs_io_methods;
+  return SQLITE_OK;
+}
+
+static int vfs_delete(sqlite3_vfs *vfs, const char *name, int sync_dir) {
+  return ROOT_VFS(vfs)->xDelete(ROOT_VFS(vfs), name, sync_dir);
+}
+
+static int vfs_access(sqlite3_vfs *vfs, const char *name, int flags,
+                      int *out) {
+  return ROOT_VFS(vfs)->xAccess(ROOT_VFS(vfs), name, flags, out);
+}
+
+/* no journal or WAL is hot for a reader, the owner of the locker rolls back */
+static int reader_access(sqlite3_vfs *vfs, const char *name, int flags,
+                         int *out) {
+  (void)vfs;
+  (void)name;
+  (void)flags;
+  *out = 0;
+  return SQLITE_OK;
+}
+
+static int vfs_full_pathname(sqlite3_vfs *vfs, const char *name, int n,
+                             char *out) {
+  return ROOT_VFS(vfs)->xFullPathname(ROOT_VFS(vfs), name, n, out);
+}
+
+static void *vfs_dl_open(sqlite3_vfs *vfs, const char *path) {
+  return ROOT_VFS(vfs)->xDlOpen(ROOT_VFS(vfs), path);
+}
+
+static void vfs_dl_error(sqlite3_vfs *vfs, int n, char *out) {
+  ROOT_VFS(vfs)->xDlError(ROOT_VFS(vfs), n, out);
+}
+
+static void (*vfs_dl_sym(sqlite3_vfs *vfs, void *handle, const char *sym))(void) {
+  return ROOT_VFS(vfs)->xDlSym(ROOT_VFS(vfs), handle, sym);
+}
+
+static void vfs_dl_close(sqlite3_vfs *vfs, void *handle) {
+  ROOT_VFS(vfs)->xDlClose(ROOT_VFS(vfs), handle);
+}
+
+static int vfs_randomness(sqlite3_vfs *vfs, int n, char *out) {
+  return ROOT_VFS(vfs)->xRandomness(ROOT_VFS(vfs), n, out);
+}
+
+static int vfs_sleep(sqlite3_vfs *vfs, int microseconds) {
+  return ROOT_VFS(vfs)->xSleep(ROOT_VFS(vfs), microseconds);
+}
+
+static int vfs_current_time(sqlite3_vfs *vfs, double *out) {
+  return ROOT_VFS(vfs)->xCurrentTime(ROOT_VFS(vfs), out);
+}
+
+static int vfs_get_last_error(sqlite3_vfs *vfs, int n, char *out) {
+  return ROOT_VFS(vfs)->xGetLastError(ROOT_VFS(vfs), n, out);
+}
+
+static int vfs_current_time_int64(sqlite3_vfs *vfs, sqlite3_int64 *out) {
+  return ROOT_VFS(vfs)->xCurrentTimeInt64(ROOT_VFS(vfs), out);
+}
+
+static sqlite3_vfs locker_vfs = {
+    .iVersion = 2,
+    .zName = LOCKER_VFS_NAME,
+    .xOpen = vfs_open,
+    .xDelete = vfs_delete,
+    .xAccess = vfs_access,
+    .xFullPathname = vfs_full_pathname,
+    .xDlOpen = vfs_dl_open,
+    .xDlError = vfs_dl_error,
+    .xDlSym = vfs_dl_sym,
+    .xDlClose = vfs_dl_close,
+    .xRandomness = vfs_randomness,
+    .xSleep = vfs_sleep,
+    .xCurrentTime = vfs_current_time,
+    .xGetLastError = vfs_get_last_error,
+    .xCurrentTimeInt64 = vfs_current_time_int64,
+};
+
+static sqlite3_vfs locker_vfs_reader = {
+    .iVersion = 2,
+    .zName = LOCKER_VFS_READER_NAME,
+    .xOpen = vfs_open,
+    .xDelete = vfs_delete,
+    .xAccess = reader_access,
+    .xFullPathname = vfs_full_pathname,
+    .xDlOpen = vfs_dl_open,
+    .xDlError = vfs_dl_error,
+    .xDlSym = vfs_dl_sym,
+    .xDlClose = vfs_dl_close,
+    .xRandomness = vfs_randomness,
+    .xSleep = vfs_sleep,
+    .xCurrentTime = vfs_current_time,
+    .xGetLastError = vfs_get_last_error,
+    .xCurrentTimeInt64 = vfs_current_time_int64,
+};
+
+int locker_vfs_register(void) {
+  pthread_mutex_lock(&vfs_mutex);
+
+  int rc = SQLITE_OK;
+  sqlite3_vfs *root = sqlite3_vfs_find(NULL);
+  if (!sqlite3_vfs_find(LOCKER_VFS_NAME)) {
+    locker_vfs.szOsFile = sizeof(locker_vfs_file_t) + root->szOsFile;
+    locker_vfs.mxPathname = root->mxPathname;
+    locker_vfs.pAppData = root;
+
+    rc = sqlite3_vfs_register(&locker_vfs, 0);
+  }
+  if (rc == SQLITE_OK && !sqlite3_vfs_find(LOCKER_VFS_READER_NAME)) {
+    locker_vfs_reader.szOsFile = locker_vfs.szOsFile;
+    locker_vfs_reader.mxPathname = root->mxPathname;
+    locker_vfs_reader.pAppData = root;
+
+    rc = sqlite3_vfs_register(&locker_vfs_reader, 0);
+  }
+
+  pthread_mutex_unlock(&vfs_mutex);
+  return rc;
+}
+
+int locker_vfs_open(const char path[static 1],
+                    const locker_vfs_params_t params[static 1], sqlite3 **db) {
+  pthread_mutex_lock(&vfs_mutex);
+  pending_params = params;
+
+  int rc = sqlite3_open_v2(path, db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                           LOCKER_VFS_NAME);
+
+  pending_params = NULL;
+  pthread_mutex_unlock(&vfs_mutex);
+  return rc;
+}
+
+int locker_vfs_open_reader(const char path[static 1],
+                           const locker_vfs_params_t params[static 1],
+                           sqlite3 **db) {
+  pthread_mutex_lock(&vfs_mutex);
+  pending_params = params;
+
+  int rc = sqlite3_open_v2(path, db, SQLITE_OPEN_READONLY,
+                           LOCKER_VFS_READER_NAME);
+
+  pending_params = NULL;
+  pthread_mutex_unlock(&vfs_mutex);
+  return rc;
+}
+
+void locker_vfs_track_writes(sqlite3 *db, locker_vfs_versions_t *versions) {
+  locker_vfs_file_t *f;
+  if (sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &f) ==
+      SQLITE_OK)
+    f->versions = versions;
+}